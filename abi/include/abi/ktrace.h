@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup generic
+ * @{
+ */
+/** @file
+ */
+
+#ifndef ABI_KTRACE_H_
+#define ABI_KTRACE_H_
+
+#include <stdint.h>
+
+/** Kernel tracepoint events.
+ *
+ * The argument layout of each event is documented next to its identifier.
+ */
+typedef enum {
+	/** Thread switch (thread ID, task ID, run queue) */
+	KTRACE_SCHED_SWITCH,
+	/** IPC call sent (call, caller task ID, callee task ID) */
+	KTRACE_IPC_CALL,
+	/** IPC call forwarded (call, forwarder task ID, new callee task ID) */
+	KTRACE_IPC_FORWARD,
+	/** IPC call answered (call, answering task ID, return value) */
+	KTRACE_IPC_ANSWER,
+	/** Page fault (faulting address, access type, program counter) */
+	KTRACE_PAGE_FAULT,
+	/** Interrupt dispatched (interrupt number, 0, 0) */
+	KTRACE_IRQ,
+	KTRACE_COUNT
+} ktrace_event_t;
+
+/** Tracing record as stored in the per-CPU rings. */
+typedef struct {
+	/**
+	 * CPU cycle counter at the time of the event. The counters of
+	 * different CPUs need not be synchronized, so only records of the
+	 * same CPU can be compared.
+	 */
+	uint64_t cycle;
+	/** Event type (ktrace_event_t) */
+	uint32_t event;
+	/** CPU which recorded the event */
+	uint32_t cpu;
+	/** Event arguments */
+	uint64_t arg[3];
+} ktrace_record_t;
+
+/** Size of the slot holding the head of a single per-CPU ring. */
+#define KTRACE_HEAD_SIZE  64
+
+/** Head of a per-CPU ring, alone in its own cache line. */
+typedef struct {
+	/** Number of records ever written to the ring */
+	volatile uint64_t head;
+	uint8_t pad[KTRACE_HEAD_SIZE - sizeof(uint64_t)];
+} ktrace_head_t;
+
+/** Header of the tracing area shared with userspace.
+ *
+ * The header is followed by @c cpus rings of @c capacity records each,
+ * the first of them starting @c offset bytes from the beginning of the
+ * area. Ring @c i holds the record number @c n in its slot
+ * <tt>n & (capacity - 1)</tt>.
+ *
+ * A reader copies the records it is interested in and then re-reads
+ * the head of the ring. A copied record number @c n is consistent if
+ * <tt>head - n < capacity</tt> holds for the re-read head.
+ */
+typedef struct {
+	/** Bitmask of enabled events, writable by the consumer */
+	volatile uint32_t mask;
+	/** Number of per-CPU rings */
+	uint32_t cpus;
+	/** Number of records in each ring (a power of two) */
+	uint32_t capacity;
+	/** Offset of the first ring from the beginning of the area */
+	uint32_t offset;
+	uint8_t pad[KTRACE_HEAD_SIZE - 4 * sizeof(uint32_t)];
+
+	/** Per-CPU ring heads */
+	ktrace_head_t ring[];
+} ktrace_header_t;
+
+#endif
+
+/** @}
+ */
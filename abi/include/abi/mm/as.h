@@ -44,6 +44,7 @@
 #define AS_AREA_CACHEABLE    0x08
 #define AS_AREA_GUARD        0x10
 #define AS_AREA_LATE_RESERVE 0x20
+#define AS_AREA_POPULATE     0x40
 
 #define AS_AREA_ANY    ((void *) -1)
 #define AS_MAP_FAILED  ((void *) -1)
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup generic
+ * @{
+ */
+/** @file
+ */
+
+#ifndef ABI_PROF_H_
+#define ABI_PROF_H_
+
+#include <stdint.h>
+
+/** Maximum number of program counters in a single sample */
+#define PROF_DEPTH  14
+
+/** The sample was taken while the thread was executing the kernel */
+#define PROF_SAMPLE_KERNEL  0x1
+
+/** Sample of a profiled thread */
+typedef struct {
+	/** ID of the sampled thread */
+	uint64_t thread_id;
+	/** Sample flags (PROF_SAMPLE_*) */
+	uint32_t flags;
+	/** Number of valid entries in @c pc */
+	uint32_t depth;
+	/**
+	 * Interrupted userspace program counter followed by the return
+	 * addresses found by walking the frame pointer chain.
+	 */
+	uint64_t pc[PROF_DEPTH];
+} prof_sample_t;
+
+/** Header of the sample area shared with userspace.
+ *
+ * The header is followed by @c capacity samples, the first of them
+ * starting @c offset bytes from the beginning of the area. The sample
+ * number @c n is stored in the slot <tt>n & (capacity - 1)</tt>.
+ *
+ * A reader copies the samples it is interested in and then re-reads
+ * @c head. A copied sample number @c n is consistent if
+ * <tt>head - n < capacity</tt> holds for the re-read head.
+ */
+typedef struct {
+	/** ID of the profiled task or zero if profiling is stopped */
+	volatile uint64_t task_id;
+	/** Number of samples taken since profiling was started */
+	volatile uint64_t head;
+	/** Number of sample slots (a power of two) */
+	uint32_t capacity;
+	/** Offset of the first sample from the beginning of the area */
+	uint32_t offset;
+} prof_header_t;
+
+#endif
+
+/** @}
+ */
@@ -48,6 +48,9 @@
 #define TASK_NAME_BUFLEN  20
 #define EXC_NAME_BUFLEN   20
 
+/** Number of syscall latency histogram buckets */
+#define STATS_SYSCALL_BUCKETS  32
+
 /** Item value type
  *
  */
@@ -122,6 +125,21 @@ typedef struct {
 	unsigned int cpu;       /**< Associated CPU ID (if on_cpu is true) */
 } stats_thread_t;
 
+/** Incremental task or thread statistics
+ *
+ * The header is followed by @c changed statistics records (stats_task_t
+ * or stats_thread_t) of the objects which changed or appeared since the
+ * generation passed to the query and by @c removed IDs of the objects
+ * which have ceased to exist since then.
+ *
+ */
+typedef struct {
+	uint64_t generation;  /**< Generation to pass to the next query */
+	bool full;            /**< All objects are included, forget the rest */
+	size_t changed;       /**< Number of changed or new objects */
+	size_t removed;       /**< Number of removed objects */
+} stats_delta_t;
+
 /** Statistics about a single exception
  *
  */
@@ -133,6 +151,19 @@ typedef struct {
 	uint64_t count;              /**< Number of handled exceptions */
 } stats_exc_t;
 
+/** Statistics about a single syscall
+ *
+ * Bucket i of the histogram counts the calls which took
+ * between 2^i and 2^(i + 1) - 1 CPU cycles.
+ *
+ */
+typedef struct {
+	unsigned int id;                        /**< Syscall number */
+	uint64_t count;                         /**< Number of calls */
+	uint64_t cycles;                        /**< Total CPU cycles */
+	uint64_t hist[STATS_SYSCALL_BUCKETS];   /**< Latency histogram */
+} stats_syscall_t;
+
 /** Load fixed-point value */
 typedef uint32_t load_t;
 
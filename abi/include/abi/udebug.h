@@ -150,7 +150,19 @@ typedef enum { /* udebug_method_t */
 	 * - ARG4 - size of receiving buffer in bytes
 	 *
 	 */
-	UDEBUG_M_MEM_READ
+	UDEBUG_M_MEM_READ,
+
+	/** Start sampling the program counters of the debugged task.
+	 *
+	 * The samples are stored in the physical area published in sysinfo
+	 * as "prof.faddr" and "prof.pages". Only one task can be profiled
+	 * at a time.
+	 *
+	 */
+	UDEBUG_M_PROF_START,
+
+	/** Stop sampling the program counters of the debugged task. */
+	UDEBUG_M_PROF_STOP
 } udebug_method_t;
 
 typedef enum {
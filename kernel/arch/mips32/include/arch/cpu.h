@@ -41,6 +41,9 @@
 typedef struct {
 	uint32_t imp_num;
 	uint32_t rev_num;
+
+	/** Count register value of the next periodic clock interrupt */
+	unsigned long nextcount;
 } cpu_arch_t;
 
 #endif
@@ -46,6 +46,7 @@ extern function virtual_timer_fnc;
 extern uint32_t count_hi;
 
 extern void interrupt_init(void);
+extern void timer_start(void);
 
 #endif
 
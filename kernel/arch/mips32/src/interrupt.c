@@ -58,7 +58,6 @@ static irq_t dorder_irq;
 // TODO: This is SMP unsafe!!!
 
 uint32_t count_hi = 0;
-static unsigned long nextcount;
 static unsigned long lastcount;
 
 /** Disable interrupts.
@@ -111,14 +110,18 @@ bool interrupts_disabled(void)
 	return !(cp0_status_read() & cp0_status_ie_enabled_bit);
 }
 
-/** Start hardware clock
+/** Start hardware clock on the current CPU
+ *
+ * Must be called after the CPU structure has been initialized,
+ * because the clock deadline is kept per CPU.
  *
  */
-static void timer_start(void)
+void timer_start(void)
 {
 	lastcount = cp0_count_read();
-	nextcount = cp0_compare_value + cp0_count_read();
-	cp0_compare_write(nextcount);
+	CPU->arch.nextcount = cp0_compare_value + cp0_count_read();
+	cp0_compare_write(CPU->arch.nextcount);
+	cp0_unmask_int(TIMER_IRQ);
 }
 
 static irq_ownership_t timer_claim(irq_t *irq)
@@ -134,14 +137,14 @@ static void timer_irq_handler(irq_t *irq)
 
 	lastcount = cp0_count_read();
 
-	unsigned long drift = cp0_count_read() - nextcount;
+	unsigned long drift = cp0_count_read() - CPU->arch.nextcount;
 	while (drift > cp0_compare_value) {
 		drift -= cp0_compare_value;
 		CPU->missed_clock_ticks++;
 	}
 
-	nextcount = cp0_count_read() + cp0_compare_value - drift;
-	cp0_compare_write(nextcount);
+	CPU->arch.nextcount = cp0_count_read() + cp0_compare_value - drift;
+	cp0_compare_write(CPU->arch.nextcount);
 
 	/*
 	 * We are holding a lock which prevents preemption.
@@ -155,6 +158,51 @@ static void timer_irq_handler(irq_t *irq)
 		virtual_timer_fnc();
 }
 
+#ifdef CONFIG_TICKLESS
+
+/** Let the next clock interrupt come after the given number of ticks
+ *
+ * The periodic deadline in CPU->arch.nextcount is kept, so that the
+ * timer interrupt handler accounts the skipped ticks as missed ones.
+ *
+ * @param ticks Number of clock ticks to skip.
+ *
+ */
+void clock_arch_oneshot(size_t ticks)
+{
+	cp0_compare_write(CPU->arch.nextcount +
+	    (ticks - 1) * cp0_compare_value);
+}
+
+/** Resume periodic clock interrupts */
+void clock_arch_periodic(void)
+{
+	unsigned long now = cp0_count_read();
+
+	if ((long) (CPU->arch.nextcount - now) > 0) {
+		cp0_compare_write(CPU->arch.nextcount);
+	} else {
+		/*
+		 * The periodic deadline has passed already, let the
+		 * interrupt come soon to catch up with the missed ticks.
+		 */
+		cp0_compare_write(now + cp0_compare_value / 4);
+	}
+}
+
+/** Get number of elapsed ticks not processed by the timer interrupt yet */
+size_t clock_arch_pending(void)
+{
+	unsigned long now = cp0_count_read();
+
+	if ((long) (now - CPU->arch.nextcount) < 0)
+		return 0;
+
+	return (now - CPU->arch.nextcount) / cp0_compare_value + 1;
+}
+
+#endif /* CONFIG_TICKLESS */
+
 #ifdef MACHINE_msim
 static irq_ownership_t dorder_claim(irq_t *irq)
 {
@@ -178,9 +226,6 @@ void interrupt_init(void)
 	timer_irq.handler = timer_irq_handler;
 	irq_register(&timer_irq);
 
-	timer_start();
-	cp0_unmask_int(TIMER_IRQ);
-
 #ifdef MACHINE_msim
 	irq_initialize(&dorder_irq);
 	dorder_irq.inr = DORDER_IRQ;
@@ -59,11 +59,13 @@
 
 static void mips32_pre_mm_init(void);
 static void mips32_post_mm_init(void);
+static void mips32_post_cpu_init(void);
 static void mips32_post_smp_init(void);
 
 arch_ops_t mips32_ops = {
 	.pre_mm_init = mips32_pre_mm_init,
 	.post_mm_init = mips32_post_mm_init,
+	.post_cpu_init = mips32_post_cpu_init,
 	.post_smp_init = mips32_post_smp_init,
 };
 
@@ -147,6 +149,11 @@ void mips32_post_mm_init(void)
 	machine_output_init();
 }
 
+void mips32_post_cpu_init(void)
+{
+	timer_start();
+}
+
 void mips32_post_smp_init(void)
 {
 	/* Set platform name. */
@@ -35,6 +35,9 @@
 #include <stdint.h>
 #include <smp/ipi.h>
 #include <arch/smp/dorder.h>
+#include <cpu/cpu_mask.h>
+#include <cpu.h>
+#include <arch.h>
 
 #define MSIM_DORDER_ADDRESS  0xB0000100
 
@@ -45,6 +48,19 @@ void ipi_broadcast_arch(int ipi)
 	*((volatile uint32_t *) MSIM_DORDER_ADDRESS) = 0x7fffffff;
 }
 
+void ipi_multicast_arch(cpu_mask_t *mask, int ipi)
+{
+	uint32_t dest = 0;
+
+	cpu_mask_for_each(*mask, i) {
+		if ((i != CPU->id) && (i < 31))
+			dest |= 1 << i;
+	}
+
+	if (dest != 0)
+		*((volatile uint32_t *) MSIM_DORDER_ADDRESS) = dest;
+}
+
 #endif
 
 uint32_t dorder_cpuid(void)
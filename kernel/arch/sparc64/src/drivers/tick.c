@@ -124,5 +124,51 @@ void tick_interrupt(unsigned int n, istate_t *istate)
 	clock();
 }
 
+#ifdef CONFIG_TICKLESS
+
+/** Let the next tick interrupt come after the given number of ticks
+ *
+ * The periodic deadline in next_tick_cmpr is kept, so that the tick
+ * interrupt handler accounts the skipped ticks as missed ones.
+ *
+ * @param ticks Number of clock ticks to skip.
+ *
+ */
+void clock_arch_oneshot(size_t ticks)
+{
+	tick_compare_write(CPU->arch.next_tick_cmpr +
+	    (ticks - 1) * (CPU->arch.clock_frequency / HZ));
+}
+
+/** Resume periodic tick interrupts */
+void clock_arch_periodic(void)
+{
+	uint64_t now = tick_counter_read();
+
+	if (CPU->arch.next_tick_cmpr > now) {
+		tick_compare_write(CPU->arch.next_tick_cmpr);
+	} else {
+		/*
+		 * The periodic deadline has passed already, let the
+		 * interrupt come soon to catch up with the missed ticks.
+		 */
+		tick_compare_write(now + CPU->arch.clock_frequency / HZ / 4);
+	}
+}
+
+/** Get number of elapsed ticks not processed by the tick interrupt yet */
+size_t clock_arch_pending(void)
+{
+	uint64_t now = tick_counter_read();
+
+	if (now < CPU->arch.next_tick_cmpr)
+		return 0;
+
+	return (now - CPU->arch.next_tick_cmpr) /
+	    (CPU->arch.clock_frequency / HZ) + 1;
+}
+
+#endif /* CONFIG_TICKLESS */
+
 /** @}
  */
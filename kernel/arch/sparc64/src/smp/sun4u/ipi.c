@@ -40,6 +40,7 @@
 #include <arch/cpu.h>
 #include <arch/asm.h>
 #include <config.h>
+#include <cpu/cpu_mask.h>
 #include <mm/tlb.h>
 #include <smp/smp_call.h>
 #include <arch/interrupt.h>
@@ -173,6 +174,35 @@ void ipi_broadcast_arch(int ipi)
 	}
 }
 
+/*
+ * Deliver IPI to a set of processors except the current one.
+ *
+ * We assume that interrupts are disabled.
+ *
+ * @param mask Destination processors.
+ * @param ipi  IPI number.
+ */
+void ipi_multicast_arch(cpu_mask_t *mask, int ipi)
+{
+	void (*func)(void);
+
+	switch (ipi) {
+	case IPI_TLB_SHOOTDOWN:
+		func = tlb_shootdown_ipi_recv;
+		break;
+	default:
+		panic("Unknown IPI (%d).\n", ipi);
+		break;
+	}
+
+	cpu_mask_for_each(*mask, i) {
+		if ((i >= config.cpu_active) || (&cpus[i] == CPU))
+			continue;
+
+		cross_call(cpus[i].arch.mid, func);
+	}
+}
+
 
 /*
  * Deliver an IPI to the specified processors (except the current one).
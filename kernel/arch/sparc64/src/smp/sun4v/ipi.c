@@ -35,6 +35,7 @@
 #include <smp/ipi.h>
 #include <cpu.h>
 #include <config.h>
+#include <cpu/cpu_mask.h>
 #include <interrupt.h>
 #include <arch/asm.h>
 #include <arch/cpu.h>
@@ -121,5 +122,39 @@ void ipi_broadcast_arch(int ipi)
 	ipi_brodcast_to(func, ipi_cpu_list[CPU->arch.id], idx);
 }
 
+/*
+ * Deliver IPI to a set of processors except the current one.
+ *
+ * We assume that interrupts are disabled.
+ *
+ * @param mask Destination processors.
+ * @param ipi  IPI number.
+ */
+void ipi_multicast_arch(cpu_mask_t *mask, int ipi)
+{
+	void (*func)(void);
+
+	switch (ipi) {
+	case IPI_TLB_SHOOTDOWN:
+		func = tlb_shootdown_ipi_recv;
+		break;
+	default:
+		panic("Unknown IPI (%d).\n", ipi);
+		break;
+	}
+
+	unsigned idx = 0;
+	cpu_mask_for_each(*mask, i) {
+		if ((i >= config.cpu_active) || (&cpus[i] == CPU))
+			continue;
+
+		ipi_cpu_list[CPU->id][idx] = (uint16_t) cpus[i].id;
+		idx++;
+	}
+
+	if (idx > 0)
+		ipi_brodcast_to(func, ipi_cpu_list[CPU->arch.id], idx);
+}
+
 /** @}
  */
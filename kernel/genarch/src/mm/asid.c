@@ -60,6 +60,7 @@
 #include <mm/asid.h>
 #include <mm/as.h>
 #include <mm/tlb.h>
+#include <cpu/cpu_mask.h>
 #include <arch/mm/asid.h>
 #include <synch/spinlock.h>
 #include <synch/mutex.h>
@@ -127,6 +128,15 @@ asid_t asid_get(void)
 		 */
 		ipl_t ipl = tlb_shootdown_start(TLB_INVL_ASID, asid, 0, 0);
 		tlb_invalidate_asid(asid);
+
+		/*
+		 * No processor holds translations of the address space
+		 * any more, so it need not receive its shootdowns until
+		 * it is switched to again.
+		 */
+		if (as->cpu_mask)
+			cpu_mask_none(as->cpu_mask);
+
 		tlb_shootdown_finalize(ipl);
 	} else {
 
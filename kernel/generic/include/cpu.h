@@ -38,11 +38,14 @@
 #include <mm/tlb.h>
 #include <synch/spinlock.h>
 #include <synch/rcu_types.h>
+#include <time/timeout_types.h>
 #include <proc/scheduler.h>
 #include <arch/cpu.h>
 #include <arch/context.h>
 #include <adt/list.h>
 #include <arch.h>
+#include <abi/syscall.h>
+#include <abi/sysinfo.h>
 
 #define CPU                  THE->cpu
 
@@ -64,7 +67,7 @@ typedef struct cpu {
 	volatile size_t needs_relink;
 
 	IRQ_SPINLOCK_DECLARE(timeoutlock);
-	list_t timeout_active_list;
+	timeout_wheel_t timeout_wheel;
 
 	/**
 	 * When system clock loses a tick, it is
@@ -75,6 +78,12 @@ typedef struct cpu {
 	 */
 	size_t missed_clock_ticks;
 
+	/**
+	 * Periodic clock is stopped while the processor is idle.
+	 * Only accessed with interrupts disabled.
+	 */
+	bool tickless;
+
 	/**
 	 * Processor cycle accounting.
 	 */
@@ -83,6 +92,13 @@ typedef struct cpu {
 	uint64_t idle_cycles;
 	uint64_t busy_cycles;
 
+#ifdef CONFIG_SYSCALL_STATS
+	/**
+	 * Syscall latency statistics of syscalls finished on this
+	 * processor. Only accessed with interrupts disabled.
+	 */
+	stats_syscall_t syscall_stats[SYSCALL_END];
+#endif
 	/**
 	 * Processor ID assigned by kernel.
 	 */
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup genericdebug
+ * @{
+ */
+/** @file
+ */
+
+#ifndef KERN_KTRACE_H_
+#define KERN_KTRACE_H_
+
+#include <abi/ktrace.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef CONFIG_KTRACE
+
+extern volatile uint32_t *ktrace_mask;
+
+extern void ktrace_init(void);
+extern void ktrace_record(ktrace_event_t, uint64_t, uint64_t, uint64_t);
+
+/** Check whether the event is enabled by the consumer. */
+static inline bool ktrace_enabled(ktrace_event_t event)
+{
+	return (*ktrace_mask & (1U << event)) != 0;
+}
+
+/** Static tracepoint.
+ *
+ * The arguments are evaluated only if the event is enabled, so that
+ * a disabled tracepoint costs just a load and a branch.
+ */
+#define KTRACE(event, arg0, arg1, arg2) \
+	do { \
+		if (ktrace_enabled(event)) \
+			ktrace_record((event), (uint64_t) (arg0), \
+			    (uint64_t) (arg1), (uint64_t) (arg2)); \
+	} while (0)
+
+#else /* CONFIG_KTRACE */
+
+#define ktrace_init()
+
+#define KTRACE(event, arg0, arg1, arg2)
+
+#endif /* CONFIG_KTRACE */
+
+#endif
+
+/** @}
+ */
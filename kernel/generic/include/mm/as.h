@@ -82,6 +82,14 @@
 /** The page fault was not resolved by as_page_fault(). Non-verbose version. */
 #define AS_PF_SILENT 3
 
+/**
+ * Maximum number of pages mapped after a faulting page of an area which is
+ * being accessed sequentially. Zero disables fault-around.
+ */
+#ifndef AS_FAULT_AROUND
+#define AS_FAULT_AROUND  15
+#endif
+
 /** Address space structure.
  *
  * as_t contains the list of as_areas of userspace accessible
@@ -109,6 +117,14 @@ typedef struct as {
 	 */
 	asid_t asid;
 
+	/**
+	 * Processors which might hold TLB entries of this address space
+	 * and therefore receive its TLB shootdowns. NULL for the kernel
+	 * address space, whose shootdowns are broadcast. Protected by
+	 * tlblock, reset when the ASID is stolen.
+	 */
+	struct cpu_mask *cpu_mask;
+
 	/** Number of references (i.e. tasks that reference this as). */
 	atomic_t refcount;
 
@@ -117,6 +133,18 @@ typedef struct as {
 	/** B+tree of address space areas. */
 	btree_t as_area_btree;
 
+	/** Number of pages in all address space areas. Protected by lock. */
+	size_t pages;
+
+	/**
+	 * Number of resident pages in all address space areas. Protected by
+	 * lock.
+	 */
+	size_t resident;
+
+	/** Statistics generation of the last change, see stats_as_touch(). */
+	atomic_count_t stats_gen;
+
 	/** Non-generic content. */
 	as_genarch_t genarch;
 
@@ -243,6 +271,8 @@ typedef struct mem_backend {
 
 	bool (*is_resizable)(as_area_t *);
 	bool (*is_shareable)(as_area_t *);
+	/** Pages can be mapped before being accessed (fault-around). */
+	bool (*is_prefaultable)(as_area_t *);
 
 	int (*page_fault)(as_area_t *, uintptr_t, pf_access_t);
 	void (*frame_free)(as_area_t *, uintptr_t, uintptr_t);
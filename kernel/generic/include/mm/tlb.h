@@ -64,23 +64,30 @@ typedef struct {
 	size_t count;			/**< Number of pages to invalidate. */
 } tlb_shootdown_msg_t;
 
+struct cpu_mask;
+
 extern void tlb_init(void);
 
 #ifdef CONFIG_SMP
 extern ipl_t tlb_shootdown_start(tlb_invalidate_type_t, asid_t, uintptr_t,
     size_t);
+extern ipl_t tlb_shootdown_mask_start(struct cpu_mask *,
+    tlb_invalidate_type_t, asid_t, uintptr_t, size_t);
 extern void tlb_shootdown_finalize(ipl_t);
+extern void tlb_shootdown_join(struct cpu_mask *);
 extern void tlb_shootdown_ipi_recv(void);
 #else
 #define tlb_shootdown_start(w, x, y, z)	interrupts_disable()
+#define tlb_shootdown_mask_start(m, w, x, y, z)	interrupts_disable()
 #define tlb_shootdown_finalize(i)	(interrupts_restore(i));
+#define tlb_shootdown_join(m)
 #define tlb_shootdown_ipi_recv()
 #endif /* CONFIG_SMP */
 
 /* Export TLB interface that each architecture must implement. */
 extern void tlb_arch_init(void);
 extern void tlb_print(void);
-extern void tlb_shootdown_ipi_send(void);
+extern void tlb_shootdown_ipi_send(struct cpu_mask *);
 
 extern void tlb_invalidate_all(void);
 extern void tlb_invalidate_asid(asid_t);
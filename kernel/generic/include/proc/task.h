@@ -61,6 +61,7 @@
 #include <abi/sysinfo.h>
 #include <arch.h>
 #include <cap/cap.h>
+#include <sysinfo/stats.h>
 
 #define TASK                 THE->task
 
@@ -144,6 +145,9 @@ typedef struct task {
 	/** Accumulated accounting. */
 	uint64_t ucycles;
 	uint64_t kcycles;
+
+	/** Change tracking for statistics, see stats_task_touch(). */
+	stats_entry_t stats;
 } task_t;
 
 IRQ_SPINLOCK_EXTERN(tasks_lock);
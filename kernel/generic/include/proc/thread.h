@@ -41,6 +41,7 @@
 #include <cpu.h>
 #include <synch/spinlock.h>
 #include <synch/rcu_types.h>
+#include <synch/seqcount.h>
 #include <adt/avl.h>
 #include <mm/slab.h>
 #include <arch/cpu.h>
@@ -50,6 +51,7 @@
 #include <abi/proc/thread.h>
 #include <abi/sysinfo.h>
 #include <arch.h>
+#include <sysinfo/stats.h>
 
 
 #define THREAD              THE->thread
@@ -173,11 +175,17 @@ typedef struct thread {
 	/** Ticks before preemption. */
 	uint64_t ticks;
 
-	/** Thread accounting. */
+	/**
+	 * Thread accounting. Updated only by the thread itself with
+	 * interrupts disabled, read by others under acct_seq.
+	 */
 	uint64_t ucycles;
 	uint64_t kcycles;
+	seqcount_t acct_seq;
 	/** Last sampled cycle. */
 	uint64_t last_cycle;
+	/** Change tracking for statistics, see stats_thread_touch(). */
+	stats_entry_t stats;
 	/** Thread doesn't affect accumulated accounting. */
 	bool uncounted;
 
@@ -262,6 +270,7 @@ extern void thread_print_list(bool);
 extern void thread_destroy(thread_t *, bool);
 extern thread_t *thread_find_by_id(thread_id_t);
 extern void thread_update_accounting(bool);
+extern void thread_get_accounting(thread_t *, uint64_t *, uint64_t *);
 extern bool thread_exists(thread_t *);
 
 extern void thread_migration_disable(void);
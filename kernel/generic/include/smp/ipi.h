@@ -37,12 +37,17 @@
 
 #ifdef CONFIG_SMP
 
+struct cpu_mask;
+
 extern void ipi_broadcast(int);
 extern void ipi_broadcast_arch(int);
+extern void ipi_multicast(struct cpu_mask *, int);
+extern void ipi_multicast_arch(struct cpu_mask *, int);
 
 #else
 
 #define ipi_broadcast(ipi)
+#define ipi_multicast(mask, ipi)
 
 #endif /* CONFIG_SMP */
 
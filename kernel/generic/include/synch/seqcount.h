@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup sync
+ * @{
+ */
+/** @file
+ * @brief Sequence counters.
+ *
+ * A sequence counter lets a single writer update a small group of values
+ * without taking a lock, while readers on other processors detect a
+ * concurrent update and retry. The writer must not be preempted or
+ * interrupted by another writer of the same counter, e.g. by updating
+ * with interrupts disabled on the processor owning the data.
+ */
+
+#ifndef KERN_SEQCOUNT_H_
+#define KERN_SEQCOUNT_H_
+
+#include <arch/barrier.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+	/** Odd while an update is in progress. */
+	volatile uint32_t seq;
+} seqcount_t;
+
+static inline void seqcount_initialize(seqcount_t *sc)
+{
+	sc->seq = 0;
+}
+
+static inline void seqcount_write_begin(seqcount_t *sc)
+{
+	sc->seq++;
+	write_barrier();
+}
+
+static inline void seqcount_write_end(seqcount_t *sc)
+{
+	write_barrier();
+	sc->seq++;
+}
+
+/** Begin reading values protected by a sequence counter.
+ *
+ * @param sc Sequence counter.
+ *
+ * @return Value to pass to seqcount_read_retry().
+ *
+ */
+static inline uint32_t seqcount_read_begin(seqcount_t *sc)
+{
+	uint32_t seq;
+
+	do {
+		seq = sc->seq;
+	} while (seq & 1);
+
+	read_barrier();
+	return seq;
+}
+
+/** Check whether the values read need to be read again.
+ *
+ * @param sc  Sequence counter.
+ * @param seq Value returned by seqcount_read_begin().
+ *
+ * @return True if the values were updated while being read.
+ *
+ */
+static inline bool seqcount_read_retry(seqcount_t *sc, uint32_t seq)
+{
+	read_barrier();
+	return sc->seq != seq;
+}
+
+#endif
+
+/** @}
+ */
@@ -35,8 +35,66 @@
 #ifndef KERN_STATS_H_
 #define KERN_STATS_H_
 
+#include <adt/list.h>
+#include <atomic.h>
+#include <typedefs.h>
+
+struct as;
+struct task;
+struct thread;
+
+/** Change tracking of a task or thread */
+typedef struct {
+	/** Link among the objects ordered by the generation of last change */
+	link_t link;
+
+	/** Statistics generation of the last change */
+	atomic_count_t gen;
+} stats_entry_t;
+
+extern atomic_t stats_generation;
+
+/** Mark statistics of a task as changed.
+ *
+ * The task is reported by the next incremental statistics query. Only
+ * the first change in a generation takes a lock, the others cost just
+ * a comparison.
+ *
+ */
+#define stats_task_touch(task) \
+	do { \
+		if ((task)->stats.gen != atomic_get(&stats_generation)) \
+			stats_task_changed(task); \
+	} while (0)
+
+/** Mark statistics of a thread as changed, see stats_task_touch(). */
+#define stats_thread_touch(thread) \
+	do { \
+		if ((thread)->stats.gen != atomic_get(&stats_generation)) \
+			stats_thread_changed(thread); \
+	} while (0)
+
+/** Mark memory statistics of an address space as changed.
+ *
+ * The task using the address space is reported by the next incremental
+ * statistics query, see stats_task_touch().
+ *
+ */
+#define stats_as_touch(as) \
+	do { \
+		if ((as)->stats_gen != atomic_get(&stats_generation)) \
+			stats_as_changed(as); \
+	} while (0)
+
 extern void kload(void *arg);
 extern void stats_init(void);
+extern void stats_task_changed(struct task *);
+extern void stats_thread_changed(struct thread *);
+extern void stats_as_changed(struct as *);
+extern void stats_task_added(struct task *);
+extern void stats_task_removed(struct task *);
+extern void stats_thread_added(struct thread *);
+extern void stats_thread_removed(struct thread *);
 
 #endif
 
@@ -36,6 +36,7 @@
 #define KERN_CLOCK_H_
 
 #include <typedefs.h>
+#include <stdbool.h>
 
 #define HZ  100
 
@@ -51,6 +52,27 @@ extern uptime_t *uptime;
 extern void clock(void);
 extern void clock_counter_init(void);
 
+#ifdef CONFIG_TICKLESS
+
+struct cpu;
+
+extern bool clock_idle_enter(void);
+extern void clock_idle_exit(void);
+extern void clock_idle_wakeup(struct cpu *);
+extern size_t clock_pending_ticks(void);
+
+/*
+ * Architecture timer hooks. The one-shot mode fires a single clock
+ * interrupt after the given number of ticks, the periodic mode
+ * restores regular clock interrupts. The pending hook returns the number
+ * of elapsed ticks the clock interrupt has not accounted for yet.
+ */
+extern void clock_arch_oneshot(size_t);
+extern void clock_arch_periodic(void);
+extern size_t clock_arch_pending(void);
+
+#endif
+
 #endif
 
 /** @}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup time
+ * @{
+ */
+/** @file
+ */
+
+#ifndef KERN_TIMEOUT_TYPES_H_
+#define KERN_TIMEOUT_TYPES_H_
+
+#include <adt/list.h>
+#include <stdint.h>
+
+/** Bits of the expiration tick covered by one wheel level */
+#define TIMEOUT_WHEEL_BITS    6
+/** Number of slots of one wheel level */
+#define TIMEOUT_WHEEL_SLOTS   (1 << TIMEOUT_WHEEL_BITS)
+/** Number of wheel levels */
+#define TIMEOUT_WHEEL_LEVELS  4
+
+/** Per-CPU hierarchical timer wheel
+ *
+ * Level 0 holds timeouts expiring within TIMEOUT_WHEEL_SLOTS ticks, one
+ * slot per tick. Each further level covers TIMEOUT_WHEEL_SLOTS times
+ * longer span with proportionally coarser slots. Whenever the lower
+ * level wraps around, the timeouts of the current slot of the upper
+ * level are redistributed (cascaded) to the lower levels.
+ */
+typedef struct {
+	/** Next clock tick to be processed */
+	uint64_t now;
+	/** Number of registered timeouts */
+	size_t count;
+	/** Lists of timeouts */
+	list_t slot[TIMEOUT_WHEEL_LEVELS][TIMEOUT_WHEEL_SLOTS];
+} timeout_wheel_t;
+
+#endif
+
+/** @}
+ */
@@ -100,6 +100,7 @@ void cpu_init(void)
 	CPU->tlb_active = true;
 
 	CPU->idle = false;
+	CPU->tickless = false;
 	CPU->last_cycle = get_cycle();
 	CPU->idle_cycles = 0;
 	CPU->busy_cycles = 0;
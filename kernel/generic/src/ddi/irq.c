@@ -48,6 +48,7 @@
 #include <interrupt.h>
 #include <mem.h>
 #include <arch.h>
+#include <ktrace.h>
 
 slab_cache_t *irq_cache = NULL;
 
@@ -173,6 +174,8 @@ irq_dispatch_and_lock_table(hash_table_t *h, irq_spinlock_t *l, inr_t inr)
  */
 irq_t *irq_dispatch_and_lock(inr_t inr)
 {
+	KTRACE(KTRACE_IRQ, inr, 0, 0);
+
 	/*
 	 * If the kernel console override is on, then try first the kernel
 	 * handlers and eventually fall back to uspace handlers.
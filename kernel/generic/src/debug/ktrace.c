@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup genericdebug
+ * @{
+ */
+
+/**
+ * @file
+ * @brief Kernel tracepoints.
+ *
+ * Every CPU records the enabled events into its own ring, so recording
+ * needs neither locks nor atomic operations; disabling interrupts is
+ * enough to keep the ring consistent. The rings, together with a header
+ * describing them, live in physically contiguous frames which are exported
+ * to userspace as a physical area. The consumer selects the events to be
+ * recorded by writing the event mask in the header and reads the rings
+ * without any cooperation from the kernel.
+ */
+
+#include <ktrace.h>
+#include <align.h>
+#include <arch.h>
+#include <arch/asm.h>
+#include <arch/barrier.h>
+#include <arch/cycle.h>
+#include <config.h>
+#include <cpu.h>
+#include <ddi/ddi.h>
+#include <log.h>
+#include <mem.h>
+#include <mm/frame.h>
+#include <mm/slab.h>
+#include <str.h>
+#include <sysinfo/sysinfo.h>
+
+/** Number of records in each per-CPU ring (must be a power of two) */
+#define KTRACE_CAPACITY  4096
+
+/** Event mask used until the tracing area is set up */
+static uint32_t ktrace_mask_disabled = 0;
+
+/** Event mask of the tracing area, see ktrace_enabled() */
+volatile uint32_t *ktrace_mask = &ktrace_mask_disabled;
+
+static ktrace_header_t *ktrace_header;
+static ktrace_record_t *ktrace_rings;
+
+/**
+ * Kernel copy of the ring heads. The copies in the shared header are
+ * only published for the consumer and never read back by the kernel.
+ */
+static uint64_t *ktrace_heads;
+
+static parea_t ktrace_parea;
+
+/** Allocate the tracing area and export it to userspace. */
+void ktrace_init(void)
+{
+	size_t offset = ALIGN_UP(sizeof(ktrace_header_t) +
+	    config.cpu_count * sizeof(ktrace_head_t), FRAME_SIZE);
+	size_t size = offset +
+	    config.cpu_count * KTRACE_CAPACITY * sizeof(ktrace_record_t);
+	size_t frames = SIZE2FRAMES(size);
+
+	ktrace_heads = malloc(config.cpu_count * sizeof(uint64_t),
+	    FRAME_ATOMIC);
+	if (!ktrace_heads) {
+		log(LF_OTHER, LVL_ERROR, "Unable to allocate tracing heads");
+		return;
+	}
+
+	uintptr_t faddr = frame_alloc(frames, FRAME_LOWMEM | FRAME_ATOMIC, 0);
+	if (!faddr) {
+		log(LF_OTHER, LVL_ERROR, "Unable to allocate %zu frames for "
+		    "tracing", frames);
+		free(ktrace_heads);
+		ktrace_heads = NULL;
+		return;
+	}
+
+	ktrace_header = (ktrace_header_t *) PA2KA(faddr);
+	memsetb(ktrace_header, offset, 0);
+
+	ktrace_header->cpus = config.cpu_count;
+	ktrace_header->capacity = KTRACE_CAPACITY;
+	ktrace_header->offset = offset;
+	ktrace_rings = (ktrace_record_t *) ((uint8_t *) ktrace_header + offset);
+
+	for (unsigned int i = 0; i < config.cpu_count; i++)
+		ktrace_heads[i] = 0;
+
+	ktrace_parea.pbase = faddr;
+	ktrace_parea.frames = frames;
+	ktrace_parea.unpriv = false;
+	ktrace_parea.mapped = false;
+	ddi_parea_register(&ktrace_parea);
+
+	sysinfo_set_item_val("ktrace.faddr", NULL, (sysarg_t) faddr);
+	sysinfo_set_item_val("ktrace.pages", NULL, frames);
+
+	/* From now on the consumer controls which events are recorded. */
+	write_barrier();
+	ktrace_mask = &ktrace_header->mask;
+}
+
+/** Record an event into the ring of the current CPU.
+ *
+ * Use the KTRACE() macro instead of calling this function directly.
+ *
+ * @param event Event type.
+ * @param arg0  First event argument.
+ * @param arg1  Second event argument.
+ * @param arg2  Third event argument.
+ *
+ */
+void ktrace_record(ktrace_event_t event, uint64_t arg0, uint64_t arg1,
+    uint64_t arg2)
+{
+	ipl_t ipl = interrupts_disable();
+
+	unsigned int id = CPU->id;
+	uint64_t head = ktrace_heads[id];
+	ktrace_record_t *record = &ktrace_rings[id * KTRACE_CAPACITY +
+	    (head & (KTRACE_CAPACITY - 1))];
+
+	record->cycle = get_cycle();
+	record->event = event;
+	record->cpu = id;
+	record->arg[0] = arg0;
+	record->arg[1] = arg1;
+	record->arg[2] = arg2;
+
+	/*
+	 * Publish the record. The new head must not become visible before
+	 * the record itself and the next record must not become visible
+	 * before the new head, otherwise the consumer could not tell
+	 * a record being overwritten from a consistent one.
+	 */
+	ktrace_heads[id] = head + 1;
+	write_barrier();
+	ktrace_header->ring[id].head = head + 1;
+	write_barrier();
+
+	interrupts_restore(ipl);
+}
+
+/** @}
+ */
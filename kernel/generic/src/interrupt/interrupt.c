@@ -105,11 +105,8 @@ NO_TRACE void exc_dispatch(unsigned int n, istate_t *istate)
 #endif
 
 	/* Account user cycles */
-	if (THREAD) {
-		irq_spinlock_lock(&THREAD->lock, false);
+	if (THREAD)
 		thread_update_accounting(true);
-		irq_spinlock_unlock(&THREAD->lock, false);
-	}
 
 	/* Account CPU usage if it woke up from sleep */
 	if (CPU && CPU->idle) {
@@ -148,11 +145,8 @@ NO_TRACE void exc_dispatch(unsigned int n, istate_t *istate)
 	irq_spinlock_unlock(&exctbl_lock, false);
 
 	/* Do not charge THREAD for exception cycles */
-	if (THREAD) {
-		irq_spinlock_lock(&THREAD->lock, false);
+	if (THREAD)
 		THREAD->last_cycle = end_cycle;
-		irq_spinlock_unlock(&THREAD->lock, false);
-	}
 }
 
 /** Default 'null' exception handler
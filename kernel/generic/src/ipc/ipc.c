@@ -59,6 +59,8 @@
 #include <arch/interrupt.h>
 #include <ipc/irq.h>
 #include <cap/cap.h>
+#include <ktrace.h>
+#include <sysinfo/stats.h>
 
 static void ipc_forget_call(call_t *);
 
@@ -280,8 +282,12 @@ void _ipc_answer_free_call(call_t *call, bool selflocked)
 	/* Count sent answer */
 	irq_spinlock_lock(&TASK->lock, true);
 	TASK->ipc_info.answer_sent++;
+	stats_task_touch(TASK);
 	irq_spinlock_unlock(&TASK->lock, true);
 
+	KTRACE(KTRACE_IPC_ANSWER, (uintptr_t) call, TASK->taskid,
+	    IPC_GET_RETVAL(call->data));
+
 	spinlock_lock(&call->forget_lock);
 	if (call->forget) {
 		/* This is a forgotten call and call->sender is not valid. */
@@ -399,10 +405,17 @@ static void _ipc_call(phone_t *phone, answerbox_t *box, call_t *call,
 	/* Count sent ipc call */
 	irq_spinlock_lock(&caller->lock, true);
 	caller->ipc_info.call_sent++;
+	stats_task_touch(caller);
 	irq_spinlock_unlock(&caller->lock, true);
 
-	if (!(call->flags & IPC_CALL_FORWARDED))
+	if (!(call->flags & IPC_CALL_FORWARDED)) {
 		_ipc_call_actions_internal(phone, call, preforget);
+		KTRACE(KTRACE_IPC_CALL, (uintptr_t) call, caller->taskid,
+		    box->task->taskid);
+	} else {
+		KTRACE(KTRACE_IPC_FORWARD, (uintptr_t) call, caller->taskid,
+		    box->task->taskid);
+	}
 
 	irq_spinlock_lock(&box->lock, true);
 	list_append(&call->ab_link, &box->calls);
@@ -506,6 +519,7 @@ errno_t ipc_forward(call_t *call, phone_t *newphone, answerbox_t *oldbox,
 	/* Count forwarded calls */
 	irq_spinlock_lock(&TASK->lock, true);
 	TASK->ipc_info.forwarded++;
+	stats_task_touch(TASK);
 	irq_spinlock_pass(&TASK->lock, &oldbox->lock);
 	list_remove(&call->ab_link);
 	irq_spinlock_unlock(&oldbox->lock, true);
@@ -592,6 +606,7 @@ restart:
 	TASK->ipc_info.irq_notif_received += irq_cnt;
 	TASK->ipc_info.answer_received += answer_cnt;
 	TASK->ipc_info.call_received += call_cnt;
+	stats_task_touch(TASK);
 
 	irq_spinlock_unlock(&TASK->lock, true);
 
@@ -91,6 +91,8 @@
 #include <ipc/event.h>
 #include <sysinfo/sysinfo.h>
 #include <sysinfo/stats.h>
+#include <ktrace.h>
+#include <udebug/udebug_prof.h>
 #include <lib/ra.h>
 #include <cap/cap.h>
 
@@ -298,6 +300,10 @@ void main_bsp_separated_stack(void)
 	kio_init();
 	log_init();
 	stats_init();
+	ktrace_init();
+#ifdef CONFIG_UDEBUG
+	udebug_prof_init();
+#endif
 
 	/*
 	 * Create kernel task.
@@ -74,11 +74,14 @@
 #include <arch.h>
 #include <errno.h>
 #include <config.h>
+#include <cpu/cpu_mask.h>
 #include <align.h>
 #include <typedefs.h>
 #include <syscall/copy.h>
 #include <arch/interrupt.h>
 #include <interrupt.h>
+#include <ktrace.h>
+#include <sysinfo/stats.h>
 
 /**
  * Each architecture decides what functions will be used to carry out
@@ -156,6 +159,9 @@ as_t *as_create(unsigned int flags)
 	(void) as_create_arch(as, 0);
 
 	btree_create(&as->as_area_btree);
+	as->pages = 0;
+	as->resident = 0;
+	as->stats_gen = 0;
 
 	if (flags & FLAG_AS_KERNEL)
 		as->asid = ASID_KERNEL;
@@ -165,6 +171,17 @@ as_t *as_create(unsigned int flags)
 	atomic_set(&as->refcount, 0);
 	as->cpu_refcount = 0;
 
+	/*
+	 * The kernel address space is created before all processors are
+	 * known and its shootdowns are always broadcast.
+	 */
+	if (flags & FLAG_AS_KERNEL) {
+		as->cpu_mask = NULL;
+	} else {
+		as->cpu_mask = (cpu_mask_t *) malloc(cpu_mask_size(), 0);
+		cpu_mask_none(as->cpu_mask);
+	}
+
 #ifdef AS_PAGE_TABLE
 	as->genarch.page_table = page_table_create(flags);
 #else
@@ -253,6 +270,9 @@ retry:
 	page_table_destroy(NULL);
 #endif
 
+	if (as->cpu_mask)
+		free(as->cpu_mask);
+
 	slab_free(as_cache, as);
 }
 
@@ -562,10 +582,70 @@ NO_TRACE static void sh_info_remove_reference(share_info_t *sh_info)
 }
 
 
+/** Check whether pages of an area can be mapped ahead of access.
+ *
+ * @param area Address space area.
+ *
+ * @return True if the backend supports fault-around and population.
+ *
+ */
+NO_TRACE static bool as_area_is_prefaultable(as_area_t *area)
+{
+	return (area->backend) && (area->backend->page_fault) &&
+	    (area->backend->is_prefaultable) &&
+	    (area->backend->is_prefaultable(area));
+}
+
+/** Map pages of an area ahead of access.
+ *
+ * Consecutive pages are mapped by the area's backend until a page which
+ * is already mapped, the end of the area or a backend failure is reached.
+ * The locks are taken only once for the whole batch.
+ *
+ * The address space area and page tables must be already locked and the
+ * area must belong to the current address space.
+ *
+ * @param area   Address space area.
+ * @param page   First page to map.
+ * @param count  Maximum number of pages to map.
+ * @param access Access mode to map the pages for.
+ *
+ * @return Number of pages mapped.
+ *
+ */
+NO_TRACE static size_t as_area_prefault(as_area_t *area, uintptr_t page,
+    size_t count, pf_access_t access)
+{
+	assert(area->as == AS);
+	assert(mutex_locked(&area->lock));
+	assert(page_table_locked(AS));
+
+	uintptr_t end = area->base + P2SZ(area->pages);
+	size_t i;
+
+	for (i = 0; (i < count) && (page + P2SZ(i) < end); i++) {
+		pte_t pte;
+		bool found = page_mapping_find(AS, page + P2SZ(i), false, &pte);
+		if ((found) && (PTE_PRESENT(&pte)))
+			break;
+
+		if (area->backend->page_fault(area, page + P2SZ(i), access) !=
+		    AS_PF_OK)
+			break;
+	}
+
+	return i;
+}
+
 /** Create address space area of common attributes.
  *
  * The created address space area is added to the target address space.
  *
+ * If AS_AREA_POPULATE is among the flags, the target address space is
+ * the current one and the backend supports it, all pages of the area are
+ * mapped right away rather than on first access. Population stops early
+ * without failing the call if the memory runs out.
+ *
  * @param as           Target address space.
  * @param flags        Flags of the area memory.
  * @param size         Size of area.
@@ -679,6 +759,27 @@ as_area_t *as_area_create(as_t *as, unsigned int flags, size_t size,
 	btree_insert(&as->as_area_btree, *base, (void *) area,
 	    NULL);
 
+	as->pages += area->pages;
+	stats_as_touch(as);
+
+	if ((flags & AS_AREA_POPULATE) && (as == AS) &&
+	    !(attrs & AS_AREA_ATTR_PARTIAL) && as_area_is_prefaultable(area)) {
+		pf_access_t access;
+
+		if (flags & AS_AREA_WRITE)
+			access = PF_ACCESS_WRITE;
+		else if (flags & AS_AREA_READ)
+			access = PF_ACCESS_READ;
+		else
+			access = PF_ACCESS_EXEC;
+
+		mutex_lock(&area->lock);
+		page_table_lock(as, false);
+		(void) as_area_prefault(area, area->base, area->pages, access);
+		page_table_unlock(as, false);
+		mutex_unlock(&area->lock);
+	}
+
 	mutex_unlock(&as->lock);
 
 	return area;
@@ -818,13 +919,87 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 		page_table_lock(as, false);
 
 		/*
-		 * Remove frames belonging to used space starting from
-		 * the highest addresses downwards until an overlap with
-		 * the resized address space area is found. Note that this
-		 * is also the right way to remove part of the used_space
-		 * B+tree leaf list.
+		 * Remove the mappings of all used pages beyond the new end
+		 * of the area in a single TLB shootdown round.
+		 *
+		 * The used_space B+tree is only read here and trimmed
+		 * afterwards, because used_space_remove() may use a blocking
+		 * memory allocation for its B+tree. Blocking while holding
+		 * the tlblock spinlock is forbidden and would hit a kernel
+		 * assertion.
 		 */
+		ipl_t ipl = tlb_shootdown_mask_start(as->cpu_mask,
+		    TLB_INVL_PAGES, as->asid, start_free, area->pages - pages);
+
 		bool cond = true;
+		list_foreach_rev(area->used_space.leaf_list, leaf_link,
+		    btree_node_t, node) {
+			btree_key_t key;
+
+			for (key = node->keys; key > 0; key--) {
+				uintptr_t ptr = node->key[key - 1];
+				size_t node_size = (size_t) node->value[key - 1];
+				size_t i = 0;
+
+				if (ptr + P2SZ(node_size) <= start_free) {
+					/*
+					 * The interval and all intervals
+					 * below it fit completely in the
+					 * resized address space area.
+					 */
+					cond = false;
+					break;
+				}
+
+				if (ptr < start_free)
+					i = (start_free - ptr) >> PAGE_WIDTH;
+
+				for (; i < node_size; i++) {
+					pte_t pte;
+					bool found = page_mapping_find(as,
+					    ptr + P2SZ(i), false, &pte);
+
+					assert(found);
+					assert(PTE_VALID(&pte));
+					assert(PTE_PRESENT(&pte));
+
+					if ((area->backend) &&
+					    (area->backend->frame_free)) {
+						area->backend->frame_free(area,
+						    ptr + P2SZ(i),
+						    PTE_GET_FRAME(&pte));
+					}
+
+					page_mapping_remove(as, ptr + P2SZ(i));
+				}
+			}
+
+			if (!cond)
+				break;
+		}
+
+		/*
+		 * Finish TLB shootdown sequence.
+		 */
+
+		tlb_invalidate_pages(as->asid, start_free,
+		    area->pages - pages);
+
+		/*
+		 * Invalidate software translation caches
+		 * (e.g. TSB on sparc64, PHT on ppc32).
+		 */
+		as_invalidate_translation_cache(as, start_free,
+		    area->pages - pages);
+		tlb_shootdown_finalize(ipl);
+
+		/*
+		 * Remove used space starting from the highest addresses
+		 * downwards until an overlap with the resized address space
+		 * area is found. Note that this is also the right way to
+		 * remove part of the used_space B+tree leaf list.
+		 */
+		cond = true;
 		while (cond) {
 			assert(!list_empty(&area->used_space.leaf_list));
 
@@ -836,7 +1011,6 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 				uintptr_t ptr = node->key[node->keys - 1];
 				size_t node_size =
 				    (size_t) node->value[node->keys - 1];
-				size_t i = 0;
 
 				if (overlaps(ptr, P2SZ(node_size), area->base,
 				    P2SZ(pages))) {
@@ -858,7 +1032,8 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 
 					/* We are almost done */
 					cond = false;
-					i = (start_free - ptr) >> PAGE_WIDTH;
+					size_t i =
+					    (start_free - ptr) >> PAGE_WIDTH;
 					if (!used_space_remove(area, start_free,
 					    node_size - i))
 						panic("Cannot remove used space.");
@@ -870,58 +1045,6 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 					if (!used_space_remove(area, ptr, node_size))
 						panic("Cannot remove used space.");
 				}
-
-				/*
-				 * Start TLB shootdown sequence.
-				 *
-				 * The sequence is rather short and can be
-				 * repeated multiple times. The reason is that
-				 * we don't want to have used_space_remove()
-				 * inside the sequence as it may use a blocking
-				 * memory allocation for its B+tree. Blocking
-				 * while holding the tlblock spinlock is
-				 * forbidden and would hit a kernel assertion.
-				 */
-
-				ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES,
-				    as->asid, area->base + P2SZ(pages),
-				    area->pages - pages);
-
-				for (; i < node_size; i++) {
-					pte_t pte;
-					bool found = page_mapping_find(as,
-					    ptr + P2SZ(i), false, &pte);
-
-					assert(found);
-					assert(PTE_VALID(&pte));
-					assert(PTE_PRESENT(&pte));
-
-					if ((area->backend) &&
-					    (area->backend->frame_free)) {
-						area->backend->frame_free(area,
-						    ptr + P2SZ(i),
-						    PTE_GET_FRAME(&pte));
-					}
-
-					page_mapping_remove(as, ptr + P2SZ(i));
-				}
-
-				/*
-				 * Finish TLB shootdown sequence.
-				 */
-
-				tlb_invalidate_pages(as->asid,
-				    area->base + P2SZ(pages),
-				    area->pages - pages);
-
-				/*
-				 * Invalidate software translation caches
-				 * (e.g. TSB on sparc64, PHT on ppc32).
-				 */
-				as_invalidate_translation_cache(as,
-				    area->base + P2SZ(pages),
-				    area->pages - pages);
-				tlb_shootdown_finalize(ipl);
 			}
 		}
 		page_table_unlock(as, false);
@@ -952,6 +1075,9 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 		}
 	}
 
+	as->pages = as->pages - area->pages + pages;
+	stats_as_touch(as);
+
 	area->pages = pages;
 
 	mutex_unlock(&area->lock);
@@ -988,8 +1114,8 @@ errno_t as_area_destroy(as_t *as, uintptr_t address)
 	/*
 	 * Start TLB shootdown sequence.
 	 */
-	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
-	    area->pages);
+	ipl_t ipl = tlb_shootdown_mask_start(as->cpu_mask, TLB_INVL_PAGES,
+	    as->asid, area->base, area->pages);
 
 	/*
 	 * Visit only the pages mapped by used_space B+tree.
@@ -1044,6 +1170,10 @@ errno_t as_area_destroy(as_t *as, uintptr_t address)
 
 	sh_info_remove_reference(area->sh_info);
 
+	as->pages -= area->pages;
+	as->resident -= area->resident;
+	stats_as_touch(as);
+
 	mutex_unlock(&area->lock);
 
 	/*
@@ -1298,8 +1428,8 @@ errno_t as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 	/*
 	 * Start TLB shootdown sequence.
 	 */
-	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
-	    area->pages);
+	ipl_t ipl = tlb_shootdown_mask_start(as->cpu_mask, TLB_INVL_PAGES,
+	    as->asid, area->base, area->pages);
 
 	/*
 	 * Remove used pages from page tables and remember their frame
@@ -1411,6 +1541,8 @@ int as_page_fault(uintptr_t address, pf_access_t access, istate_t *istate)
 	uintptr_t page = ALIGN_DOWN(address, PAGE_SIZE);
 	int rc = AS_PF_FAULT;
 
+	KTRACE(KTRACE_PAGE_FAULT, address, access, istate_get_pc(istate));
+
 	if (!THREAD)
 		goto page_fault;
 
@@ -1478,6 +1610,26 @@ int as_page_fault(uintptr_t address, pf_access_t access, istate_t *istate)
 		goto page_fault;
 	}
 
+	/*
+	 * Fault-around. If the area is being accessed sequentially, i.e. the
+	 * preceding page is already mapped, map the following pages as well
+	 * while holding the locks to spare the thread the upcoming faults.
+	 */
+	if ((AS_FAULT_AROUND > 0) && as_area_is_prefaultable(area)) {
+		bool sequential = (page == area->base);
+
+		if (!sequential) {
+			found = page_mapping_find(AS, page - PAGE_SIZE, false,
+			    &pte);
+			sequential = (found) && (PTE_PRESENT(&pte));
+		}
+
+		if (sequential) {
+			(void) as_area_prefault(area, page + PAGE_SIZE,
+			    AS_FAULT_AROUND, access);
+		}
+	}
+
 	page_table_unlock(AS, false);
 	mutex_unlock(&area->lock);
 	mutex_unlock(&AS->lock);
@@ -1572,6 +1724,14 @@ retry:
 			new_as->asid = asid_get();
 	}
 
+	/*
+	 * Make sure this processor receives TLB shootdowns for the new
+	 * address space before it can cache any of its translations.
+	 */
+	if ((new_as->cpu_mask) &&
+	    (!cpu_mask_is_set(new_as->cpu_mask, CPU->id)))
+		tlb_shootdown_join(new_as->cpu_mask);
+
 #ifdef AS_PAGE_TABLE
 	SET_PTL0_ADDRESS(new_as->genarch.page_table);
 #endif
@@ -1993,6 +2153,8 @@ bool used_space_insert(as_area_t *area, uintptr_t page, size_t count)
 
 success:
 	area->resident += count;
+	area->as->resident += count;
+	stats_as_touch(area->as);
 	return true;
 }
 
@@ -2176,6 +2338,8 @@ error:
 
 success:
 	area->resident -= count;
+	area->as->resident -= count;
+	stats_as_touch(area->as);
 	return true;
 }
 
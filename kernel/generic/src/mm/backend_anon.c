@@ -61,6 +61,7 @@ static void anon_destroy(as_area_t *);
 
 static bool anon_is_resizable(as_area_t *);
 static bool anon_is_shareable(as_area_t *);
+static bool anon_is_prefaultable(as_area_t *);
 
 static int anon_page_fault(as_area_t *, uintptr_t, pf_access_t);
 static void anon_frame_free(as_area_t *, uintptr_t, uintptr_t);
@@ -73,6 +74,7 @@ mem_backend_t anon_backend = {
 
 	.is_resizable = anon_is_resizable,
 	.is_shareable = anon_is_shareable,
+	.is_prefaultable = anon_is_prefaultable,
 
 	.page_fault = anon_page_fault,
 	.frame_free = anon_frame_free,
@@ -174,6 +176,11 @@ bool anon_is_shareable(as_area_t *area)
 	return !(area->flags & AS_AREA_LATE_RESERVE);
 }
 
+bool anon_is_prefaultable(as_area_t *area)
+{
+	return true;
+}
+
 /** Service a page fault in the anonymous memory address space area.
  *
  * The address space area and page tables must be already locked.
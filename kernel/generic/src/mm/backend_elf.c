@@ -59,6 +59,7 @@ static void elf_destroy(as_area_t *);
 
 static bool elf_is_resizable(as_area_t *);
 static bool elf_is_shareable(as_area_t *);
+static bool elf_is_prefaultable(as_area_t *);
 
 static int elf_page_fault(as_area_t *, uintptr_t, pf_access_t);
 static void elf_frame_free(as_area_t *, uintptr_t, uintptr_t);
@@ -71,6 +72,7 @@ mem_backend_t elf_backend = {
 
 	.is_resizable = elf_is_resizable,
 	.is_shareable = elf_is_shareable,
+	.is_prefaultable = elf_is_prefaultable,
 
 	.page_fault = elf_page_fault,
 	.frame_free = elf_frame_free,
@@ -235,6 +237,11 @@ bool elf_is_shareable(as_area_t *area)
 	return true;
 }
 
+bool elf_is_prefaultable(as_area_t *area)
+{
+	return true;
+}
+
 
 /** Service a page fault in the ELF backend address space area.
  *
@@ -71,6 +71,7 @@ mem_backend_t phys_backend = {
 
 	.is_resizable = phys_is_resizable,
 	.is_shareable = phys_is_shareable,
+	.is_prefaultable = NULL,
 
 	.page_fault = phys_page_fault,
 	.frame_free = NULL,
@@ -39,6 +39,8 @@
 #include <mm/as.h>
 #include <mm/page.h>
 #include <mm/frame.h>
+#include <mm/km.h>
+#include <mm/reserve.h>
 #include <abi/mm/as.h>
 #include <abi/ipc/methods.h>
 #include <ipc/sysipc.h>
@@ -48,6 +50,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <log.h>
+#include <mem.h>
 #include <str.h>
 
 static bool user_create(as_area_t *);
@@ -67,6 +70,7 @@ mem_backend_t user_backend = {
 
 	.is_resizable = user_is_resizable,
 	.is_shareable = user_is_shareable,
+	.is_prefaultable = NULL,
 
 	.page_fault = user_page_fault,
 	.frame_free = user_frame_free,
@@ -145,6 +149,37 @@ int user_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 	 */
 
 	uintptr_t frame = IPC_GET_ARG1(data);
+
+	/*
+	 * The pager may hand out the same frame to other areas, e.g. a page
+	 * of a file cached by VFS. A writable area must not modify it, so it
+	 * gets a private copy.
+	 */
+	if (area->flags & AS_AREA_WRITE) {
+		uintptr_t src = km_map(frame, PAGE_SIZE,
+		    PAGE_READ | PAGE_CACHEABLE);
+		if (!src) {
+			user_frame_free(area, upage, frame);
+			return AS_PF_SILENT;
+		}
+
+		if (!reserve_try_alloc(1)) {
+			km_unmap(src, PAGE_SIZE);
+			user_frame_free(area, upage, frame);
+			return AS_PF_SILENT;
+		}
+
+		uintptr_t copy;
+		uintptr_t kpage = km_temporary_page_get(&copy,
+		    FRAME_NO_RESERVE);
+		memcpy((void *) kpage, (void *) src, PAGE_SIZE);
+		km_temporary_page_put(kpage);
+		km_unmap(src, PAGE_SIZE);
+
+		user_frame_free(area, upage, frame);
+		frame = copy;
+	}
+
 	page_mapping_insert(AS, upage, frame, as_area_get_flags(area));
 	if (!used_space_insert(area, upage, 1))
 		panic("Cannot insert used space.");
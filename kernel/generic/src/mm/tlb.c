@@ -35,8 +35,16 @@
  * @brief Generic TLB shootdown algorithm.
  *
  * The algorithm implemented here is based on the CMU TLB shootdown
- * algorithm and is further simplified (e.g. all CPUs receive all TLB
- * shootdown messages).
+ * algorithm and is further simplified (e.g. there is only one shootdown
+ * in progress at a time).
+ *
+ * Shootdowns concerning a user address space are sent only to the
+ * processors recorded in the address space's CPU mask, i.e. the processors
+ * which might have cached translations for it. A processor adds itself to
+ * the mask when it switches to the address space (see as_switch()). Both
+ * the mask updates and the sender's read of the mask happen under tlblock,
+ * so a processor either receives the shootdown or joins the address space
+ * only after the page tables have been updated.
  */
 
 #include <mm/tlb.h>
@@ -51,6 +59,7 @@
 #include <arch.h>
 #include <panic.h>
 #include <cpu.h>
+#include <cpu/cpu_mask.h>
 
 void tlb_init(void)
 {
@@ -67,6 +76,20 @@ void tlb_init(void)
  */
 IRQ_SPINLOCK_STATIC_INITIALIZE(tlblock);
 
+/** Check whether a processor is a target of the current shootdown.
+ *
+ * @param mask   Target processors or NULL for all processors.
+ * @param cpu_id Processor to check.
+ *
+ */
+static bool tlb_shootdown_target(cpu_mask_t *mask, unsigned int cpu_id)
+{
+	if (cpu_id == CPU->id)
+		return false;
+
+	return (mask == NULL) || cpu_mask_is_set(mask, cpu_id);
+}
+
 /** Send TLB shootdown message.
  *
  * This function attempts to deliver TLB shootdown message
@@ -82,6 +105,28 @@ IRQ_SPINLOCK_STATIC_INITIALIZE(tlblock);
  */
 ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
     uintptr_t page, size_t count)
+{
+	return tlb_shootdown_mask_start(NULL, type, asid, page, count);
+}
+
+/** Send TLB shootdown message to a set of processors.
+ *
+ * Only the processors in the mask are interrupted and waited for. The
+ * mask is read under tlblock and therefore must only be modified under
+ * tlblock as well, i.e. by tlb_shootdown_join() or between
+ * tlb_shootdown_mask_start() and tlb_shootdown_finalize().
+ *
+ * @param mask  Target processors or NULL for all processors.
+ * @param type  Type describing scope of shootdown.
+ * @param asid  Address space, if required by type.
+ * @param page  Virtual page address, if required by type.
+ * @param count Number of pages, if required by type.
+ *
+ * @return The interrupt priority level as it existed prior to this call.
+ *
+ */
+ipl_t tlb_shootdown_mask_start(cpu_mask_t *mask, tlb_invalidate_type_t type,
+    asid_t asid, uintptr_t page, size_t count)
 {
 	ipl_t ipl = interrupts_disable();
 	CPU->tlb_active = false;
@@ -89,7 +134,7 @@ ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
 
 	size_t i;
 	for (i = 0; i < config.cpu_count; i++) {
-		if (i == CPU->id)
+		if (!tlb_shootdown_target(mask, i))
 			continue;
 
 		cpu_t *cpu = &cpus[i];
@@ -118,11 +163,11 @@ ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
 		irq_spinlock_unlock(&cpu->lock, false);
 	}
 
-	tlb_shootdown_ipi_send();
+	tlb_shootdown_ipi_send(mask);
 
 busy_wait:
 	for (i = 0; i < config.cpu_count; i++) {
-		if (cpus[i].tlb_active)
+		if ((tlb_shootdown_target(mask, i)) && (cpus[i].tlb_active))
 			goto busy_wait;
 	}
 
@@ -141,9 +186,38 @@ void tlb_shootdown_finalize(ipl_t ipl)
 	interrupts_restore(ipl);
 }
 
-void tlb_shootdown_ipi_send(void)
+/** Add the current processor to a set of shootdown targets.
+ *
+ * The processor is marked inactive while it waits for tlblock so that
+ * a shootdown in progress does not wait for it.
+ *
+ * Interrupts must be disabled.
+ *
+ * @param mask Set of processors to join.
+ *
+ */
+void tlb_shootdown_join(cpu_mask_t *mask)
+{
+	assert(interrupts_disabled());
+
+	CPU->tlb_active = false;
+	irq_spinlock_lock(&tlblock, false);
+	cpu_mask_set(mask, CPU->id);
+	irq_spinlock_unlock(&tlblock, false);
+	CPU->tlb_active = true;
+}
+
+/** Interrupt processors taking part in TLB shootdown.
+ *
+ * @param mask Target processors or NULL for all processors.
+ *
+ */
+void tlb_shootdown_ipi_send(cpu_mask_t *mask)
 {
-	ipi_broadcast(VECTOR_TLB_SHOOTDOWN_IPI);
+	if (mask == NULL)
+		ipi_broadcast(VECTOR_TLB_SHOOTDOWN_IPI);
+	else
+		ipi_multicast(mask, VECTOR_TLB_SHOOTDOWN_IPI);
 }
 
 /** Receive TLB shootdown message.
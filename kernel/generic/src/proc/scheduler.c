@@ -46,6 +46,7 @@
 #include <mm/page.h>
 #include <mm/as.h>
 #include <time/timeout.h>
+#include <time/clock.h>
 #include <time/delay.h>
 #include <arch/asm.h>
 #include <arch/faddr.h>
@@ -65,6 +66,8 @@
 #include <print.h>
 #include <log.h>
 #include <stacktrace.h>
+#include <ktrace.h>
+#include <sysinfo/stats.h>
 
 static void scheduler_separated_stack(void);
 
@@ -212,6 +215,14 @@ loop:
 		irq_spinlock_lock(&CPU->lock, false);
 		CPU->idle = true;
 		irq_spinlock_unlock(&CPU->lock, false);
+#ifdef CONFIG_TICKLESS
+		if (!clock_idle_enter()) {
+			irq_spinlock_lock(&CPU->lock, false);
+			CPU->idle = false;
+			irq_spinlock_unlock(&CPU->lock, false);
+			goto loop;
+		}
+#endif
 		interrupts_enable();
 
 		/*
@@ -221,6 +232,9 @@ loop:
 		 */
 		cpu_sleep();
 		interrupts_disable();
+#ifdef CONFIG_TICKLESS
+		clock_idle_exit();
+#endif
 		goto loop;
 	}
 
@@ -332,7 +346,7 @@ void scheduler(void)
 		irq_spinlock_lock(&THREAD->lock, false);
 
 		/* Update thread kernel accounting */
-		THREAD->kcycles += get_cycle() - THREAD->last_cycle;
+		thread_update_accounting(false);
 
 #if (defined CONFIG_FPU) && (!defined CONFIG_FPU_LAZY)
 		fpu_context_save(THREAD->saved_fpu_context);
@@ -493,6 +507,9 @@ void scheduler_separated_stack(void)
 
 	relink_rq(priority);
 
+	KTRACE(KTRACE_SCHED_SWITCH, THREAD->tid, THREAD->task->taskid,
+	    priority);
+
 	/*
 	 * If both the old and the new task are the same,
 	 * lots of work is avoided.
@@ -524,6 +541,7 @@ void scheduler_separated_stack(void)
 
 	irq_spinlock_lock(&THREAD->lock, false);
 	THREAD->state = Running;
+	stats_thread_touch(THREAD);
 
 #ifdef SCHEDULER_VERBOSE
 	log(LF_OTHER, LVL_DEBUG,
@@ -59,6 +59,7 @@
 #include <str.h>
 #include <syscall/copy.h>
 #include <macros.h>
+#include <sysinfo/stats.h>
 
 /** Spinlock protecting the tasks_tree AVL tree. */
 IRQ_SPINLOCK_INITIALIZE(tasks_lock);
@@ -219,6 +220,8 @@ task_t *task_create(as_t *as, const char *name)
 	task->perms = 0;
 	task->ucycles = 0;
 	task->kcycles = 0;
+	link_initialize(&task->stats.link);
+	task->stats.gen = 0;
 
 	caps_task_init(task);
 
@@ -271,6 +274,7 @@ task_t *task_create(as_t *as, const char *name)
 	avltree_node_initialize(&task->tasks_tree_node);
 	task->tasks_tree_node.key = task->taskid;
 	avltree_insert(&tasks_tree, &task->tasks_tree_node);
+	stats_task_added(task);
 
 	irq_spinlock_unlock(&tasks_lock, true);
 
@@ -289,6 +293,7 @@ void task_destroy(task_t *task)
 	 */
 	irq_spinlock_lock(&tasks_lock, true);
 	avltree_delete(&tasks_tree, &task->tasks_tree_node);
+	stats_task_removed(task);
 	irq_spinlock_unlock(&tasks_lock, true);
 
 	/*
@@ -410,6 +415,7 @@ sys_errno_t sys_task_set_name(const char *uspace_name, size_t name_len)
 
 	/* Set task name */
 	str_cpy(TASK->name, TASK_NAME_BUFLEN, namebuf);
+	stats_task_touch(TASK);
 
 	irq_spinlock_unlock(&threads_lock, false);
 	irq_spinlock_unlock(&TASK->lock, false);
@@ -480,8 +486,6 @@ void task_get_accounting(task_t *task, uint64_t *ucycles, uint64_t *kcycles)
 
 	/* Current values of threads */
 	list_foreach(task->threads, th_link, thread_t, thread) {
-		irq_spinlock_lock(&thread->lock, false);
-
 		/* Process only counted threads */
 		if (!thread->uncounted) {
 			if (thread == THREAD) {
@@ -489,11 +493,13 @@ void task_get_accounting(task_t *task, uint64_t *ucycles, uint64_t *kcycles)
 				thread_update_accounting(false);
 			}
 
-			uret += thread->ucycles;
-			kret += thread->kcycles;
-		}
+			uint64_t ucycles;
+			uint64_t kcycles;
+			thread_get_accounting(thread, &ucycles, &kcycles);
 
-		irq_spinlock_unlock(&thread->lock, false);
+			uret += ucycles;
+			kret += kcycles;
+		}
 	}
 
 	*ucycles = uret;
@@ -67,6 +67,7 @@
 #include <main/uinit.h>
 #include <syscall/copy.h>
 #include <errno.h>
+#include <sysinfo/stats.h>
 
 /** Thread states */
 const char *thread_states[] = {
@@ -128,21 +129,24 @@ static void cushion(void)
 
 	f(arg);
 
-	/* Accumulate accounting to the task */
-	irq_spinlock_lock(&THREAD->lock, true);
+	/*
+	 * Accumulate accounting to the task. The counters are moved
+	 * under the task lock so that task_get_accounting() counts them
+	 * exactly once.
+	 */
 	if (!THREAD->uncounted) {
+		irq_spinlock_lock(&TASK->lock, true);
 		thread_update_accounting(true);
-		uint64_t ucycles = THREAD->ucycles;
+
+		seqcount_write_begin(&THREAD->acct_seq);
+		TASK->ucycles += THREAD->ucycles;
+		TASK->kcycles += THREAD->kcycles;
 		THREAD->ucycles = 0;
-		uint64_t kcycles = THREAD->kcycles;
 		THREAD->kcycles = 0;
+		seqcount_write_end(&THREAD->acct_seq);
 
-		irq_spinlock_pass(&THREAD->lock, &TASK->lock);
-		TASK->ucycles += ucycles;
-		TASK->kcycles += kcycles;
 		irq_spinlock_unlock(&TASK->lock, true);
-	} else
-		irq_spinlock_unlock(&THREAD->lock, true);
+	}
 
 	thread_exit();
 
@@ -306,6 +310,7 @@ void thread_ready(thread_t *thread)
 	}
 
 	thread->state = Ready;
+	stats_thread_touch(thread);
 
 	irq_spinlock_pass(&thread->lock, &(cpu->rq[i].lock));
 
@@ -320,6 +325,10 @@ void thread_ready(thread_t *thread)
 
 	atomic_inc(&nrdy);
 	atomic_inc(&cpu->nrdy);
+
+#ifdef CONFIG_TICKLESS
+	clock_idle_wakeup(cpu);
+#endif
 }
 
 /** Create new thread
@@ -368,6 +377,9 @@ thread_t *thread_create(void (*func)(void *), void *arg, task_t *task,
 	thread->ticks = -1;
 	thread->ucycles = 0;
 	thread->kcycles = 0;
+	seqcount_initialize(&thread->acct_seq);
+	link_initialize(&thread->stats.link);
+	thread->stats.gen = 0;
 	thread->uncounted =
 	    ((flags & THREAD_FLAG_UNCOUNTED) == THREAD_FLAG_UNCOUNTED);
 	thread->priority = -1;          /* Start in rq[0] */
@@ -443,6 +455,7 @@ void thread_destroy(thread_t *thread, bool irq_res)
 	irq_spinlock_pass(&thread->lock, &threads_lock);
 
 	avltree_delete(&threads_tree, &thread->threads_tree_node);
+	stats_thread_removed(thread);
 
 	irq_spinlock_pass(&threads_lock, &thread->task->lock);
 
@@ -450,6 +463,7 @@ void thread_destroy(thread_t *thread, bool irq_res)
 	 * Detach from the containing task.
 	 */
 	list_remove(&thread->th_link);
+	stats_task_touch(thread->task);
 	irq_spinlock_unlock(&thread->task->lock, irq_res);
 
 	/*
@@ -483,6 +497,7 @@ void thread_attach(thread_t *thread, task_t *task)
 		atomic_inc(&task->lifecount);
 
 	list_append(&thread->th_link, &task->threads);
+	stats_task_touch(task);
 
 	irq_spinlock_pass(&task->lock, &threads_lock);
 
@@ -490,6 +505,7 @@ void thread_attach(thread_t *thread, task_t *task)
 	 * Register this thread in the system-wide list.
 	 */
 	avltree_insert(&threads_tree, &thread->threads_tree_node);
+	stats_thread_added(thread);
 	irq_spinlock_unlock(&threads_lock, true);
 }
 
@@ -710,8 +726,9 @@ static bool thread_walker(avltree_node_t *node, void *arg)
 
 	uint64_t ucycles, kcycles;
 	char usuffix, ksuffix;
-	order_suffix(thread->ucycles, &ucycles, &usuffix);
-	order_suffix(thread->kcycles, &kcycles, &ksuffix);
+	thread_get_accounting(thread, &ucycles, &kcycles);
+	order_suffix(ucycles, &ucycles, &usuffix);
+	order_suffix(kcycles, &kcycles, &ksuffix);
 
 	char *name;
 	if (str_cmp(thread->name, "uinit") == 0)
@@ -820,8 +837,8 @@ bool thread_exists(thread_t *thread)
 
 /** Update accounting of current thread.
  *
- * Note that thread_lock on THREAD must be already held and
- * interrupts must be already disabled.
+ * Interrupts must be already disabled. No lock is needed, as the
+ * counters are only modified by the thread itself.
  *
  * @param user True to update user accounting, false for kernel.
  *
@@ -831,14 +848,42 @@ void thread_update_accounting(bool user)
 	uint64_t time = get_cycle();
 
 	assert(interrupts_disabled());
-	assert(irq_spinlock_locked(&THREAD->lock));
+
+	seqcount_write_begin(&THREAD->acct_seq);
 
 	if (user)
 		THREAD->ucycles += time - THREAD->last_cycle;
 	else
 		THREAD->kcycles += time - THREAD->last_cycle;
 
+	seqcount_write_end(&THREAD->acct_seq);
+
 	THREAD->last_cycle = time;
+
+	stats_thread_touch(THREAD);
+	stats_task_touch(THREAD->task);
+}
+
+/** Get consistent accounting of a thread.
+ *
+ * The values may be slightly out of date for a thread running on
+ * another processor.
+ *
+ * @param thread  Thread.
+ * @param ucycles Out pointer to user cycles.
+ * @param kcycles Out pointer to kernel cycles.
+ *
+ */
+void thread_get_accounting(thread_t *thread, uint64_t *ucycles,
+    uint64_t *kcycles)
+{
+	uint32_t seq;
+
+	do {
+		seq = seqcount_read_begin(&thread->acct_seq);
+		*ucycles = thread->ucycles;
+		*kcycles = thread->kcycles;
+	} while (seqcount_read_retry(&thread->acct_seq, seq));
 }
 
 static bool thread_search_walker(avltree_node_t *node, void *arg)
@@ -38,6 +38,7 @@
 #ifdef CONFIG_SMP
 
 #include <smp/ipi.h>
+#include <cpu/cpu_mask.h>
 #include <config.h>
 
 /** Broadcast IPI message
@@ -59,6 +60,20 @@ void ipi_broadcast(int ipi)
 		ipi_broadcast_arch(ipi);
 }
 
+/** Send IPI message to a set of CPUs
+ *
+ * The current CPU is skipped even if it is included in the mask.
+ *
+ * @param mask Destination CPUs.
+ * @param ipi  Message to send.
+ *
+ */
+void ipi_multicast(cpu_mask_t *mask, int ipi)
+{
+	if (config.cpu_count > 1)
+		ipi_multicast_arch(mask, ipi);
+}
+
 #endif /* CONFIG_SMP */
 
 /** @}
@@ -56,15 +56,47 @@
 #include <console/console.h>
 #include <udebug/udebug.h>
 #include <log.h>
+#include <assert.h>
+#include <macros.h>
+#include <bitops.h>
+#include <abi/sysinfo.h>
+
+#ifdef CONFIG_SYSCALL_STATS
+
+/** Record the latency of a finished syscall.
+ *
+ * @param id     Syscall number.
+ * @param cycles Number of cycles the syscall took.
+ *
+ */
+static void syscall_stats_update(sysarg_t id, uint64_t cycles)
+{
+	assert(interrupts_disabled());
+
+	if (id >= SYSCALL_END)
+		return;
+
+	stats_syscall_t *stats = &CPU->syscall_stats[id];
+	unsigned int bucket = (cycles > 0) ? fnzb64(cycles) : 0;
+
+	stats->count++;
+	stats->cycles += cycles;
+	stats->hist[min(bucket, STATS_SYSCALL_BUCKETS - 1)]++;
+}
+
+#endif /* CONFIG_SYSCALL_STATS */
 
 /** Dispatch system call */
 sysarg_t syscall_handler(sysarg_t a1, sysarg_t a2, sysarg_t a3,
     sysarg_t a4, sysarg_t a5, sysarg_t a6, sysarg_t id)
 {
 	/* Do userpace accounting */
-	irq_spinlock_lock(&THREAD->lock, true);
+	ipl_t ipl = interrupts_disable();
 	thread_update_accounting(true);
-	irq_spinlock_unlock(&THREAD->lock, true);
+#ifdef CONFIG_SYSCALL_STATS
+	uint64_t begin_cycle = THREAD->last_cycle;
+#endif
+	interrupts_restore(ipl);
 
 #ifdef CONFIG_UDEBUG
 	/*
@@ -112,9 +144,12 @@ sysarg_t syscall_handler(sysarg_t a1, sysarg_t a2, sysarg_t a3,
 #endif
 
 	/* Do kernel accounting */
-	irq_spinlock_lock(&THREAD->lock, true);
+	ipl = interrupts_disable();
 	thread_update_accounting(false);
-	irq_spinlock_unlock(&THREAD->lock, true);
+#ifdef CONFIG_SYSCALL_STATS
+	syscall_stats_update(id, THREAD->last_cycle - begin_cycle);
+#endif
+	interrupts_restore(ipl);
 
 	return rc;
 }
@@ -47,9 +47,11 @@
 #include <interrupt.h>
 #include <stdbool.h>
 #include <str.h>
+#include <mem.h>
 #include <errno.h>
 #include <cpu.h>
 #include <arch.h>
+#include <macros.h>
 
 /** Bits of fixed-point precision for load */
 #define LOAD_FIXED_SHIFT  11
@@ -81,6 +83,63 @@ static load_t avenrdy[LOAD_STEPS] = { 0, 0, 0 };
 /** Load calculation lock */
 static mutex_t load_lock;
 
+/** Number of remembered removals of tasks or threads */
+#define STATS_REMOVED_COUNT  128
+
+/** Changes of tasks or threads */
+typedef struct {
+	IRQ_SPINLOCK_DECLARE(lock);
+
+	/**
+	 * All objects, ordered by the generation of their last change
+	 * (stats_entry_t).
+	 */
+	list_t changed;
+
+	/**
+	 * Newest generation of a change which did not move the changed
+	 * object to the end of the list. Objects changed since such
+	 * a generation can only be found by checking all of them.
+	 */
+	atomic_count_t unordered;
+
+	/** IDs of the removed objects */
+	uint64_t id[STATS_REMOVED_COUNT];
+
+	/** Generations of the removals */
+	atomic_count_t gen[STATS_REMOVED_COUNT];
+
+	/** Number of removals ever logged */
+	size_t count;
+
+	/** Newest generation of a removal which is no longer logged */
+	atomic_count_t lost;
+} stats_changes_t;
+
+/** State of an incremental statistics query */
+typedef struct {
+	/** Report objects changed in this or a later generation */
+	atomic_count_t since;
+
+	/** Report all objects */
+	bool full;
+
+	/** Check all objects, not just the recently changed ones */
+	bool unordered;
+} stats_query_t;
+
+/** Check whether an object changed out of order is to be reported */
+typedef bool (*stats_changed_t)(stats_entry_t *, stats_query_t *);
+
+/** Produce statistics record of an object */
+typedef void (*stats_produce_t)(stats_entry_t *, void *);
+
+/** Statistics generation, advanced by every incremental query */
+atomic_t stats_generation = { 1 };
+
+static stats_changes_t task_changes;
+static stats_changes_t thread_changes;
+
 /** Get statistics of all CPUs
  *
  * @param item    Sysinfo item (unused).
@@ -141,6 +200,9 @@ static bool avl_count_walker(avltree_node_t *node, void *arg)
 }
 
 /** Get the size of a virtual address space
+ *
+ * The size is maintained by the address space code, so it can be read
+ * without locking. It might be slightly out of date, though.
  *
  * @param as Address space.
  *
@@ -149,39 +211,13 @@ static bool avl_count_walker(avltree_node_t *node, void *arg)
  */
 static size_t get_task_virtmem(as_t *as)
 {
-	/*
-	 * We are holding spinlocks here and therefore are not allowed to
-	 * block. Only attempt to lock the address space and address space
-	 * area mutexes conditionally. If it is not possible to lock either
-	 * object, return inexact statistics by skipping the respective object.
-	 */
-
-	if (mutex_trylock(&as->lock) != EOK)
-		return 0;
-
-	size_t pages = 0;
-
-	/* Walk the B+ tree and count pages */
-	list_foreach(as->as_area_btree.leaf_list, leaf_link, btree_node_t,
-	    node) {
-		unsigned int i;
-		for (i = 0; i < node->keys; i++) {
-			as_area_t *area = node->value[i];
-
-			if (mutex_trylock(&area->lock) != EOK)
-				continue;
-
-			pages += area->pages;
-			mutex_unlock(&area->lock);
-		}
-	}
-
-	mutex_unlock(&as->lock);
-
-	return (pages << PAGE_WIDTH);
+	return (as->pages << PAGE_WIDTH);
 }
 
 /** Get the resident (used) size of a virtual address space
+ *
+ * The size is maintained by the address space code, so it can be read
+ * without locking. It might be slightly out of date, though.
  *
  * @param as Address space.
  *
@@ -190,35 +226,7 @@ static size_t get_task_virtmem(as_t *as)
  */
 static size_t get_task_resmem(as_t *as)
 {
-	/*
-	 * We are holding spinlocks here and therefore are not allowed to
-	 * block. Only attempt to lock the address space and address space
-	 * area mutexes conditionally. If it is not possible to lock either
-	 * object, return inexact statistics by skipping the respective object.
-	 */
-
-	if (mutex_trylock(&as->lock) != EOK)
-		return 0;
-
-	size_t pages = 0;
-
-	/* Walk the B+ tree and count pages */
-	list_foreach(as->as_area_btree.leaf_list, leaf_link, btree_node_t, node) {
-		unsigned int i;
-		for (i = 0; i < node->keys; i++) {
-			as_area_t *area = node->value[i];
-
-			if (mutex_trylock(&area->lock) != EOK)
-				continue;
-
-			pages += area->resident;
-			mutex_unlock(&area->lock);
-		}
-	}
-
-	mutex_unlock(&as->lock);
-
-	return (pages << PAGE_WIDTH);
+	return (as->resident << PAGE_WIDTH);
 }
 
 /* Produce task statistics
@@ -340,8 +348,8 @@ static void produce_stats_thread(thread_t *thread, stats_thread_t *stats_thread)
 	stats_thread->task_id = thread->task->taskid;
 	stats_thread->state = thread->state;
 	stats_thread->priority = thread->priority;
-	stats_thread->ucycles = thread->ucycles;
-	stats_thread->kcycles = thread->kcycles;
+	thread_get_accounting(thread, &stats_thread->ucycles,
+	    &stats_thread->kcycles);
 
 	if (thread->cpu != NULL) {
 		stats_thread->on_cpu = true;
@@ -571,6 +579,465 @@ static sysinfo_return_t get_stats_thread(const char *name, bool dry_run,
 	return ret;
 }
 
+/** Move a changed object to the end of the list of changed objects
+ *
+ * @param changes Changes of objects of the given type (locked).
+ * @param entry   Change tracking of the object.
+ *
+ */
+static void stats_entry_touch(stats_changes_t *changes, stats_entry_t *entry)
+{
+	assert(irq_spinlock_locked(&changes->lock));
+
+	atomic_count_t gen = atomic_get(&stats_generation);
+	if (entry->gen == gen)
+		return;
+
+	/*
+	 * The generation only grows, so moving the object to the end
+	 * keeps the list ordered. Objects which are not on the list yet
+	 * or any more are just stamped.
+	 */
+	entry->gen = gen;
+	if (link_in_use(&entry->link)) {
+		list_remove(&entry->link);
+		list_append(&entry->link, &changes->changed);
+	}
+}
+
+/** Record that statistics of a task have changed
+ *
+ * Use stats_task_touch() instead of calling this function directly.
+ *
+ * @param task Changed task.
+ *
+ */
+void stats_task_changed(task_t *task)
+{
+	irq_spinlock_lock(&task_changes.lock, true);
+	stats_entry_touch(&task_changes, &task->stats);
+	irq_spinlock_unlock(&task_changes.lock, true);
+}
+
+/** Record that statistics of a thread have changed
+ *
+ * Use stats_thread_touch() instead of calling this function directly.
+ *
+ * @param thread Changed thread.
+ *
+ */
+void stats_thread_changed(thread_t *thread)
+{
+	irq_spinlock_lock(&thread_changes.lock, true);
+	stats_entry_touch(&thread_changes, &thread->stats);
+	irq_spinlock_unlock(&thread_changes.lock, true);
+}
+
+/** Record that memory statistics of an address space have changed
+ *
+ * An address space is used by a single task, but there is no link from
+ * the address space to the task. A change made by the task itself marks
+ * the task. The task using an address space changed by anybody else
+ * (e.g. the program loader or the sharing of an area) is only found by
+ * the next query checking all tasks.
+ *
+ * Use stats_as_touch() instead of calling this function directly.
+ *
+ * @param as Changed address space.
+ *
+ */
+void stats_as_changed(as_t *as)
+{
+	irq_spinlock_lock(&task_changes.lock, true);
+
+	atomic_count_t gen = atomic_get(&stats_generation);
+	if (as->stats_gen != gen) {
+		as->stats_gen = gen;
+
+		if ((TASK != NULL) && (TASK->as == as))
+			stats_entry_touch(&task_changes, &TASK->stats);
+		else
+			task_changes.unordered = gen;
+	}
+
+	irq_spinlock_unlock(&task_changes.lock, true);
+}
+
+/** Add a new object to the list of changed objects
+ *
+ * @param changes Changes of objects of the given type.
+ * @param entry   Change tracking of the object.
+ *
+ */
+static void stats_entry_add(stats_changes_t *changes, stats_entry_t *entry)
+{
+	/* Interrupts are already disabled */
+	irq_spinlock_lock(&changes->lock, false);
+
+	entry->gen = atomic_get(&stats_generation);
+	list_append(&entry->link, &changes->changed);
+
+	irq_spinlock_unlock(&changes->lock, false);
+}
+
+/** Remove an object from the list of changed objects and log its removal
+ *
+ * @param changes Changes of objects of the given type.
+ * @param entry   Change tracking of the object.
+ * @param id      ID of the removed object.
+ *
+ */
+static void stats_entry_remove(stats_changes_t *changes, stats_entry_t *entry,
+    uint64_t id)
+{
+	/* Interrupts are already disabled */
+	irq_spinlock_lock(&changes->lock, false);
+
+	list_remove(&entry->link);
+
+	size_t i = changes->count % STATS_REMOVED_COUNT;
+	if (changes->count >= STATS_REMOVED_COUNT)
+		changes->lost = changes->gen[i];
+
+	changes->id[i] = id;
+	changes->gen[i] = atomic_get(&stats_generation);
+	changes->count++;
+
+	irq_spinlock_unlock(&changes->lock, false);
+}
+
+/** Record that a task has been added to the task tree
+ *
+ * @param task Added task, tasks_lock must be held.
+ *
+ */
+void stats_task_added(task_t *task)
+{
+	assert(irq_spinlock_locked(&tasks_lock));
+	stats_entry_add(&task_changes, &task->stats);
+}
+
+/** Record that a task has been removed from the task tree
+ *
+ * @param task Removed task, tasks_lock must be held.
+ *
+ */
+void stats_task_removed(task_t *task)
+{
+	assert(irq_spinlock_locked(&tasks_lock));
+	stats_entry_remove(&task_changes, &task->stats, task->taskid);
+}
+
+/** Record that a thread has been added to the thread tree
+ *
+ * @param thread Added thread, threads_lock must be held.
+ *
+ */
+void stats_thread_added(thread_t *thread)
+{
+	assert(irq_spinlock_locked(&threads_lock));
+	stats_entry_add(&thread_changes, &thread->stats);
+}
+
+/** Record that a thread has been removed from the thread tree
+ *
+ * @param thread Removed thread, threads_lock must be held.
+ *
+ */
+void stats_thread_removed(thread_t *thread)
+{
+	assert(irq_spinlock_locked(&threads_lock));
+	stats_entry_remove(&thread_changes, &thread->stats, thread->tid);
+}
+
+/** Gather the objects to be reported by an incremental query
+ *
+ * Unless all objects have to be checked, only the end of the list with
+ * the objects changed since the generation passed to the query is
+ * walked.
+ *
+ * @param changes Changes of objects of the given type (locked).
+ * @param query   Query state.
+ * @param changed Check of an object changed out of order or NULL.
+ * @param entries Array to store the objects into or NULL to count
+ *                them only.
+ *
+ * @return Number of objects to report.
+ *
+ */
+static size_t stats_changed_gather(stats_changes_t *changes,
+    stats_query_t *query, stats_changed_t changed, stats_entry_t **entries)
+{
+	assert(irq_spinlock_locked(&changes->lock));
+
+	size_t count = 0;
+
+	for (link_t *link = list_last(&changes->changed); link != NULL;
+	    link = list_prev(link, &changes->changed)) {
+		stats_entry_t *entry = list_get_instance(link, stats_entry_t,
+		    link);
+
+		if ((!query->full) && (entry->gen < query->since)) {
+			if (!query->unordered)
+				break;
+
+			if ((changed == NULL) || (!changed(entry, query)))
+				continue;
+		}
+
+		if (entries != NULL)
+			entries[count] = entry;
+
+		count++;
+	}
+
+	return count;
+}
+
+/** Gather IDs of the removed objects
+ *
+ * @param changes Changes of objects of the given type (locked).
+ * @param query   Query state.
+ * @param ids     Array to store the IDs into or NULL to count them only.
+ *
+ * @return Number of removed objects to report.
+ *
+ */
+static size_t stats_removed_gather(stats_changes_t *changes,
+    stats_query_t *query, uint64_t *ids)
+{
+	assert(irq_spinlock_locked(&changes->lock));
+
+	if (query->full)
+		return 0;
+
+	size_t count = min(changes->count, (size_t) STATS_REMOVED_COUNT);
+	size_t removed = 0;
+
+	for (size_t i = changes->count - count; i < changes->count; i++) {
+		size_t idx = i % STATS_REMOVED_COUNT;
+
+		if (changes->gen[idx] >= query->since) {
+			if (ids != NULL)
+				ids[removed] = changes->id[idx];
+
+			removed++;
+		}
+	}
+
+	return removed;
+}
+
+/** Check whether the address space of a task has changed
+ *
+ * @param entry Change tracking of the task.
+ * @param query Query state.
+ *
+ * @return True if the task is to be reported.
+ *
+ */
+static bool task_as_changed(stats_entry_t *entry, stats_query_t *query)
+{
+	task_t *task = member_to_inst(entry, task_t, stats);
+
+	return (task->as->stats_gen >= query->since);
+}
+
+/** Produce statistics of a task reported by an incremental query
+ *
+ * @param entry  Change tracking of the task.
+ * @param record Task statistics (stats_task_t).
+ *
+ */
+static void task_produce_changed(stats_entry_t *entry, void *record)
+{
+	task_t *task = member_to_inst(entry, task_t, stats);
+
+	/* Interrupts are already disabled */
+	irq_spinlock_lock(&task->lock, false);
+	produce_stats_task(task, (stats_task_t *) record);
+	irq_spinlock_unlock(&task->lock, false);
+}
+
+/** Produce statistics of a thread reported by an incremental query
+ *
+ * @param entry  Change tracking of the thread.
+ * @param record Thread statistics (stats_thread_t).
+ *
+ */
+static void thread_produce_changed(stats_entry_t *entry, void *record)
+{
+	thread_t *thread = member_to_inst(entry, thread_t, stats);
+
+	/* Interrupts are already disabled */
+	irq_spinlock_lock(&thread->lock, false);
+	produce_stats_thread(thread, (stats_thread_t *) record);
+	irq_spinlock_unlock(&thread->lock, false);
+}
+
+/** Get incremental task or thread statistics
+ *
+ * Every query which is not a dry run starts a new generation. The objects
+ * changed or removed in the generation passed to the query or later are
+ * reported, so that nothing changed while the previous query was running
+ * is missed. If too many objects have been removed since the generation
+ * passed to the query, all objects are reported instead.
+ *
+ * The objects are kept ordered by the generation of their last change,
+ * so the work done with the global locks held is proportional to the
+ * number of changed objects rather than to the number of all objects.
+ *
+ * @param name    Generation (string-encoded number) returned by
+ *                the previous query or zero.
+ * @param dry_run Do not get the data, just calculate the size.
+ * @param lock    Lock of the object tree.
+ * @param changes Changes of the objects.
+ * @param changed Check of an object changed out of order or NULL.
+ * @param produce Function producing statistics of an object.
+ * @param record_size Size of a statistics record of an object.
+ *
+ * @return Sysinfo return holder. The type of the returned data is either
+ *         SYSINFO_VAL_UNDEFINED (malformed generation or memory allocation
+ *         error) or SYSINFO_VAL_FUNCTION_DATA (in that case the generated
+ *         stats_delta_t structure with the appended records should be
+ *         freed within the sysinfo request context).
+ *
+ */
+static sysinfo_return_t get_stats_delta(const char *name, bool dry_run,
+    irq_spinlock_t *lock, stats_changes_t *changes, stats_changed_t changed,
+    stats_produce_t produce, size_t record_size)
+{
+	/* Initially no return value */
+	sysinfo_return_t ret;
+	ret.tag = SYSINFO_VAL_UNDEFINED;
+
+	/* Parse the generation */
+	uint64_t since;
+	if (str_uint64_t(name, NULL, 0, true, &since) != EOK)
+		return ret;
+
+	/*
+	 * Objects changed from now on are stamped with the next generation
+	 * and reported again by the next query.
+	 */
+	atomic_count_t generation = dry_run ?
+	    atomic_get(&stats_generation) : atomic_postinc(&stats_generation);
+
+	stats_query_t query;
+	query.since = since;
+
+	/*
+	 * The objects cannot be destroyed while the lock of their tree is
+	 * held, as they leave the list of changed objects only together
+	 * with the tree.
+	 */
+	irq_spinlock_lock(lock, true);
+	irq_spinlock_lock(&changes->lock, false);
+
+	query.full = ((since == 0) || (changes->lost >= since));
+	query.unordered = (changes->unordered >= since);
+
+	size_t count = stats_changed_gather(changes, &query, changed, NULL);
+	size_t removed = stats_removed_gather(changes, &query, NULL);
+
+	size_t size = sizeof(stats_delta_t) + count * record_size +
+	    removed * sizeof(uint64_t);
+
+	if (dry_run) {
+		ret.tag = SYSINFO_VAL_FUNCTION_DATA;
+		ret.data.data = NULL;
+		ret.data.size = size;
+
+		irq_spinlock_unlock(&changes->lock, false);
+		irq_spinlock_unlock(lock, true);
+		return ret;
+	}
+
+	stats_delta_t *delta = (stats_delta_t *) malloc(size, FRAME_ATOMIC);
+	stats_entry_t **entries = (stats_entry_t **)
+	    malloc(max(count, (size_t) 1) * sizeof(stats_entry_t *),
+	    FRAME_ATOMIC);
+	if ((delta == NULL) || (entries == NULL)) {
+		irq_spinlock_unlock(&changes->lock, false);
+		irq_spinlock_unlock(lock, true);
+
+		if (delta != NULL)
+			free(delta);
+		if (entries != NULL)
+			free(entries);
+
+		return ret;
+	}
+
+	/*
+	 * The list cannot have changed, as its lock has been held since
+	 * the objects were counted.
+	 */
+	delta->generation = generation;
+	delta->full = query.full;
+	delta->changed = stats_changed_gather(changes, &query, changed,
+	    entries);
+	uint64_t *removed_ids = (uint64_t *)
+	    ((uint8_t *) (delta + 1) + count * record_size);
+	delta->removed = stats_removed_gather(changes, &query, removed_ids);
+
+	/*
+	 * The lock of the list must not be held while locking the objects,
+	 * as the objects are touched with their locks held.
+	 */
+	irq_spinlock_unlock(&changes->lock, false);
+
+	uint8_t *record = (uint8_t *) (delta + 1);
+	for (size_t i = 0; i < delta->changed; i++) {
+		produce(entries[i], record);
+		record += record_size;
+	}
+
+	irq_spinlock_unlock(lock, true);
+
+	free(entries);
+
+	ret.tag = SYSINFO_VAL_FUNCTION_DATA;
+	ret.data.data = (void *) delta;
+	ret.data.size = size;
+
+	return ret;
+}
+
+/** Get incremental task statistics
+ *
+ * @param name    Generation (string-encoded number) returned by
+ *                the previous query or zero.
+ * @param dry_run Do not get the data, just calculate the size.
+ * @param data    Unused.
+ *
+ * @return Sysinfo return holder, see get_stats_delta().
+ *
+ */
+static sysinfo_return_t get_stats_tasks_delta(const char *name, bool dry_run,
+    void *data)
+{
+	return get_stats_delta(name, dry_run, &tasks_lock, &task_changes,
+	    task_as_changed, task_produce_changed, sizeof(stats_task_t));
+}
+
+/** Get incremental thread statistics
+ *
+ * @param name    Generation (string-encoded number) returned by
+ *                the previous query or zero.
+ * @param dry_run Do not get the data, just calculate the size.
+ * @param data    Unused.
+ *
+ * @return Sysinfo return holder, see get_stats_delta().
+ *
+ */
+static sysinfo_return_t get_stats_threads_delta(const char *name,
+    bool dry_run, void *data)
+{
+	return get_stats_delta(name, dry_run, &threads_lock, &thread_changes,
+	    NULL, thread_produce_changed, sizeof(stats_thread_t));
+}
+
 /** Get exceptions statistics
  *
  * @param item    Sysinfo item (unused).
@@ -617,6 +1084,59 @@ static void *get_stats_exceptions(struct sysinfo_item *item, size_t *size,
 	return ((void *) stats_exceptions);
 }
 
+#ifdef CONFIG_SYSCALL_STATS
+
+/** Get syscall statistics
+ *
+ * The per-processor statistics are summed without synchronization,
+ * so the result is only approximate while syscalls are running.
+ *
+ * @param item    Sysinfo item (unused).
+ * @param size    Size of the returned data.
+ * @param dry_run Do not get the data, just calculate the size.
+ * @param data    Unused.
+ *
+ * @return Data containing SYSCALL_END stats_syscall_t structures.
+ *         If the return value is not NULL, it should be freed
+ *         in the context of the sysinfo request.
+ */
+static void *get_stats_syscalls(struct sysinfo_item *item, size_t *size,
+    bool dry_run, void *data)
+{
+	*size = sizeof(stats_syscall_t) * SYSCALL_END;
+
+	if (dry_run)
+		return NULL;
+
+	stats_syscall_t *stats_syscalls =
+	    (stats_syscall_t *) malloc(*size, FRAME_ATOMIC);
+	if (stats_syscalls == NULL) {
+		/* No free space for allocation */
+		*size = 0;
+		return NULL;
+	}
+
+	memsetb(stats_syscalls, *size, 0);
+
+	for (unsigned int i = 0; i < SYSCALL_END; i++) {
+		stats_syscalls[i].id = i;
+
+		for (unsigned int j = 0; j < config.cpu_count; j++) {
+			stats_syscall_t *cpu_stats = &cpus[j].syscall_stats[i];
+
+			stats_syscalls[i].count += cpu_stats->count;
+			stats_syscalls[i].cycles += cpu_stats->cycles;
+
+			for (unsigned int k = 0; k < STATS_SYSCALL_BUCKETS; k++)
+				stats_syscalls[i].hist[k] += cpu_stats->hist[k];
+		}
+	}
+
+	return ((void *) stats_syscalls);
+}
+
+#endif /* CONFIG_SYSCALL_STATS */
+
 /** Get exception statistics
  *
  * Get statistics of a given exception. The exception number
@@ -804,6 +1324,10 @@ void kload(void *arg)
 void stats_init(void)
 {
 	mutex_initialize(&load_lock, MUTEX_PASSIVE);
+	irq_spinlock_initialize(&task_changes.lock, "stats_task_changes");
+	list_initialize(&task_changes.changed);
+	irq_spinlock_initialize(&thread_changes.lock, "stats_thread_changes");
+	list_initialize(&thread_changes.changed);
 
 	sysinfo_set_item_gen_data("system.cpus", NULL, get_stats_cpus, NULL);
 	sysinfo_set_item_gen_data("system.physmem", NULL, get_stats_physmem, NULL);
@@ -811,9 +1335,16 @@ void stats_init(void)
 	sysinfo_set_item_gen_data("system.tasks", NULL, get_stats_tasks, NULL);
 	sysinfo_set_item_gen_data("system.threads", NULL, get_stats_threads, NULL);
 	sysinfo_set_item_gen_data("system.exceptions", NULL, get_stats_exceptions, NULL);
+#ifdef CONFIG_SYSCALL_STATS
+	sysinfo_set_item_gen_data("system.syscalls", NULL, get_stats_syscalls, NULL);
+#endif
 	sysinfo_set_subtree_fn("system.tasks", NULL, get_stats_task, NULL);
 	sysinfo_set_subtree_fn("system.threads", NULL, get_stats_thread, NULL);
 	sysinfo_set_subtree_fn("system.exceptions", NULL, get_stats_exception, NULL);
+	sysinfo_set_subtree_fn("system.tasks_delta", NULL, get_stats_tasks_delta,
+	    NULL);
+	sysinfo_set_subtree_fn("system.threads_delta", NULL,
+	    get_stats_threads_delta, NULL);
 }
 
 /** @}
@@ -57,6 +57,8 @@
 #include <mm/frame.h>
 #include <ddi/ddi.h>
 #include <arch/cycle.h>
+#include <udebug/udebug_prof.h>
+#include <smp/smp_call.h>
 
 /* Pointer to variable with uptime */
 uptime_t *uptime;
@@ -146,47 +148,18 @@ void clock(void)
 {
 	size_t missed_clock_ticks = CPU->missed_clock_ticks;
 
-	/* Account CPU usage */
-	cpu_update_accounting();
-
 	/*
-	 * To avoid lock ordering problems,
-	 * run all expired timeouts as you visit them.
-	 *
+	 * Account CPU usage. Ticks skipped while the CPU was idle have
+	 * already been charged as idle cycles on interrupt entry, so the
+	 * accounting is done just once, not per missed tick.
 	 */
+	cpu_update_accounting();
+
 	size_t i;
 	for (i = 0; i <= missed_clock_ticks; i++) {
-		/* Update counters and accounting */
+		/* Update counters and run expired timeouts */
 		clock_update_counters();
-		cpu_update_accounting();
-
-		irq_spinlock_lock(&CPU->timeoutlock, false);
-
-		link_t *cur;
-		while ((cur = list_first(&CPU->timeout_active_list)) != NULL) {
-			timeout_t *timeout = list_get_instance(cur, timeout_t,
-			    link);
-
-			irq_spinlock_lock(&timeout->lock, false);
-			if (timeout->ticks-- != 0) {
-				irq_spinlock_unlock(&timeout->lock, false);
-				break;
-			}
-
-			list_remove(cur);
-			timeout_handler_t handler = timeout->handler;
-			void *arg = timeout->arg;
-			timeout_reinitialize(timeout);
-
-			irq_spinlock_unlock(&timeout->lock, false);
-			irq_spinlock_unlock(&CPU->timeoutlock, false);
-
-			handler(arg);
-
-			irq_spinlock_lock(&CPU->timeoutlock, false);
-		}
-
-		irq_spinlock_unlock(&CPU->timeoutlock, false);
+		timeout_tick();
 	}
 	CPU->missed_clock_ticks = 0;
 
@@ -211,6 +184,11 @@ void clock(void)
 		}
 		irq_spinlock_unlock(&THREAD->lock, false);
 
+#ifdef CONFIG_UDEBUG
+		/* Sample the thread if its task is being profiled. */
+		udebug_prof_tick(THREAD->udebug.uspace_state);
+#endif
+
 		if (ticks == 0 && PREEMPTION_ENABLED) {
 			scheduler();
 #ifdef CONFIG_UDEBUG
@@ -226,5 +204,90 @@ void clock(void)
 	}
 }
 
+#ifdef CONFIG_TICKLESS
+
+/** Maximum number of clock ticks an idle CPU may skip */
+#define CLOCK_MAX_IDLE_TICKS  HZ
+
+/** Stop periodic clock interrupts on an idle CPU
+ *
+ * Programs the timer to fire when the nearest timeout of this CPU
+ * expires. The ticks skipped meanwhile are caught up as missed clock
+ * ticks by the next clock interrupt.
+ *
+ * Must be called with interrupts disabled right before the CPU
+ * goes to sleep, after it has been marked idle.
+ *
+ * @return False if a thread has become ready on this CPU meanwhile
+ *         and the CPU must not go to sleep.
+ *
+ */
+bool clock_idle_enter(void)
+{
+	/*
+	 * A thread readied by another CPU after the scheduler found the
+	 * run queues empty would not be noticed until the one-shot clock
+	 * interrupt. Pairs with the barrier in clock_idle_wakeup().
+	 */
+	memory_barrier();
+	if (atomic_get(&CPU->nrdy) != 0)
+		return false;
+
+	size_t ticks = timeout_idle_ticks(CLOCK_MAX_IDLE_TICKS);
+
+	if (ticks > 1) {
+		clock_arch_oneshot(ticks);
+		CPU->tickless = true;
+	}
+
+	return true;
+}
+
+/** Resume periodic clock interrupts after the CPU wakes up
+ *
+ * Must be called with interrupts disabled.
+ *
+ */
+void clock_idle_exit(void)
+{
+	if (CPU->tickless) {
+		clock_arch_periodic();
+		CPU->tickless = false;
+	}
+}
+
+/** Wake up a CPU which may be sleeping without periodic clock interrupts
+ *
+ * Must be called after a thread has been appended to a run queue of
+ * @a cpu.
+ *
+ * @param cpu CPU whose run queue has been modified.
+ *
+ */
+void clock_idle_wakeup(cpu_t *cpu)
+{
+#ifdef CONFIG_SMP
+	/* Pairs with the barrier in clock_idle_enter(). */
+	memory_barrier();
+	if ((cpu != CPU) && (cpu->idle))
+		arch_smp_call_ipi(cpu->id);
+#endif
+}
+
+/** Get number of elapsed clock ticks not yet processed on this CPU
+ *
+ * After an idle CPU wakes up, the ticks it skipped are processed only
+ * by the next clock interrupt.
+ *
+ * Must be called with interrupts disabled.
+ *
+ */
+size_t clock_pending_ticks(void)
+{
+	return clock_arch_pending();
+}
+
+#endif /* CONFIG_TICKLESS */
+
 /** @}
  */
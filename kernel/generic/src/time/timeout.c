@@ -33,6 +33,9 @@
 /**
  * @file
  * @brief Timeout management functions.
+ *
+ * Timeouts are kept in a per-CPU hierarchical timer wheel, which makes
+ * both registration and cancellation constant time operations.
  */
 
 #include <time/timeout.h>
@@ -44,6 +47,13 @@
 #include <cpu.h>
 #include <arch/asm.h>
 #include <arch.h>
+#include <time/clock.h>
+
+/** Mask of slot index bits of one wheel level */
+#define SLOT_MASK  (TIMEOUT_WHEEL_SLOTS - 1)
+
+/** Number of ticks covered by all wheel levels */
+#define WHEEL_SPAN  (UINT64_C(1) << (TIMEOUT_WHEEL_BITS * TIMEOUT_WHEEL_LEVELS))
 
 /** Initialize timeouts
  *
@@ -53,7 +63,15 @@
 void timeout_init(void)
 {
 	irq_spinlock_initialize(&CPU->timeoutlock, "cpu.timeoutlock");
-	list_initialize(&CPU->timeout_active_list);
+
+	timeout_wheel_t *wheel = &CPU->timeout_wheel;
+	wheel->now = 0;
+	wheel->count = 0;
+
+	for (unsigned int level = 0; level < TIMEOUT_WHEEL_LEVELS; level++) {
+		for (unsigned int i = 0; i < TIMEOUT_WHEEL_SLOTS; i++)
+			list_initialize(&wheel->slot[level][i]);
+	}
 }
 
 /** Reinitialize timeout
@@ -66,7 +84,7 @@ void timeout_init(void)
 void timeout_reinitialize(timeout_t *timeout)
 {
 	timeout->cpu = NULL;
-	timeout->ticks = 0;
+	timeout->deadline = 0;
 	timeout->handler = NULL;
 	timeout->arg = NULL;
 	link_initialize(&timeout->link);
@@ -85,10 +103,59 @@ void timeout_initialize(timeout_t *timeout)
 	timeout_reinitialize(timeout);
 }
 
+/** Insert timeout into the timer wheel
+ *
+ * The level is chosen by the distance to the deadline, the slot within
+ * the level by the deadline itself. Timeouts beyond the span of the
+ * wheel are parked in the farthest slot and cascaded again later.
+ *
+ * @param wheel   Timer wheel locked by its CPU's timeoutlock.
+ * @param timeout Timeout with deadline not before wheel->now.
+ *
+ */
+static void wheel_insert(timeout_wheel_t *wheel, timeout_t *timeout)
+{
+	uint64_t delta = timeout->deadline - wheel->now;
+	uint64_t deadline = timeout->deadline;
+
+	if (delta >= WHEEL_SPAN) {
+		delta = WHEEL_SPAN - 1;
+		deadline = wheel->now + delta;
+	}
+
+	unsigned int level = 0;
+	while (delta >= TIMEOUT_WHEEL_SLOTS) {
+		delta >>= TIMEOUT_WHEEL_BITS;
+		level++;
+	}
+
+	size_t index = (deadline >> (level * TIMEOUT_WHEEL_BITS)) & SLOT_MASK;
+	list_append(&timeout->link, &wheel->slot[level][index]);
+}
+
+/** Redistribute timeouts of one wheel slot to lower levels
+ *
+ * @param wheel Timer wheel locked by its CPU's timeoutlock.
+ * @param level Wheel level.
+ * @param index Slot index.
+ *
+ */
+static void wheel_cascade(timeout_wheel_t *wheel, unsigned int level,
+    size_t index)
+{
+	list_t *slot = &wheel->slot[level][index];
+	link_t *cur;
+
+	while ((cur = list_first(slot)) != NULL) {
+		list_remove(cur);
+		wheel_insert(wheel, list_get_instance(cur, timeout_t, link));
+	}
+}
+
 /** Register timeout
  *
  * Insert timeout handler f (with argument arg)
- * to timeout list and make it execute in
+ * to the timer wheel and make it execute in
  * time microseconds (or slightly more).
  *
  * @param timeout Timeout structure.
@@ -107,49 +174,22 @@ void timeout_register(timeout_t *timeout, uint64_t time,
 		panic("Unexpected: timeout->cpu != 0.");
 
 	timeout->cpu = CPU;
-	timeout->ticks = us2ticks(time);
-
-	timeout->handler = handler;
-	timeout->arg = arg;
 
 	/*
-	 * Insert timeout into the active timeouts list according to timeout->ticks.
+	 * Ticks skipped by an idle CPU are processed only by the next clock
+	 * interrupt, count them in so that the timeout does not fire early.
 	 */
-	uint64_t sum = 0;
-	timeout_t *target = NULL;
-	link_t *cur;
-	for (cur = CPU->timeout_active_list.head.next;
-	    cur != &CPU->timeout_active_list.head; cur = cur->next) {
-		target = list_get_instance(cur, timeout_t, link);
-		irq_spinlock_lock(&target->lock, false);
-
-		if (timeout->ticks < sum + target->ticks) {
-			irq_spinlock_unlock(&target->lock, false);
-			break;
-		}
+	uint64_t now = CPU->timeout_wheel.now;
+#ifdef CONFIG_TICKLESS
+	now += clock_pending_ticks();
+#endif
+	timeout->deadline = now + us2ticks(time);
 
-		sum += target->ticks;
-		irq_spinlock_unlock(&target->lock, false);
-	}
-
-	/* Avoid using cur->prev directly */
-	link_t *prev = cur->prev;
-	list_insert_after(&timeout->link, prev);
-
-	/*
-	 * Adjust timeout->ticks according to ticks
-	 * accumulated in target's predecessors.
-	 */
-	timeout->ticks -= sum;
+	timeout->handler = handler;
+	timeout->arg = arg;
 
-	/*
-	 * Decrease ticks of timeout's immediate succesor by timeout->ticks.
-	 */
-	if (cur != &CPU->timeout_active_list.head) {
-		irq_spinlock_lock(&target->lock, false);
-		target->ticks -= timeout->ticks;
-		irq_spinlock_unlock(&target->lock, false);
-	}
+	wheel_insert(&CPU->timeout_wheel, timeout);
+	CPU->timeout_wheel.count++;
 
 	irq_spinlock_unlock(&timeout->lock, false);
 	irq_spinlock_unlock(&CPU->timeoutlock, true);
@@ -157,7 +197,7 @@ void timeout_register(timeout_t *timeout, uint64_t time,
 
 /** Unregister timeout
  *
- * Remove timeout from timeout list.
+ * Remove timeout from the timer wheel.
  *
  * @param timeout Timeout to unregister.
  *
@@ -183,18 +223,11 @@ grab_locks:
 
 	/*
 	 * Now we know for sure that timeout hasn't been activated yet
-	 * and is lurking in timeout->cpu->timeout_active_list.
+	 * and is lurking in timeout->cpu->timeout_wheel.
 	 */
 
-	link_t *cur = timeout->link.next;
-	if (cur != &timeout->cpu->timeout_active_list.head) {
-		timeout_t *tmp = list_get_instance(cur, timeout_t, link);
-		irq_spinlock_lock(&tmp->lock, false);
-		tmp->ticks += timeout->ticks;
-		irq_spinlock_unlock(&tmp->lock, false);
-	}
-
 	list_remove(&timeout->link);
+	timeout->cpu->timeout_wheel.count--;
 	irq_spinlock_unlock(&timeout->cpu->timeoutlock, false);
 
 	timeout_reinitialize(timeout);
@@ -203,5 +236,124 @@ grab_locks:
 	return true;
 }
 
+/** Process one clock tick of the timer wheel
+ *
+ * Runs all timeouts expiring at the current tick of this CPU and
+ * advances the wheel. To avoid lock ordering problems, the handlers
+ * are executed as they are visited, with no locks held.
+ *
+ * Must be called with interrupts disabled.
+ *
+ */
+void timeout_tick(void)
+{
+	timeout_wheel_t *wheel = &CPU->timeout_wheel;
+
+	irq_spinlock_lock(&CPU->timeoutlock, false);
+
+	/* Bring timeouts of upper levels closer on lower level wrap-around */
+	size_t index = wheel->now & SLOT_MASK;
+	for (unsigned int level = 1;
+	    (index == 0) && (level < TIMEOUT_WHEEL_LEVELS); level++) {
+		index = (wheel->now >> (level * TIMEOUT_WHEEL_BITS)) &
+		    SLOT_MASK;
+		wheel_cascade(wheel, level, index);
+	}
+
+	list_t *slot = &wheel->slot[0][wheel->now & SLOT_MASK];
+	link_t *cur;
+
+	while ((cur = list_first(slot)) != NULL) {
+		timeout_t *timeout = list_get_instance(cur, timeout_t, link);
+
+		irq_spinlock_lock(&timeout->lock, false);
+
+		list_remove(cur);
+		wheel->count--;
+		timeout_handler_t handler = timeout->handler;
+		void *arg = timeout->arg;
+		timeout_reinitialize(timeout);
+
+		irq_spinlock_unlock(&timeout->lock, false);
+		irq_spinlock_unlock(&CPU->timeoutlock, false);
+
+		handler(arg);
+
+		irq_spinlock_lock(&CPU->timeoutlock, false);
+	}
+
+	wheel->now++;
+
+	irq_spinlock_unlock(&CPU->timeoutlock, false);
+}
+
+/** Get number of clock ticks this CPU can skip
+ *
+ * Finds the nearest non-empty slot of the timer wheel. For upper levels
+ * the beginning of the slot is used, so the result may be shorter than
+ * the actual distance to the nearest timeout but never longer.
+ *
+ * Must be called with interrupts disabled.
+ *
+ * @param limit Maximum number of ticks to report.
+ *
+ * @return Number of ticks until the next timeout expires, at most
+ *         @a limit. Zero means the next tick must not be skipped.
+ *
+ */
+size_t timeout_idle_ticks(size_t limit)
+{
+	timeout_wheel_t *wheel = &CPU->timeout_wheel;
+	uint64_t ticks = limit;
+
+	irq_spinlock_lock(&CPU->timeoutlock, false);
+
+	if (wheel->count > 0) {
+		for (unsigned int i = 0; i < TIMEOUT_WHEEL_SLOTS; i++) {
+			if (i >= ticks)
+				break;
+
+			size_t index = (wheel->now + i) & SLOT_MASK;
+			if (!list_empty(&wheel->slot[0][index])) {
+				ticks = i;
+				break;
+			}
+		}
+
+		for (unsigned int level = 1; level < TIMEOUT_WHEEL_LEVELS;
+		    level++) {
+			const unsigned int shift = level * TIMEOUT_WHEEL_BITS;
+			const uint64_t base = wheel->now >> shift;
+
+			/*
+			 * The slot of the current block is still waiting to be
+			 * cascaded if the block has just begun. Otherwise it
+			 * holds timeouts of the block one full turn ahead,
+			 * hence the inclusive bound.
+			 */
+			const uint64_t mask = (UINT64_C(1) << shift) - 1;
+			unsigned int first = ((wheel->now & mask) == 0) ? 0 : 1;
+
+			for (unsigned int i = first; i <= TIMEOUT_WHEEL_SLOTS;
+			    i++) {
+				const uint64_t start = ((base + i) << shift) -
+				    wheel->now;
+				if (start >= ticks)
+					break;
+
+				if (!list_empty(&wheel->slot[level]
+				    [(base + i) & SLOT_MASK])) {
+					ticks = start;
+					break;
+				}
+			}
+		}
+	}
+
+	irq_spinlock_unlock(&CPU->timeoutlock, false);
+
+	return (size_t) ticks;
+}
+
 /** @}
  */
@@ -41,6 +41,7 @@
 #include <debug.h>
 #include <synch/waitq.h>
 #include <udebug/udebug.h>
+#include <udebug/udebug_prof.h>
 #include <errno.h>
 #include <print.h>
 #include <arch.h>
@@ -456,6 +457,8 @@ errno_t udebug_task_cleanup(struct task *task)
 			mutex_unlock(&thread->udebug.lock);
 	}
 
+	udebug_prof_task_cleanup(task);
+
 	task->udebug.dt_state = UDEBUG_TS_INACTIVE;
 	task->udebug.debugger = NULL;
 
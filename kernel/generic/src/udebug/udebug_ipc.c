@@ -49,6 +49,7 @@
 #include <udebug/udebug.h>
 #include <udebug/udebug_ops.h>
 #include <udebug/udebug_ipc.h>
+#include <udebug/udebug_prof.h>
 
 errno_t udebug_request_preprocess(call_t *call, phone_t *phone)
 {
@@ -378,6 +379,36 @@ static void udebug_receive_regs_read(call_t *call)
 }
 
 
+/** Process a PROF_START call.
+ *
+ * Starts sampling the current (debugged) task.
+ * @param call	The call structure.
+ */
+static void udebug_receive_prof_start(call_t *call)
+{
+	errno_t rc;
+
+	rc = udebug_prof_start();
+
+	IPC_SET_RETVAL(call->data, rc);
+	ipc_answer(&TASK->kb.box, call);
+}
+
+/** Process a PROF_STOP call.
+ *
+ * Stops sampling the current (debugged) task.
+ * @param call	The call structure.
+ */
+static void udebug_receive_prof_stop(call_t *call)
+{
+	errno_t rc;
+
+	rc = udebug_prof_stop();
+
+	IPC_SET_RETVAL(call->data, rc);
+	ipc_answer(&TASK->kb.box, call);
+}
+
 /** Process an MEM_READ call.
  *
  * Reads memory of the current (debugged) task.
@@ -475,6 +506,12 @@ void udebug_call_receive(call_t *call)
 	case UDEBUG_M_MEM_READ:
 		udebug_receive_mem_read(call);
 		break;
+	case UDEBUG_M_PROF_START:
+		udebug_receive_prof_start(call);
+		break;
+	case UDEBUG_M_PROF_STOP:
+		udebug_receive_prof_stop(call);
+		break;
 	}
 }
 
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup generic
+ * @{
+ */
+
+/**
+ * @file
+ * @brief Statistical sampling profiler.
+ *
+ * While a task is being profiled, every clock tick which interrupts
+ * one of its threads records the interrupted userspace program counter
+ * together with the return addresses found by walking the frame pointer
+ * chain. The samples are stored in a ring which is exported to userspace
+ * as a physical area, so the profiler collects them without any further
+ * cooperation from the kernel.
+ *
+ * The profiling is controlled through the udebug interface, so only the
+ * debugger of a task can profile it.
+ */
+
+#include <udebug/udebug_prof.h>
+#include <udebug/udebug.h>
+#include <align.h>
+#include <arch.h>
+#include <arch/barrier.h>
+#include <ddi/ddi.h>
+#include <errno.h>
+#include <log.h>
+#include <mem.h>
+#include <mm/as.h>
+#include <mm/frame.h>
+#include <mm/page.h>
+#include <proc/task.h>
+#include <proc/thread.h>
+#include <stacktrace.h>
+#include <synch/spinlock.h>
+#include <sysinfo/sysinfo.h>
+
+/** Number of sample slots (must be a power of two) */
+#define PROF_CAPACITY  2048
+
+/** Protects the sample ring and the profiled task */
+IRQ_SPINLOCK_STATIC_INITIALIZE(prof_lock);
+
+/** ID of the profiled task, zero if none */
+static volatile task_id_t prof_task_id = 0;
+
+static prof_header_t *prof_header;
+static prof_sample_t *prof_samples;
+static parea_t prof_parea;
+
+/** Allocate the sample area and export it to userspace. */
+void udebug_prof_init(void)
+{
+	size_t offset = ALIGN_UP(sizeof(prof_header_t), FRAME_SIZE);
+	size_t frames = SIZE2FRAMES(offset +
+	    PROF_CAPACITY * sizeof(prof_sample_t));
+
+	uintptr_t faddr = frame_alloc(frames, FRAME_LOWMEM | FRAME_ATOMIC, 0);
+	if (!faddr) {
+		log(LF_OTHER, LVL_ERROR, "Unable to allocate %zu frames for "
+		    "profiling", frames);
+		return;
+	}
+
+	prof_header = (prof_header_t *) PA2KA(faddr);
+	memsetb(prof_header, offset, 0);
+
+	prof_header->capacity = PROF_CAPACITY;
+	prof_header->offset = offset;
+	prof_samples = (prof_sample_t *) ((uint8_t *) prof_header + offset);
+
+	prof_parea.pbase = faddr;
+	prof_parea.frames = frames;
+	prof_parea.unpriv = false;
+	prof_parea.mapped = false;
+	ddi_parea_register(&prof_parea);
+
+	sysinfo_set_item_val("prof.faddr", NULL, (sysarg_t) faddr);
+	sysinfo_set_item_val("prof.pages", NULL, frames);
+}
+
+/** Start profiling the current task.
+ *
+ * Called by the kbox servicing thread of the debugged task.
+ *
+ * @return EOK on success, ENOENT if the sample area is not available,
+ *         EINVAL if the task is not being debugged or EBUSY if
+ *         another task is being profiled.
+ *
+ */
+errno_t udebug_prof_start(void)
+{
+	if (!prof_header)
+		return ENOENT;
+
+	mutex_lock(&TASK->udebug.lock);
+
+	if (TASK->udebug.dt_state != UDEBUG_TS_ACTIVE) {
+		mutex_unlock(&TASK->udebug.lock);
+		return EINVAL;
+	}
+
+	irq_spinlock_lock(&prof_lock, true);
+
+	if ((prof_task_id != 0) && (prof_task_id != TASK->taskid)) {
+		irq_spinlock_unlock(&prof_lock, true);
+		mutex_unlock(&TASK->udebug.lock);
+		return EBUSY;
+	}
+
+	prof_header->head = 0;
+	prof_header->task_id = TASK->taskid;
+	write_barrier();
+	prof_task_id = TASK->taskid;
+
+	irq_spinlock_unlock(&prof_lock, true);
+	mutex_unlock(&TASK->udebug.lock);
+
+	return EOK;
+}
+
+/** Stop profiling the current task.
+ *
+ * Called by the kbox servicing thread of the debugged task.
+ *
+ * @return EOK on success, EINVAL if the task is not being profiled.
+ *
+ */
+errno_t udebug_prof_stop(void)
+{
+	irq_spinlock_lock(&prof_lock, true);
+
+	if ((prof_task_id == 0) || (prof_task_id != TASK->taskid)) {
+		irq_spinlock_unlock(&prof_lock, true);
+		return EINVAL;
+	}
+
+	prof_task_id = 0;
+	prof_header->task_id = 0;
+
+	irq_spinlock_unlock(&prof_lock, true);
+	return EOK;
+}
+
+/** Stop profiling a task whose debugging session is ending.
+ *
+ * @param task Task being cleaned up.
+ *
+ */
+void udebug_prof_task_cleanup(task_t *task)
+{
+	irq_spinlock_lock(&prof_lock, true);
+
+	if ((prof_task_id != 0) && (prof_task_id == task->taskid)) {
+		prof_task_id = 0;
+		prof_header->task_id = 0;
+	}
+
+	irq_spinlock_unlock(&prof_lock, true);
+}
+
+/** Check that the userspace frame of the current thread can be read.
+ *
+ * The sample is taken from the clock interrupt handler, which must not
+ * service a page fault. Therefore the frame is read only if the pages
+ * it occupies are present.
+ *
+ * @param fp Frame pointer.
+ *
+ * @return True if the frame can be read without faulting.
+ *
+ */
+static bool prof_frame_present(uintptr_t fp)
+{
+	uintptr_t first = ALIGN_DOWN(fp, PAGE_SIZE);
+	uintptr_t last = ALIGN_DOWN(fp + 2 * sizeof(uintptr_t) - 1, PAGE_SIZE);
+
+	for (uintptr_t page = first; page <= last; page += PAGE_SIZE) {
+		pte_t pte;
+		bool found = page_mapping_find(AS, page, true, &pte);
+		if ((!found) || (!PTE_VALID(&pte)) || (!PTE_PRESENT(&pte)))
+			return false;
+	}
+
+	return true;
+}
+
+/** Sample the current thread.
+ *
+ * Called from the clock interrupt handler with interrupts disabled.
+ *
+ * @param istate State of the interrupted thread.
+ *
+ */
+void udebug_prof_tick(istate_t *istate)
+{
+	if ((prof_task_id == 0) || (THREAD->task->taskid != prof_task_id) ||
+	    (!THREAD->uspace) || (!istate))
+		return;
+
+	irq_spinlock_lock(&prof_lock, false);
+
+	/* Profiling might have been stopped in the meantime. */
+	if (THREAD->task->taskid != prof_task_id) {
+		irq_spinlock_unlock(&prof_lock, false);
+		return;
+	}
+
+	uint64_t head = prof_header->head;
+	prof_sample_t *sample = &prof_samples[head & (PROF_CAPACITY - 1)];
+
+	sample->thread_id = THREAD->tid;
+	sample->flags = 0;
+	sample->depth = 0;
+
+	if (istate_from_uspace(istate)) {
+		stack_trace_context_t ctx = {
+			.fp = istate_get_fp(istate),
+			.pc = istate_get_pc(istate),
+			.istate = istate
+		};
+
+		sample->pc[sample->depth++] = ctx.pc;
+
+		while ((sample->depth < PROF_DEPTH) &&
+		    (uspace_stack_trace_context_validate(&ctx)) &&
+		    (prof_frame_present(ctx.fp))) {
+			uintptr_t ra;
+			uintptr_t fp;
+
+			if ((!uspace_return_address_get(&ctx, &ra)) ||
+			    (!uspace_frame_pointer_prev(&ctx, &fp)) ||
+			    (ra == 0))
+				break;
+
+			sample->pc[sample->depth++] = ra;
+
+			/* Stop at frames which do not move up the stack. */
+			if (fp <= ctx.fp)
+				break;
+
+			ctx.fp = fp;
+		}
+	} else
+		sample->flags |= PROF_SAMPLE_KERNEL;
+
+	/*
+	 * Publish the sample. The new head must not become visible before
+	 * the sample and the next sample must not become visible before
+	 * the new head.
+	 */
+	write_barrier();
+	prof_header->head = head + 1;
+	write_barrier();
+
+	irq_spinlock_unlock(&prof_lock, false);
+}
+
+/** @}
+ */
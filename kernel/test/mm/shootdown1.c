@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <print.h>
+#include <test.h>
+#include <mm/tlb.h>
+#include <mm/asid.h>
+#include <arch/mm/asid.h>
+#include <arch/mm/tlb.h>
+#include <arch/mm/page.h>
+#include <arch/cycle.h>
+#include <cpu/cpu_mask.h>
+#include <config.h>
+#include <typedefs.h>
+
+#define ROUNDS  1000
+
+static uint8_t target[PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+/** Measure the average duration of a single-page shootdown round.
+ *
+ * @param mask Target processors or NULL for a broadcast.
+ *
+ * @return Average number of cycles per round.
+ *
+ */
+static uint64_t shootdown_rounds(cpu_mask_t *mask)
+{
+	uintptr_t page = (uintptr_t) target;
+	uint64_t start = get_cycle();
+
+	for (unsigned int i = 0; i < ROUNDS; i++) {
+		ipl_t ipl = tlb_shootdown_mask_start(mask, TLB_INVL_PAGES,
+		    ASID_KERNEL, page, 1);
+		tlb_invalidate_pages(ASID_KERNEL, page, 1);
+		tlb_shootdown_finalize(ipl);
+	}
+
+	return (get_cycle() - start) / ROUNDS;
+}
+
+const char *test_shootdown1(void)
+{
+	DEFINE_CPU_MASK(mask);
+
+	TPRINTF("Shootdown latency of an address space active on N cpus:\n");
+
+	/*
+	 * An address space active on the first N processors. The sending
+	 * processor itself is never interrupted, so the number of remote
+	 * targets is N - 1 or N.
+	 */
+	for (unsigned int n = 1; n <= config.cpu_active; n++) {
+		cpu_mask_none(mask);
+		for (unsigned int i = 0; i < n; i++)
+			cpu_mask_set(mask, i);
+
+		uint64_t cycles = shootdown_rounds(mask);
+		TPRINTF("  N = %u: %" PRIu64 " cycles\n", n, cycles);
+	}
+
+	uint64_t cycles = shootdown_rounds(NULL);
+	TPRINTF("Broadcast to %zu cpus: %" PRIu64 " cycles\n",
+	    config.cpu_active, cycles);
+
+	return NULL;
+}
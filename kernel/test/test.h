@@ -65,6 +65,7 @@ extern const char *test_falloc1(void);
 extern const char *test_falloc2(void);
 extern const char *test_mapping1(void);
 extern const char *test_purge1(void);
+extern const char *test_shootdown1(void);
 extern const char *test_slab1(void);
 extern const char *test_slab2(void);
 extern const char *test_semaphore1(void);
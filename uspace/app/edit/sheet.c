@@ -43,15 +43,20 @@
  * versa. The text that is inserted or deleted can contain tabs and newlines
  * which are interpreted and properly acted upon.
  *
- * This is a trivial implementation with poor efficiency with O(N+n)
- * insertion and deletion and O(N) mapping (in both directions), where
- * N is the size of the file and n is the size of the inserted/deleted text.
+ * This implementation is a piece table. The text is stored in append-only
+ * text blocks and the sheet is a sequence of pieces referring to stretches
+ * of the blocks. The pieces are kept in a treap which caches the size and
+ * the number of newlines of each subtree. Insertion and deletion take
+ * O(log N + n) expected time and mapping coordinates takes O(log N + L),
+ * where N is the size of the file, n is the size of the inserted text and
+ * L is the length of the row. Tags are kept in an ordered dictionary, only
+ * the tags following the point of modification need to be adjusted.
  */
 
 #include <stdlib.h>
 #include <str.h>
 #include <errno.h>
-#include <adt/list.h>
+#include <adt/odict.h>
 #include <align.h>
 #include <macros.h>
 
@@ -61,10 +66,380 @@
 enum {
 	TAB_WIDTH	= 8,
 
-	/** Initial  of dat buffer in bytes */
-	INITIAL_SIZE	= 32
+	/** Maximum size of a piece in bytes */
+	PIECE_MAX	= 4096,
+
+	/** Size of a text block in bytes */
+	BLOCK_SIZE	= 65536,
+
+	/** Size of the buffer used when decoding text of a row */
+	READ_BUF_SIZE	= 256
 };
 
+/** Sequential reader of sheet text */
+typedef struct {
+	sheet_t *sh;
+	/** Offset of the first byte in @c buf */
+	size_t buf_off;
+	/** Number of valid bytes in @c buf */
+	size_t buf_len;
+	char buf[READ_BUF_SIZE];
+} sheet_reader_t;
+
+static void *tag_getkey(odlink_t *odlink)
+{
+	tag_t *tag = odict_get_instance(odlink, tag_t, ltags);
+	return (void *) &tag->b_off;
+}
+
+static int tag_cmp(void *a, void *b)
+{
+	size_t oa = *(size_t *) a;
+	size_t ob = *(size_t *) b;
+
+	if (oa < ob)
+		return -1;
+	else if (oa > ob)
+		return 1;
+
+	return 0;
+}
+
+static size_t piece_sub_size(piece_t *p)
+{
+	return (p != NULL) ? p->sub_size : 0;
+}
+
+static size_t piece_sub_nl(piece_t *p)
+{
+	return (p != NULL) ? p->sub_nl : 0;
+}
+
+/** Recompute the cached values of a piece subtree. */
+static void piece_update(piece_t *p)
+{
+	p->sub_size = piece_sub_size(p->left) + p->size +
+	    piece_sub_size(p->right);
+	p->sub_nl = piece_sub_nl(p->left) + p->nl + piece_sub_nl(p->right);
+}
+
+static size_t count_nl(const char *text, size_t size)
+{
+	size_t nl = 0;
+
+	for (size_t i = 0; i < size; i++) {
+		if (text[i] == '\n')
+			++nl;
+	}
+
+	return nl;
+}
+
+static piece_t *piece_create(void)
+{
+	piece_t *p = calloc(1, sizeof(piece_t));
+	if (p == NULL)
+		return NULL;
+
+	p->prio = (unsigned int) rand();
+	return p;
+}
+
+/** Set the text of a piece. */
+static void piece_set_text(piece_t *p, char *text, size_t size)
+{
+	p->text = text;
+	p->size = size;
+	p->nl = count_nl(text, size);
+	piece_update(p);
+}
+
+static void piece_destroy_tree(piece_t *p)
+{
+	if (p == NULL)
+		return;
+
+	piece_destroy_tree(p->left);
+	piece_destroy_tree(p->right);
+	free(p);
+}
+
+/** Concatenate two piece treaps. */
+static piece_t *piece_merge(piece_t *a, piece_t *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	if (a->prio > b->prio) {
+		a->right = piece_merge(a->right, b);
+		piece_update(a);
+		return a;
+	}
+
+	b->left = piece_merge(a, b->left);
+	piece_update(b);
+	return b;
+}
+
+/** Split a piece treap at a byte offset.
+ *
+ * @param p	Treap to split.
+ * @param off	Byte offset to split at.
+ * @param spare	Piece to use if a piece needs to be split in two. Set to
+ *		@c NULL if it has been used.
+ * @param l	Place to store the treap with the text before @a off.
+ * @param r	Place to store the treap with the text after @a off.
+ */
+static void piece_split(piece_t *p, size_t off, piece_t **spare,
+    piece_t **l, piece_t **r)
+{
+	if (p == NULL) {
+		*l = *r = NULL;
+		return;
+	}
+
+	size_t lsize = piece_sub_size(p->left);
+
+	if (off <= lsize) {
+		piece_split(p->left, off, spare, l, &p->left);
+		piece_update(p);
+		*r = p;
+	} else if (off >= lsize + p->size) {
+		piece_split(p->right, off - lsize - p->size, spare,
+		    &p->right, r);
+		piece_update(p);
+		*l = p;
+	} else {
+		/* Split the piece itself, the tail goes to the spare. */
+		piece_t *tail = *spare;
+		size_t hsize = off - lsize;
+
+		*spare = NULL;
+		piece_set_text(tail, p->text + hsize, p->size - hsize);
+
+		*r = piece_merge(tail, p->right);
+		p->right = NULL;
+		piece_set_text(p, p->text, hsize);
+		*l = p;
+	}
+}
+
+/** Extend the last piece of a treap if it can be appended to in place.
+ *
+ * @return @c true if the piece has been extended.
+ */
+static bool piece_extend_last(sheet_t *sh, piece_t *p, const char *str,
+    size_t sz)
+{
+	if (p == NULL)
+		return false;
+
+	if (p->right != NULL) {
+		if (!piece_extend_last(sh, p->right, str, sz))
+			return false;
+
+		piece_update(p);
+		return true;
+	}
+
+	if (p->text + p->size != sh->block + sh->block_used ||
+	    p->size + sz > PIECE_MAX || sh->block_used + sz > sh->block_size)
+		return false;
+
+	memcpy(sh->block + sh->block_used, str, sz);
+	sh->block_used += sz;
+	piece_set_text(p, p->text, p->size + sz);
+	return true;
+}
+
+/** Copy text to a text block.
+ *
+ * @return Pointer to the copy or @c NULL if out of memory.
+ */
+static char *sheet_store(sheet_t *sh, const char *str, size_t sz)
+{
+	if (sh->block == NULL || sh->block_used + sz > sh->block_size) {
+		/*
+		 * The old block is still referred to by the pieces, it is
+		 * never freed.
+		 */
+		char *block = malloc(BLOCK_SIZE);
+		if (block == NULL)
+			return NULL;
+
+		sh->block = block;
+		sh->block_used = 0;
+		sh->block_size = BLOCK_SIZE;
+	}
+
+	char *text = sh->block + sh->block_used;
+	memcpy(text, str, sz);
+	sh->block_used += sz;
+	return text;
+}
+
+/** Copy text from a piece treap.
+ *
+ * @param p	Treap.
+ * @param off	Offset of the text to copy within the treap.
+ * @param buf	Destination buffer.
+ * @param sz	Number of bytes to copy.
+ */
+static void piece_copy(piece_t *p, size_t off, char *buf, size_t sz)
+{
+	while (p != NULL && sz > 0) {
+		size_t lsize = piece_sub_size(p->left);
+
+		if (off < lsize) {
+			size_t n = min(sz, lsize - off);
+			piece_copy(p->left, off, buf, n);
+			buf += n;
+			sz -= n;
+			off = lsize;
+		}
+
+		if (sz > 0 && off < lsize + p->size) {
+			size_t n = min(sz, lsize + p->size - off);
+			memcpy(buf, p->text + (off - lsize), n);
+			buf += n;
+			sz -= n;
+			off = lsize + p->size;
+		}
+
+		/* Continue in the right subtree. */
+		off -= lsize + p->size;
+		p = p->right;
+	}
+}
+
+/** Count newlines preceding a byte offset in a piece treap. */
+static size_t piece_count_nl(piece_t *p, size_t off)
+{
+	size_t nl = 0;
+
+	while (p != NULL) {
+		size_t lsize = piece_sub_size(p->left);
+
+		if (off <= lsize) {
+			p = p->left;
+			continue;
+		}
+
+		nl += piece_sub_nl(p->left);
+
+		if (off < lsize + p->size)
+			return nl + count_nl(p->text, off - lsize);
+
+		nl += p->nl;
+		off -= lsize + p->size;
+		p = p->right;
+	}
+
+	return nl;
+}
+
+/** Find the offset following a newline in a piece treap.
+ *
+ * @param p	Treap.
+ * @param k	Number of the newline (counted from 1).
+ *
+ * @return Offset following the @a k-th newline. The treap must contain
+ *         at least @a k newlines.
+ */
+static size_t piece_find_nl(piece_t *p, size_t k)
+{
+	size_t base = 0;
+
+	while (true) {
+		size_t lnl = piece_sub_nl(p->left);
+
+		if (k <= lnl) {
+			p = p->left;
+			continue;
+		}
+
+		k -= lnl;
+		base += piece_sub_size(p->left);
+
+		if (k <= p->nl) {
+			for (size_t i = 0; i < p->size; i++) {
+				if (p->text[i] == '\n' && --k == 0)
+					return base + i + 1;
+			}
+		}
+
+		k -= p->nl;
+		base += p->size;
+		p = p->right;
+	}
+}
+
+static size_t sheet_size(sheet_t *sh)
+{
+	return piece_sub_size(sh->root);
+}
+
+/** Read text from the sheet.
+ *
+ * @return Number of bytes read (limited by the end of text).
+ */
+static size_t sheet_read(sheet_t *sh, size_t off, char *buf, size_t sz)
+{
+	size_t size = sheet_size(sh);
+
+	if (off >= size)
+		return 0;
+
+	sz = min(sz, size - off);
+	piece_copy(sh->root, off, buf, sz);
+	return sz;
+}
+
+/** Get the offset of the start of a row. */
+static size_t sheet_row_start(sheet_t *sh, int row)
+{
+	if (row <= 1)
+		return 0;
+
+	return piece_find_nl(sh->root, row - 1);
+}
+
+static void sheet_reader_init(sheet_reader_t *r, sheet_t *sh)
+{
+	r->sh = sh;
+	/* Force reading the buffer on first use. */
+	r->buf_off = SIZE_MAX;
+	r->buf_len = 0;
+}
+
+/** Decode a character using a sheet reader.
+ *
+ * @param r	Reader.
+ * @param off	Offset of the character, advanced past it.
+ *
+ * @return Decoded character or zero at the end of text.
+ */
+static wchar_t sheet_reader_decode(sheet_reader_t *r, size_t *off)
+{
+	/*
+	 * Make sure a whole character is in the buffer unless the buffer
+	 * already extends to the end of text.
+	 */
+	if (*off < r->buf_off || *off > r->buf_off + r->buf_len ||
+	    (*off + STR_BOUNDS(1) > r->buf_off + r->buf_len &&
+	    r->buf_len == READ_BUF_SIZE)) {
+		r->buf_off = *off;
+		r->buf_len = sheet_read(r->sh, *off, r->buf, READ_BUF_SIZE);
+	}
+
+	size_t boff = *off - r->buf_off;
+	wchar_t c = str_decode(r->buf, &boff, r->buf_len);
+	*off = r->buf_off + boff;
+	return c;
+}
+
 /** Initialize an empty sheet. */
 errno_t sheet_create(sheet_t **rsh)
 {
@@ -74,14 +449,12 @@ errno_t sheet_create(sheet_t **rsh)
 	if (sh == NULL)
 		return ENOMEM;
 
-	sh->dbuf_size = INITIAL_SIZE;
-	sh->text_size = 0;
-
-	sh->data = malloc(sh->dbuf_size);
-	if (sh->data == NULL)
-		return ENOMEM;
+	sh->root = NULL;
+	sh->block = NULL;
+	sh->block_used = 0;
+	sh->block_size = 0;
 
-	list_initialize(&sh->tags);
+	odict_initialize(&sh->tags, tag_getkey, tag_cmp);
 
 	*rsh = sh;
 	return EOK;
@@ -102,35 +475,70 @@ errno_t sheet_create(sheet_t **rsh)
  */
 errno_t sheet_insert(sheet_t *sh, spt_t *pos, enum dir_spec dir, char *str)
 {
-	char *ipp;
+	piece_t *spare;
+	piece_t *l, *r;
+	piece_t *m;
 	size_t sz;
-	char *newp;
+	odlink_t *odlink;
 
 	sz = str_size(str);
-	if (sh->text_size + sz > sh->dbuf_size) {
-		/* Enlarge data buffer. */
-		newp = realloc(sh->data, sh->dbuf_size * 2);
-		if (newp == NULL)
-			return ELIMIT;
-
-		sh->data = newp;
-		sh->dbuf_size = sh->dbuf_size * 2;
-	}
+	if (sz == 0)
+		return EOK;
 
-	ipp = sh->data + pos->b_off;
+	spare = piece_create();
+	if (spare == NULL)
+		return ENOMEM;
 
-	/* Copy data. */
-	memmove(ipp + sz, ipp, sh->text_size - pos->b_off);
-	memcpy(ipp, str, sz);
-	sh->text_size += sz;
+	piece_split(sh->root, pos->b_off, &spare, &l, &r);
+
+	/* Typing usually just extends the piece inserted last. */
+	if (!piece_extend_last(sh, l, str, sz)) {
+		/* Create pieces of at most PIECE_MAX bytes. */
+		m = NULL;
+		size_t done = 0;
+		while (done < sz) {
+			size_t n = min(sz - done, (size_t) PIECE_MAX);
+
+			/* Do not split a character. */
+			while (done + n < sz && n > 1 &&
+			    (str[done + n] & 0xc0) == 0x80)
+				--n;
+
+			piece_t *p = (spare != NULL) ? spare : piece_create();
+			spare = NULL;
+
+			char *text = (p != NULL) ?
+			    sheet_store(sh, str + done, n) : NULL;
+			if (text == NULL) {
+				free(p);
+				piece_destroy_tree(m);
+				sh->root = piece_merge(l, r);
+				return ENOMEM;
+			}
+
+			piece_set_text(p, text, n);
+			m = piece_merge(m, p);
+			done += n;
+		}
+
+		l = piece_merge(l, m);
+	}
+
+	sh->root = piece_merge(l, r);
+	free(spare);
 
 	/* Adjust tags. */
 
-	list_foreach(sh->tags, link, tag_t, tag) {
-		if (tag->b_off > pos->b_off)
-			tag->b_off += sz;
-		else if (tag->b_off == pos->b_off && dir == dir_before)
-			tag->b_off += sz;
+	if (dir == dir_before)
+		odlink = odict_find_geq(&sh->tags, &pos->b_off, NULL);
+	else
+		odlink = odict_find_gt(&sh->tags, &pos->b_off, NULL);
+
+	/* The order of the tags does not change. */
+	while (odlink != NULL) {
+		tag_t *tag = odict_get_instance(odlink, tag_t, ltags);
+		tag->b_off += sz;
+		odlink = odict_next(odlink, &sh->tags);
 	}
 
 	return EOK;
@@ -148,37 +556,40 @@ errno_t sheet_insert(sheet_t *sh, spt_t *pos, enum dir_spec dir, char *str)
  **/
 errno_t sheet_delete(sheet_t *sh, spt_t *spos, spt_t *epos)
 {
-	char *spp;
+	piece_t *spare[2];
+	piece_t *l, *m, *r;
 	size_t sz;
-	char *newp;
-	size_t shrink_size;
+	odlink_t *odlink;
 
-	spp = sh->data + spos->b_off;
 	sz = epos->b_off - spos->b_off;
+	if (sz == 0)
+		return EOK;
+
+	spare[0] = piece_create();
+	spare[1] = piece_create();
+	if (spare[0] == NULL || spare[1] == NULL) {
+		free(spare[0]);
+		free(spare[1]);
+		return ENOMEM;
+	}
 
-	memmove(spp, spp + sz, sh->text_size - (spos->b_off + sz));
-	sh->text_size -= sz;
+	piece_split(sh->root, epos->b_off, &spare[0], &m, &r);
+	piece_split(m, spos->b_off, &spare[1], &l, &m);
+	piece_destroy_tree(m);
+	sh->root = piece_merge(l, r);
 
-	/* Adjust tags. */
-	list_foreach(sh->tags, link, tag_t, tag) {
+	free(spare[0]);
+	free(spare[1]);
+
+	/* Adjust tags. The order of the tags does not change. */
+	odlink = odict_find_geq(&sh->tags, &spos->b_off, NULL);
+	while (odlink != NULL) {
+		tag_t *tag = odict_get_instance(odlink, tag_t, ltags);
 		if (tag->b_off >= epos->b_off)
 			tag->b_off -= sz;
-		else if (tag->b_off >= spos->b_off)
+		else
 			tag->b_off = spos->b_off;
-	}
-
-	/* See if we should free up some memory. */
-	shrink_size = max(sh->dbuf_size / 4, INITIAL_SIZE);
-	if (sh->text_size <= shrink_size && sh->dbuf_size > INITIAL_SIZE) {
-		/* Shrink data buffer. */
-		newp = realloc(sh->data, shrink_size);
-		if (newp == NULL) {
-			/* Failed to shrink buffer... no matter. */
-			return EOK;
-		}
-
-		sh->data = newp;
-		sh->dbuf_size = shrink_size;
+		odlink = odict_next(odlink, &sh->tags);
 	}
 
 	return EOK;
@@ -188,26 +599,24 @@ errno_t sheet_delete(sheet_t *sh, spt_t *spos, spt_t *epos)
 void sheet_copy_out(sheet_t *sh, spt_t const *spos, spt_t const *epos,
     char *buf, size_t bufsize, spt_t *fpos)
 {
-	char *spp;
 	size_t range_sz;
 	size_t copy_sz;
 	size_t off, prev;
 	wchar_t c;
 
-	spp = sh->data + spos->b_off;
 	range_sz = epos->b_off - spos->b_off;
 	copy_sz = (range_sz < bufsize - 1) ? range_sz : bufsize - 1;
+	copy_sz = sheet_read(sh, spos->b_off, buf, copy_sz);
 
 	prev = off = 0;
 	do {
 		prev = off;
-		c = str_decode(spp, &off, copy_sz);
+		c = str_decode(buf, &off, copy_sz);
 	} while (c != '\0');
 
 	/* Crop copy_sz down to the last full character. */
 	copy_sz = prev;
 
-	memcpy(buf, spp, copy_sz);
 	buf[copy_sz] = '\0';
 
 	fpos->b_off = spos->b_off + copy_sz;
@@ -219,13 +628,34 @@ void sheet_get_cell_pt(sheet_t *sh, coord_t const *coord, enum dir_spec dir,
     spt_t *pt)
 {
 	size_t cur_pos, prev_pos;
+	size_t text_size;
+	sheet_reader_t reader;
 	wchar_t c;
 	coord_t cc;
 
-	cc.row = cc.column = 1;
-	cur_pos = prev_pos = 0;
+	text_size = sheet_size(sh);
+	pt->sh = sh;
+
+	if (coord->row > 1 &&
+	    (size_t) (coord->row - 1) > piece_sub_nl(sh->root)) {
+		/* Past the last row. */
+		pt->b_off = text_size;
+		return;
+	}
+
+	/*
+	 * Start at the beginning of the row, as if the preceding
+	 * newline has just been decoded.
+	 */
+	cc.row = max(coord->row, 1);
+	cc.column = 1;
+	cur_pos = sheet_row_start(sh, coord->row);
+	prev_pos = (cur_pos > 0) ? cur_pos - 1 : 0;
+
+	sheet_reader_init(&reader, sh);
+
 	while (true) {
-		if (prev_pos >= sh->text_size) {
+		if (prev_pos >= text_size) {
 			/* Cannot advance any further. */
 			break;
 		}
@@ -238,7 +668,7 @@ void sheet_get_cell_pt(sheet_t *sh, coord_t const *coord, enum dir_spec dir,
 
 		prev_pos = cur_pos;
 
-		c = str_decode(sh->data, &cur_pos, sh->text_size);
+		c = sheet_reader_decode(&reader, &cur_pos);
 		if (c == '\n') {
 			++cc.row;
 			cc.column = 1;
@@ -249,7 +679,6 @@ void sheet_get_cell_pt(sheet_t *sh, coord_t const *coord, enum dir_spec dir,
 		}
 	}
 
-	pt->sh = sh;
 	pt->b_off = (dir == dir_before) ? prev_pos : cur_pos;
 }
 
@@ -271,40 +700,34 @@ void sheet_get_row_width(sheet_t *sh, int row, int *length)
 /** Get the number of rows in a sheet. */
 void sheet_get_num_rows(sheet_t *sh, int *rows)
 {
-	int cnt;
-	size_t bo;
-
-	cnt = 1;
-	for (bo = 0; bo < sh->dbuf_size; ++bo) {
-		if (sh->data[bo] == '\n')
-			cnt += 1;
-	}
-
-	*rows = cnt;
+	*rows = 1 + piece_sub_nl(sh->root);
 }
 
 /** Get the coordinates of an s-point. */
 void spt_get_coord(spt_t const *pos, coord_t *coord)
 {
 	size_t off;
+	size_t end;
 	coord_t cc;
 	wchar_t c;
 	sheet_t *sh;
+	sheet_reader_t reader;
 
 	sh = pos->sh;
-	cc.row = cc.column = 1;
+	end = min(pos->b_off, sheet_size(sh));
 
-	off = 0;
-	while (off < pos->b_off && off < sh->text_size) {
-		c = str_decode(sh->data, &off, sh->text_size);
-		if (c == '\n') {
-			++cc.row;
-			cc.column = 1;
-		} else if (c == '\t') {
+	cc.row = 1 + piece_count_nl(sh->root, end);
+	cc.column = 1;
+
+	sheet_reader_init(&reader, sh);
+
+	off = sheet_row_start(sh, cc.row);
+	while (off < end) {
+		c = sheet_reader_decode(&reader, &off);
+		if (c == '\t')
 			cc.column = 1 + ALIGN_UP(cc.column, TAB_WIDTH);
-		} else {
+		else
 			++cc.column;
-		}
 	}
 
 	*coord = cc;
@@ -319,7 +742,12 @@ bool spt_equal(spt_t const *a, spt_t const *b)
 /** Get a character at spt and return next spt */
 wchar_t spt_next_char(spt_t spt, spt_t *next)
 {
-	wchar_t ch = str_decode(spt.sh->data, &spt.b_off, spt.sh->text_size);
+	char buf[STR_BOUNDS(1)];
+	size_t len = sheet_read(spt.sh, spt.b_off, buf, sizeof(buf));
+	size_t off = 0;
+
+	wchar_t ch = str_decode(buf, &off, len);
+	spt.b_off += off;
 	if (next)
 		*next = spt;
 	return ch;
@@ -327,7 +755,13 @@ wchar_t spt_next_char(spt_t spt, spt_t *next)
 
 wchar_t spt_prev_char(spt_t spt, spt_t *prev)
 {
-	wchar_t ch = str_decode_reverse(spt.sh->data, &spt.b_off, spt.sh->text_size);
+	char buf[STR_BOUNDS(1)];
+	size_t start = (spt.b_off > sizeof(buf)) ? spt.b_off - sizeof(buf) : 0;
+	size_t len = sheet_read(spt.sh, start, buf, spt.b_off - start);
+	size_t off = len;
+
+	wchar_t ch = str_decode_reverse(buf, &off, len);
+	spt.b_off = start + off;
 	if (prev)
 		*prev = spt;
 	return ch;
@@ -338,13 +772,14 @@ void sheet_place_tag(sheet_t *sh, spt_t const *pt, tag_t *tag)
 {
 	tag->b_off = pt->b_off;
 	tag->sh = sh;
-	list_append(&tag->link, &sh->tags);
+	odlink_initialize(&tag->ltags);
+	odict_insert(&tag->ltags, &sh->tags, NULL);
 }
 
 /** Remove a tag from the sheet. */
 void sheet_remove_tag(sheet_t *sh, tag_t *tag)
 {
-	list_remove(&tag->link);
+	odict_remove(&tag->ltags);
 }
 
 /** Get s-point on which the tag is located right now. */
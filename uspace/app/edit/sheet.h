@@ -36,7 +36,7 @@
 #ifndef SHEET_H__
 #define SHEET_H__
 
-#include <adt/list.h>
+#include <adt/odict.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -83,8 +83,8 @@ typedef struct {
 typedef struct {
 	/* Note: This structure is opaque for the user. */
 
-	/** Link to list of all tags in the sheet (see sheet_t.tags) */
-	link_t link;
+	/** Link to the ordered dictionary of tags (see sheet_t.tags) */
+	odlink_t ltags;
 	sheet_t *sh;
 	size_t b_off;
 } tag_t;
@@ -36,17 +36,56 @@
 #ifndef SHEET_IMPL_H__
 #define SHEET_IMPL_H__
 
+#include <stddef.h>
+
+#include <adt/odict.h>
 #include "sheet.h"
 
+/** Piece of text
+ *
+ * The text of the sheet is a sequence of pieces, each referring to
+ * a stretch of text in one of the text blocks. The pieces are kept in
+ * a treap ordered by their position in the text. Each node caches the
+ * size and the number of newlines of its subtree, which allows finding
+ * a byte offset or the start of a row in logarithmic time.
+ */
+typedef struct piece {
+	/** Pieces preceding this one */
+	struct piece *left;
+	/** Pieces following this one */
+	struct piece *right;
+	/** Treap priority */
+	unsigned int prio;
+
+	/** Text of the piece (not null-terminated) */
+	char *text;
+	/** Size of the piece in bytes */
+	size_t size;
+	/** Number of newlines in the piece */
+	size_t nl;
+
+	/** Size of the subtree in bytes */
+	size_t sub_size;
+	/** Number of newlines in the subtree */
+	size_t sub_nl;
+} piece_t;
+
 /** Sheet */
 struct sheet {
 	/* Note: This structure is opaque for the user. */
 
-	size_t text_size;
-	size_t dbuf_size;
-	char *data;
+	/** Root of the treap of pieces */
+	piece_t *root;
+
+	/** Text block new text is appended to */
+	char *block;
+	/** Number of bytes used in @c block */
+	size_t block_used;
+	/** Size of @c block in bytes */
+	size_t block_size;
 
-	list_t tags;
+	/** Tags ordered by their position */
+	odict_t tags;
 };
 
 #endif
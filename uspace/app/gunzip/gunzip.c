@@ -37,13 +37,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/** Size of the input and output buffers */
+#define BUFFER_SIZE  16384
+
 int main(int argc, char *argv[])
 {
 	errno_t rc;
-	void *data, *ddata;
-	size_t size, dsize;
-	size_t nread, nwr;
-	long len;
+	gzip_stream_t *stream;
+	uint8_t *ibuf, *obuf;
+	size_t ipos = 0, ilen = 0;
+	size_t accepted, drained, nwr;
+	bool eof = false;
 	FILE *f, *wf;
 
 	if (argc != 3) {
@@ -57,68 +61,84 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (fseek(f, 0, SEEK_END) < 0) {
-		printf("Error determining size of '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	len = ftell(f);
-	if (len < 0) {
-		printf("Error determining size of '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	if (fseek(f, 0, SEEK_SET) < 0) {
-		printf ("Error rewinding '%s'\n", argv[1]);
-		fclose(f);
-		return 1;
-	}
-
-	data = malloc(len);
-	if (data == NULL) {
-		printf("Error allocating %ld bytes.\n", len);
-		fclose(f);
-		return 1;
-	}
-
-	nread = fread(data, 1, len, f);
-	if (nread != (size_t)len) {
-		printf("Error reading '%s'\n", argv[1]);
+	ibuf = malloc(BUFFER_SIZE);
+	obuf = malloc(BUFFER_SIZE);
+	if ((ibuf == NULL) || (obuf == NULL)) {
+		printf("Error allocating buffers.\n");
 		fclose(f);
 		return 1;
 	}
 
-	fclose(f);
-
-	size = (size_t) len;
-
-	rc = gzip_expand(data, size, &ddata, &dsize);
+	rc = gzip_stream_create(&stream);
 	if (rc != EOK) {
-		printf("Error decompressing data.\n");
+		printf("Error allocating decompression state.\n");
+		fclose(f);
 		return 1;
 	}
 
 	wf = fopen(argv[2], "wb");
 	if (wf == NULL) {
 		printf("Error creating file '%s'\n", argv[2]);
+		fclose(f);
 		return 1;
 	}
 
-	nwr = fwrite(ddata, 1, dsize, wf);
-	if (nwr != dsize) {
-		printf("Error writing '%s'\n", argv[2]);
-		fclose(wf);
-		return 1;
+	while (!gzip_stream_done(stream)) {
+		if ((ipos == ilen) && !eof) {
+			ilen = fread(ibuf, 1, BUFFER_SIZE, f);
+			ipos = 0;
+			if (ilen < BUFFER_SIZE) {
+				if (ferror(f)) {
+					printf("Error reading '%s'\n", argv[1]);
+					goto error;
+				}
+
+				eof = true;
+			}
+		}
+
+		rc = gzip_stream_feed(stream, ibuf + ipos, ilen - ipos,
+		    &accepted);
+		if (rc != EOK) {
+			printf("Error decompressing data.\n");
+			goto error;
+		}
+
+		ipos += accepted;
+
+		rc = gzip_stream_drain(stream, obuf, BUFFER_SIZE, &drained);
+		if (rc != EOK) {
+			printf("Error decompressing data.\n");
+			goto error;
+		}
+
+		if (drained > 0) {
+			nwr = fwrite(obuf, 1, drained, wf);
+			if (nwr != drained) {
+				printf("Error writing '%s'\n", argv[2]);
+				goto error;
+			}
+		} else if (eof && (ipos == ilen) && (accepted == 0)) {
+			printf("Error decompressing data (truncated).\n");
+			goto error;
+		}
 	}
 
+	fclose(f);
+	gzip_stream_destroy(stream);
+
 	if (fclose(wf) != 0) {
 		printf("Error writing '%s'\n", argv[2]);
 		return 1;
 	}
 
 	return 0;
+
+error:
+	fclose(f);
+	fclose(wf);
+	gzip_stream_destroy(stream);
+	return 1;
 }
 
 /** @}
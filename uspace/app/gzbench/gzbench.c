@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup gzbench
+ * @{
+ */
+/**
+ * @file GZIP decompression benchmark.
+ *
+ * Measures throughput of the one-shot gzip_expand() and of the
+ * incremental gzip stream decoder fed and drained in fixed-size chunks,
+ * and checks that both produce the same data.
+ */
+
+#include <errno.h>
+#include <gzip.h>
+#include <inttypes.h>
+#include <macros.h>
+#include <mem.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+
+#define NAME  "gzbench"
+
+/** Default number of rounds */
+#define BENCH_ROUNDS  10
+
+/** Default stream chunk size */
+#define BENCH_CHUNK  4096
+
+static void print_result(const char *name, size_t size, uint32_t rounds,
+    suseconds_t usec)
+{
+	const uint64_t bytes = (uint64_t) size * rounds;
+
+	printf("%-16s %10lld us  %10llu KiB/s\n", name, (long long) usec,
+	    usec > 0 ? (unsigned long long) (bytes * 1000000 / usec / 1024) :
+	    0ULL);
+}
+
+static errno_t bench_expand(void *data, size_t size, uint32_t rounds,
+    void **out, size_t *out_size)
+{
+	struct timeval start, end;
+	errno_t rc = EOK;
+
+	*out = NULL;
+
+	getuptime(&start);
+	for (uint32_t i = 0; i < rounds; ++i) {
+		free(*out);
+		rc = gzip_expand(data, size, out, out_size);
+		if (rc != EOK) {
+			*out = NULL;
+			return rc;
+		}
+	}
+	getuptime(&end);
+
+	print_result("gzip_expand", *out_size, rounds,
+	    tv_sub_diff(&end, &start));
+	return EOK;
+}
+
+static errno_t bench_stream_round(uint8_t *data, size_t size, size_t chunk,
+    uint8_t *buf, const uint8_t *expect, size_t expect_size)
+{
+	gzip_stream_t *stream;
+	size_t ipos = 0;
+	size_t opos = 0;
+
+	errno_t rc = gzip_stream_create(&stream);
+	if (rc != EOK)
+		return rc;
+
+	while (!gzip_stream_done(stream)) {
+		size_t accepted, drained;
+
+		rc = gzip_stream_feed(stream, data + ipos,
+		    min(chunk, size - ipos), &accepted);
+		if (rc != EOK)
+			goto out;
+
+		ipos += accepted;
+
+		rc = gzip_stream_drain(stream, buf, chunk, &drained);
+		if (rc != EOK)
+			goto out;
+
+		if ((opos + drained > expect_size) ||
+		    (memcmp(buf, expect + opos, drained) != 0)) {
+			rc = EINVAL;
+			goto out;
+		}
+
+		opos += drained;
+
+		if ((drained == 0) && (accepted == 0) && (ipos == size)) {
+			rc = ELIMIT;
+			goto out;
+		}
+	}
+
+	if (opos != expect_size)
+		rc = EINVAL;
+out:
+	gzip_stream_destroy(stream);
+	return rc;
+}
+
+static errno_t bench_stream(void *data, size_t size, uint32_t rounds,
+    size_t chunk, const void *expect, size_t expect_size)
+{
+	struct timeval start, end;
+	errno_t rc = EOK;
+
+	uint8_t *buf = malloc(chunk);
+	if (buf == NULL)
+		return ENOMEM;
+
+	getuptime(&start);
+	for (uint32_t i = 0; i < rounds; ++i) {
+		rc = bench_stream_round(data, size, chunk, buf, expect,
+		    expect_size);
+		if (rc != EOK)
+			break;
+	}
+	getuptime(&end);
+
+	free(buf);
+
+	if (rc != EOK)
+		return rc;
+
+	print_result("gzip_stream", expect_size, rounds,
+	    tv_sub_diff(&end, &start));
+	return EOK;
+}
+
+static void *read_file(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+		return NULL;
+
+	void *data = NULL;
+	if (fseek(f, 0, SEEK_END) < 0)
+		goto out;
+
+	long len = ftell(f);
+	if ((len < 0) || (fseek(f, 0, SEEK_SET) < 0))
+		goto out;
+
+	data = malloc(len);
+	if (data == NULL)
+		goto out;
+
+	if (fread(data, 1, len, f) != (size_t) len) {
+		free(data);
+		data = NULL;
+		goto out;
+	}
+
+	*size = (size_t) len;
+out:
+	fclose(f);
+	return data;
+}
+
+static void print_syntax(void)
+{
+	printf("Usage: " NAME " <file.gz> [<rounds> [<chunk>]]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t rounds = BENCH_ROUNDS;
+	size_t chunk = BENCH_CHUNK;
+	void *expanded;
+	size_t expanded_size;
+	size_t size;
+
+	if ((argc < 2) || (argc > 4)) {
+		print_syntax();
+		return 1;
+	}
+
+	if ((argc > 2) &&
+	    (str_uint32_t(argv[2], NULL, 10, true, &rounds) != EOK)) {
+		print_syntax();
+		return 1;
+	}
+
+	if ((argc > 3) &&
+	    ((str_size_t(argv[3], NULL, 10, true, &chunk) != EOK) ||
+	    (chunk == 0))) {
+		print_syntax();
+		return 1;
+	}
+
+	void *data = read_file(argv[1], &size);
+	if (data == NULL) {
+		printf(NAME ": Error reading '%s'\n", argv[1]);
+		return 1;
+	}
+
+	printf("Decompressing %zu bytes %" PRIu32 " times, stream chunk "
+	    "%zu bytes\n", size, rounds, chunk);
+
+	errno_t rc = bench_expand(data, size, rounds, &expanded,
+	    &expanded_size);
+	if (rc != EOK) {
+		printf(NAME ": gzip_expand failed: %s\n", str_error(rc));
+		free(data);
+		return 1;
+	}
+
+	rc = bench_stream(data, size, rounds, chunk, expanded, expanded_size);
+	if (rc != EOK)
+		printf(NAME ": gzip_stream failed: %s\n", str_error(rc));
+
+	free(expanded);
+	free(data);
+	return (rc == EOK) ? 0 : 1;
+}
+
+/** @}
+ */
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup httpload
+ * @{
+ */
+/**
+ * @file HTTP load generator.
+ *
+ * Issues GET requests for a single path over a number of concurrent
+ * connections and reports request rate and latency distribution.
+ */
+
+#include <errno.h>
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+#include <macros.h>
+
+#include <http/http.h>
+
+#define NAME  "httpload"
+
+#define DEFAULT_HOST  "127.0.0.1"
+#define DEFAULT_PORT  8080
+#define DEFAULT_CONNS  4
+#define DEFAULT_REQUESTS  1000
+
+/** Maximum number of requests in flight on one connection */
+#define MAX_PIPELINE  64
+
+#define MAX_HEADERS_SIZE  4096
+#define MAX_HEADERS_COUNT  32
+
+/** Size of buffer for discarding response bodies */
+#define BODY_BUF_SIZE  4096
+
+static const char *host = DEFAULT_HOST;
+static uint16_t port = DEFAULT_PORT;
+static const char *path = "/";
+static size_t nconns = DEFAULT_CONNS;
+static size_t nrequests = DEFAULT_REQUESTS;
+static size_t pipeline = 1;
+static bool keep_alive = true;
+
+/** Synchronizes the shared counters below */
+static FIBRIL_MUTEX_INITIALIZE(load_lock);
+/** Signalled when a worker fibril terminates */
+static FIBRIL_CONDVAR_INITIALIZE(load_cv);
+/** Number of requests handed out to workers */
+static size_t req_issued;
+/** Number of completed requests */
+static size_t req_done;
+/** Number of failed requests */
+static size_t req_failed;
+/** Number of running worker fibrils */
+static unsigned workers_running;
+/** Latency of each completed request in microseconds */
+static suseconds_t *latency;
+
+static void syntax_print(void)
+{
+	fprintf(stderr, "Usage: " NAME " [-h <host>] [-p <port>] "
+	    "[-c <connections>] [-n <requests>] [-P <depth>] [-C] [<path>]\n");
+	fprintf(stderr, "  -c  Number of concurrent connections (default %u)\n",
+	    DEFAULT_CONNS);
+	fprintf(stderr, "  -n  Total number of requests (default %u)\n",
+	    DEFAULT_REQUESTS);
+	fprintf(stderr, "  -P  Number of pipelined requests per connection "
+	    "(default 1)\n");
+	fprintf(stderr, "  -C  Close connection after each request\n");
+}
+
+/** Reserve up to @a max requests for a worker. */
+static size_t load_reserve(size_t max)
+{
+	size_t n;
+
+	fibril_mutex_lock(&load_lock);
+	n = min(max, nrequests - req_issued);
+	req_issued += n;
+	fibril_mutex_unlock(&load_lock);
+
+	return n;
+}
+
+static void load_complete(suseconds_t usec, bool ok)
+{
+	fibril_mutex_lock(&load_lock);
+	if (ok)
+		latency[req_done++] = usec;
+	else
+		++req_failed;
+	fibril_mutex_unlock(&load_lock);
+}
+
+/** Receive one response, discarding the body. */
+static errno_t response_receive(http_t *http, void *buf)
+{
+	http_response_t *resp = NULL;
+	char *value;
+	size_t clen = 0;
+	size_t nrecv;
+	errno_t rc;
+
+	rc = http_receive_response(&http->recv_buffer, &resp,
+	    MAX_HEADERS_SIZE, MAX_HEADERS_COUNT);
+	if (rc != EOK)
+		return rc;
+
+	if (resp->status != 200) {
+		rc = EIO;
+		goto out;
+	}
+
+	rc = http_headers_get(&resp->headers, "Content-Length", &value);
+	if (rc != EOK)
+		goto out;
+
+	rc = str_size_t(value, NULL, 10, true, &clen);
+	free(value);
+	if (rc != EOK)
+		goto out;
+
+	while (clen > 0) {
+		rc = recv_buffer(&http->recv_buffer, buf,
+		    min(clen, BODY_BUF_SIZE), &nrecv);
+		if (rc != EOK)
+			goto out;
+		if (nrecv == 0) {
+			rc = EIO;
+			goto out;
+		}
+
+		clen -= nrecv;
+	}
+
+out:
+	http_response_destroy(resp);
+	return rc;
+}
+
+/** Issue requests over one connection until the connection is closed. */
+static errno_t worker_conn(http_t *http, http_request_t *req, void *buf)
+{
+	struct timeval sent[MAX_PIPELINE];
+	struct timeval now;
+	size_t n, i;
+	errno_t rc;
+
+	rc = http_connect(http);
+	if (rc != EOK)
+		return rc;
+
+	do {
+		n = load_reserve(keep_alive ? pipeline : 1);
+
+		for (i = 0; i < n; i++) {
+			getuptime(&sent[i]);
+			rc = http_send_request(http, req);
+			if (rc != EOK) {
+				i = 0;
+				goto error;
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			rc = response_receive(http, buf);
+			if (rc != EOK)
+				goto error;
+
+			getuptime(&now);
+			load_complete(tv_sub_diff(&now, &sent[i]), true);
+		}
+	} while (keep_alive && n > 0);
+
+	http_close(http);
+	return EOK;
+error:
+	/* The rest of the batch is lost */
+	while (i++ < n)
+		load_complete(0, false);
+	http_close(http);
+	return rc;
+}
+
+static errno_t worker_fibril(void *arg)
+{
+	http_request_t *req = NULL;
+	http_t *http;
+	void *buf = NULL;
+	errno_t rc;
+
+	buf = malloc(BODY_BUF_SIZE);
+	req = http_request_create("GET", path);
+	if (buf == NULL || req == NULL)
+		goto out;
+
+	rc = http_headers_append(&req->headers, "Host", host);
+	if (rc != EOK)
+		goto out;
+
+	rc = http_headers_append(&req->headers, "Connection",
+	    keep_alive ? "keep-alive" : "close");
+	if (rc != EOK)
+		goto out;
+
+	while (true) {
+		fibril_mutex_lock(&load_lock);
+		bool done = (req_issued >= nrequests);
+		fibril_mutex_unlock(&load_lock);
+		if (done)
+			break;
+
+		http = http_create(host, port);
+		if (http == NULL)
+			break;
+
+		rc = worker_conn(http, req, buf);
+		if (rc != EOK) {
+			fprintf(stderr, "Connection failed: %s\n",
+			    str_error(rc));
+		}
+
+		/* The recv buffer keeps unparsed data, start afresh */
+		http_destroy(http);
+
+		if (rc != EOK)
+			break;
+	}
+
+out:
+	if (req != NULL)
+		http_request_destroy(req);
+	free(buf);
+
+	fibril_mutex_lock(&load_lock);
+	--workers_running;
+	fibril_condvar_broadcast(&load_cv);
+	fibril_mutex_unlock(&load_lock);
+
+	return EOK;
+}
+
+static int latency_cmp(const void *a, const void *b)
+{
+	suseconds_t la = *(const suseconds_t *) a;
+	suseconds_t lb = *(const suseconds_t *) b;
+
+	if (la < lb)
+		return -1;
+	return la > lb ? 1 : 0;
+}
+
+static suseconds_t latency_pct(unsigned pct)
+{
+	size_t idx = (req_done * pct) / 100;
+
+	if (idx >= req_done)
+		idx = req_done - 1;
+	return latency[idx];
+}
+
+int main(int argc, char *argv[])
+{
+	struct timeval start, end;
+	size_t i;
+	errno_t rc;
+	int c;
+
+	for (c = 1; c < argc && argv[c][0] == '-'; c++) {
+		if (str_cmp(argv[c], "-C") == 0) {
+			keep_alive = false;
+			continue;
+		}
+
+		if (c + 1 >= argc) {
+			syntax_print();
+			return 1;
+		}
+
+		if (str_cmp(argv[c], "-h") == 0) {
+			host = argv[++c];
+		} else if (str_cmp(argv[c], "-p") == 0) {
+			rc = str_uint16_t(argv[++c], NULL, 10, true, &port);
+			if (rc != EOK)
+				goto bad_arg;
+		} else if (str_cmp(argv[c], "-c") == 0) {
+			rc = str_size_t(argv[++c], NULL, 10, true, &nconns);
+			if (rc != EOK || nconns == 0)
+				goto bad_arg;
+		} else if (str_cmp(argv[c], "-n") == 0) {
+			rc = str_size_t(argv[++c], NULL, 10, true, &nrequests);
+			if (rc != EOK || nrequests == 0)
+				goto bad_arg;
+		} else if (str_cmp(argv[c], "-P") == 0) {
+			rc = str_size_t(argv[++c], NULL, 10, true, &pipeline);
+			if (rc != EOK || pipeline == 0 || pipeline > MAX_PIPELINE)
+				goto bad_arg;
+		} else {
+			goto bad_arg;
+		}
+	}
+
+	if (c < argc)
+		path = argv[c++];
+
+	if (c < argc) {
+		syntax_print();
+		return 1;
+	}
+
+	latency = calloc(nrequests, sizeof(suseconds_t));
+	if (latency == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
+	printf("%s: %zu requests for http://%s:%u%s over %zu connections\n",
+	    NAME, nrequests, host, port, path, nconns);
+
+	getuptime(&start);
+
+	for (i = 0; i < nconns; i++) {
+		fid_t fid = fibril_create(worker_fibril, NULL);
+		if (fid == 0) {
+			fprintf(stderr, "Out of memory.\n");
+			break;
+		}
+
+		fibril_mutex_lock(&load_lock);
+		++workers_running;
+		fibril_mutex_unlock(&load_lock);
+		fibril_add_ready(fid);
+	}
+
+	fibril_mutex_lock(&load_lock);
+	while (workers_running > 0)
+		fibril_condvar_wait(&load_cv, &load_lock);
+	fibril_mutex_unlock(&load_lock);
+
+	getuptime(&end);
+
+	suseconds_t elapsed = tv_sub_diff(&end, &start);
+	printf("Completed %zu requests, %zu failed, in %lld ms\n",
+	    req_done, req_failed, (long long) elapsed / 1000);
+
+	if (req_done > 0 && elapsed > 0) {
+		qsort(latency, req_done, sizeof(suseconds_t), latency_cmp);
+		printf("Requests/sec: %llu\n", (unsigned long long)
+		    ((uint64_t) req_done * 1000000 / elapsed));
+		printf("Latency [us]: min %lld, p50 %lld, p99 %lld, max %lld\n",
+		    (long long) latency[0], (long long) latency_pct(50),
+		    (long long) latency_pct(99),
+		    (long long) latency[req_done - 1]);
+	}
+
+	free(latency);
+	return req_failed > 0 ? 1 : 0;
+bad_arg:
+	fprintf(stderr, "Invalid value for %s\n", argv[c - 1]);
+	syntax_print();
+	return 1;
+}
+
+/** @}
+ */
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup ktrace
+ * @brief Kernel tracepoint consumer.
+ * @{
+ */
+/**
+ * @file
+ */
+
+#include <abi/ktrace.h>
+#include <as.h>
+#include <ddi.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <libarch/barrier.h>
+#include <stats.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <sysinfo.h>
+
+#define NAME  "ktrace"
+
+static const char *event_names[KTRACE_COUNT] = {
+	[KTRACE_SCHED_SWITCH] = "sched",
+	[KTRACE_IPC_CALL] = "call",
+	[KTRACE_IPC_FORWARD] = "forward",
+	[KTRACE_IPC_ANSWER] = "answer",
+	[KTRACE_PAGE_FAULT] = "pf",
+	[KTRACE_IRQ] = "irq"
+};
+
+/** IPC latency statistics of a caller and callee pair */
+typedef struct {
+	uint64_t caller;
+	uint64_t callee;
+	/** Calls answered on the CPU which sent them */
+	size_t count;
+	/** Calls answered on another CPU, not timed */
+	size_t other_cpu;
+	uint64_t total;
+	uint64_t max;
+} ipc_pair_t;
+
+static ktrace_header_t *header;
+
+static errno_t ktrace_map(void)
+{
+	sysarg_t faddr;
+	errno_t rc = sysinfo_get_value("ktrace.faddr", &faddr);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Kernel tracing not available\n", NAME);
+		return rc;
+	}
+
+	sysarg_t pages;
+	rc = sysinfo_get_value("ktrace.pages", &pages);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to get number of tracing pages\n",
+		    NAME);
+		return rc;
+	}
+
+	rc = physmem_map(faddr, pages,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE,
+	    (void **) &header);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to map tracing area\n", NAME);
+		return rc;
+	}
+
+	return EOK;
+}
+
+static errno_t event_parse(const char *name, uint32_t *mask)
+{
+	if (str_cmp(name, "all") == 0) {
+		*mask = (1U << KTRACE_COUNT) - 1;
+		return EOK;
+	}
+
+	for (unsigned int i = 0; i < KTRACE_COUNT; i++) {
+		if (str_cmp(name, event_names[i]) == 0) {
+			*mask = 1U << i;
+			return EOK;
+		}
+	}
+
+	fprintf(stderr, "%s: Unknown event '%s'\n", NAME, name);
+	return EINVAL;
+}
+
+/** Copy the consistent records of all rings.
+ *
+ * @param count Place to store the number of copied records.
+ *
+ * @return Array of records sorted by the cycle counter or NULL.
+ *
+ */
+static ktrace_record_t *snapshot(size_t *count)
+{
+	ktrace_record_t *rings = (ktrace_record_t *)
+	    ((uint8_t *) header + header->offset);
+	size_t capacity = header->capacity;
+
+	ktrace_record_t *records =
+	    calloc(header->cpus * capacity, sizeof(ktrace_record_t));
+	if (records == NULL)
+		return NULL;
+
+	size_t cnt = 0;
+	for (unsigned int cpu = 0; cpu < header->cpus; cpu++) {
+		ktrace_record_t *ring = rings + cpu * capacity;
+		size_t first = cnt;
+
+		uint64_t head = header->ring[cpu].head;
+		read_barrier();
+
+		uint64_t start = (head > capacity) ? head - capacity : 0;
+		for (uint64_t n = start; n < head; n++)
+			records[cnt++] = ring[n & (capacity - 1)];
+
+		/*
+		 * Drop the records which the kernel might have overwritten
+		 * while they were being copied.
+		 */
+		read_barrier();
+		uint64_t tail = header->ring[cpu].head;
+		if (tail >= start + capacity) {
+			size_t lost = tail - start - capacity + 1;
+			if (lost > cnt - first)
+				lost = cnt - first;
+
+			memmove(records + first, records + first + lost,
+			    (cnt - first - lost) * sizeof(ktrace_record_t));
+			cnt -= lost;
+		}
+	}
+
+	*count = cnt;
+	return records;
+}
+
+static int record_cmp(const void *a, const void *b)
+{
+	const ktrace_record_t *ra = a;
+	const ktrace_record_t *rb = b;
+
+	if (ra->cycle < rb->cycle)
+		return -1;
+	if (ra->cycle > rb->cycle)
+		return 1;
+	return 0;
+}
+
+static int record_call_cmp(const void *a, const void *b)
+{
+	const ktrace_record_t *ra = a;
+	const ktrace_record_t *rb = b;
+
+	if (ra->arg[0] < rb->arg[0])
+		return -1;
+	if (ra->arg[0] > rb->arg[0])
+		return 1;
+	return record_cmp(a, b);
+}
+
+static void status(void)
+{
+	printf("%u CPU(s), %u records per CPU\n", header->cpus,
+	    header->capacity);
+
+	for (unsigned int i = 0; i < KTRACE_COUNT; i++) {
+		printf("%-8s %s\n", event_names[i],
+		    (header->mask & (1U << i)) ? "enabled" : "disabled");
+	}
+}
+
+static errno_t dump(void)
+{
+	size_t count;
+	ktrace_record_t *records = snapshot(&count);
+	if (records == NULL) {
+		fprintf(stderr, "%s: Out of memory\n", NAME);
+		return ENOMEM;
+	}
+
+	/*
+	 * Note that the cycle counters of different CPUs need not be
+	 * synchronized, so the order of events recorded on different CPUs
+	 * is only approximate.
+	 */
+	qsort(records, count, sizeof(ktrace_record_t), record_cmp);
+
+	printf("[cycle] [cpu] [event] [arg0] [arg1] [arg2]\n");
+
+	for (size_t i = 0; i < count; i++) {
+		ktrace_record_t *rec = &records[i];
+		const char *name = (rec->event < KTRACE_COUNT) ?
+		    event_names[rec->event] : "?";
+
+		printf("%16" PRIu64 " %3" PRIu32 " %-8s %#" PRIx64 " %#"
+		    PRIx64 " %#" PRIx64 "\n", rec->cycle, rec->cpu, name,
+		    rec->arg[0], rec->arg[1], rec->arg[2]);
+	}
+
+	free(records);
+	return EOK;
+}
+
+static const char *task_name(stats_task_t *tasks, size_t count,
+    uint64_t task_id)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (tasks[i].task_id == task_id)
+			return tasks[i].name;
+	}
+
+	return "?";
+}
+
+/** Account a call to the statistics of its caller and callee pair.
+ *
+ * @param pairs  Array of pairs, reallocated when the pair is new.
+ * @param count  Number of pairs in the array.
+ * @param call   Record of the call.
+ * @param answer Record of the answer.
+ *
+ * @return EOK on success or ENOMEM.
+ *
+ */
+static errno_t ipc_pair_add(ipc_pair_t **pairs, size_t *count,
+    ktrace_record_t *call, ktrace_record_t *answer)
+{
+	uint64_t caller = call->arg[1];
+	uint64_t callee = answer->arg[1];
+	ipc_pair_t *pair = NULL;
+
+	for (size_t i = 0; i < *count; i++) {
+		if (((*pairs)[i].caller == caller) &&
+		    ((*pairs)[i].callee == callee)) {
+			pair = &(*pairs)[i];
+			break;
+		}
+	}
+
+	if (pair == NULL) {
+		ipc_pair_t *tmp = realloc(*pairs,
+		    (*count + 1) * sizeof(ipc_pair_t));
+		if (tmp == NULL)
+			return ENOMEM;
+
+		*pairs = tmp;
+		pair = &tmp[(*count)++];
+		pair->caller = caller;
+		pair->callee = callee;
+		pair->count = 0;
+		pair->other_cpu = 0;
+		pair->total = 0;
+		pair->max = 0;
+	}
+
+	/*
+	 * The cycle counters of different CPUs need not be synchronized,
+	 * so only a call answered on the same CPU can be timed.
+	 */
+	if (call->cpu != answer->cpu) {
+		pair->other_cpu++;
+		return EOK;
+	}
+
+	uint64_t cycles = answer->cycle - call->cycle;
+	pair->count++;
+	pair->total += cycles;
+	if (cycles > pair->max)
+		pair->max = cycles;
+
+	return EOK;
+}
+
+/** Print IPC round-trip latencies aggregated per caller and callee pair.
+ *
+ * Calls are matched with their answers by the kernel address of the call
+ * structure. The callee of a forwarded call is the task which finally
+ * answered it. Only the calls answered on the CPU which sent them are
+ * timed, the others are just counted.
+ */
+static errno_t ipc_latency(void)
+{
+	size_t count;
+	ktrace_record_t *records = snapshot(&count);
+	if (records == NULL) {
+		fprintf(stderr, "%s: Out of memory\n", NAME);
+		return ENOMEM;
+	}
+
+	qsort(records, count, sizeof(ktrace_record_t), record_call_cmp);
+
+	ipc_pair_t *pairs = NULL;
+	size_t pairs_count = 0;
+	ktrace_record_t *call = NULL;
+	errno_t rc = EOK;
+
+	for (size_t i = 0; i < count; i++) {
+		ktrace_record_t *rec = &records[i];
+
+		switch (rec->event) {
+		case KTRACE_IPC_CALL:
+			call = rec;
+			break;
+		case KTRACE_IPC_ANSWER:
+			if ((call == NULL) || (call->arg[0] != rec->arg[0]))
+				break;
+
+			rc = ipc_pair_add(&pairs, &pairs_count, call, rec);
+			call = NULL;
+			break;
+		default:
+			break;
+		}
+
+		if (rc != EOK)
+			break;
+	}
+
+	free(records);
+
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Out of memory\n", NAME);
+		free(pairs);
+		return rc;
+	}
+
+	size_t tasks_count;
+	stats_task_t *tasks = stats_get_tasks(&tasks_count);
+	if (tasks == NULL)
+		tasks_count = 0;
+
+	printf("[caller] [callee] [calls] [other cpu] [avg cycles] "
+	    "[max cycles]\n");
+
+	for (size_t i = 0; i < pairs_count; i++) {
+		ipc_pair_t *pair = &pairs[i];
+		uint64_t avg = (pair->count > 0) ? pair->total / pair->count : 0;
+
+		printf("%-16s %-16s %8zu %8zu %12" PRIu64 " %12" PRIu64 "\n",
+		    task_name(tasks, tasks_count, pair->caller),
+		    task_name(tasks, tasks_count, pair->callee),
+		    pair->count, pair->other_cpu, avg, pair->max);
+	}
+
+	free(tasks);
+	free(pairs);
+	return EOK;
+}
+
+static void usage(const char *name)
+{
+	printf(
+	    "Usage: %s <command> [<event>...]\n"
+	    "\n"
+	    "Commands:\n"
+	    "\tstatus\t\tShow the enabled events\n"
+	    "\tenable\t\tEnable recording of the given events\n"
+	    "\tdisable\t\tDisable recording of the given events\n"
+	    "\tdump\t\tPrint the recorded events\n"
+	    "\tipc\t\tPrint IPC latencies per caller and callee pair\n"
+	    "\n"
+	    "Events: sched, call, forward, answer, pf, irq or all\n",
+	    name);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (ktrace_map() != EOK)
+		return 2;
+
+	if (str_cmp(argv[1], "status") == 0) {
+		status();
+		return 0;
+	}
+
+	if ((str_cmp(argv[1], "enable") == 0) ||
+	    (str_cmp(argv[1], "disable") == 0)) {
+		bool enable = (str_cmp(argv[1], "enable") == 0);
+		uint32_t mask = 0;
+
+		for (int i = 2; i < argc; i++) {
+			uint32_t event;
+			if (event_parse(argv[i], &event) != EOK)
+				return 1;
+
+			mask |= event;
+		}
+
+		if (enable)
+			header->mask |= mask;
+		else
+			header->mask &= ~mask;
+
+		return 0;
+	}
+
+	if (str_cmp(argv[1], "dump") == 0)
+		return (dump() == EOK) ? 0 : 2;
+
+	if (str_cmp(argv[1], "ipc") == 0)
+		return (ipc_latency() == EOK) ? 0 : 2;
+
+	usage(argv[0]);
+	return 1;
+}
+
+/** @}
+ */
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup pcmbench
+ * @{
+ */
+/**
+ * @file PCM mixing microbenchmark.
+ *
+ * Measures throughput of pcm_format_convert_and_mix() for a selection of
+ * source/destination format pairs, i.e. the cost hound pays for every
+ * stream it mixes into a device buffer.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+#include <pcm/format.h>
+
+#define NAME  "pcmbench"
+
+/** Frames per mixed buffer */
+#define BENCH_FRAMES  4096
+
+/** Default number of mixing rounds */
+#define BENCH_ROUNDS  1000
+
+typedef struct {
+	const char *name;
+	pcm_sample_format_t src;
+	pcm_sample_format_t dst;
+} bench_pair_t;
+
+static bench_pair_t pairs[] = {
+	{ "s16le + s16le", PCM_SAMPLE_SINT16_LE, PCM_SAMPLE_SINT16_LE },
+	{ "u8 + u8", PCM_SAMPLE_UINT8, PCM_SAMPLE_UINT8 },
+	{ "s32le + s32le", PCM_SAMPLE_SINT32_LE, PCM_SAMPLE_SINT32_LE },
+	{ "f32 + f32", PCM_SAMPLE_FLOAT32, PCM_SAMPLE_FLOAT32 },
+	{ "u8 -> s16le", PCM_SAMPLE_UINT8, PCM_SAMPLE_SINT16_LE },
+	{ "s16be -> s16le", PCM_SAMPLE_SINT16_BE, PCM_SAMPLE_SINT16_LE },
+	{ "f32 -> s16le", PCM_SAMPLE_FLOAT32, PCM_SAMPLE_SINT16_LE },
+	{ "s16le -> f32", PCM_SAMPLE_SINT16_LE, PCM_SAMPLE_FLOAT32 },
+};
+
+static errno_t bench_run(bench_pair_t *pair, uint32_t rounds)
+{
+	pcm_format_t sf = AUDIO_FORMAT_DEFAULT;
+	pcm_format_t df = AUDIO_FORMAT_DEFAULT;
+	struct timeval start, end;
+	errno_t rc = EOK;
+
+	sf.sample_format = pair->src;
+	df.sample_format = pair->dst;
+
+	const size_t src_size = BENCH_FRAMES * pcm_format_frame_size(&sf);
+	const size_t dst_size = BENCH_FRAMES * pcm_format_frame_size(&df);
+
+	void *src = malloc(src_size);
+	void *dst = malloc(dst_size);
+	if (src == NULL || dst == NULL) {
+		free(src);
+		free(dst);
+		return ENOMEM;
+	}
+
+	pcm_format_silence(src, src_size, &sf);
+	pcm_format_silence(dst, dst_size, &df);
+
+	getuptime(&start);
+	for (uint32_t i = 0; i < rounds; ++i) {
+		rc = pcm_format_convert_and_mix(dst, dst_size, src, src_size,
+		    &sf, &df);
+		if (rc != EOK)
+			break;
+	}
+	getuptime(&end);
+
+	free(src);
+	free(dst);
+
+	if (rc != EOK)
+		return rc;
+
+	const suseconds_t usec = tv_sub_diff(&end, &start);
+	const uint64_t frames = (uint64_t) BENCH_FRAMES * rounds;
+
+	printf("%-16s %8lld us  %10llu frames/s\n", pair->name,
+	    (long long) usec, usec > 0 ?
+	    (unsigned long long) (frames * 1000000 / usec) : 0ULL);
+	return EOK;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t rounds = BENCH_ROUNDS;
+
+	if (argc > 2 || (argc == 2 &&
+	    str_uint32_t(argv[1], NULL, 10, true, &rounds) != EOK)) {
+		printf("Usage: " NAME " [<rounds>]\n");
+		return 1;
+	}
+
+	printf("Mixing %" PRIu32 " rounds of %u stereo frames\n", rounds,
+	    BENCH_FRAMES);
+
+	for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); ++i) {
+		errno_t rc = bench_run(&pairs[i], rounds);
+		if (rc != EOK) {
+			printf("%-16s failed: %s\n", pairs[i].name,
+			    str_error(rc));
+		}
+	}
+
+	return 0;
+}
+
+/** @}
+ */
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup prof
+ * @brief Statistical sampling profiler.
+ * @{
+ */
+/**
+ * @file
+ */
+
+#include <abi/prof.h>
+#include <as.h>
+#include <async.h>
+#include <ddi.h>
+#include <elf/elf_symtab.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <libarch/barrier.h>
+#include <stats.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sysinfo.h>
+#include <task.h>
+#include <udebug.h>
+
+#define NAME  "prof"
+
+/** Interval between two collections of samples in microseconds */
+#define COLLECT_INTERVAL  100000
+
+/** Default profiling duration in seconds */
+#define DEFAULT_DURATION  10
+
+/** Function found in the profiled program */
+typedef struct {
+	/** Start address of the function or the unresolved address */
+	uintptr_t addr;
+	/** Name of the function or NULL if the address is unresolved */
+	const char *name;
+	/** Number of samples taken directly in the function */
+	size_t self;
+	/** Number of samples with the function anywhere on the stack */
+	size_t total;
+	/** Last sample counted in @c total */
+	size_t last;
+} func_t;
+
+/** Address found in the samples */
+typedef struct {
+	uintptr_t addr;
+	/** Index of the function containing the address */
+	size_t func;
+} addr_t;
+
+/** Call graph edge */
+typedef struct {
+	size_t caller;
+	size_t callee;
+} edge_t;
+
+static prof_header_t *header;
+static prof_sample_t *samples;
+static size_t samples_count;
+static size_t samples_size;
+static uint64_t samples_lost;
+
+static symtab_t *symtab;
+
+static func_t *funcs;
+static size_t funcs_count;
+static addr_t *addrs;
+static size_t addrs_count;
+
+static errno_t prof_map(void)
+{
+	sysarg_t faddr;
+	errno_t rc = sysinfo_get_value("prof.faddr", &faddr);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Profiling not available\n", NAME);
+		return rc;
+	}
+
+	sysarg_t pages;
+	rc = sysinfo_get_value("prof.pages", &pages);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to get number of profiling "
+		    "pages\n", NAME);
+		return rc;
+	}
+
+	rc = physmem_map(faddr, pages, AS_AREA_READ | AS_AREA_CACHEABLE,
+	    (void **) &header);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to map profiling area\n", NAME);
+		return rc;
+	}
+
+	return EOK;
+}
+
+/** Copy the samples taken since the last collection.
+ *
+ * @param next Number of the first sample not collected yet.
+ *
+ * @return EOK on success or ENOMEM.
+ *
+ */
+static errno_t collect(uint64_t *next)
+{
+	prof_sample_t *ring = (prof_sample_t *)
+	    ((uint8_t *) header + header->offset);
+	uint64_t capacity = header->capacity;
+
+	uint64_t head = header->head;
+	read_barrier();
+
+	uint64_t start = *next;
+	if (head - start > capacity) {
+		samples_lost += head - capacity - start;
+		start = head - capacity;
+	}
+
+	size_t needed = samples_count + (head - start);
+	if (needed > samples_size) {
+		size_t size = (samples_size > 0) ? samples_size : 1024;
+		while (size < needed)
+			size *= 2;
+
+		prof_sample_t *tmp = realloc(samples,
+		    size * sizeof(prof_sample_t));
+		if (tmp == NULL)
+			return ENOMEM;
+
+		samples = tmp;
+		samples_size = size;
+	}
+
+	size_t first = samples_count;
+	for (uint64_t n = start; n < head; n++)
+		samples[samples_count++] = ring[n & (capacity - 1)];
+
+	/*
+	 * Drop the samples which the kernel might have overwritten
+	 * while they were being copied.
+	 */
+	read_barrier();
+	uint64_t tail = header->head;
+	if (tail >= start + capacity) {
+		size_t lost = tail - start - capacity + 1;
+		if (lost > samples_count - first)
+			lost = samples_count - first;
+
+		memmove(samples + first, samples + first + lost,
+		    (samples_count - first - lost) * sizeof(prof_sample_t));
+		samples_count -= lost;
+		samples_lost += lost;
+	}
+
+	*next = head;
+	return EOK;
+}
+
+static errno_t profile(task_id_t task_id, unsigned int duration)
+{
+	async_sess_t *sess = async_connect_kbox(task_id);
+	if (sess == NULL) {
+		fprintf(stderr, "%s: Unable to connect to task %" PRIu64
+		    " (%s)\n", NAME, task_id, str_error(errno));
+		return errno;
+	}
+
+	errno_t rc = udebug_begin(sess);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to debug task %" PRIu64 " (%s)\n",
+		    NAME, task_id, str_error(rc));
+		async_hangup(sess);
+		return rc;
+	}
+
+	rc = udebug_prof_start(sess);
+	if (rc != EOK) {
+		fprintf(stderr, "%s: Unable to start profiling (%s)\n", NAME,
+		    str_error(rc));
+		udebug_end(sess);
+		async_hangup(sess);
+		return rc;
+	}
+
+	printf("Profiling task %" PRIu64 " for %u seconds...\n", task_id,
+	    duration);
+
+	uint64_t next = 0;
+	unsigned int rounds = duration * (1000000 / COLLECT_INTERVAL);
+
+	for (unsigned int i = 0; i < rounds; i++) {
+		async_usleep(COLLECT_INTERVAL);
+
+		rc = collect(&next);
+		if (rc != EOK)
+			break;
+
+		/* The task has terminated. */
+		if (header->task_id != task_id)
+			break;
+	}
+
+	if (rc == EOK)
+		rc = collect(&next);
+
+	udebug_prof_stop(sess);
+	udebug_end(sess);
+	async_hangup(sess);
+
+	if (rc != EOK)
+		fprintf(stderr, "%s: Out of memory\n", NAME);
+
+	return rc;
+}
+
+static void symtab_autoload(task_id_t task_id)
+{
+	stats_task_t *stats = stats_get_task(task_id);
+	if (stats == NULL)
+		return;
+
+	const char *dirs[] = { "/app", "/srv" };
+
+	for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+		char *file_name;
+		if (asprintf(&file_name, "%s/%s", dirs[i], stats->name) < 0)
+			break;
+
+		errno_t rc = symtab_load(file_name, &symtab);
+		free(file_name);
+
+		if (rc == EOK)
+			break;
+	}
+
+	free(stats);
+}
+
+static int uintptr_cmp(const void *a, const void *b)
+{
+	uintptr_t ua = *(const uintptr_t *) a;
+	uintptr_t ub = *(const uintptr_t *) b;
+
+	if (ua < ub)
+		return -1;
+	if (ua > ub)
+		return 1;
+	return 0;
+}
+
+/** Address to be resolved for the given stack level.
+ *
+ * Return addresses point just past the call instruction, which might
+ * already belong to the next function.
+ */
+static uintptr_t sample_addr(prof_sample_t *sample, size_t level)
+{
+	return (level == 0) ? sample->pc[0] : sample->pc[level] - 1;
+}
+
+static size_t func_find(uintptr_t addr)
+{
+	size_t lo = 0;
+	size_t hi = addrs_count;
+
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (addrs[mid].addr < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return addrs[lo].func;
+}
+
+/** Resolve every distinct address found in the samples.
+ *
+ * Each address is looked up in the symbol table just once and mapped
+ * to the function containing it.
+ */
+static errno_t resolve(void)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < samples_count; i++)
+		count += samples[i].depth;
+
+	uintptr_t *all = calloc(count, sizeof(uintptr_t));
+	if ((all == NULL) && (count > 0))
+		return ENOMEM;
+
+	size_t n = 0;
+	for (size_t i = 0; i < samples_count; i++) {
+		for (size_t j = 0; j < samples[i].depth; j++)
+			all[n++] = sample_addr(&samples[i], j);
+	}
+
+	qsort(all, n, sizeof(uintptr_t), uintptr_cmp);
+
+	addrs = calloc(n, sizeof(addr_t));
+	funcs = calloc(n + 1, sizeof(func_t));
+	if (((addrs == NULL) && (n > 0)) || (funcs == NULL)) {
+		free(all);
+		return ENOMEM;
+	}
+
+	/* Samples taken in the kernel are attributed to a pseudo-function. */
+	funcs[0].name = "[kernel]";
+	funcs[0].last = (size_t) -1;
+	funcs_count = 1;
+
+	for (size_t i = 0; i < n; i++) {
+		if ((addrs_count > 0) && (addrs[addrs_count - 1].addr == all[i]))
+			continue;
+
+		char *name = NULL;
+		size_t offs = 0;
+		uintptr_t addr = all[i];
+
+		if ((symtab != NULL) &&
+		    (symtab_addr_to_name(symtab, all[i], &name, &offs) == EOK))
+			addr = all[i] - offs;
+		else
+			name = NULL;
+
+		/* The addresses are sorted, so the function may be the last. */
+		size_t func = funcs_count;
+		if ((name != NULL) && (funcs[funcs_count - 1].name == name))
+			func = funcs_count - 1;
+
+		if (func == funcs_count) {
+			funcs[func].addr = addr;
+			funcs[func].name = name;
+			funcs[func].last = (size_t) -1;
+			funcs_count++;
+		}
+
+		addrs[addrs_count].addr = all[i];
+		addrs[addrs_count].func = func;
+		addrs_count++;
+	}
+
+	free(all);
+	return EOK;
+}
+
+static void func_print(func_t *func)
+{
+	if (func->name != NULL)
+		printf("%s", func->name);
+	else
+		printf("%#" PRIxPTR, func->addr);
+}
+
+static int func_self_cmp(const void *a, const void *b)
+{
+	const func_t *fa = *(const func_t **) a;
+	const func_t *fb = *(const func_t **) b;
+
+	if (fa->self != fb->self)
+		return (fa->self > fb->self) ? -1 : 1;
+	if (fa->total != fb->total)
+		return (fa->total > fb->total) ? -1 : 1;
+	return 0;
+}
+
+static errno_t print_flat(void)
+{
+	for (size_t i = 0; i < samples_count; i++) {
+		prof_sample_t *sample = &samples[i];
+
+		if (sample->flags & PROF_SAMPLE_KERNEL) {
+			funcs[0].self++;
+			funcs[0].total++;
+			continue;
+		}
+
+		for (size_t j = 0; j < sample->depth; j++) {
+			func_t *func = &funcs[func_find(sample_addr(sample, j))];
+
+			if (j == 0)
+				func->self++;
+
+			/* Count recursive functions just once per sample. */
+			if (func->last != i) {
+				func->total++;
+				func->last = i;
+			}
+		}
+	}
+
+	func_t **sorted = calloc(funcs_count, sizeof(func_t *));
+	if (sorted == NULL)
+		return ENOMEM;
+
+	for (size_t i = 0; i < funcs_count; i++)
+		sorted[i] = &funcs[i];
+
+	qsort(sorted, funcs_count, sizeof(func_t *), func_self_cmp);
+
+	printf("\nFlat profile (%zu samples, %" PRIu64 " lost):\n\n",
+	    samples_count, samples_lost);
+	printf("[self %%] [total %%] [self] [total] [function]\n");
+
+	for (size_t i = 0; i < funcs_count; i++) {
+		func_t *func = sorted[i];
+		if (func->total == 0)
+			continue;
+
+		printf("%7zu%% %8zu%% %6zu %7zu ",
+		    func->self * 100 / samples_count,
+		    func->total * 100 / samples_count, func->self, func->total);
+		func_print(func);
+		printf("\n");
+	}
+
+	free(sorted);
+	return EOK;
+}
+
+static int edge_cmp(const void *a, const void *b)
+{
+	const edge_t *ea = a;
+	const edge_t *eb = b;
+
+	if (ea->caller != eb->caller)
+		return (ea->caller < eb->caller) ? -1 : 1;
+	if (ea->callee != eb->callee)
+		return (ea->callee < eb->callee) ? -1 : 1;
+	return 0;
+}
+
+/** Print the number of samples in which a caller called a callee. */
+static errno_t print_graph(void)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < samples_count; i++) {
+		if (samples[i].depth > 1)
+			count += samples[i].depth - 1;
+	}
+
+	edge_t *edges = calloc(count, sizeof(edge_t));
+	if ((edges == NULL) && (count > 0))
+		return ENOMEM;
+
+	size_t n = 0;
+	for (size_t i = 0; i < samples_count; i++) {
+		prof_sample_t *sample = &samples[i];
+
+		for (size_t j = 1; j < sample->depth; j++) {
+			edges[n].caller = func_find(sample_addr(sample, j));
+			edges[n].callee = func_find(sample_addr(sample, j - 1));
+			n++;
+		}
+	}
+
+	qsort(edges, n, sizeof(edge_t), edge_cmp);
+
+	printf("\nCall graph:\n\n");
+	printf("[samples] [caller] -> [callee]\n");
+
+	size_t i = 0;
+	while (i < n) {
+		size_t j = i + 1;
+		while ((j < n) && (edge_cmp(&edges[i], &edges[j]) == 0))
+			j++;
+
+		printf("%9zu ", j - i);
+		func_print(&funcs[edges[i].caller]);
+		printf(" -> ");
+		func_print(&funcs[edges[i].callee]);
+		printf("\n");
+
+		i = j;
+	}
+
+	free(edges);
+	return EOK;
+}
+
+static void usage(const char *name)
+{
+	printf(
+	    "Usage: %s [options] <task_id> [<executable>]\n"
+	    "\n"
+	    "Options:\n"
+	    "\t-d <seconds>\tProfiling duration (default %u)\n"
+	    "\t-g\t\tPrint the call graph\n"
+	    "\n"
+	    "The symbols are read from the executable, which is looked up\n"
+	    "in /app and /srv by the task name if not given.\n",
+	    name, DEFAULT_DURATION);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int duration = DEFAULT_DURATION;
+	bool graph = false;
+
+	int i = 1;
+	while ((i < argc) && (argv[i][0] == '-')) {
+		if (str_cmp(argv[i], "-g") == 0) {
+			graph = true;
+		} else if ((str_cmp(argv[i], "-d") == 0) && (i + 1 < argc)) {
+			i++;
+			if ((str_uint32_t(argv[i], NULL, 10, true,
+			    &duration) != EOK) || (duration == 0)) {
+				fprintf(stderr, "%s: Invalid duration '%s'\n",
+				    NAME, argv[i]);
+				return 1;
+			}
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+
+		i++;
+	}
+
+	if ((i >= argc) || (i + 2 < argc)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	uint64_t task_id;
+	if (str_uint64_t(argv[i], NULL, 10, true, &task_id) != EOK) {
+		fprintf(stderr, "%s: Invalid task ID '%s'\n", NAME, argv[i]);
+		return 1;
+	}
+
+	if (i + 1 < argc) {
+		errno_t rc = symtab_load(argv[i + 1], &symtab);
+		if (rc != EOK) {
+			fprintf(stderr, "%s: Unable to load symbols from %s "
+			    "(%s)\n", NAME, argv[i + 1], str_error(rc));
+			return 1;
+		}
+	} else
+		symtab_autoload(task_id);
+
+	if (symtab == NULL)
+		printf("No symbols loaded, printing raw addresses.\n");
+
+	if (prof_map() != EOK)
+		return 2;
+
+	if (profile(task_id, duration) != EOK)
+		return 2;
+
+	if (samples_count == 0) {
+		printf("No samples taken.\n");
+		return 0;
+	}
+
+	if ((resolve() != EOK) || (print_flat() != EOK) ||
+	    ((graph) && (print_graph() != EOK))) {
+		fprintf(stderr, "%s: Out of memory\n", NAME);
+		return 2;
+	}
+
+	return 0;
+}
+
+/** @}
+ */
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/** @addtogroup rtriebench
+ * @{
+ */
+/**
+ * @file Routing trie lookup benchmark.
+ *
+ * Fills a routing trie with random prefixes of length 16 to 24 and
+ * measures the latency of longest-prefix lookups of random addresses,
+ * i.e. the per-datagram cost of route selection in the internet service.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <nettl/rtrie.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+
+#define NAME  "rtriebench"
+
+/** Default largest number of routes */
+#define BENCH_ROUTES  100000
+
+/** Default number of lookups per round */
+#define BENCH_LOOKUPS  1000000
+
+static uint32_t bench_seed = 2;
+
+static void print_syntax(void)
+{
+	printf("Usage: " NAME " [-r <routes>] [-n <lookups>]\n");
+	printf("Runs rounds with 1000 routes, ten times more routes in each "
+	    "following round, up to <routes>.\n");
+}
+
+static uint32_t bench_rand(void)
+{
+	bench_seed = bench_seed * 1103515245 + 12345;
+	return bench_seed >> 8;
+}
+
+static void bench_key(uint32_t addr, uint8_t *key)
+{
+	key[0] = addr >> 24;
+	key[1] = (addr >> 16) & 0xff;
+	key[2] = (addr >> 8) & 0xff;
+	key[3] = addr & 0xff;
+}
+
+/** Parse a numeric option argument.
+ *
+ * @param argc Argument count.
+ * @param argv Arguments.
+ * @param i Index of the option.
+ * @param val Place to store the value.
+ *
+ * @return EOK on success or EINVAL if the value is missing or invalid.
+ */
+static errno_t parse_count(int argc, char *argv[], int i, uint32_t *val)
+{
+	if ((argc <= i + 1) ||
+	    (str_uint32_t(argv[i + 1], NULL, 10, true, val) != EOK) ||
+	    (*val == 0))
+		return EINVAL;
+
+	return EOK;
+}
+
+int main(int argc, char *argv[])
+{
+	struct timeval start;
+	struct timeval end;
+	uint32_t max_routes = BENCH_ROUTES;
+	uint32_t lookups = BENCH_LOOKUPS;
+	uint8_t key[4];
+	rtrie_t trie;
+	size_t nroutes = 0;
+	errno_t rc;
+	int i = 1;
+
+	while (argc > i) {
+		if (str_cmp(argv[i], "-r") == 0) {
+			rc = parse_count(argc, argv, i, &max_routes);
+		} else if (str_cmp(argv[i], "-n") == 0) {
+			rc = parse_count(argc, argv, i, &lookups);
+		} else {
+			rc = EINVAL;
+		}
+
+		if (rc != EOK) {
+			print_syntax();
+			return 1;
+		}
+
+		i += 2;
+	}
+
+	rc = rtrie_init(&trie, 32);
+	if (rc != EOK) {
+		printf(NAME ": Error initializing trie: %s\n", str_error(rc));
+		return 1;
+	}
+
+	for (size_t limit = 1000; limit <= max_routes; limit *= 10) {
+		while (nroutes < limit) {
+			bench_key(bench_rand() << 8, key);
+			rc = rtrie_insert(&trie, key, 16 + bench_rand() % 9,
+			    &trie);
+			if (rc == EEXIST)
+				continue;
+			if (rc != EOK) {
+				printf(NAME ": Error inserting route: %s\n",
+				    str_error(rc));
+				rtrie_fini(&trie);
+				return 1;
+			}
+
+			++nroutes;
+		}
+
+		rtrie_synchronize(&trie);
+
+		size_t hits = 0;
+		getuptime(&start);
+		for (uint32_t n = 0; n < lookups; n++) {
+			bench_key(bench_rand(), key);
+			if (rtrie_lookup(&trie, key) != NULL)
+				++hits;
+		}
+		getuptime(&end);
+
+		suseconds_t usec = tv_sub_diff(&end, &start);
+		printf("%7zu routes: %" PRIu32 " lookups (%zu hits) in "
+		    "%lld us, %lld ns per lookup\n", nroutes, lookups, hits,
+		    (long long) usec, (long long) usec * 1000 / lookups);
+	}
+
+	rtrie_fini(&trie);
+	return 0;
+}
+
+/** @}
+ */
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup spawnbench
+ * @{
+ */
+/**
+ * @file Task spawn benchmark.
+ *
+ * Measures the latency from spawning a task to its exit, i.e. the cost of
+ * the program loader, the dynamic linker and the task startup and
+ * teardown. The first spawn is reported separately, as it fills the
+ * caches of the file system and of the VFS pager.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include <sys/time.h>
+#include <task.h>
+
+#define NAME  "spawnbench"
+
+/** Default number of spawns */
+#define BENCH_COUNT  100
+
+/** Option to run as the spawned task */
+#define CHILD_OPTION  "--child"
+
+static void print_syntax(void)
+{
+	printf("Usage: " NAME " [-n <count>] [<program> [<arg>...]]\n");
+	printf("Without <program>, " NAME " spawns itself as a task which "
+	    "just exits.\n");
+}
+
+/** Spawn a task and wait for it to exit.
+ *
+ * @param path Program to spawn.
+ * @param args Arguments of the program.
+ * @param usec Place to store the spawn-to-exit latency.
+ *
+ * @return EOK on success or an error code.
+ */
+static errno_t spawn_one(const char *path, const char *const args[],
+    suseconds_t *usec)
+{
+	struct timeval start;
+	struct timeval end;
+	task_wait_t wait;
+	task_exit_t texit;
+	int retval;
+
+	getuptime(&start);
+
+	errno_t rc = task_spawnv(NULL, &wait, path, args);
+	if (rc != EOK)
+		return rc;
+
+	rc = task_wait(&wait, &texit, &retval);
+	if (rc != EOK)
+		return rc;
+
+	getuptime(&end);
+
+	if ((texit != TASK_EXIT_NORMAL) || (retval != 0))
+		return EIO;
+
+	*usec = tv_sub_diff(&end, &start);
+	return EOK;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = BENCH_COUNT;
+	const char *self_args[] = { argv[0], CHILD_OPTION, NULL };
+	const char *const *args = self_args;
+	const char *path = "/app/" NAME;
+	int i = 1;
+
+	if ((argc == 2) && (str_cmp(argv[1], CHILD_OPTION) == 0))
+		return 0;
+
+	if ((argc > i) && (str_cmp(argv[i], "-n") == 0)) {
+		if ((argc <= i + 1) ||
+		    (str_uint32_t(argv[i + 1], NULL, 10, true, &count) != EOK) ||
+		    (count == 0)) {
+			print_syntax();
+			return 1;
+		}
+
+		i += 2;
+	}
+
+	if (argc > i) {
+		if (argv[i][0] == '-') {
+			print_syntax();
+			return 1;
+		}
+
+		path = argv[i];
+		args = (const char *const *) &argv[i];
+	}
+
+	printf("Spawning '%s' %" PRIu32 " times\n", path, count);
+
+	suseconds_t first;
+	errno_t rc = spawn_one(path, args, &first);
+	if (rc != EOK) {
+		printf(NAME ": Error spawning '%s': %s\n", path,
+		    str_error(rc));
+		return 1;
+	}
+
+	suseconds_t min = first;
+	suseconds_t max = first;
+	suseconds_t total = 0;
+
+	for (uint32_t n = 1; n < count; n++) {
+		suseconds_t usec;
+
+		rc = spawn_one(path, args, &usec);
+		if (rc != EOK) {
+			printf(NAME ": Error spawning '%s': %s\n", path,
+			    str_error(rc));
+			return 1;
+		}
+
+		if ((n == 1) || (usec < min))
+			min = usec;
+		if ((n == 1) || (usec > max))
+			max = usec;
+		total += usec;
+	}
+
+	printf("first %10lld us\n", (long long) first);
+
+	if (count > 1) {
+		suseconds_t avg = total / (count - 1);
+
+		printf("min   %10lld us\n", (long long) min);
+		printf("avg   %10lld us\n", (long long) avg);
+		printf("max   %10lld us\n", (long long) max);
+		if (avg > 0) {
+			printf("%lld spawns/s\n",
+			    (long long) (1000000 / avg));
+		}
+	}
+
+	return 0;
+}
+
+/** @}
+ */
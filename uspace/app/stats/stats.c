@@ -163,6 +163,37 @@ static void list_cpus(void)
 	free(cpus);
 }
 
+static void list_syscalls(void)
+{
+	size_t count;
+	stats_syscall_t *syscalls = stats_get_syscalls(&count);
+
+	if (syscalls == NULL) {
+		fprintf(stderr, "%s: Unable to get syscall statistics "
+		    "(kernel without CONFIG_SYSCALL_STATS?)\n", NAME);
+		return;
+	}
+
+	printf("[id] [calls    ] [avg cycles] [log2(cycles):calls ...]\n");
+
+	for (size_t i = 0; i < count; i++) {
+		if (syscalls[i].count == 0)
+			continue;
+
+		printf("%-4u %11" PRIu64 " %12" PRIu64 " ", syscalls[i].id,
+		    syscalls[i].count, syscalls[i].cycles / syscalls[i].count);
+
+		for (unsigned int j = 0; j < STATS_SYSCALL_BUCKETS; j++) {
+			if (syscalls[i].hist[j] != 0)
+				printf(" %u:%" PRIu64, j, syscalls[i].hist[j]);
+		}
+
+		printf("\n");
+	}
+
+	free(syscalls);
+}
+
 static void print_load(void)
 {
 	size_t count;
@@ -201,7 +232,7 @@ static void print_uptime(void)
 static void usage(const char *name)
 {
 	printf(
-	    "Usage: %s [-t task_id] [-a] [-c] [-l] [-u]\n"
+	    "Usage: %s [-t task_id] [-a] [-c] [-s] [-l] [-u]\n"
 	    "\n"
 	    "Options:\n"
 	    "\t-t task_id\n"
@@ -216,6 +247,10 @@ static void usage(const char *name)
 	    "\t--cpus\n"
 	    "\t\tList CPUs\n"
 	    "\n"
+	    "\t-s\n"
+	    "\t--syscalls\n"
+	    "\t\tList syscall latency statistics\n"
+	    "\n"
 	    "\t-l\n"
 	    "\t--load\n"
 	    "\t\tPrint system load\n"
@@ -238,6 +273,7 @@ int main(int argc, char *argv[])
 	bool toggle_threads = false;
 	bool toggle_all = false;
 	bool toggle_cpus = false;
+	bool toggle_syscalls = false;
 	bool toggle_load = false;
 	bool toggle_uptime = false;
 
@@ -268,6 +304,13 @@ int main(int argc, char *argv[])
 			continue;
 		}
 
+		/* Syscalls */
+		if ((off = arg_parse_short_long(argv[i], "-s", "--syscalls")) != -1) {
+			toggle_tasks = false;
+			toggle_syscalls = true;
+			continue;
+		}
+
 		/* Threads */
 		if ((off = arg_parse_short_long(argv[i], "-t", "--task=")) != -1) {
 			// TODO: Support for 64b range
@@ -309,6 +352,9 @@ int main(int argc, char *argv[])
 	if (toggle_cpus)
 		list_cpus();
 
+	if (toggle_syscalls)
+		list_syscalls();
+
 	if (toggle_load)
 		print_load();
 
@@ -49,7 +49,7 @@
 #include <assert.h>
 #include <str.h>
 
-#include <symtab.h>
+#include <elf/elf_symtab.h>
 #include <elf_core.h>
 #include <stacktrace.h>
 #include <taskdump.h>
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <as.h>
+#include "../tester.h"
+
+#define AREA_SIZE  (64 * 1024 * 1024)
+
+/** Create an area, touch every page and report first-touch bandwidth.
+ *
+ * @param flags Additional area flags.
+ * @param desc  Description of the variant.
+ *
+ * @return NULL on success or an error message.
+ *
+ */
+static const char *touch_bench(unsigned int flags, const char *desc)
+{
+	struct timeval start;
+	gettimeofday(&start, NULL);
+
+	void *area = as_area_create(AS_AREA_ANY, AREA_SIZE,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE | flags,
+	    AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return "Cannot create AS area";
+
+	volatile uint8_t *ptr = (volatile uint8_t *) area;
+	for (size_t i = 0; i < AREA_SIZE; i += PAGE_SIZE)
+		ptr[i] = 1;
+
+	struct timeval end;
+	gettimeofday(&end, NULL);
+
+	/* Check that every page has been mapped and zeroed. */
+	const char *err = NULL;
+	for (size_t i = 0; i < AREA_SIZE; i += PAGE_SIZE) {
+		if ((ptr[i] != 1) || (ptr[i + 1] != 0)) {
+			err = "Unexpected content of a touched page";
+			break;
+		}
+	}
+
+	as_area_destroy(area);
+
+	if (err != NULL)
+		return err;
+
+	suseconds_t usec = tv_sub_diff(&end, &start);
+	if (usec == 0)
+		usec = 1;
+
+	TPRINTF("%s: %d MiB in %ld us (%" PRIu64 " MiB/s)\n", desc,
+	    AREA_SIZE / (1024 * 1024), (long) usec,
+	    (uint64_t) AREA_SIZE * 1000000 / (1024 * 1024) / usec);
+
+	return NULL;
+}
+
+const char *test_populate1(void)
+{
+	TPRINTF("First-touch bandwidth of anonymous memory:\n");
+
+	const char *err = touch_bench(0, "On demand (fault-around)");
+	if (err != NULL)
+		return err;
+
+	return touch_bench(AS_AREA_POPULATE, "Populated at creation");
+}
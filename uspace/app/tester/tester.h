@@ -106,6 +106,7 @@ extern const char *test_malloc2(void);
 extern const char *test_malloc3(void);
 extern const char *test_mapping1(void);
 extern const char *test_pager1(void);
+extern const char *test_populate1(void);
 extern const char *test_serial1(void);
 extern const char *test_devman1(void);
 extern const char *test_devman2(void);
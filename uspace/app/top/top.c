@@ -42,6 +42,7 @@
 #include <sys/time.h>
 #include <errno.h>
 #include <gsort.h>
+#include <mem.h>
 #include <str.h>
 #include "screen.h"
 #include "top.h"
@@ -131,6 +132,84 @@ static size_t sort_column = TASK_COL_PERCENT_USER;
 static int sort_reverse = -1;
 static bool excs_all = false;
 
+/** Task statistics kept up to date by incremental queries */
+static stats_task_t *tasks_cache = NULL;
+static size_t tasks_cache_count = 0;
+static uint64_t tasks_generation = 0;
+
+/** Thread statistics kept up to date by incremental queries */
+static stats_thread_t *threads_cache = NULL;
+static size_t threads_cache_count = 0;
+static uint64_t threads_generation = 0;
+
+/** Update the task statistics cache and copy it to the data structure
+ *
+ * Only the tasks which changed since the previous update are transferred
+ * from the kernel.
+ *
+ */
+static const char *read_tasks(data_t *target)
+{
+	stats_delta_t *delta = stats_get_tasks_delta(tasks_generation);
+	if (delta == NULL)
+		return "Cannot get tasks";
+
+	stats_task_t *tasks =
+	    stats_merge_tasks(tasks_cache, &tasks_cache_count, delta);
+	if (tasks == NULL) {
+		free(delta);
+		return "Not enough memory for tasks";
+	}
+
+	tasks_cache = tasks;
+	tasks_generation = delta->generation;
+	free(delta);
+
+	target->tasks_count = tasks_cache_count;
+	target->tasks = (stats_task_t *)
+	    malloc(tasks_cache_count * sizeof(stats_task_t));
+	if (target->tasks == NULL)
+		return "Not enough memory for tasks";
+
+	memcpy(target->tasks, tasks_cache,
+	    tasks_cache_count * sizeof(stats_task_t));
+	return NULL;
+}
+
+/** Update the thread statistics cache and copy it to the data structure
+ *
+ * Only the threads which changed since the previous update are transferred
+ * from the kernel.
+ *
+ */
+static const char *read_threads(data_t *target)
+{
+	stats_delta_t *delta = stats_get_threads_delta(threads_generation);
+	if (delta == NULL)
+		return "Cannot get threads";
+
+	stats_thread_t *threads =
+	    stats_merge_threads(threads_cache, &threads_cache_count, delta);
+	if (threads == NULL) {
+		free(delta);
+		return "Not enough memory for threads";
+	}
+
+	threads_cache = threads;
+	threads_generation = delta->generation;
+	free(delta);
+
+	target->threads_count = threads_cache_count;
+	target->threads = (stats_thread_t *)
+	    malloc(threads_cache_count * sizeof(stats_thread_t));
+	if (target->threads == NULL)
+		return "Not enough memory for threads";
+
+	memcpy(target->threads, threads_cache,
+	    threads_cache_count * sizeof(stats_thread_t));
+	return NULL;
+}
+
 static const char *read_data(data_t *target)
 {
 	/* Initialize data */
@@ -186,9 +265,9 @@ static const char *read_data(data_t *target)
 		return "Not enough memory for CPU utilization";
 
 	/* Get tasks */
-	target->tasks = stats_get_tasks(&(target->tasks_count));
-	if (target->tasks == NULL)
-		return "Cannot get tasks";
+	const char *ret = read_tasks(target);
+	if (ret != NULL)
+		return ret;
 
 	target->tasks_perc =
 	    (perc_task_t *) calloc(target->tasks_count, sizeof(perc_task_t));
@@ -196,9 +275,9 @@ static const char *read_data(data_t *target)
 		return "Not enough memory for task utilization";
 
 	/* Get threads */
-	target->threads = stats_get_threads(&(target->threads_count));
-	if (target->threads == NULL)
-		return "Cannot get threads";
+	ret = read_threads(target);
+	if (ret != NULL)
+		return ret;
 
 	/* Get Exceptions */
 	target->exceptions = stats_get_exceptions(&(target->exceptions_count));
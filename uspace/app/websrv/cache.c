@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup websrv
+ * @{
+ */
+/**
+ * @file Open file cache.
+ *
+ * Keeps recently requested files open and, if they are small enough,
+ * their contents in memory. Since VFS does not provide modification times,
+ * an entry is revalidated by comparing the file's node identity and size
+ * with the values recorded when the entry was created. Revalidation is
+ * performed at most once per @c CACHE_VALIDATE_USEC per entry.
+ */
+
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <assert.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <str.h>
+
+#include "cache.h"
+
+/** Maximum number of cached files */
+#define CACHE_MAX_ENTRIES  64
+
+/** Maximum size of a file whose contents are kept in memory */
+#define CACHE_MAX_FILE_SIZE  (256 * 1024)
+
+/** Maximum total size of file contents kept in memory */
+#define CACHE_MAX_DATA_SIZE  (4 * 1024 * 1024)
+
+/** Interval after which an entry needs to be revalidated */
+#define CACHE_VALIDATE_USEC  1000000
+
+static size_t cache_key_hash(void *key)
+{
+	size_t hash = 0;
+	const char *cp;
+
+	for (cp = (const char *) key; *cp != '\0'; cp++)
+		hash = hash_combine(hash, (size_t) *cp);
+
+	return hash;
+}
+
+static size_t cache_hash(const ht_link_t *item)
+{
+	cache_entry_t *entry = hash_table_get_inst(item, cache_entry_t, lhash);
+	return cache_key_hash(entry->path);
+}
+
+static bool cache_key_equal(void *key, const ht_link_t *item)
+{
+	cache_entry_t *entry = hash_table_get_inst(item, cache_entry_t, lhash);
+	return str_cmp(entry->path, (const char *) key) == 0;
+}
+
+static hash_table_ops_t cache_ht_ops = {
+	.hash = cache_hash,
+	.key_hash = cache_key_hash,
+	.key_equal = cache_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Synchronizes access to all cache structures */
+static FIBRIL_MUTEX_INITIALIZE(cache_lock);
+/** Cache entries keyed by path */
+static hash_table_t cache_ht;
+/** Unreferenced entries, least recently used first */
+static LIST_INITIALIZE(cache_lru);
+/** Number of entries in the cache */
+static size_t cache_entries;
+/** Total size of file contents held in memory */
+static size_t cache_data_size;
+
+/** Initialize open file cache.
+ *
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t cache_init(void)
+{
+	if (!hash_table_create(&cache_ht, 0, 0, &cache_ht_ops))
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Destroy cache entry, closing the file. */
+static void cache_entry_destroy(cache_entry_t *entry)
+{
+	if (entry->fd >= 0)
+		vfs_put(entry->fd);
+	free(entry->data);
+	free(entry->path);
+	free(entry);
+}
+
+/** Remove entry from the cache.
+ *
+ * The entry is destroyed immediately if it is not referenced, otherwise
+ * when the last reference is released.
+ */
+static void cache_remove(cache_entry_t *entry)
+{
+	assert(fibril_mutex_is_locked(&cache_lock));
+
+	hash_table_remove_item(&cache_ht, &entry->lhash);
+	--cache_entries;
+	if (entry->data != NULL)
+		cache_data_size -= entry->stat.size;
+
+	entry->stale = true;
+	if (entry->refcnt == 0) {
+		list_remove(&entry->llru);
+		cache_entry_destroy(entry);
+	}
+}
+
+/** Evict unreferenced entries to make room for a new one.
+ *
+ * @param data_size Size of contents the new entry will hold in memory
+ */
+static void cache_evict(size_t data_size)
+{
+	assert(fibril_mutex_is_locked(&cache_lock));
+
+	while (cache_entries >= CACHE_MAX_ENTRIES ||
+	    cache_data_size + data_size > CACHE_MAX_DATA_SIZE) {
+		link_t *link = list_first(&cache_lru);
+		if (link == NULL)
+			break;
+
+		cache_remove(list_get_instance(link, cache_entry_t, llru));
+	}
+}
+
+/** Determine whether file status indicates the file has changed. */
+static bool cache_stat_changed(vfs_stat_t *a, vfs_stat_t *b)
+{
+	return a->fs_handle != b->fs_handle || a->service_id != b->service_id ||
+	    a->index != b->index || a->size != b->size;
+}
+
+/** Open file and create a new cache entry for it. */
+static errno_t cache_entry_load(const char *path, cache_entry_t **rentry)
+{
+	cache_entry_t *entry;
+	size_t nread;
+	errno_t rc;
+
+	entry = calloc(1, sizeof(cache_entry_t));
+	if (entry == NULL)
+		return ENOMEM;
+
+	link_initialize(&entry->llru);
+	entry->fd = -1;
+
+	entry->path = str_dup(path);
+	if (entry->path == NULL) {
+		rc = ENOMEM;
+		goto error;
+	}
+
+	rc = vfs_lookup_open(path, WALK_REGULAR, MODE_READ, &entry->fd);
+	if (rc != EOK)
+		goto error;
+
+	rc = vfs_stat(entry->fd, &entry->stat);
+	if (rc != EOK)
+		goto error;
+
+	if (entry->stat.size > 0 && entry->stat.size <= CACHE_MAX_FILE_SIZE) {
+		entry->data = malloc(entry->stat.size);
+		if (entry->data == NULL) {
+			rc = ENOMEM;
+			goto error;
+		}
+
+		rc = vfs_read(entry->fd, (aoff64_t []) { 0 }, entry->data,
+		    entry->stat.size, &nread);
+		if (rc != EOK)
+			goto error;
+
+		/* File was truncated meanwhile, do not cache contents */
+		if (nread != entry->stat.size) {
+			free(entry->data);
+			entry->data = NULL;
+		}
+	}
+
+	getuptime(&entry->validated);
+	*rentry = entry;
+	return EOK;
+error:
+	cache_entry_destroy(entry);
+	return rc;
+}
+
+/** Add reference to cache entry. */
+static void cache_entry_ref(cache_entry_t *entry)
+{
+	assert(fibril_mutex_is_locked(&cache_lock));
+
+	if (entry->refcnt++ == 0)
+		list_remove(&entry->llru);
+}
+
+/** Drop reference to cache entry. */
+static void cache_entry_unref(cache_entry_t *entry)
+{
+	assert(fibril_mutex_is_locked(&cache_lock));
+
+	assert(entry->refcnt > 0);
+	if (--entry->refcnt == 0) {
+		if (entry->stale)
+			cache_entry_destroy(entry);
+		else
+			list_append(&entry->llru, &cache_lru);
+	}
+}
+
+/** Look up a valid cache entry and add a reference to it.
+ *
+ * The cache lock is dropped while the entry is being revalidated.
+ *
+ * @param path File path
+ *
+ * @return Referenced entry or @c NULL if the file is not cached or its
+ *         entry is no longer valid
+ */
+static cache_entry_t *cache_lookup(const char *path)
+{
+	cache_entry_t *entry;
+	struct timeval now;
+	vfs_stat_t stat;
+	ht_link_t *link;
+	errno_t rc;
+
+	assert(fibril_mutex_is_locked(&cache_lock));
+
+	link = hash_table_find(&cache_ht, (void *) path);
+	if (link == NULL)
+		return NULL;
+
+	entry = hash_table_get_inst(link, cache_entry_t, lhash);
+	cache_entry_ref(entry);
+
+	getuptime(&now);
+	if (tv_sub_diff(&now, &entry->validated) < CACHE_VALIDATE_USEC)
+		return entry;
+
+	/* The reference keeps the entry alive while the lock is dropped */
+	fibril_mutex_unlock(&cache_lock);
+	rc = vfs_stat_path(path, &stat);
+	fibril_mutex_lock(&cache_lock);
+
+	if (rc != EOK || cache_stat_changed(&stat, &entry->stat)) {
+		if (!entry->stale)
+			cache_remove(entry);
+		cache_entry_unref(entry);
+		return NULL;
+	}
+
+	entry->validated = now;
+	return entry;
+}
+
+/** Get cache entry for file.
+ *
+ * Looks up the file in the cache, revalidating the entry if needed,
+ * or opens the file and inserts a new entry. The cache lock is not held
+ * while accessing the file so that other requests are not blocked.
+ * The caller must release the entry using cache_release() when done.
+ *
+ * @param path File path
+ * @param rentry Place to store pointer to the referenced entry
+ *
+ * @return EOK on success or an error code (e.g. if the file does not
+ *         exist)
+ */
+errno_t cache_get(const char *path, cache_entry_t **rentry)
+{
+	cache_entry_t *entry;
+	cache_entry_t *other;
+	errno_t rc;
+
+	fibril_mutex_lock(&cache_lock);
+	entry = cache_lookup(path);
+	fibril_mutex_unlock(&cache_lock);
+
+	if (entry != NULL) {
+		*rentry = entry;
+		return EOK;
+	}
+
+	rc = cache_entry_load(path, &entry);
+	if (rc != EOK)
+		return rc;
+
+	fibril_mutex_lock(&cache_lock);
+
+	/* Another request may have inserted the file meanwhile */
+	if (hash_table_find(&cache_ht, (void *) path) != NULL) {
+		other = cache_lookup(path);
+		if (other != NULL) {
+			fibril_mutex_unlock(&cache_lock);
+			cache_entry_destroy(entry);
+			*rentry = other;
+			return EOK;
+		}
+
+		/* Revalidation may have dropped the lock */
+		if (hash_table_find(&cache_ht, (void *) path) != NULL) {
+			/* Serve our fresh copy without caching it */
+			entry->stale = true;
+			entry->refcnt = 1;
+			fibril_mutex_unlock(&cache_lock);
+			*rentry = entry;
+			return EOK;
+		}
+	}
+
+	cache_evict(entry->data != NULL ? entry->stat.size : 0);
+
+	hash_table_insert(&cache_ht, &entry->lhash);
+	++cache_entries;
+	if (entry->data != NULL)
+		cache_data_size += entry->stat.size;
+
+	entry->refcnt = 1;
+	fibril_mutex_unlock(&cache_lock);
+
+	*rentry = entry;
+	return EOK;
+}
+
+/** Release reference to cache entry.
+ *
+ * @param entry Cache entry
+ */
+void cache_release(cache_entry_t *entry)
+{
+	fibril_mutex_lock(&cache_lock);
+	cache_entry_unref(entry);
+	fibril_mutex_unlock(&cache_lock);
+}
+
+/** @}
+ */
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup websrv
+ * @{
+ */
+/**
+ * @file Open file cache.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <errno.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <vfs/vfs.h>
+
+/** Cached open file */
+typedef struct {
+	/** Link to cache hash table */
+	ht_link_t lhash;
+	/** Link to LRU list of unreferenced entries */
+	link_t llru;
+	/** File path (the key) */
+	char *path;
+	/** Open file handle */
+	int fd;
+	/** File status at the time of last validation */
+	vfs_stat_t stat;
+	/** Time of last validation */
+	struct timeval validated;
+	/** File contents or @c NULL if the file is too large to be cached */
+	void *data;
+	/** Number of references held by requests being served */
+	unsigned refcnt;
+	/** Entry has been removed from the cache, destroy on last release */
+	bool stale;
+} cache_entry_t;
+
+extern errno_t cache_init(void);
+extern errno_t cache_get(const char *, cache_entry_t **);
+extern void cache_release(cache_entry_t *);
+
+#endif
+
+/** @}
+ */
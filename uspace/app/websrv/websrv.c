@@ -48,19 +48,33 @@
 #include <inet/endpoint.h>
 #include <inet/tcp.h>
 
+#include <http/http.h>
+#include <http/receive-buffer.h>
+
 #include <arg_parse.h>
 #include <macros.h>
 #include <str.h>
 #include <str_error.h>
 
+#include "cache.h"
+
 #define NAME  "websrv"
 
 #define DEFAULT_PORT  8080
 
 #define WEB_ROOT  "/data/web"
 
-/** Buffer for receiving the request. */
-#define BUFFER_SIZE  1024
+/** Buffer for receiving requests. */
+#define BUFFER_SIZE  4096
+
+/** Maximum total size of request headers. */
+#define MAX_HEADERS_SIZE  4096
+
+/** Maximum number of request headers. */
+#define MAX_HEADERS_COUNT  32
+
+/** Size of buffer for formatting response header. */
+#define RESPONSE_HDR_SIZE  256
 
 static void websrv_new_conn(tcp_listener_t *, tcp_conn_t *);
 
@@ -74,28 +88,11 @@ static tcp_cb_t conn_cb = {
 
 static uint16_t port = DEFAULT_PORT;
 
-typedef struct {
-	tcp_conn_t *conn;
-
-	char rbuf[BUFFER_SIZE];
-	size_t rbuf_out;
-	size_t rbuf_in;
-
-	char lbuf[BUFFER_SIZE + 1];
-	size_t lbuf_used;
-} recv_t;
-
 static bool verbose = false;
 
-/** Responses to send to client. */
-
-static const char *msg_ok =
-    "HTTP/1.0 200 OK\r\n"
-    "\r\n";
+/** Bodies of error responses to send to client. */
 
 static const char *msg_bad_request =
-    "HTTP/1.0 400 Bad Request\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>400 Bad Request</title>\r\n"
@@ -107,8 +104,6 @@ static const char *msg_bad_request =
     "</html>\r\n";
 
 static const char *msg_not_found =
-    "HTTP/1.0 404 Not Found\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>404 Not Found</title>\r\n"
@@ -120,8 +115,6 @@ static const char *msg_not_found =
     "</html>\r\n";
 
 static const char *msg_not_implemented =
-    "HTTP/1.0 501 Not Implemented\r\n"
-    "\r\n"
     "<!DOCTYPE HTML PUBLIC \"-//IETF//DTD HTML 2.0//EN\">\r\n"
     "<html><head>\r\n"
     "<title>501 Not Implemented</title>\r\n"
@@ -132,210 +125,197 @@ static const char *msg_not_implemented =
     "</body>\r\n"
     "</html>\r\n";
 
-
-static errno_t recv_create(tcp_conn_t *conn, recv_t **rrecv)
+/** Receive function for the request receive buffer */
+static errno_t websrv_recv(void *arg, void *buf, size_t bsize, size_t *nrecv)
 {
-	recv_t *recv;
-
-	recv = calloc(1, sizeof(recv_t));
-	if (recv == NULL)
-		return ENOMEM;
-
-	recv->conn = conn;
-	recv->rbuf_out = 0;
-	recv->rbuf_in = 0;
-	recv->lbuf_used = 0;
-
-	*rrecv = recv;
-	return EOK;
-}
+	tcp_conn_t *conn = (tcp_conn_t *) arg;
 
-static void recv_destroy(recv_t *recv)
-{
-	free(recv);
+	return tcp_conn_recv_wait(conn, buf, bsize, nrecv);
 }
 
-/** Receive one character (with buffering) */
-static errno_t recv_char(recv_t *recv, char *c)
+static bool uri_is_valid(char *uri)
 {
-	size_t nrecv;
-	errno_t rc;
+	if (uri[0] != '/')
+		return false;
 
-	if (recv->rbuf_out == recv->rbuf_in) {
-		recv->rbuf_out = 0;
-		recv->rbuf_in = 0;
+	if (uri[1] == '.')
+		return false;
 
-		rc = tcp_conn_recv_wait(recv->conn, recv->rbuf, BUFFER_SIZE, &nrecv);
-		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_recv() failed: %s\n", str_error(rc));
-			return rc;
-		}
+	char *cp = uri + 1;
 
-		recv->rbuf_in = nrecv;
+	while (*cp != '\0') {
+		char c = *cp++;
+		if (c == '/')
+			return false;
 	}
 
-	*c = recv->rbuf[recv->rbuf_out++];
-	return EOK;
+	return true;
 }
 
-/** Receive one line with length limit */
-static errno_t recv_line(recv_t *recv, char **rbuf)
+/** Determine whether connection should be kept open after request. */
+static bool req_keep_alive(http_request_t *req)
 {
-	char *bp = recv->lbuf;
-	char c = '\0';
-
-	while (bp < recv->lbuf + BUFFER_SIZE) {
-		char prev = c;
-		errno_t rc = recv_char(recv, &c);
+	http_header_t *header;
+	errno_t rc;
 
-		if (rc != EOK)
-			return rc;
+	/* HTTP/0.9 and HTTP/1.0 close the connection by default */
+	bool keep_alive = req->version.major > 1 ||
+	    (req->version.major == 1 && req->version.minor >= 1);
 
-		*bp++ = c;
-		if ((prev == '\r') && (c == '\n'))
-			break;
+	rc = http_headers_find_single(&req->headers, "Connection", &header);
+	if (rc == EOK) {
+		if (str_casecmp(header->value, "close") == 0)
+			keep_alive = false;
+		else if (str_casecmp(header->value, "keep-alive") == 0)
+			keep_alive = (req->version.major >= 1);
 	}
 
-	recv->lbuf_used = bp - recv->lbuf;
-	*bp = '\0';
-
-	if (bp == recv->lbuf + BUFFER_SIZE)
-		return ELIMIT;
+	/* We do not consume request bodies */
+	rc = http_headers_find_single(&req->headers, "Content-Length", &header);
+	if (rc == EOK && str_cmp(header->value, "0") != 0)
+		keep_alive = false;
 
-	*rbuf = recv->lbuf;
-	return EOK;
+	return keep_alive;
 }
 
-static bool uri_is_valid(char *uri)
+/** Send data, splitting it to transfers of acceptable size. */
+static errno_t send_data(tcp_conn_t *conn, const void *data, size_t size)
 {
-	if (uri[0] != '/')
-		return false;
-
-	if (uri[1] == '.')
-		return false;
+	while (size > 0) {
+		size_t xfer_size = min(size, DATA_XFER_LIMIT);
 
-	char *cp = uri + 1;
+		errno_t rc = tcp_conn_send(conn, data, xfer_size);
+		if (rc != EOK) {
+			fprintf(stderr, "tcp_conn_send() failed\n");
+			return rc;
+		}
 
-	while (*cp != '\0') {
-		char c = *cp++;
-		if (c == '/')
-			return false;
+		data += xfer_size;
+		size -= xfer_size;
 	}
 
-	return true;
+	return EOK;
 }
 
-static errno_t send_response(tcp_conn_t *conn, const char *msg)
+static errno_t send_header(tcp_conn_t *conn, const char *status,
+    aoff64_t content_length, bool keep_alive)
 {
-	size_t response_size = str_size(msg);
+	char hdr[RESPONSE_HDR_SIZE];
+	int len;
+
+	len = snprintf(hdr, sizeof(hdr),
+	    "HTTP/1.1 %s\r\n"
+	    "Content-Length: %" PRIu64 "\r\n"
+	    "Connection: %s\r\n"
+	    "\r\n", status, content_length,
+	    keep_alive ? "keep-alive" : "close");
+	if (len < 0 || (size_t) len >= sizeof(hdr))
+		return EINVAL;
 
 	if (verbose)
 		fprintf(stderr, "Sending response\n");
 
-	errno_t rc = tcp_conn_send(conn, (void *) msg, response_size);
-	if (rc != EOK) {
-		fprintf(stderr, "tcp_conn_send() failed\n");
+	return send_data(conn, hdr, len);
+}
+
+static errno_t send_response(tcp_conn_t *conn, const char *status,
+    const char *msg, bool keep_alive)
+{
+	size_t msg_size = str_size(msg);
+
+	errno_t rc = send_header(conn, status, msg_size, keep_alive);
+	if (rc != EOK)
 		return rc;
-	}
 
-	return EOK;
+	return send_data(conn, msg, msg_size);
 }
 
-static errno_t uri_get(const char *uri, tcp_conn_t *conn)
+static errno_t uri_get(const char *uri, tcp_conn_t *conn, bool keep_alive)
 {
-	char *fbuf = NULL;
+	cache_entry_t *entry;
 	char *fname = NULL;
 	errno_t rc;
-	size_t nr;
-	int fd = -1;
-
-	fbuf = calloc(BUFFER_SIZE, 1);
-	if (fbuf == NULL) {
-		rc = ENOMEM;
-		goto out;
-	}
 
 	if (str_cmp(uri, "/") == 0)
 		uri = "/index.html";
 
-	if (asprintf(&fname, "%s%s", WEB_ROOT, uri) < 0) {
-		rc = ENOMEM;
-		goto out;
-	}
-
-	rc = vfs_lookup_open(fname, WALK_REGULAR, MODE_READ, &fd);
-	if (rc != EOK) {
-		rc = send_response(conn, msg_not_found);
-		goto out;
-	}
+	if (asprintf(&fname, "%s%s", WEB_ROOT, uri) < 0)
+		return ENOMEM;
 
+	rc = cache_get(fname, &entry);
 	free(fname);
-	fname = NULL;
+	if (rc != EOK)
+		return send_response(conn, "404 Not Found", msg_not_found,
+		    keep_alive);
 
-	rc = send_response(conn, msg_ok);
+	rc = send_header(conn, "200 OK", entry->stat.size, keep_alive);
 	if (rc != EOK)
 		goto out;
 
-	aoff64_t pos = 0;
-	while (true) {
-		rc = vfs_read(fd, &pos, fbuf, BUFFER_SIZE, &nr);
+	if (entry->data != NULL) {
+		rc = send_data(conn, entry->data, entry->stat.size);
+	} else if (entry->stat.size > 0) {
+		/* Let the TCP service fetch the file contents directly */
+		rc = tcp_conn_sendfile(conn, entry->fd, 0,
+		    min(entry->stat.size, SIZE_MAX));
 		if (rc != EOK)
-			goto out;
-
-		if (nr == 0)
-			break;
-
-		rc = tcp_conn_send(conn, fbuf, nr);
-		if (rc != EOK) {
-			fprintf(stderr, "tcp_conn_send() failed\n");
-			goto out;
-		}
+			fprintf(stderr, "tcp_conn_sendfile() failed\n");
 	}
 
-	rc = EOK;
 out:
-	if (fd >= 0)
-		vfs_put(fd);
-	free(fname);
-	free(fbuf);
+	cache_release(entry);
 	return rc;
 }
 
-static errno_t req_process(tcp_conn_t *conn, recv_t *recv)
+/** Receive and process one request.
+ *
+ * @param conn       Connection
+ * @param rb         Receive buffer of the connection
+ * @param keep_alive Place to store @c true if the connection should be
+ *                   kept open for further requests
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t req_process(tcp_conn_t *conn, receive_buffer_t *rb,
+    bool *keep_alive)
 {
-	char *reqline = NULL;
+	http_request_t *req = NULL;
+
+	*keep_alive = false;
 
-	errno_t rc = recv_line(recv, &reqline);
+	errno_t rc = http_receive_request(rb, &req, MAX_HEADERS_SIZE,
+	    MAX_HEADERS_COUNT);
+	if (rc == HTTP_EPARSE || rc == ELIMIT)
+		return send_response(conn, "400 Bad Request", msg_bad_request,
+		    false);
 	if (rc != EOK) {
-		fprintf(stderr, "recv_line() failed\n");
+		fprintf(stderr, "http_receive_request() failed\n");
 		return rc;
 	}
 
-	if (verbose)
-		fprintf(stderr, "Request: %s", reqline);
-
-	if (str_lcmp(reqline, "GET ", 4) != 0) {
-		rc = send_response(conn, msg_not_implemented);
-		return rc;
+	if (verbose) {
+		fprintf(stderr, "Request: %s %s HTTP/%u.%u\n", req->method,
+		    req->path, req->version.major, req->version.minor);
 	}
 
-	char *uri = reqline + 4;
-	char *end_uri = str_chr(uri, ' ');
-	if (end_uri == NULL) {
-		end_uri = reqline + str_size(reqline) - 2;
-		assert(*end_uri == '\r');
+	if (str_cmp(req->method, "GET") != 0) {
+		rc = send_response(conn, "501 Not Implemented",
+		    msg_not_implemented, false);
+		goto out;
 	}
 
-	*end_uri = '\0';
-	if (verbose)
-		fprintf(stderr, "Requested URI: %s\n", uri);
+	*keep_alive = req_keep_alive(req);
 
-	if (!uri_is_valid(uri)) {
-		rc = send_response(conn, msg_bad_request);
-		return rc;
+	if (!uri_is_valid(req->path)) {
+		rc = send_response(conn, "400 Bad Request", msg_bad_request,
+		    *keep_alive);
+		goto out;
 	}
 
-	return uri_get(uri, conn);
+	rc = uri_get(req->path, conn, *keep_alive);
+out:
+	http_request_destroy(req);
+	return rc;
 }
 
 static void usage(void)
@@ -402,24 +382,40 @@ static errno_t parse_option(int argc, char *argv[], int *index)
 
 static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 {
+	receive_buffer_t rb;
+	bool keep_alive;
 	errno_t rc;
-	recv_t *recv = NULL;
+	char c;
 
 	if (verbose)
 		fprintf(stderr, "New connection, waiting for request\n");
 
-	rc = recv_create(conn, &recv);
+	rc = recv_buffer_init(&rb, BUFFER_SIZE, websrv_recv, conn);
 	if (rc != EOK) {
 		fprintf(stderr, "Out of memory.\n");
 		goto error;
 	}
 
-	rc = req_process(conn, recv);
-	if (rc != EOK) {
-		fprintf(stderr, "Error processing request (%s)\n",
-		    str_error(rc));
-		goto error;
-	}
+	/*
+	 * Serve requests until the client asks us to close the connection
+	 * or closes it itself. Pipelined requests simply wait in the receive
+	 * buffer until the preceding response has been sent.
+	 */
+	do {
+		rc = recv_char(&rb, &c, false);
+		if (rc != EOK)
+			break;
+
+		rc = req_process(conn, &rb, &keep_alive);
+		if (rc != EOK) {
+			fprintf(stderr, "Error processing request (%s)\n",
+			    str_error(rc));
+			recv_buffer_fini(&rb);
+			goto error;
+		}
+	} while (keep_alive);
+
+	recv_buffer_fini(&rb);
 
 	rc = tcp_conn_send_fin(conn);
 	if (rc != EOK) {
@@ -427,14 +423,11 @@ static void websrv_new_conn(tcp_listener_t *lst, tcp_conn_t *conn)
 		goto error;
 	}
 
-	recv_destroy(recv);
 	return;
 error:
 	rc = tcp_conn_reset(conn);
 	if (rc != EOK)
 		fprintf(stderr, "Error resetting connection.\n");
-
-	recv_destroy(recv);
 }
 
 int main(int argc, char *argv[])
@@ -458,6 +451,12 @@ int main(int argc, char *argv[])
 
 	printf("%s: HelenOS web server\n", NAME);
 
+	rc = cache_init();
+	if (rc != EOK) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
 	if (verbose)
 		fprintf(stderr, "Creating listener\n");
 
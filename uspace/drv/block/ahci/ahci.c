@@ -31,7 +31,9 @@
  */
 
 #include <as.h>
+#include <assert.h>
 #include <errno.h>
+#include <macros.h>
 #include <stdio.h>
 #include <ddf/interrupt.h>
 #include <ddf/log.h>
@@ -51,6 +53,26 @@
 #define HI(ptr) \
 	((uint32_t) (((uint64_t) ((uintptr_t) (ptr))) >> 32))
 
+/** Size of command table of one slot (header and PRDT). */
+#define AHCI_CMD_TABLE_SIZE  256
+
+/** Offset of PRDT in command table. */
+#define AHCI_CMD_TABLE_PRDT_OFFSET  0x80
+
+/** Maximum number of PRDT entries in command table. */
+#define AHCI_CMD_TABLE_PRDT_MAX \
+	((AHCI_CMD_TABLE_SIZE - AHCI_CMD_TABLE_PRDT_OFFSET) / \
+	sizeof(ahci_cmd_prdt_t))
+
+/** Maximum number of bytes described by one PRDT entry. */
+#define AHCI_PRD_MAX_SIZE  (4 * 1024 * 1024)
+
+/** Size of DMA buffer of one slot (maximum size of one command). */
+#define AHCI_SLOT_BUFFER_SIZE  (64 * 1024)
+
+/** Time for the port to stop command list and FIS receive (in ms). */
+#define AHCI_PORT_STOP_TIMEOUT  500
+
 /** Interrupt pseudocode for a single port
  *
  * The interrupt handling works as follows:
@@ -116,11 +138,11 @@ static errno_t write_blocks(ddf_fun_t *, uint64_t, size_t, void *);
 
 static errno_t ahci_identify_device(sata_dev_t *);
 static errno_t ahci_set_highest_ultra_dma_mode(sata_dev_t *);
-static errno_t ahci_rb_fpdma(sata_dev_t *, uintptr_t, uint64_t);
-static errno_t ahci_wb_fpdma(sata_dev_t *, uintptr_t, uint64_t);
+static errno_t ahci_rw_fpdma(sata_dev_t *, uint64_t, size_t, void *, bool);
 
 static void ahci_sata_devices_create(ahci_dev_t *, ddf_dev_t *);
 static ahci_dev_t *ahci_ahci_create(ddf_dev_t *);
+static void ahci_sata_hw_start(sata_dev_t *);
 static void ahci_ahci_hw_start(ahci_dev_t *);
 
 static errno_t ahci_dev_add(ddf_dev_t *);
@@ -228,33 +250,7 @@ static errno_t read_blocks(ddf_fun_t *fun, uint64_t blocknum,
     size_t count, void *buf)
 {
 	sata_dev_t *sata = fun_sata_dev(fun);
-
-	uintptr_t phys;
-	void *ibuf = AS_AREA_ANY;
-	errno_t rc = dmamem_map_anonymous(sata->block_size, DMAMEM_4GiB,
-	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &ibuf);
-	if (rc != EOK) {
-		ddf_msg(LVL_ERROR, "Cannot allocate read buffer.");
-		return rc;
-	}
-
-	memset(buf, 0, sata->block_size);
-
-	fibril_mutex_lock(&sata->lock);
-
-	for (size_t cur = 0; cur < count; cur++) {
-		rc = ahci_rb_fpdma(sata, phys, blocknum + cur);
-		if (rc != EOK)
-			break;
-
-		memcpy((void *) (((uint8_t *) buf) + (sata->block_size * cur)),
-		    ibuf, sata->block_size);
-	}
-
-	fibril_mutex_unlock(&sata->lock);
-	dmamem_unmap_anonymous(ibuf);
-
-	return rc;
+	return ahci_rw_fpdma(sata, blocknum, count, buf, false);
 }
 
 /** Write data blocks into SATA device.
@@ -271,30 +267,7 @@ static errno_t write_blocks(ddf_fun_t *fun, uint64_t blocknum,
     size_t count, void *buf)
 {
 	sata_dev_t *sata = fun_sata_dev(fun);
-
-	uintptr_t phys;
-	void *ibuf = AS_AREA_ANY;
-	errno_t rc = dmamem_map_anonymous(sata->block_size, DMAMEM_4GiB,
-	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &ibuf);
-	if (rc != EOK) {
-		ddf_msg(LVL_ERROR, "Cannot allocate write buffer.");
-		return rc;
-	}
-
-	fibril_mutex_lock(&sata->lock);
-
-	for (size_t cur = 0; cur < count; cur++) {
-		memcpy(ibuf, (void *) (((uint8_t *) buf) + (sata->block_size * cur)),
-		    sata->block_size);
-		rc = ahci_wb_fpdma(sata, phys, blocknum + cur);
-		if (rc != EOK)
-			break;
-	}
-
-	fibril_mutex_unlock(&sata->lock);
-	dmamem_unmap_anonymous(ibuf);
-
-	return rc;
+	return ahci_rw_fpdma(sata, blocknum, count, buf, true);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -525,6 +498,11 @@ static errno_t ahci_identify_device(sata_dev_t *sata)
 		}
 	}
 
+	/* Do not queue more commands than the device can accept */
+	unsigned int queue_depth = (idata->queue_depth & 0x1f) + 1;
+	if (sata->slots > queue_depth)
+		sata->slots = queue_depth;
+
 	uint8_t udma_mask = idata->udma & 0x007f;
 	sata->highest_udma_mode = (uint8_t) -1;
 	if (udma_mask == 0) {
@@ -668,110 +646,186 @@ error:
 	return EINTR;
 }
 
-/** Set AHCI registers for reading one sector from the SATA device using FPDMA.
+/** Allocate command slot.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer for sector data.
- * @param blocknum Block number to read.
+ * Restarts the port first if a previous command failed and no other
+ * command is still running.
+ *
+ * @param sata SATA device structure.
+ * @param wait Wait for a slot to become free.
+ *
+ * @return Slot number, -1 if no slot is free and not waiting.
  *
  */
-static void ahci_rb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
-    uint64_t blocknum)
+static int ahci_slot_alloc(sata_dev_t *sata, bool wait)
 {
-	volatile sata_ncq_command_frame_t *cmd =
-	    (sata_ncq_command_frame_t *) sata->cmd_table;
+	uint32_t mask = (sata->slots == AHCI_MAX_SLOTS) ?
+	    UINT32_MAX : (UINT32_C(1) << sata->slots) - 1;
 
-	cmd->fis_type = SATA_CMD_FIS_TYPE;
-	cmd->c = SATA_CMD_FIS_COMMAND_INDICATOR;
-	cmd->command = 0x60;
-	cmd->tag = 0;
-	cmd->control = 0;
+	fibril_mutex_lock(&sata->slot_lock);
 
-	cmd->reserved1 = 0;
-	cmd->reserved2 = 0;
-	cmd->reserved3 = 0;
-	cmd->reserved4 = 0;
-	cmd->reserved5 = 0;
-	cmd->reserved6 = 0;
+	while (true) {
+		if ((sata->port_error) && (sata->slots_active == 0)) {
+			ahci_sata_hw_start(sata);
+			sata->port_error = false;
+		}
 
-	cmd->sector_count_low = 1;
-	cmd->sector_count_high = 0;
+		uint32_t free = mask & ~sata->slots_used;
+		if ((free != 0) && (!sata->port_error)) {
+			int slot = 0;
+			while ((free & (UINT32_C(1) << slot)) == 0)
+				slot++;
 
-	cmd->lba0 = blocknum & 0xff;
-	cmd->lba1 = (blocknum >> 8) & 0xff;
-	cmd->lba2 = (blocknum >> 16) & 0xff;
-	cmd->lba3 = (blocknum >> 24) & 0xff;
-	cmd->lba4 = (blocknum >> 32) & 0xff;
-	cmd->lba5 = (blocknum >> 40) & 0xff;
+			sata->slots_used |= UINT32_C(1) << slot;
+			fibril_mutex_unlock(&sata->slot_lock);
+			return slot;
+		}
 
-	volatile ahci_cmd_prdt_t *prdt =
-	    (ahci_cmd_prdt_t *) (&sata->cmd_table[0x20]);
+		if (!wait)
+			break;
 
-	prdt->data_address_low = LO(phys);
-	prdt->data_address_upper = HI(phys);
-	prdt->reserved1 = 0;
-	prdt->dbc = sata->block_size - 1;
-	prdt->reserved2 = 0;
-	prdt->ioc = 0;
+		fibril_condvar_wait(&sata->slot_condvar, &sata->slot_lock);
+	}
 
-	sata->cmd_header->prdtl = 1;
-	sata->cmd_header->flags =
-	    AHCI_CMDHDR_FLAGS_CLEAR_BUSY_UPON_OK |
-	    AHCI_CMDHDR_FLAGS_5DWCMD;
-	sata->cmd_header->bytesprocessed = 0;
+	fibril_mutex_unlock(&sata->slot_lock);
+	return -1;
+}
 
-	sata->port->pxsact |= 1;
-	sata->port->pxci |= 1;
+/** Release command slot.
+ *
+ * @param sata SATA device structure.
+ * @param slot Slot number.
+ *
+ */
+static void ahci_slot_free(sata_dev_t *sata, int slot)
+{
+	fibril_mutex_lock(&sata->slot_lock);
+
+	sata->slots_used &= ~(UINT32_C(1) << slot);
+	sata->slots_failed &= ~(UINT32_C(1) << slot);
+	fibril_condvar_broadcast(&sata->slot_condvar);
+
+	fibril_mutex_unlock(&sata->slot_lock);
 }
 
-/** Read one sector from the SATA device using FPDMA.
+/** Wait for completion of command in slot.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer for sector data.
- * @param blocknum Block number to read.
+ * @param sata SATA device structure.
+ * @param slot Slot number.
  *
- * @return EOK if succeed, error code otherwise
+ * @return EOK if the command succeeded, EINTR otherwise.
  *
  */
-static errno_t ahci_rb_fpdma(sata_dev_t *sata, uintptr_t phys, uint64_t blocknum)
+static errno_t ahci_slot_wait(sata_dev_t *sata, int slot)
 {
-	if (sata->is_invalid_device) {
-		ddf_msg(LVL_ERROR,
-		    "%s: FPDMA read from invalid device", sata->model);
-		return EINTR;
+	uint32_t bit = UINT32_C(1) << slot;
+
+	fibril_mutex_lock(&sata->slot_lock);
+
+	while ((sata->slots_active & bit) != 0)
+		fibril_condvar_wait(&sata->slot_condvar, &sata->slot_lock);
+
+	errno_t rc = ((sata->slots_failed & bit) != 0) ? EINTR : EOK;
+
+	fibril_mutex_unlock(&sata->slot_lock);
+
+	return rc;
+}
+
+/** Complete commands finished by the device.
+ *
+ * Commands whose bits were cleared in the SActive register are
+ * finished, possibly in different order than they were issued.
+ * On error all running commands are failed and the port is restarted
+ * before next command.
+ *
+ * @param sata SATA device structure.
+ * @param pxis Value of port interrupt status register.
+ *
+ */
+static void ahci_slots_complete(sata_dev_t *sata, ahci_port_is_t pxis)
+{
+	fibril_mutex_lock(&sata->slot_lock);
+
+	uint32_t done;
+	if (ahci_port_is_error(pxis)) {
+		done = sata->slots_active;
+		sata->slots_failed |= done;
+		if (done != 0)
+			sata->port_error = true;
+
+		if (ahci_port_is_permanent_error(pxis))
+			sata->is_invalid_device = true;
+	} else {
+		done = sata->slots_active & ~sata->port->pxsact;
 	}
 
-	ahci_rb_fpdma_cmd(sata, phys, blocknum);
-	ahci_port_is_t pxis = ahci_wait_event(sata);
+	if (done != 0) {
+		sata->slots_active &= ~done;
+		fibril_condvar_broadcast(&sata->slot_condvar);
+	}
 
-	if ((sata->is_invalid_device) || (ahci_port_is_error(pxis))) {
-		ddf_msg(LVL_ERROR,
-		    "%s: Unrecoverable error during FPDMA read", sata->model);
-		return EINTR;
+	fibril_mutex_unlock(&sata->slot_lock);
+}
+
+/** Fill PRDT of command table to describe DMA buffer.
+ *
+ * @param table Command table.
+ * @param phys  Physical address of buffer.
+ * @param size  Number of bytes to transfer.
+ *
+ * @return Number of PRDT entries.
+ *
+ */
+static uint16_t ahci_fill_prdt(volatile uint32_t *table, uintptr_t phys,
+    size_t size)
+{
+	volatile ahci_cmd_prdt_t *prdt = (ahci_cmd_prdt_t *)
+	    (((volatile uint8_t *) table) + AHCI_CMD_TABLE_PRDT_OFFSET);
+	uint16_t entries = 0;
+
+	while (size > 0) {
+		assert(entries < AHCI_CMD_TABLE_PRDT_MAX);
+
+		size_t chunk = min(size, AHCI_PRD_MAX_SIZE);
+
+		prdt[entries].data_address_low = LO(phys);
+		prdt[entries].data_address_upper = HI(phys);
+		prdt[entries].reserved1 = 0;
+		prdt[entries].dbc = chunk - 1;
+		prdt[entries].reserved2 = 0;
+		prdt[entries].ioc = 0;
+
+		phys += chunk;
+		size -= chunk;
+		entries++;
 	}
 
-	return EOK;
+	return entries;
 }
 
-/** Set AHCI registers for writing one sector to the SATA device, use FPDMA.
+/** Issue FPDMA read or write of consecutive sectors in slot.
  *
- * @param sata     SATA device structure.
- * @param phys     Physical address of buffer with sector data.
- * @param blocknum Block number to write.
+ * Data are transferred from or to the DMA buffer of the slot.
  *
- * @return EOK if succeed, error code otherwise
+ * @param sata     SATA device structure.
+ * @param slot     Slot number, used also as NCQ tag.
+ * @param blocknum Number of first block.
+ * @param count    Number of blocks.
+ * @param write    True for write, false for read.
  *
  */
-static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
-    uint64_t blocknum)
+static void ahci_rw_fpdma_cmd(sata_dev_t *sata, int slot, uint64_t blocknum,
+    size_t count, bool write)
 {
+	volatile uint32_t *table = sata->cmd_tables[slot];
 	volatile sata_ncq_command_frame_t *cmd =
-	    (sata_ncq_command_frame_t *) sata->cmd_table;
+	    (sata_ncq_command_frame_t *) table;
 
 	cmd->fis_type = SATA_CMD_FIS_TYPE;
 	cmd->c = SATA_CMD_FIS_COMMAND_INDICATOR;
-	cmd->command = 0x61;
-	cmd->tag = 0;
+	cmd->command = write ? 0x61 : 0x60;
+	cmd->tag = slot << 3;
 	cmd->control = 0;
 
 	cmd->reserved1 = 0;
@@ -781,8 +835,8 @@ static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
 	cmd->reserved5 = 0;
 	cmd->reserved6 = 0;
 
-	cmd->sector_count_low = 1;
-	cmd->sector_count_high = 0;
+	cmd->sector_count_low = count & 0xff;
+	cmd->sector_count_high = (count >> 8) & 0xff;
 
 	cmd->lba0 = blocknum & 0xff;
 	cmd->lba1 = (blocknum >> 8) & 0xff;
@@ -791,54 +845,123 @@ static void ahci_wb_fpdma_cmd(sata_dev_t *sata, uintptr_t phys,
 	cmd->lba4 = (blocknum >> 32) & 0xff;
 	cmd->lba5 = (blocknum >> 40) & 0xff;
 
-	volatile ahci_cmd_prdt_t *prdt =
-	    (ahci_cmd_prdt_t *) (&sata->cmd_table[0x20]);
+	volatile ahci_cmdhdr_t *header = &sata->cmd_header[slot];
 
-	prdt->data_address_low = LO(phys);
-	prdt->data_address_upper = HI(phys);
-	prdt->reserved1 = 0;
-	prdt->dbc = sata->block_size - 1;
-	prdt->reserved2 = 0;
-	prdt->ioc = 0;
-
-	sata->cmd_header->prdtl = 1;
-	sata->cmd_header->flags =
+	header->prdtl = ahci_fill_prdt(table, sata->slot_buf_phys[slot],
+	    count * sata->block_size);
+	header->flags =
 	    AHCI_CMDHDR_FLAGS_CLEAR_BUSY_UPON_OK |
-	    AHCI_CMDHDR_FLAGS_WRITE |
 	    AHCI_CMDHDR_FLAGS_5DWCMD;
-	sata->cmd_header->bytesprocessed = 0;
+	if (write)
+		header->flags |= AHCI_CMDHDR_FLAGS_WRITE;
+	header->bytesprocessed = 0;
 
-	sata->port->pxsact |= 1;
-	sata->port->pxci |= 1;
+	/*
+	 * Both registers are write-one-to-set, bits of other running
+	 * commands must not be written.
+	 */
+	uint32_t bit = UINT32_C(1) << slot;
+
+	fibril_mutex_lock(&sata->slot_lock);
+
+	sata->slots_active |= bit;
+	sata->port->pxsact = bit;
+	sata->port->pxci = bit;
+
+	fibril_mutex_unlock(&sata->slot_lock);
 }
 
-/** Write one sector into the SATA device, use FPDMA.
+/** Command issued in a slot on behalf of a transfer. */
+typedef struct {
+	/** Slot number. */
+	int slot;
+	/** Part of the caller's buffer transferred by the command. */
+	uint8_t *buf;
+	/** Number of bytes transferred by the command. */
+	size_t size;
+} ahci_rw_cmd_t;
+
+/** Read or write sectors using FPDMA.
+ *
+ * The transfer is split into commands of up to AHCI_SLOT_BUFFER_SIZE
+ * bytes, which are queued to the device in all free command slots.
+ * Commands of concurrent transfers share the slots.
  *
  * @param sata     SATA device structure.
- * @param phys     Physical addres of buffer with sector data.
- * @param blocknum Block number to write.
+ * @param blocknum Number of first block.
+ * @param count    Number of blocks.
+ * @param buf      Buffer for data.
+ * @param write    True for write, false for read.
  *
  * @return EOK if succeed, error code otherwise
  *
  */
-static errno_t ahci_wb_fpdma(sata_dev_t *sata, uintptr_t phys, uint64_t blocknum)
+static errno_t ahci_rw_fpdma(sata_dev_t *sata, uint64_t blocknum,
+    size_t count, void *buf, bool write)
 {
-	if (sata->is_invalid_device) {
-		ddf_msg(LVL_ERROR,
-		    "%s: FPDMA write to invalid device", sata->model);
-		return EINTR;
-	}
+	ahci_rw_cmd_t cmds[AHCI_MAX_SLOTS];
+	unsigned int first = 0;
+	unsigned int pending = 0;
+	size_t max_blocks = AHCI_SLOT_BUFFER_SIZE / sata->block_size;
+	size_t done = 0;
+	errno_t rc = EOK;
+
+	while (((done < count) && (rc == EOK)) || (pending > 0)) {
+		if ((done < count) && (rc == EOK)) {
+			if (sata->is_invalid_device) {
+				ddf_msg(LVL_ERROR, "%s: FPDMA %s invalid device",
+				    sata->model,
+				    write ? "write to" : "read from");
+				rc = EINTR;
+				continue;
+			}
+
+			/* Do not block while own commands can be completed */
+			int slot = ahci_slot_alloc(sata, pending == 0);
+			if (slot >= 0) {
+				size_t blocks = min(count - done, max_blocks);
+				ahci_rw_cmd_t *cmd =
+				    &cmds[(first + pending) % AHCI_MAX_SLOTS];
+
+				cmd->slot = slot;
+				cmd->buf = ((uint8_t *) buf) +
+				    done * sata->block_size;
+				cmd->size = blocks * sata->block_size;
+
+				if (write) {
+					memcpy(sata->slot_buf[slot], cmd->buf,
+					    cmd->size);
+				}
+
+				ahci_rw_fpdma_cmd(sata, slot, blocknum + done,
+				    blocks, write);
+
+				done += blocks;
+				pending++;
+				continue;
+			}
+		}
 
-	ahci_wb_fpdma_cmd(sata, phys, blocknum);
-	ahci_port_is_t pxis = ahci_wait_event(sata);
+		/* Finish the oldest command */
+		ahci_rw_cmd_t *cmd = &cmds[first];
+		first = (first + 1) % AHCI_MAX_SLOTS;
+		pending--;
 
-	if ((sata->is_invalid_device) || (ahci_port_is_error(pxis))) {
-		ddf_msg(LVL_ERROR,
-		    "%s: Unrecoverable error during FPDMA write", sata->model);
-		return EINTR;
+		errno_t cmd_rc = ahci_slot_wait(sata, cmd->slot);
+		if ((cmd_rc == EOK) && (!write))
+			memcpy(cmd->buf, sata->slot_buf[cmd->slot], cmd->size);
+
+		ahci_slot_free(sata, cmd->slot);
+
+		if ((cmd_rc != EOK) && (rc == EOK)) {
+			ddf_msg(LVL_ERROR,
+			    "%s: Unrecoverable error during FPDMA %s",
+			    sata->model, write ? "write" : "read");
+			rc = cmd_rc;
+		}
 	}
 
-	return EOK;
+	return rc;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -915,6 +1038,8 @@ static void ahci_interrupt(ipc_call_t *icall, ddf_dev_t *dev)
 		fibril_condvar_signal(&sata->event_condvar);
 
 		fibril_mutex_unlock(&sata->event_lock);
+
+		ahci_slots_complete(sata, pxis);
 	}
 }
 
@@ -932,6 +1057,7 @@ static void ahci_interrupt(ipc_call_t *icall, ddf_dev_t *dev)
 static sata_dev_t *ahci_sata_allocate(ahci_dev_t *ahci, volatile ahci_port_t *port)
 {
 	size_t size = 4096;
+	size_t table_size = AHCI_MAX_SLOTS * AHCI_CMD_TABLE_SIZE;
 	uintptr_t phys = 0;
 	void *virt_fb = AS_AREA_ANY;
 	void *virt_cmd = AS_AREA_ANY;
@@ -968,19 +1094,52 @@ static sata_dev_t *ahci_sata_allocate(ahci_dev_t *ahci, volatile ahci_port_t *po
 	sata->port->pxclb = LO(phys);
 	sata->cmd_header = (ahci_cmdhdr_t *) virt_cmd;
 
-	/* Allocate and init command table structure. */
-	rc = dmamem_map_anonymous(size, DMAMEM_4GiB,
+	/* Allocate and init command tables of all slots. */
+	rc = dmamem_map_anonymous(table_size, DMAMEM_4GiB,
 	    AS_AREA_READ | AS_AREA_WRITE, 0, &phys, &virt_table);
 	if (rc != EOK)
 		goto error_table;
 
-	memset(virt_table, 0, size);
-	sata->cmd_header->cmdtableu = HI(phys);
-	sata->cmd_header->cmdtable = LO(phys);
-	sata->cmd_table = (uint32_t *) virt_table;
+	memset(virt_table, 0, table_size);
+	for (unsigned int slot = 0; slot < AHCI_MAX_SLOTS; slot++) {
+		uintptr_t table_phys = phys + slot * AHCI_CMD_TABLE_SIZE;
+
+		sata->cmd_header[slot].cmdtableu = HI(table_phys);
+		sata->cmd_header[slot].cmdtable = LO(table_phys);
+		sata->cmd_tables[slot] = (uint32_t *)
+		    (((uint8_t *) virt_table) + slot * AHCI_CMD_TABLE_SIZE);
+	}
+
+	sata->cmd_table = sata->cmd_tables[0];
+
+	/*
+	 * Allocate DMA buffers for slots supported by the controller,
+	 * settle for fewer slots if memory is short.
+	 */
+	ahci_ghc_cap_t cap;
+	cap.u32 = ahci->memregs->ghc.cap;
+
+	unsigned int slots = min(cap.ncs + 1, AHCI_MAX_SLOTS);
+	sata->slots = 0;
+	while (sata->slots < slots) {
+		void *buf = AS_AREA_ANY;
+		rc = dmamem_map_anonymous(AHCI_SLOT_BUFFER_SIZE, DMAMEM_4GiB,
+		    AS_AREA_READ | AS_AREA_WRITE, 0,
+		    &sata->slot_buf_phys[sata->slots], &buf);
+		if (rc != EOK)
+			break;
+
+		sata->slot_buf[sata->slots] = buf;
+		sata->slots++;
+	}
+
+	if (sata->slots == 0)
+		goto error_buffers;
 
 	return sata;
 
+error_buffers:
+	dmamem_unmap(virt_table, table_size);
 error_table:
 	dmamem_unmap(virt_cmd, size);
 error_cmd:
@@ -990,7 +1149,34 @@ error_retfis:
 	return NULL;
 }
 
+/** Wait until the port stops running the command list or FIS receive.
+ *
+ * @param sata SATA device structure.
+ * @param fr   Wait for FIS receive to stop, otherwise for command list.
+ *
+ * @return True if stopped, false on timeout.
+ *
+ */
+static bool ahci_sata_hw_wait_stopped(sata_dev_t *sata, bool fr)
+{
+	ahci_port_cmd_t pxcmd;
+
+	for (unsigned int i = 0; i < AHCI_PORT_STOP_TIMEOUT; i++) {
+		pxcmd.u32 = sata->port->pxcmd;
+		if ((fr ? pxcmd.fr : pxcmd.cr) == 0)
+			return true;
+
+		async_usleep(1000);
+	}
+
+	return false;
+}
+
 /** Initialize and start SATA hardware device.
+ *
+ * Also used to restart the port after a command failed. The command
+ * list and FIS receive are stopped and the port has to report them
+ * as not running before they are enabled again.
  *
  * @param sata SATA device structure.
  *
@@ -1001,14 +1187,22 @@ static void ahci_sata_hw_start(sata_dev_t *sata)
 
 	pxcmd.u32 = sata->port->pxcmd;
 
-	/* Frame receiver disabled. */
-	pxcmd.fre = 0;
-
 	/* Disable process the command list. */
 	pxcmd.st = 0;
+	sata->port->pxcmd = pxcmd.u32;
 
+	if (!ahci_sata_hw_wait_stopped(sata, false)) {
+		ddf_msg(LVL_WARN, "%s: Command list does not stop.",
+		    sata->model);
+	}
+
+	/* Frame receiver disabled. */
+	pxcmd.fre = 0;
 	sata->port->pxcmd = pxcmd.u32;
 
+	if (!ahci_sata_hw_wait_stopped(sata, true))
+		ddf_msg(LVL_WARN, "%s: FIS receive does not stop.", sata->model);
+
 	/* Clear interrupt status. */
 	sata->port->pxis = 0xffffffff;
 
@@ -1056,6 +1250,8 @@ static errno_t ahci_sata_create(ahci_dev_t *ahci, ddf_dev_t *dev,
 	fibril_mutex_initialize(&sata->lock);
 	fibril_mutex_initialize(&sata->event_lock);
 	fibril_condvar_initialize(&sata->event_condvar);
+	fibril_mutex_initialize(&sata->slot_lock);
+	fibril_condvar_initialize(&sata->slot_condvar);
 
 	ahci_sata_hw_start(sata);
 
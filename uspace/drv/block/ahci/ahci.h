@@ -72,12 +72,42 @@ typedef struct {
 	/** Pointer to SATA port. */
 	volatile ahci_port_t *port;
 
-	/** Pointer to command header. */
+	/** Pointer to command list (command headers of all slots). */
 	volatile ahci_cmdhdr_t *cmd_header;
 
-	/** Pointer to command table. */
+	/** Pointer to command table of slot 0. */
 	volatile uint32_t *cmd_table;
 
+	/** Number of command slots used for NCQ commands. */
+	unsigned int slots;
+
+	/** Pointers to command tables of all slots. */
+	volatile uint32_t *cmd_tables[AHCI_MAX_SLOTS];
+
+	/** DMA buffers of all slots. */
+	void *slot_buf[AHCI_MAX_SLOTS];
+
+	/** Physical addresses of DMA buffers of all slots. */
+	uintptr_t slot_buf_phys[AHCI_MAX_SLOTS];
+
+	/** Mutex protecting state of command slots. */
+	fibril_mutex_t slot_lock;
+
+	/** Signalled when a slot is released or a command completes. */
+	fibril_condvar_t slot_condvar;
+
+	/** Slots owned by a request. */
+	uint32_t slots_used;
+
+	/** Slots with command issued to the device. */
+	uint32_t slots_active;
+
+	/** Slots whose command failed. */
+	uint32_t slots_failed;
+
+	/** Port has to be restarted after an error. */
+	bool port_error;
+
 	/** Mutex for single operation on device. */
 	fibril_mutex_t lock;
 
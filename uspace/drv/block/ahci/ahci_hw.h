@@ -42,6 +42,9 @@
 /** AHCI standard 1.3 - maximum ports. */
 #define AHCI_MAX_PORTS  32
 
+/** AHCI standard 1.3 - maximum command slots per port. */
+#define AHCI_MAX_SLOTS  32
+
 /*----------------------------------------------------------------------------*/
 /*-- AHCI PCI Registers ------------------------------------------------------*/
 /*----------------------------------------------------------------------------*/
@@ -1013,6 +1016,8 @@ typedef volatile struct {
 	uint32_t cmdtable;
 	/** Command Table Descriptor Base Address Upper 32-bits. */
 	uint32_t cmdtableu;
+	/** Reserved. */
+	uint32_t reserved[4];
 } ahci_cmdhdr_t;
 
 /** Clear Busy upon R_OK (C) flag. */
@@ -58,6 +58,9 @@
 
 #define MAX_WRITE_RETRIES 10
 
+/** Number of attempts to read blocks directly before going through cache */
+#define MAX_DIRECT_READ_RETRIES 3
+
 /** Lock protecting the device connection list */
 static FIBRIL_MUTEX_INITIALIZE(dcl_lock);
 /** Device connection list head. */
@@ -70,6 +73,7 @@ typedef struct {
 	unsigned blocks_cluster;  /**< Physical blocks per block_t */
 	unsigned block_count;     /**< Total number of blocks. */
 	unsigned blocks_cached;   /**< Number of cached blocks. */
+	unsigned evictions;       /**< Blocks removed from block_hash so far. */
 	hash_table_t block_hash;
 	list_t free_list;
 	enum cache_mode mode;
@@ -80,6 +84,9 @@ typedef struct {
 	service_id_t service_id;
 	async_sess_t *sess;
 	bd_t *bd;
+	/** Session to the opened service if I/O is passed through, or NULL */
+	async_sess_t *psess;
+	bd_t *pbd;
 	void *bb_buf;
 	aoff64_t bb_addr;
 	aoff64_t pblocks;    /**< Number of physical blocks */
@@ -107,7 +114,8 @@ static devcon_t *devcon_search(service_id_t service_id)
 }
 
 static errno_t devcon_add(service_id_t service_id, async_sess_t *sess,
-    size_t bsize, aoff64_t dev_size, bd_t *bd)
+    size_t bsize, aoff64_t dev_size, bd_t *bd, async_sess_t *psess,
+    bd_t *pbd)
 {
 	devcon_t *devcon;
 
@@ -119,6 +127,8 @@ static errno_t devcon_add(service_id_t service_id, async_sess_t *sess,
 	devcon->service_id = service_id;
 	devcon->sess = sess;
 	devcon->bd = bd;
+	devcon->psess = psess;
+	devcon->pbd = pbd;
 	devcon->bb_buf = NULL;
 	devcon->bb_addr = 0;
 	devcon->pblock_size = bsize;
@@ -145,9 +155,59 @@ static void devcon_remove(devcon_t *devcon)
 	fibril_mutex_unlock(&dcl_lock);
 }
 
+/** Open direct session to the device underlying a block device.
+ *
+ * If the service only forwards a window of another block device (such as
+ * a partition), connect to that device directly and restrict the new
+ * session to the window. This saves a round trip through the forwarding
+ * server for every request.
+ *
+ * @param bd    Opened block device
+ * @param rsess Place to store session to the underlying device
+ * @param rbd   Place to store the underlying block device
+ *
+ * @return EOK on success, ENOTSUP if pass-through is not available
+ */
+static errno_t block_passthrough_open(bd_t *bd, async_sess_t **rsess,
+    bd_t **rbd)
+{
+	service_id_t dsid;
+	sysarg_t window;
+	async_sess_t *dsess;
+	bd_t *dbd;
+	errno_t rc;
+
+	rc = bd_get_passthrough(bd, &dsid, &window);
+	if (rc != EOK)
+		return rc;
+
+	dsess = loc_service_connect(dsid, INTERFACE_BLOCK, 0);
+	if (dsess == NULL)
+		return ENOENT;
+
+	rc = bd_open(dsess, &dbd);
+	if (rc != EOK) {
+		async_hangup(dsess);
+		return rc;
+	}
+
+	rc = bd_window_attach(dbd, window);
+	if (rc != EOK) {
+		bd_close(dbd);
+		async_hangup(dsess);
+		return rc;
+	}
+
+	*rsess = dsess;
+	*rbd = dbd;
+	return EOK;
+}
+
 errno_t block_init(service_id_t service_id, size_t comm_size)
 {
 	bd_t *bd;
+	async_sess_t *psess = NULL;
+	bd_t *pbd = NULL;
 
 	async_sess_t *sess = loc_service_connect(service_id, INTERFACE_BLOCK,
 	    IPC_FLAG_BLOCKING);
@@ -161,30 +221,42 @@ errno_t block_init(service_id_t service_id, size_t comm_size)
 		return rc;
 	}
 
+	/*
+	 * Keep the original session open while passing I/O through so
+	 * that the service knows the device is in use.
+	 */
+	async_sess_t *dsess;
+	bd_t *dbd;
+	if (block_passthrough_open(bd, &dsess, &dbd) == EOK) {
+		psess = sess;
+		pbd = bd;
+		sess = dsess;
+		bd = dbd;
+	}
+
 	size_t bsize;
 	rc = bd_get_block_size(bd, &bsize);
-	if (rc != EOK) {
-		bd_close(bd);
-		async_hangup(sess);
-		return rc;
-	}
+	if (rc != EOK)
+		goto error;
 
 	aoff64_t dev_size;
 	rc = bd_get_num_blocks(bd, &dev_size);
-	if (rc != EOK) {
-		bd_close(bd);
-		async_hangup(sess);
-		return rc;
-	}
+	if (rc != EOK)
+		goto error;
 
-	rc = devcon_add(service_id, sess, bsize, dev_size, bd);
-	if (rc != EOK) {
-		bd_close(bd);
-		async_hangup(sess);
-		return rc;
-	}
+	rc = devcon_add(service_id, sess, bsize, dev_size, bd, psess, pbd);
+	if (rc != EOK)
+		goto error;
 
 	return EOK;
+error:
+	bd_close(bd);
+	async_hangup(sess);
+	if (pbd != NULL) {
+		bd_close(pbd);
+		async_hangup(psess);
+	}
+	return rc;
 }
 
 void block_fini(service_id_t service_id)
@@ -205,6 +277,11 @@ void block_fini(service_id_t service_id)
 	bd_close(devcon->bd);
 	async_hangup(devcon->sess);
 
+	if (devcon->pbd != NULL) {
+		bd_close(devcon->pbd);
+		async_hangup(devcon->psess);
+	}
+
 	free(devcon);
 }
 
@@ -287,6 +364,7 @@ errno_t block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 	cache->lblock_size = size;
 	cache->block_count = blocks;
 	cache->blocks_cached = 0;
+	cache->evictions = 0;
 	cache->mode = mode;
 
 	/* Allow 1:1 or small-to-large block size translation */
@@ -530,6 +608,7 @@ retry:
 			 */
 			list_remove(&b->free_link);
 			hash_table_remove_item(&cache->block_hash, &b->hash_link);
+			cache->evictions++;
 		}
 
 		block_initialize(b);
@@ -657,6 +736,7 @@ retry:
 			 * Take the block out of the cache and free it.
 			 */
 			hash_table_remove_item(&cache->block_hash, &block->hash_link);
+			cache->evictions++;
 			fibril_mutex_unlock(&block->lock);
 			free(block->data);
 			free(block);
@@ -789,6 +869,188 @@ errno_t block_write_direct(service_id_t service_id, aoff64_t ba, size_t cnt,
 	return write_blocks(devcon, ba, cnt, (void *)data, devcon->pblock_size * cnt);
 }
 
+/** Read logical blocks through the cache one by one.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param buf		Buffer for storing the data.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+static errno_t block_cache_read_each(service_id_t service_id, aoff64_t ba,
+    size_t cnt, void *buf)
+{
+	block_t *b;
+	errno_t rc;
+
+	for (size_t i = 0; i < cnt; i++) {
+		rc = block_get(&b, service_id, ba + i, BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			return rc;
+
+		memcpy((uint8_t *) buf + i * b->size, b->data, b->size);
+
+		rc = block_put(b);
+		if (rc != EOK)
+			return rc;
+	}
+
+	return EOK;
+}
+
+/** Read logical blocks bypassing the cache.
+ *
+ * The blocks are transferred from the device in a single request and
+ * are not inserted into the cache. Blocks which are already cached are
+ * taken from the cache instead, so that possibly dirty cached data is
+ * never shadowed by stale device contents.
+ *
+ * A dirty block may be written back and evicted from the cache after
+ * the device has been read, but before the cached copies are taken.
+ * The data read from the device would then be stale, so the read is
+ * repeated if any block has left the cache in the meantime. If that
+ * keeps happening, the blocks are read through the cache.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param buf		Buffer for storing the data.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_cache_read_direct(service_id_t service_id, aoff64_t ba,
+    size_t cnt, void *buf)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	unsigned evictions;
+	errno_t rc;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+
+	for (unsigned attempt = 0; attempt < MAX_DIRECT_READ_RETRIES;
+	    attempt++) {
+		fibril_mutex_lock(&cache->lock);
+		evictions = cache->evictions;
+		fibril_mutex_unlock(&cache->lock);
+
+		rc = read_blocks(devcon, ba_ltop(devcon, ba),
+		    cnt * cache->blocks_cluster, buf, cnt * cache->lblock_size);
+		if (rc != EOK)
+			return rc;
+
+		fibril_mutex_lock(&cache->lock);
+		if (cache->evictions != evictions) {
+			/* Device contents may be older than evicted blocks */
+			fibril_mutex_unlock(&cache->lock);
+			continue;
+		}
+
+		for (size_t i = 0; i < cnt; i++) {
+			aoff64_t lba = ba + i;
+			ht_link_t *hlink = hash_table_find(&cache->block_hash,
+			    &lba);
+			if (!hlink)
+				continue;
+
+			block_t *b = hash_table_get_inst(hlink, block_t,
+			    hash_link);
+			fibril_mutex_lock(&b->lock);
+			if (!b->toxic) {
+				memcpy((uint8_t *) buf + i * cache->lblock_size,
+				    b->data, cache->lblock_size);
+			}
+			fibril_mutex_unlock(&b->lock);
+		}
+		fibril_mutex_unlock(&cache->lock);
+
+		return EOK;
+	}
+
+	return block_cache_read_each(service_id, ba, cnt, buf);
+}
+
+/** Update cached copies of logical blocks.
+ *
+ * Waiting for the block lock makes sure that a write-back of an older
+ * copy of the block, which holds the lock, has finished.
+ *
+ * @param cache		Block cache.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param data		New contents of the blocks or NULL to only mark
+ *			the cached copies dirty.
+ */
+static void block_cache_update(cache_t *cache, aoff64_t ba, size_t cnt,
+    const void *data)
+{
+	fibril_mutex_lock(&cache->lock);
+	for (size_t i = 0; i < cnt; i++) {
+		aoff64_t lba = ba + i;
+		ht_link_t *hlink = hash_table_find(&cache->block_hash, &lba);
+		if (!hlink)
+			continue;
+
+		block_t *b = hash_table_get_inst(hlink, block_t, hash_link);
+		fibril_mutex_lock(&b->lock);
+		if (data != NULL) {
+			memcpy(b->data,
+			    (const uint8_t *) data + i * cache->lblock_size,
+			    cache->lblock_size);
+			b->toxic = false;
+			b->dirty = false;
+		} else {
+			b->dirty = true;
+		}
+		fibril_mutex_unlock(&b->lock);
+	}
+	fibril_mutex_unlock(&cache->lock);
+}
+
+/** Write logical blocks bypassing the cache.
+ *
+ * The blocks are transferred to the device in a single request. Copies
+ * of the blocks that are already cached are updated and marked clean
+ * before the transfer, so that neither a later cache hit nor a write-back
+ * of a dirty block can resurrect the old contents. Should the transfer
+ * fail, the cached copies are left dirty for the cache to write them back.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param data		The data to be written.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_cache_write_direct(service_id_t service_id, aoff64_t ba,
+    size_t cnt, const void *data)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	errno_t rc;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+
+	block_cache_update(cache, ba, cnt, data);
+
+	rc = write_blocks(devcon, ba_ltop(devcon, ba),
+	    cnt * cache->blocks_cluster, (void *) data,
+	    cnt * cache->lblock_size);
+	if (rc != EOK)
+		block_cache_update(cache, ba, cnt, NULL);
+
+	return rc;
+}
+
 /** Synchronize blocks to persistent storage.
  *
  * @param service_id	Service ID of the block device.
@@ -807,6 +1069,43 @@ errno_t block_sync_cache(service_id_t service_id, aoff64_t ba, size_t cnt)
 	return bd_sync_cache(devcon->bd, ba, cnt);
 }
 
+/** Create block address window for pass-through clients.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block of the window (physical).
+ * @param nblocks	Number of blocks in the window.
+ * @param rid		Place to store the window ID.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_window_create(service_id_t service_id, aoff64_t ba,
+    aoff64_t nblocks, sysarg_t *rid)
+{
+	devcon_t *devcon;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+
+	return bd_window_create(devcon->bd, ba, nblocks, rid);
+}
+
+/** Destroy block address window.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param id		Window ID.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_window_destroy(service_id_t service_id, sysarg_t id)
+{
+	devcon_t *devcon;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+
+	return bd_window_destroy(devcon->bd, id);
+}
+
 /** Get device block size.
  *
  * @param service_id	Service ID of the block device.
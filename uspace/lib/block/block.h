@@ -119,7 +119,13 @@ extern errno_t block_read_toc(service_id_t, uint8_t, void *, size_t);
 extern errno_t block_read_direct(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_read_bytes_direct(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_write_direct(service_id_t, aoff64_t, size_t, const void *);
+extern errno_t block_cache_read_direct(service_id_t, aoff64_t, size_t, void *);
+extern errno_t block_cache_write_direct(service_id_t, aoff64_t, size_t,
+    const void *);
 extern errno_t block_sync_cache(service_id_t, aoff64_t, size_t);
+extern errno_t block_window_create(service_id_t, aoff64_t, aoff64_t,
+    sysarg_t *);
+extern errno_t block_window_destroy(service_id_t, sysarg_t);
 
 #endif
 
@@ -45,11 +45,85 @@
 #include <rtld/rtld_debug.h>
 #include <rtld/rtld_arch.h>
 
+/** Lazy binding trampoline, called from the PLT. */
+extern void _rtld_bind_start(void);
+
 void module_process_pre_arch(module_t *m)
 {
 	/* Unused */
 }
 
+/** Prepare lazy binding of the PLT relocations.
+ *
+ * Each PLT entry jumps through its GOT slot, which initially points back
+ * to the instructions in the entry pushing the relocation offset and
+ * jumping to the first PLT entry. That one pushes GOT[1] and jumps through
+ * GOT[2] to the binding trampoline, which resolves the symbol and patches
+ * the GOT slot, so that following calls go to the symbol directly.
+ *
+ * The trampoline is the one of the image processing the relocations, so
+ * this must only be used for modules of the running environment.
+ *
+ * @param m Module.
+ * @return @c true if lazy binding has been set up, @c false if the PLT
+ *         relocations need to be processed eagerly.
+ */
+bool module_process_lazy_arch(module_t *m)
+{
+	elf_rel_t *rt = m->dyn.jmp_rel;
+	size_t rt_entries = m->dyn.plt_rel_sz / sizeof(elf_rel_t);
+	uint32_t *got = m->dyn.plt_got;
+	size_t i;
+
+	if (m->dyn.plt_rel != DT_REL || got == NULL)
+		return false;
+
+	for (i = 0; i < rt_entries; ++i) {
+		if (ELF32_R_TYPE(rt[i].r_info) != R_386_JUMP_SLOT)
+			return false;
+	}
+
+	got[1] = (uint32_t) m;
+	got[2] = (uint32_t) _rtld_bind_start;
+
+	/* Relocate the GOT slots to point to the PLT entries. */
+	for (i = 0; i < rt_entries; ++i)
+		*(uint32_t *)(rt[i].r_offset + m->bias) += m->bias;
+
+	return true;
+}
+
+/** Bind a PLT entry.
+ *
+ * Called from the binding trampoline on the first call through the PLT
+ * entry.
+ *
+ * @param m		Module containing the PLT entry.
+ * @param reloc_off	Offset of the relocation in the PLT relocation table.
+ * @return Address of the symbol
+ */
+void *rtld_bind(module_t *m, size_t reloc_off)
+{
+	elf_rel_t *rel = (elf_rel_t *) ((uint8_t *) m->dyn.jmp_rel + reloc_off);
+	elf_word sym_idx = ELF32_R_SYM(rel->r_info);
+	uint32_t *r_ptr = (uint32_t *)(rel->r_offset + m->bias);
+	elf_symbol_t *sym_def;
+	module_t *dest;
+
+	sym_def = symbol_def_find_idx(sym_idx, m, &dest);
+	if (sym_def == NULL) {
+		elf_symbol_t *sym_table = m->dyn.sym_tab;
+		printf("Definition of '%s' not found.\n",
+		    m->dyn.str_tab + sym_table[sym_idx].st_name);
+		exit(1);
+	}
+
+	void *sym_addr = symbol_get_addr(sym_def, dest, NULL);
+	*r_ptr = (uint32_t) sym_addr;
+
+	return sym_addr;
+}
+
 
 /**
  * Process (fixup) all relocations in a relocation table.
@@ -104,8 +178,7 @@ void rel_table_process(module_t *m, elf_rel_t *rt, size_t rt_size)
 #if 0
 			DPRINTF("rel_type: %x, rel_offset: 0x%x\n", rel_type, r_offset);
 #endif
-			sym_def = symbol_def_find(str_tab + sym->st_name,
-			    m, ssf_none, &dest);
+			sym_def = symbol_def_find_idx(sym_idx, m, &dest);
 			DPRINTF("dest name: '%s'\n", dest->dyn.soname);
 			DPRINTF("dest bias: 0x%x\n", dest->bias);
 			if (sym_def) {
@@ -195,6 +195,104 @@ errno_t bd_get_num_blocks(bd_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+/** Ask for a direct session to the underlying device.
+ *
+ * A server that only forwards a block address window of another block
+ * device (e.g. a partition) can let the client talk to that device
+ * directly. The client connects to the returned service and attaches
+ * the returned window using bd_window_attach().
+ *
+ * @param bd      Block device
+ * @param rsid    Place to store service ID of the underlying device
+ * @param rwindow Place to store window ID on the underlying device
+ *
+ * @return EOK on success, ENOTSUP if pass-through is not available
+ */
+errno_t bd_get_passthrough(bd_t *bd, service_id_t *rsid, sysarg_t *rwindow)
+{
+	sysarg_t sid;
+	sysarg_t window;
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	errno_t rc = async_req_0_2(exch, BD_GET_PASSTHROUGH, &sid, &window);
+	async_exchange_end(exch);
+
+	if (rc != EOK)
+		return rc;
+
+	*rsid = sid;
+	*rwindow = window;
+	return EOK;
+}
+
+/** Create block address window.
+ *
+ * The window stays valid until destroyed or until this session is closed.
+ *
+ * @param bd      Block device
+ * @param ba      First block of the window
+ * @param nblocks Number of blocks in the window
+ * @param rid     Place to store window ID
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_window_create(bd_t *bd, aoff64_t ba, aoff64_t nblocks,
+    sysarg_t *rid)
+{
+	sysarg_t id;
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	errno_t rc = async_req_4_1(exch, BD_WINDOW_CREATE, LOWER32(ba),
+	    UPPER32(ba), LOWER32(nblocks), UPPER32(nblocks), &id);
+	async_exchange_end(exch);
+
+	if (rc != EOK)
+		return rc;
+
+	*rid = id;
+	return EOK;
+}
+
+/** Destroy block address window.
+ *
+ * Sessions still attached to the window fail any further I/O.
+ *
+ * @param bd Block device
+ * @param id Window ID
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_window_destroy(bd_t *bd, sysarg_t id)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	errno_t rc = async_req_1_0(exch, BD_WINDOW_DESTROY, id);
+	async_exchange_end(exch);
+
+	return rc;
+}
+
+/** Restrict session to a block address window.
+ *
+ * From now on all block addresses on this session are relative to the
+ * start of the window and the device appears to be as large as the
+ * window. A session can be attached to at most one window.
+ *
+ * @param bd Block device
+ * @param id Window ID
+ *
+ * @return EOK on success or an error code
+ */
+errno_t bd_window_attach(bd_t *bd, sysarg_t id)
+{
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	errno_t rc = async_req_1_0(exch, BD_WINDOW_ATTACH, id);
+	async_exchange_end(exch);
+
+	return rc;
+}
+
 static void bd_cb_conn(cap_call_handle_t icall_handle, ipc_call_t *icall, void *arg)
 {
 	bd_t *bd = (bd_t *)arg;
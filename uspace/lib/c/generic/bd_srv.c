@@ -33,7 +33,9 @@
  * @file
  * @brief Block device server stub
  */
+#include <assert.h>
 #include <errno.h>
+#include <fibril_synch.h>
 #include <ipc/bd.h>
 #include <macros.h>
 #include <stdlib.h>
@@ -42,6 +44,95 @@
 
 #include <bd_srv.h>
 
+/** Drop window reference.
+ *
+ * @param srvs   Service
+ * @param window Window
+ */
+static void bd_window_del_ref(bd_srvs_t *srvs, bd_window_t *window)
+{
+	fibril_mutex_lock(&srvs->lock);
+	assert(window->refcnt > 0);
+	if (--window->refcnt > 0) {
+		fibril_mutex_unlock(&srvs->lock);
+		return;
+	}
+
+	fibril_mutex_unlock(&srvs->lock);
+	free(window);
+}
+
+/** Revoke window.
+ *
+ * Waits for outstanding I/O through the window to complete. Sessions
+ * attached to the window fail all subsequent I/O.
+ *
+ * @param srvs   Service
+ * @param window Window, removed from the window list by the caller
+ */
+static void bd_window_revoke(bd_srvs_t *srvs, bd_window_t *window)
+{
+	fibril_rwlock_write_lock(&window->lock);
+	window->revoked = true;
+	fibril_rwlock_write_unlock(&window->lock);
+
+	/* Drop the owner's reference */
+	bd_window_del_ref(srvs, window);
+}
+
+/** Translate window-relative block address range.
+ *
+ * If the session is attached to a window, checks that the range lies
+ * within the window and translates it to a device block address. On
+ * success the window is held for reading until bd_window_io_end() is
+ * called.
+ *
+ * @param srv  Server session
+ * @param ba   Block address, translated in place
+ * @param cnt  Number of blocks
+ * @param size Size of data buffer
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t bd_window_io_begin(bd_srv_t *srv, aoff64_t *ba, size_t cnt,
+    size_t size)
+{
+	bd_window_t *window = srv->window;
+
+	if (window == NULL)
+		return EOK;
+
+	fibril_rwlock_read_lock(&window->lock);
+
+	if (window->revoked) {
+		fibril_rwlock_read_unlock(&window->lock);
+		return EIO;
+	}
+
+	if (*ba + cnt < *ba || *ba + cnt > window->nblocks) {
+		fibril_rwlock_read_unlock(&window->lock);
+		return ELIMIT;
+	}
+
+	if (cnt * window->block_size < size) {
+		fibril_rwlock_read_unlock(&window->lock);
+		return EINVAL;
+	}
+
+	*ba += window->ba;
+	return EOK;
+}
+
+/** Finish I/O started with bd_window_io_begin().
+ *
+ * @param srv Server session
+ */
+static void bd_window_io_end(bd_srv_t *srv)
+{
+	if (srv->window != NULL)
+		fibril_rwlock_read_unlock(&srv->window->lock);
+}
+
 static void bd_read_blocks_srv(bd_srv_t *srv, cap_call_handle_t chandle,
     ipc_call_t *call)
 {
@@ -74,7 +165,16 @@ static void bd_read_blocks_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 		return;
 	}
 
+	rc = bd_window_io_begin(srv, &ba, cnt, size);
+	if (rc != EOK) {
+		async_answer_0(rcall_handle, rc);
+		async_answer_0(chandle, rc);
+		free(buf);
+		return;
+	}
+
 	rc = srv->srvs->ops->read_blocks(srv, ba, cnt, buf, size);
+	bd_window_io_end(srv);
 	if (rc != EOK) {
 		async_answer_0(rcall_handle, ENOMEM);
 		async_answer_0(chandle, ENOMEM);
@@ -111,7 +211,8 @@ static void bd_read_toc_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 		return;
 	}
 
-	if (srv->srvs->ops->read_toc == NULL) {
+	/* The table of contents describes the whole medium */
+	if (srv->srvs->ops->read_toc == NULL || srv->window != NULL) {
 		async_answer_0(rcall_handle, ENOTSUP);
 		async_answer_0(chandle, ENOTSUP);
 		free(buf);
@@ -147,7 +248,24 @@ static void bd_sync_cache_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 		return;
 	}
 
+	if (srv->window != NULL && ba == 0 && cnt == 0) {
+		/* Synchronizing the whole device is a superset and harmless */
+		fibril_rwlock_read_lock(&srv->window->lock);
+		rc = srv->window->revoked ? EIO :
+		    srv->srvs->ops->sync_cache(srv, 0, 0);
+		fibril_rwlock_read_unlock(&srv->window->lock);
+		async_answer_0(chandle, rc);
+		return;
+	}
+
+	rc = bd_window_io_begin(srv, &ba, cnt, 0);
+	if (rc != EOK) {
+		async_answer_0(chandle, rc);
+		return;
+	}
+
 	rc = srv->srvs->ops->sync_cache(srv, ba, cnt);
+	bd_window_io_end(srv);
 	async_answer_0(chandle, rc);
 }
 
@@ -170,11 +288,20 @@ static void bd_write_blocks_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 	}
 
 	if (srv->srvs->ops->write_blocks == NULL) {
+		free(data);
 		async_answer_0(chandle, ENOTSUP);
 		return;
 	}
 
+	rc = bd_window_io_begin(srv, &ba, cnt, size);
+	if (rc != EOK) {
+		free(data);
+		async_answer_0(chandle, rc);
+		return;
+	}
+
 	rc = srv->srvs->ops->write_blocks(srv, ba, cnt, data, size);
+	bd_window_io_end(srv);
 	free(data);
 	async_answer_0(chandle, rc);
 }
@@ -200,6 +327,13 @@ static void bd_get_num_blocks_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 	errno_t rc;
 	aoff64_t num_blocks;
 
+	if (srv->window != NULL) {
+		num_blocks = srv->window->nblocks;
+		async_answer_2(chandle, EOK, LOWER32(num_blocks),
+		    UPPER32(num_blocks));
+		return;
+	}
+
 	if (srv->srvs->ops->get_num_blocks == NULL) {
 		async_answer_0(chandle, ENOTSUP);
 		return;
@@ -209,6 +343,178 @@ static void bd_get_num_blocks_srv(bd_srv_t *srv, cap_call_handle_t chandle,
 	async_answer_2(chandle, rc, LOWER32(num_blocks), UPPER32(num_blocks));
 }
 
+static void bd_get_passthrough_srv(bd_srv_t *srv, cap_call_handle_t chandle,
+    ipc_call_t *call)
+{
+	errno_t rc;
+	service_id_t sid;
+	sysarg_t window;
+
+	if (srv->srvs->ops->get_passthrough == NULL) {
+		async_answer_0(chandle, ENOTSUP);
+		return;
+	}
+
+	rc = srv->srvs->ops->get_passthrough(srv, &sid, &window);
+	async_answer_2(chandle, rc, sid, window);
+}
+
+static void bd_window_create_srv(bd_srv_t *srv, cap_call_handle_t chandle,
+    ipc_call_t *call)
+{
+	bd_srvs_t *srvs = srv->srvs;
+	bd_window_t *window;
+	aoff64_t ba;
+	aoff64_t nblocks;
+	aoff64_t dev_nblocks;
+	size_t block_size;
+	errno_t rc;
+
+	ba = MERGE_LOUP32(IPC_GET_ARG1(*call), IPC_GET_ARG2(*call));
+	nblocks = MERGE_LOUP32(IPC_GET_ARG3(*call), IPC_GET_ARG4(*call));
+
+	/* Windows are not nested */
+	if (srv->window != NULL || srvs->ops->get_block_size == NULL ||
+	    srvs->ops->get_num_blocks == NULL) {
+		async_answer_0(chandle, ENOTSUP);
+		return;
+	}
+
+	rc = srvs->ops->get_block_size(srv, &block_size);
+	if (rc != EOK) {
+		async_answer_0(chandle, rc);
+		return;
+	}
+
+	rc = srvs->ops->get_num_blocks(srv, &dev_nblocks);
+	if (rc != EOK) {
+		async_answer_0(chandle, rc);
+		return;
+	}
+
+	if (ba + nblocks < ba || ba + nblocks > dev_nblocks) {
+		async_answer_0(chandle, ELIMIT);
+		return;
+	}
+
+	window = calloc(1, sizeof(bd_window_t));
+	if (window == NULL) {
+		async_answer_0(chandle, ENOMEM);
+		return;
+	}
+
+	link_initialize(&window->lwindows);
+	window->owner = srv;
+	window->ba = ba;
+	window->nblocks = nblocks;
+	window->block_size = block_size;
+	window->revoked = false;
+	fibril_rwlock_initialize(&window->lock);
+	window->refcnt = 1;
+
+	fibril_mutex_lock(&srvs->lock);
+	window->id = ++srvs->next_window_id;
+	list_append(&window->lwindows, &srvs->windows);
+	fibril_mutex_unlock(&srvs->lock);
+
+	async_answer_1(chandle, EOK, window->id);
+}
+
+static void bd_window_destroy_srv(bd_srv_t *srv, cap_call_handle_t chandle,
+    ipc_call_t *call)
+{
+	bd_srvs_t *srvs = srv->srvs;
+	sysarg_t id;
+
+	id = IPC_GET_ARG1(*call);
+
+	fibril_mutex_lock(&srvs->lock);
+
+	list_foreach(srvs->windows, lwindows, bd_window_t, window) {
+		if (window->id == id && window->owner == srv) {
+			list_remove(&window->lwindows);
+			fibril_mutex_unlock(&srvs->lock);
+
+			bd_window_revoke(srvs, window);
+			async_answer_0(chandle, EOK);
+			return;
+		}
+	}
+
+	fibril_mutex_unlock(&srvs->lock);
+	async_answer_0(chandle, ENOENT);
+}
+
+static void bd_window_attach_srv(bd_srv_t *srv, cap_call_handle_t chandle,
+    ipc_call_t *call)
+{
+	bd_srvs_t *srvs = srv->srvs;
+	sysarg_t id;
+
+	id = IPC_GET_ARG1(*call);
+
+	if (srv->window != NULL) {
+		async_answer_0(chandle, EEXIST);
+		return;
+	}
+
+	fibril_mutex_lock(&srvs->lock);
+
+	list_foreach(srvs->windows, lwindows, bd_window_t, window) {
+		if (window->id == id) {
+			window->refcnt++;
+			srv->window = window;
+			fibril_mutex_unlock(&srvs->lock);
+
+			async_answer_0(chandle, EOK);
+			return;
+		}
+	}
+
+	fibril_mutex_unlock(&srvs->lock);
+	async_answer_0(chandle, ENOENT);
+}
+
+/** Clean up windows when a session is closed.
+ *
+ * Detaches the session from its window and revokes all windows the
+ * session has created.
+ *
+ * @param srv Server session
+ */
+static void bd_srv_windows_cleanup(bd_srv_t *srv)
+{
+	bd_srvs_t *srvs = srv->srvs;
+	bd_window_t *window;
+
+	if (srv->window != NULL) {
+		bd_window_del_ref(srvs, srv->window);
+		srv->window = NULL;
+	}
+
+	while (true) {
+		window = NULL;
+
+		fibril_mutex_lock(&srvs->lock);
+		list_foreach(srvs->windows, lwindows, bd_window_t, w) {
+			if (w->owner == srv) {
+				window = w;
+				break;
+			}
+		}
+
+		if (window == NULL) {
+			fibril_mutex_unlock(&srvs->lock);
+			break;
+		}
+
+		list_remove(&window->lwindows);
+		fibril_mutex_unlock(&srvs->lock);
+
+		bd_window_revoke(srvs, window);
+	}
+}
+
 static bd_srv_t *bd_srv_create(bd_srvs_t *srvs)
 {
 	bd_srv_t *srv;
@@ -225,6 +531,9 @@ void bd_srvs_init(bd_srvs_t *srvs)
 {
 	srvs->ops = NULL;
 	srvs->sarg = NULL;
+	fibril_mutex_initialize(&srvs->lock);
+	list_initialize(&srvs->windows);
+	srvs->next_window_id = 0;
 }
 
 errno_t bd_conn(cap_call_handle_t icall_handle, ipc_call_t *icall, bd_srvs_t *srvs)
@@ -279,11 +588,25 @@ errno_t bd_conn(cap_call_handle_t icall_handle, ipc_call_t *icall, bd_srvs_t *sr
 		case BD_GET_NUM_BLOCKS:
 			bd_get_num_blocks_srv(srv, chandle, &call);
 			break;
+		case BD_GET_PASSTHROUGH:
+			bd_get_passthrough_srv(srv, chandle, &call);
+			break;
+		case BD_WINDOW_CREATE:
+			bd_window_create_srv(srv, chandle, &call);
+			break;
+		case BD_WINDOW_DESTROY:
+			bd_window_destroy_srv(srv, chandle, &call);
+			break;
+		case BD_WINDOW_ATTACH:
+			bd_window_attach_srv(srv, chandle, &call);
+			break;
 		default:
 			async_answer_0(chandle, EINVAL);
 		}
 	}
 
+	bd_srv_windows_cleanup(srv);
+
 	rc = srvs->ops->close(srv);
 	free(srv);
 
@@ -37,10 +37,11 @@
  * @brief	Userspace ELF module loader.
  *
  * This module allows loading ELF binaries (both executables and
- * shared objects) from VFS. The current implementation allocates
- * anonymous memory, fills it with segment data and then adjusts
- * the memory areas' flags to the final value. In the future,
- * the segments will be mapped directly from the file.
+ * shared objects) from VFS. Read-only segments are mapped directly
+ * from the file via the VFS pager, which shares the pages among all
+ * tasks mapping the same file. For the other segments, the current
+ * implementation allocates anonymous memory, fills it with segment
+ * data and then adjusts the memory areas' flags to the final value.
  */
 
 #include <errno.h>
@@ -58,6 +59,14 @@
 #include <str_error.h>
 #include <stdlib.h>
 #include <macros.h>
+#include <async.h>
+#include <ns.h>
+#include <ipc/services.h>
+#include <ipc/vfs.h>
+
+#ifdef CONFIG_RTLD
+#include <rtld/elf_dyn.h>
+#endif
 
 #include <elf/elf_load.h>
 
@@ -73,9 +82,14 @@ static const char *error_codes[] = {
 	"file io error"
 };
 
+/** Session to the VFS pager used to map read-only segments */
+static async_sess_t *pager_sess = NULL;
+
 static unsigned int elf_load_module(elf_ld_t *elf);
+static int elf_read(elf_ld_t *elf, aoff64_t pos, void *buf, size_t size);
 static int segment_header(elf_ld_t *elf, elf_segment_header_t *entry);
 static int load_segment(elf_ld_t *elf, elf_segment_header_t *entry);
+static int check_text_rel(elf_ld_t *elf, elf_segment_header_t *entry);
 
 /** Load ELF binary from a file.
  *
@@ -105,13 +119,29 @@ int elf_load_file(int file, eld_flags_t flags, elf_finfo_t *info)
 		return EE_IO;
 	}
 
+	vfs_stat_t st;
+	rc = vfs_stat(ofile, &st);
+	if (rc != EOK) {
+		vfs_put(ofile);
+		return EE_IO;
+	}
+
 	elf.fd = ofile;
+	elf.size = st.size;
 	elf.info = info;
 	elf.flags = flags;
+	elf.text_rel = false;
+	elf.mapped = false;
 
 	int ret = elf_load_module(&elf);
 
-	vfs_put(ofile);
+	/*
+	 * The VFS pager refers to the file by the file handle, so it needs
+	 * to stay open for as long as the segments are mapped.
+	 */
+	if ((ret != EE_OK) || (!elf.mapped))
+		vfs_put(ofile);
+
 	return ret;
 }
 
@@ -141,16 +171,11 @@ static unsigned int elf_load_module(elf_ld_t *elf)
 {
 	elf_header_t header_buf;
 	elf_header_t *header = &header_buf;
-	aoff64_t pos = 0;
-	size_t nr;
 	int i, ret;
-	errno_t rc;
 
-	rc = vfs_read(elf->fd, &pos, header, sizeof(elf_header_t), &nr);
-	if (rc != EOK || nr != sizeof(elf_header_t)) {
-		DPRINTF("Read error.\n");
-		return EE_IO;
-	}
+	ret = elf_read(elf, 0, header, sizeof(elf_header_t));
+	if (ret != EE_OK)
+		return ret;
 
 	/* Identify ELF */
 	if (header->e_ident[EI_MAG0] != ELFMAG0 ||
@@ -201,12 +226,9 @@ static unsigned int elf_load_module(elf_ld_t *elf)
 		return EE_UNSUPPORTED;
 	}
 
-	pos = header->e_phoff;
-	rc = vfs_read(elf->fd, &pos, phdr, phdr_len, &nr);
-	if (rc != EOK || nr != phdr_len) {
-		DPRINTF("Read error.\n");
-		return EE_IO;
-	}
+	ret = elf_read(elf, header->e_phoff, phdr, phdr_len);
+	if (ret != EE_OK)
+		return ret;
 
 	uintptr_t module_base = UINTPTR_MAX;
 	uintptr_t module_top = 0;
@@ -229,6 +251,16 @@ static unsigned int elf_load_module(elf_ld_t *elf)
 		return EE_INVALID;
 	}
 
+	/* Read-only segments cannot be shared if they are relocated. */
+	for (i = 0; i < header->e_phnum; i++) {
+		if (phdr[i].p_type != PT_DYNAMIC)
+			continue;
+
+		ret = check_text_rel(elf, &phdr[i]);
+		if (ret != EE_OK)
+			return ret;
+	}
+
 	/* Shared objects can be loaded with a bias */
 	if (header->e_type != ET_DYN) {
 		elf->bias = 0;
@@ -380,6 +412,205 @@ static int segment_header(elf_ld_t *elf, elf_segment_header_t *entry)
 	return EE_OK;
 }
 
+/** Connect to the VFS pager.
+ *
+ * @return @c true if the VFS pager is available.
+ */
+static bool pager_connect(void)
+{
+	if (pager_sess == NULL)
+		pager_sess = service_connect(SERVICE_VFS, INTERFACE_PAGER, 0);
+
+	return (pager_sess != NULL);
+}
+
+/** Read data from the ELF file through the cache of the VFS pager.
+ *
+ * The pager keeps the pages in its cache, so loading a file again (e.g.
+ * spawning the same program or loading the same library into another
+ * task) is served from memory, without involving the file system server.
+ *
+ * @param elf	Loader state.
+ * @param pos	Position in the file.
+ * @param buf	Buffer to read the data into.
+ * @param size	Number of bytes to read, at most DATA_XFER_LIMIT.
+ *
+ * @return EOK on success or an error code.
+ */
+static errno_t pager_read(elf_ld_t *elf, aoff64_t pos, void *buf, size_t size)
+{
+	ipc_call_t answer;
+	errno_t rc;
+
+	async_exch_t *exch = async_exchange_begin(pager_sess);
+	aid_t req = async_send_3(exch, VFS_PAGER_READ, elf->fd, LOWER32(pos),
+	    UPPER32(pos), &answer);
+	rc = async_data_read_start(exch, buf, size);
+	async_exchange_end(exch);
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+
+	return (rc != EOK) ? rc : retval;
+}
+
+/** Read data from the ELF file.
+ *
+ * If possible, the data is read through the cache of the VFS pager,
+ * otherwise directly from the file system.
+ *
+ * @param elf	Loader state.
+ * @param pos	Position in the file.
+ * @param buf	Buffer to read the data into.
+ * @param size	Number of bytes to read.
+ *
+ * @return EE_OK on success, error code otherwise.
+ */
+static int elf_read(elf_ld_t *elf, aoff64_t pos, void *buf, size_t size)
+{
+	if (size == 0)
+		return EE_OK;
+
+	if (pos > elf->size || size > elf->size - pos) {
+		DPRINTF("Read beyond the end of file.\n");
+		return EE_INVALID;
+	}
+
+	if (pager_connect()) {
+		while (size > 0) {
+			size_t len = min(size, DATA_XFER_LIMIT);
+
+			if (pager_read(elf, pos, buf, len) != EOK) {
+				DPRINTF("Read error.\n");
+				return EE_IO;
+			}
+
+			pos += len;
+			buf = (uint8_t *) buf + len;
+			size -= len;
+		}
+
+		return EE_OK;
+	}
+
+	size_t nr;
+	errno_t rc = vfs_read(elf->fd, &pos, buf, size, &nr);
+	if (rc != EOK || nr != size) {
+		DPRINTF("Read error.\n");
+		return EE_IO;
+	}
+
+	return EE_OK;
+}
+
+/** Check the dynamic section for relocations of read-only segments.
+ *
+ * The dynamic section is read directly from the file, as it is needed
+ * before the segments are loaded. Without the dynamic linker, there is
+ * nobody to process the relocations.
+ *
+ * @param elf	Loader state.
+ * @param entry Program header entry describing the dynamic section.
+ *
+ * @return EE_OK on success, error code otherwise.
+ */
+static int check_text_rel(elf_ld_t *elf, elf_segment_header_t *entry)
+{
+#ifdef CONFIG_RTLD
+	if (entry->p_filesz == 0)
+		return EE_OK;
+
+	elf_dyn_t *dyn = malloc(entry->p_filesz);
+	if (dyn == NULL)
+		return EE_MEMORY;
+
+	int ret = elf_read(elf, entry->p_offset, dyn, entry->p_filesz);
+	if (ret != EE_OK) {
+		free(dyn);
+		return ret;
+	}
+
+	size_t count = entry->p_filesz / sizeof(elf_dyn_t);
+	for (size_t i = 0; i < count && dyn[i].d_tag != DT_NULL; i++) {
+		if ((dyn[i].d_tag == DT_TEXTREL) ||
+		    ((dyn[i].d_tag == DT_FLAGS) &&
+		    ((dyn[i].d_un.d_val & DF_TEXTREL) != 0)))
+			elf->text_rel = true;
+	}
+
+	free(dyn);
+#endif
+	return EE_OK;
+}
+
+/** Map a read-only segment from the file via the VFS pager.
+ *
+ * @param elf	 Loader state.
+ * @param entry  Program header entry describing segment to be mapped.
+ * @param flags  Final flags of the memory area.
+ *
+ * @return EE_OK on success, EE_UNSUPPORTED if the segment cannot be
+ *         mapped and needs to be loaded, other error code otherwise.
+ */
+static int map_segment(elf_ld_t *elf, elf_segment_header_t *entry,
+    unsigned int flags)
+{
+	uintptr_t base;
+	size_t mem_sz;
+	aoff64_t offset;
+	void *a;
+
+	/*
+	 * Only segments which are never written to can share the pages
+	 * with other tasks. The file must contain the whole segment and
+	 * the segment must be page-aligned in the file as well as in
+	 * the memory.
+	 */
+	if ((flags & AS_AREA_WRITE) != 0 || elf->text_rel)
+		return EE_UNSUPPORTED;
+
+	if (entry->p_filesz != entry->p_memsz)
+		return EE_UNSUPPORTED;
+
+	if ((entry->p_offset % PAGE_SIZE) != (entry->p_vaddr % PAGE_SIZE))
+		return EE_UNSUPPORTED;
+
+	if (!pager_connect())
+		return EE_UNSUPPORTED;
+
+	base = ALIGN_DOWN(entry->p_vaddr, PAGE_SIZE);
+	mem_sz = entry->p_memsz + (entry->p_vaddr - base);
+	offset = entry->p_offset - (entry->p_vaddr - base);
+
+	a = async_as_area_create((uint8_t *) base + elf->bias, mem_sz, flags,
+	    pager_sess, elf->fd, offset, 0);
+	if (a == AS_MAP_FAILED) {
+		DPRINTF("paged memory mapping failed (%p, %zu)\n",
+		    (void *) (base + elf->bias), mem_sz);
+		return EE_UNSUPPORTED;
+	}
+
+	DPRINTF("async_as_area_create(%p, %#zx, %d) -> %p\n",
+	    (void *) (base + elf->bias), mem_sz, flags, (void *) a);
+
+	elf->mapped = true;
+
+	/*
+	 * The pages are faulted in on demand. A task only pays for the
+	 * pages it touches and a page which is already in the cache of
+	 * the pager costs just the page-in request.
+	 */
+
+	if (flags & AS_AREA_EXEC) {
+		/* Enforce SMC coherence for the segment */
+		if (smc_coherence((void *) (entry->p_vaddr + elf->bias),
+		    entry->p_filesz))
+			return EE_MEMORY;
+	}
+
+	return EE_OK;
+}
+
 /** Load segment described by program header entry.
  *
  * @param elf	Loader state.
@@ -396,9 +627,8 @@ int load_segment(elf_ld_t *elf, elf_segment_header_t *entry)
 	void *seg_ptr;
 	uintptr_t seg_addr;
 	size_t mem_sz;
-	aoff64_t pos;
 	errno_t rc;
-	size_t nr;
+	int ret;
 
 	bias = elf->bias;
 
@@ -429,6 +659,10 @@ int load_segment(elf_ld_t *elf, elf_segment_header_t *entry)
 		flags |= AS_AREA_READ;
 	flags |= AS_AREA_CACHEABLE;
 
+	ret = map_segment(elf, entry, flags);
+	if (ret != EE_UNSUPPORTED)
+		return ret;
+
 	base = ALIGN_DOWN(entry->p_vaddr, PAGE_SIZE);
 	mem_sz = entry->p_memsz + (entry->p_vaddr - base);
 
@@ -455,12 +689,9 @@ int load_segment(elf_ld_t *elf, elf_segment_header_t *entry)
 	/*
 	 * Load segment data
 	 */
-	pos = entry->p_offset;
-	rc = vfs_read(elf->fd, &pos, seg_ptr, entry->p_filesz, &nr);
-	if (rc != EOK || nr != entry->p_filesz) {
-		DPRINTF("read error\n");
-		return EE_IO;
-	}
+	ret = elf_read(elf, entry->p_offset, seg_ptr, entry->p_filesz);
+	if (ret != EE_OK)
+		return ret;
 
 	/*
 	 * The caller wants to modify the segments first. He will then
@@ -178,6 +178,7 @@ errno_t inet_get_srcaddr(inet_addr_t *remote, uint8_t tos, inet_addr_t *local)
 static void inet_ev_recv(cap_call_handle_t icall_handle, ipc_call_t *icall)
 {
 	inet_dgram_t dgram;
+	inet_ev_recv_hdr_t hdr;
 
 	dgram.tos = IPC_GET_ARG1(*icall);
 	dgram.iplink = IPC_GET_ARG2(*icall);
@@ -190,37 +191,21 @@ static void inet_ev_recv(cap_call_handle_t icall_handle, ipc_call_t *icall)
 		return;
 	}
 
-	if (size != sizeof(inet_addr_t)) {
+	if (size != sizeof(inet_ev_recv_hdr_t)) {
 		async_answer_0(chandle, EINVAL);
 		async_answer_0(icall_handle, EINVAL);
 		return;
 	}
 
-	errno_t rc = async_data_write_finalize(chandle, &dgram.src, size);
+	errno_t rc = async_data_write_finalize(chandle, &hdr, size);
 	if (rc != EOK) {
 		async_answer_0(chandle, rc);
 		async_answer_0(icall_handle, rc);
 		return;
 	}
 
-	if (!async_data_write_receive(&chandle, &size)) {
-		async_answer_0(chandle, EINVAL);
-		async_answer_0(icall_handle, EINVAL);
-		return;
-	}
-
-	if (size != sizeof(inet_addr_t)) {
-		async_answer_0(chandle, EINVAL);
-		async_answer_0(icall_handle, EINVAL);
-		return;
-	}
-
-	rc = async_data_write_finalize(chandle, &dgram.dest, size);
-	if (rc != EOK) {
-		async_answer_0(chandle, rc);
-		async_answer_0(icall_handle, rc);
-		return;
-	}
+	dgram.src = hdr.src;
+	dgram.dest = hdr.dest;
 
 	rc = async_data_write_accept(&dgram.data, false, 0, 0, 0, &dgram.size);
 	if (rc != EOK) {
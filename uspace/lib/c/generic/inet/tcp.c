@@ -38,7 +38,9 @@
 #include <inet/tcp.h>
 #include <ipc/services.h>
 #include <ipc/tcp.h>
+#include <macros.h>
 #include <stdlib.h>
+#include <vfs/vfs.h>
 
 static void tcp_cb_conn(cap_call_handle_t, ipc_call_t *, void *);
 static errno_t tcp_conn_fibril(void *);
@@ -472,6 +474,45 @@ errno_t tcp_conn_send(tcp_conn_t *conn, const void *data, size_t bytes)
 	return rc;
 }
 
+/** Send file contents over TCP connection.
+ *
+ * Send up to @a bytes bytes of the file @a file starting at offset @a pos.
+ * Less data is sent if the end of file is reached. Instead of reading the
+ * file and copying the data to the TCP service, the file handle is passed to
+ * the TCP service which maps the file contents directly via the VFS pager.
+ *
+ * @param conn  Connection
+ * @param file  File handle
+ * @param pos   Position in file where to start sending
+ * @param bytes Number of bytes to send
+ *
+ * @return EOK on success or an error code
+ */
+errno_t tcp_conn_sendfile(tcp_conn_t *conn, int file, aoff64_t pos,
+    size_t bytes)
+{
+	async_exch_t *exch;
+	errno_t rc;
+
+	exch = async_exchange_begin(conn->tcp->sess);
+	aid_t req = async_send_4(exch, TCP_CONN_SENDFILE, conn->id,
+	    LOWER32(pos), UPPER32(pos), bytes, NULL);
+
+	async_exch_t *vfs_exch = vfs_exchange_begin();
+	rc = vfs_pass_handle(vfs_exch, file, exch);
+	vfs_exchange_end(vfs_exch);
+
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	async_wait_for(req, &rc);
+	return rc;
+}
+
 /** Send FIN.
  *
  * Send FIN, indicating no more data will be send over the connection.
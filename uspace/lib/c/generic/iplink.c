@@ -34,6 +34,7 @@
  * @brief IP link client stub
  */
 
+#include <align.h>
 #include <async.h>
 #include <assert.h>
 #include <errno.h>
@@ -263,6 +264,54 @@ static void iplink_ev_recv(iplink_t *iplink, cap_call_handle_t icall_handle,
 	async_answer_0(icall_handle, rc);
 }
 
+static void iplink_ev_recv_batch(iplink_t *iplink, cap_call_handle_t icall_handle,
+    ipc_call_t *icall)
+{
+	iplink_ev_recv_hdr_t *hdr;
+	iplink_recv_sdu_t sdu;
+	void *data;
+	size_t size;
+	size_t rsize;
+	size_t off;
+
+	size_t count = IPC_GET_ARG1(*icall);
+
+	errno_t rc = async_data_write_accept(&data, false, 0, 0, 0, &size);
+	if (rc != EOK) {
+		async_answer_0(icall_handle, rc);
+		return;
+	}
+
+	off = 0;
+	while (count > 0) {
+		if (size - off < sizeof(iplink_ev_recv_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		hdr = (iplink_ev_recv_hdr_t *) ((uint8_t *) data + off);
+		if (hdr->size > size - off - sizeof(iplink_ev_recv_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		sdu.data = hdr + 1;
+		sdu.size = hdr->size;
+		(void) iplink->ev_ops->recv(iplink, &sdu, (ip_ver_t) hdr->ver);
+
+		rsize = sizeof(iplink_ev_recv_hdr_t) +
+		    ALIGN_UP(hdr->size, sizeof(iplink_ev_recv_hdr_t));
+		if (rsize > size - off)
+			rsize = size - off;
+
+		off += rsize;
+		--count;
+	}
+
+	free(data);
+	async_answer_0(icall_handle, rc);
+}
+
 static void iplink_ev_change_addr(iplink_t *iplink, cap_call_handle_t icall_handle,
     ipc_call_t *icall)
 {
@@ -301,6 +350,9 @@ static void iplink_cb_conn(cap_call_handle_t icall_handle, ipc_call_t *icall, vo
 		case IPLINK_EV_CHANGE_ADDR:
 			iplink_ev_change_addr(iplink, chandle, &call);
 			break;
+		case IPLINK_EV_RECV_BATCH:
+			iplink_ev_recv_batch(iplink, chandle, &call);
+			break;
 		default:
 			async_answer_0(chandle, ENOTSUP);
 		}
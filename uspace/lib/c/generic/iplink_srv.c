@@ -34,8 +34,10 @@
  * @brief IP link server stub
  */
 
+#include <align.h>
 #include <errno.h>
 #include <ipc/iplink.h>
+#include <mem.h>
 #include <stdlib.h>
 #include <stddef.h>
 #include <inet/addr.h>
@@ -328,6 +330,119 @@ errno_t iplink_ev_recv(iplink_srv_t *srv, iplink_recv_sdu_t *sdu, ip_ver_t ver)
 	return EOK;
 }
 
+/** Initialize batch of received datagrams.
+ *
+ * @param batch Batch
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t iplink_recv_batch_init(iplink_recv_batch_t *batch)
+{
+	batch->buf = malloc(DATA_XFER_LIMIT);
+	if (batch->buf == NULL)
+		return ENOMEM;
+
+	batch->size = 0;
+	batch->count = 0;
+	return EOK;
+}
+
+/** Finalize batch of received datagrams.
+ *
+ * @param batch Batch, must have been flushed
+ */
+void iplink_recv_batch_fini(iplink_recv_batch_t *batch)
+{
+	free(batch->buf);
+	batch->buf = NULL;
+}
+
+/** Add received datagram to a batch.
+ *
+ * The batch is delivered to the client when it fills up. The caller
+ * must call iplink_ev_recv_batch_flush() to deliver the rest.
+ *
+ * @param srv   IP link server
+ * @param batch Batch
+ * @param sdu   Received datagram, copied to the batch
+ * @param ver   IP version
+ *
+ * @return EOK on success or an error code
+ */
+errno_t iplink_ev_recv_batch_add(iplink_srv_t *srv, iplink_recv_batch_t *batch,
+    iplink_recv_sdu_t *sdu, ip_ver_t ver)
+{
+	iplink_ev_recv_hdr_t *hdr;
+	size_t rsize;
+	errno_t rc;
+
+	rsize = sizeof(iplink_ev_recv_hdr_t) +
+	    ALIGN_UP(sdu->size, sizeof(iplink_ev_recv_hdr_t));
+
+	/* Does not fit in any batch */
+	if (rsize > DATA_XFER_LIMIT) {
+		rc = iplink_ev_recv_batch_flush(srv, batch);
+		if (rc != EOK)
+			return rc;
+
+		return iplink_ev_recv(srv, sdu, ver);
+	}
+
+	if (batch->size + rsize > DATA_XFER_LIMIT) {
+		rc = iplink_ev_recv_batch_flush(srv, batch);
+		if (rc != EOK)
+			return rc;
+	}
+
+	hdr = (iplink_ev_recv_hdr_t *) ((uint8_t *) batch->buf + batch->size);
+	hdr->size = sdu->size;
+	hdr->ver = ver;
+	memcpy(hdr + 1, sdu->data, sdu->size);
+
+	batch->size += rsize;
+	batch->count++;
+	return EOK;
+}
+
+/** Deliver batch of received datagrams to the client.
+ *
+ * @param srv   IP link server
+ * @param batch Batch, empty on return
+ *
+ * @return EOK on success or an error code
+ */
+errno_t iplink_ev_recv_batch_flush(iplink_srv_t *srv,
+    iplink_recv_batch_t *batch)
+{
+	if (batch->count == 0)
+		return EOK;
+
+	size_t size = batch->size;
+	size_t count = batch->count;
+
+	batch->size = 0;
+	batch->count = 0;
+
+	if (srv->client_sess == NULL)
+		return EIO;
+
+	async_exch_t *exch = async_exchange_begin(srv->client_sess);
+
+	ipc_call_t answer;
+	aid_t req = async_send_1(exch, IPLINK_EV_RECV_BATCH, count, &answer);
+
+	errno_t rc = async_data_write_start(exch, batch->buf, size);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		return rc;
+	}
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+	return retval;
+}
+
 errno_t iplink_ev_change_addr(iplink_srv_t *srv, addr48_t *addr)
 {
 	if (srv->client_sess == NULL)
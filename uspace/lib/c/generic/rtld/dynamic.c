@@ -37,6 +37,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <str.h>
+#include <macros.h>
 
 #include <rtld/elf_dyn.h>
 #include <rtld/dynamic.h>
@@ -77,6 +78,9 @@ void dynamic_parse(elf_dyn_t *dyn_ptr, size_t bias, dyn_info_t *info)
 		case DT_HASH:
 			info->hash = d_ptr;
 			break;
+		case DT_GNU_HASH:
+			info->gnu_hash = d_ptr;
+			break;
 		case DT_STRTAB:
 			info->str_tab = d_ptr;
 			break;
@@ -134,6 +138,12 @@ void dynamic_parse(elf_dyn_t *dyn_ptr, size_t bias, dyn_info_t *info)
 		case DT_BIND_NOW:
 			info->bind_now = true;
 			break;
+		case DT_FLAGS:
+			if ((d_val & DF_TEXTREL) != 0)
+				info->text_rel = true;
+			if ((d_val & DF_BIND_NOW) != 0)
+				info->bind_now = true;
+			break;
 
 		default:
 			if (dp->d_tag >= DT_LOPROC && dp->d_tag <= DT_HIPROC)
@@ -150,6 +160,8 @@ void dynamic_parse(elf_dyn_t *dyn_ptr, size_t bias, dyn_info_t *info)
 	/* This will be useful for parsing dependencies later */
 	info->dynamic = dyn_ptr;
 
+	info->sym_count = dynamic_sym_count(info);
+
 	DPRINTF("str_tab=0x%" PRIxPTR ", soname_idx=0x%x, soname=0x%" PRIxPTR "\n",
 	    (uintptr_t)info->soname, soname_idx, (uintptr_t)info->soname);
 	DPRINTF("soname='%s'\n", info->soname);
@@ -185,5 +197,45 @@ void dynamic_parse(elf_dyn_t *dyn_ptr, size_t bias, dyn_info_t *info)
 	}
 }
 
+/** Determine the number of entries in the symbol table.
+ *
+ * The symbol table does not record its size. The SysV hash table contains
+ * a chain entry for every symbol. With just the GNU hash table, the size
+ * is given by the end of the chain of the last non-empty bucket.
+ *
+ * @param info Dynamic info with the hash tables.
+ * @return Number of entries in the symbol table
+ */
+size_t dynamic_sym_count(dyn_info_t *info)
+{
+	if (info->hash != NULL)
+		return info->hash[1];
+
+	if (info->gnu_hash == NULL)
+		return 0;
+
+	elf_word nbucket = info->gnu_hash[0];
+	elf_word symoffset = info->gnu_hash[1];
+	elf_word bloom_size = info->gnu_hash[2];
+
+	const elf_word *buckets =
+	    (const elf_word *) ((const uintptr_t *) &info->gnu_hash[4] +
+	    bloom_size);
+	const elf_word *chain = &buckets[nbucket];
+
+	elf_word last = 0;
+	for (elf_word i = 0; i < nbucket; i++)
+		last = max(last, buckets[i]);
+
+	if (last < symoffset)
+		return symoffset;
+
+	/* The last entry of a chain has the lowest bit set. */
+	while ((chain[last - symoffset] & 1) == 0)
+		last++;
+
+	return last + 1;
+}
+
 /** @}
  */
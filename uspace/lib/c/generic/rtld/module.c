@@ -94,9 +94,16 @@ errno_t module_create_static_exec(rtld_t *rtld, module_t **rmodule)
 	return EOK;
 }
 
-/** (Eagerly) process all relocation tables in a module.
+/** Process all relocation tables in a module.
  *
- * Currently works as if LD_BIND_NOW was specified.
+ * The PLT relocations are bound lazily, on the first call through the PLT
+ * entry, unless the module requests immediate binding (DT_BIND_NOW) or
+ * the architecture does not support lazy binding.
+ *
+ * The initial modules of a program are relocated by the program loader.
+ * The binding would then go through the loader's trampoline and runtime
+ * environment, so they are always bound immediately. Lazy binding is used
+ * only for modules loaded into the running environment (i.e. by dlopen()).
  */
 void module_process_relocs(module_t *m)
 {
@@ -106,10 +113,20 @@ void module_process_relocs(module_t *m)
 	if (m->relocated)
 		return;
 
+	/*
+	 * Without the symbol cache, the symbols are just searched for
+	 * repeatedly, so its allocation failure is not fatal.
+	 */
+	if (m->dyn.sym_count > 0 && m->sym_cache == NULL)
+		m->sym_cache = calloc(m->dyn.sym_count, sizeof(symbol_cache_t));
+
 	module_process_pre_arch(m);
 
 	/* jmp_rel table */
-	if (m->dyn.jmp_rel != NULL) {
+	if (m->dyn.jmp_rel != NULL && !m->dyn.bind_now &&
+	    m->rtld == runtime_env && module_process_lazy_arch(m)) {
+		DPRINTF("jmp_rel table bound lazily\n");
+	} else if (m->dyn.jmp_rel != NULL) {
 		DPRINTF("jmp_rel table\n");
 		if (m->dyn.plt_rel == DT_REL) {
 			DPRINTF("jmp_rel table type DT_REL\n");
@@ -37,6 +37,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <str.h>
+#include <libarch/barrier.h>
 
 #include <elf/elf.h>
 #include <rtld/module.h>
@@ -44,6 +45,26 @@
 #include <rtld/rtld_debug.h>
 #include <rtld/symbol.h>
 
+/** Name of a symbol being searched for, with its hashes.
+ *
+ * The hashes are computed at most once per search, and only if a module
+ * using the respective hash table is searched.
+ */
+typedef struct {
+	const char *name;
+	elf_word hash;
+	elf_word gnu_hash;
+	bool hash_valid;
+	bool gnu_hash_valid;
+} symbol_key_t;
+
+static void symbol_key_init(symbol_key_t *key, const char *name)
+{
+	key->name = name;
+	key->hash_valid = false;
+	key->gnu_hash_valid = false;
+}
+
 /*
  * Hash tables are 32-bit (elf_word) even for 64-bit ELF files.
  */
@@ -62,38 +83,124 @@ static elf_word elf_hash(const unsigned char *name)
 	return h;
 }
 
-static elf_symbol_t *def_find_in_module(const char *name, module_t *m)
+static elf_word elf_gnu_hash(const unsigned char *name)
+{
+	elf_word h = 5381;
+
+	while (*name)
+		h = (h << 5) + h + *name++;
+
+	return h;
+}
+
+/** Look up a symbol using the SysV hash table. */
+static elf_symbol_t *hash_find(symbol_key_t *key, module_t *m)
 {
 	elf_symbol_t *sym_table;
-	elf_symbol_t *s, *sym;
+	elf_symbol_t *s;
 	elf_word nbucket;
-	/*elf_word nchain;*/
+	elf_word nchain;
 	elf_word i;
 	char *s_name;
 	elf_word bucket;
 
-	DPRINTF("def_find_in_module('%s', %s)\n", name, m->dyn.soname);
+	if (!key->hash_valid) {
+		key->hash = elf_hash((const unsigned char *) key->name);
+		key->hash_valid = true;
+	}
 
 	sym_table = m->dyn.sym_tab;
 	nbucket = m->dyn.hash[0];
-	/*nchain = m->dyn.hash[1]; XXX Use to check HT range*/
+	nchain = m->dyn.hash[1];
 
-	bucket = elf_hash((unsigned char *)name) % nbucket;
+	bucket = key->hash % nbucket;
 	i = m->dyn.hash[2 + bucket];
 
-	sym = NULL;
-	while (i != STN_UNDEF) {
+	while (i != STN_UNDEF && i < nchain) {
 		s = &sym_table[i];
 		s_name = m->dyn.str_tab + s->st_name;
 
-		if (str_cmp(name, s_name) == 0) {
-			sym = s;
-			break;
-		}
+		if (str_cmp(key->name, s_name) == 0)
+			return s;
 
 		i = m->dyn.hash[2 + nbucket + i];
 	}
 
+	return NULL;
+}
+
+/** Look up a symbol using the GNU hash table.
+ *
+ * The Bloom filter rejects most of the symbols not defined in the module
+ * without touching the buckets, chains or strings. The chain entries hold
+ * the hashes of the symbols, so the names are only compared for symbols
+ * whose hash matches.
+ */
+static elf_symbol_t *gnu_hash_find(symbol_key_t *key, module_t *m)
+{
+	const elf_word *gnu_hash = m->dyn.gnu_hash;
+	elf_symbol_t *sym_table = m->dyn.sym_tab;
+
+	if (!key->gnu_hash_valid) {
+		key->gnu_hash = elf_gnu_hash((const unsigned char *) key->name);
+		key->gnu_hash_valid = true;
+	}
+
+	elf_word h = key->gnu_hash;
+	elf_word nbucket = gnu_hash[0];
+	elf_word symoffset = gnu_hash[1];
+	elf_word bloom_size = gnu_hash[2];
+	elf_word bloom_shift = gnu_hash[3];
+
+	/* Bloom filter words have the size of an address. */
+	const uintptr_t *bloom = (const uintptr_t *) &gnu_hash[4];
+	const elf_word *buckets = (const elf_word *) &bloom[bloom_size];
+	const elf_word *chain = &buckets[nbucket];
+	const unsigned int bits = sizeof(uintptr_t) * 8;
+
+	uintptr_t word = bloom[(h / bits) % bloom_size];
+	uintptr_t mask = ((uintptr_t) 1 << (h % bits)) |
+	    ((uintptr_t) 1 << ((h >> bloom_shift) % bits));
+
+	if ((word & mask) != mask)
+		return NULL;
+
+	elf_word i = buckets[h % nbucket];
+	if (i < symoffset)
+		return NULL;
+
+	while (true) {
+		elf_word ch = chain[i - symoffset];
+
+		if (((ch ^ h) >> 1) == 0) {
+			elf_symbol_t *s = &sym_table[i];
+			if (str_cmp(key->name, m->dyn.str_tab + s->st_name) == 0)
+				return s;
+		}
+
+		/* The last entry of a chain has the lowest bit set. */
+		if ((ch & 1) != 0)
+			break;
+
+		i++;
+	}
+
+	return NULL;
+}
+
+static elf_symbol_t *def_find_in_module(symbol_key_t *key, module_t *m)
+{
+	elf_symbol_t *sym;
+
+	DPRINTF("def_find_in_module('%s', %s)\n", key->name, m->dyn.soname);
+
+	if (m->dyn.gnu_hash != NULL)
+		sym = gnu_hash_find(key, m);
+	else if (m->dyn.hash != NULL)
+		sym = hash_find(key, m);
+	else
+		sym = NULL;
+
 	if (!sym)
 		return NULL;	/* Not found */
 
@@ -123,6 +230,9 @@ elf_symbol_t *symbol_bfs_find(const char *name, module_t *start,
 	elf_symbol_t *sym, *s;
 	list_t queue;
 	size_t i;
+	symbol_key_t key;
+
+	symbol_key_init(&key, name);
 
 	/*
 	 * Do a BFS using the queue_link and bfs_tag fields.
@@ -149,7 +259,7 @@ elf_symbol_t *symbol_bfs_find(const char *name, module_t *start,
 		list_remove(&m->queue_link);
 
 		/* If ssf_noroot is specified, do not look in start module */
-		s = def_find_in_module(name, m);
+		s = def_find_in_module(&key, m);
 		if (s != NULL) {
 			/* Symbol found */
 			sym = s;
@@ -200,6 +310,9 @@ elf_symbol_t *symbol_def_find(const char *name, module_t *origin,
     symbol_search_flags_t flags, module_t **mod)
 {
 	elf_symbol_t *s;
+	symbol_key_t key;
+
+	symbol_key_init(&key, name);
 
 	DPRINTF("symbol_def_find('%s', origin='%s'\n",
 	    name, origin->dyn.soname);
@@ -209,7 +322,7 @@ elf_symbol_t *symbol_def_find(const char *name, module_t *origin,
 		 * Origin module has a DT_SYMBOLIC flag.
 		 * Try this module first
 		 */
-		s = def_find_in_module(name, origin);
+		s = def_find_in_module(&key, origin);
 		if (s != NULL) {
 			/* Found */
 			*mod = origin;
@@ -223,7 +336,7 @@ elf_symbol_t *symbol_def_find(const char *name, module_t *origin,
 		DPRINTF("module '%s' local?\n", m->dyn.soname);
 		if (!m->local && (!m->exec || (flags & ssf_noexec) == 0)) {
 			DPRINTF("!local->find '%s' in module '%s'\n", name, m->dyn.soname);
-			s = def_find_in_module(name, m);
+			s = def_find_in_module(&key, m);
 			if (s != NULL) {
 				/* Found */
 				*mod = m;
@@ -238,7 +351,7 @@ elf_symbol_t *symbol_def_find(const char *name, module_t *origin,
 	    origin->dyn.soname);
 
 	if (!origin->exec || (flags & ssf_noexec) == 0) {
-		s = def_find_in_module(name, origin);
+		s = def_find_in_module(&key, origin);
 		if (s != NULL) {
 			/* Found */
 			*mod = origin;
@@ -250,6 +363,44 @@ elf_symbol_t *symbol_def_find(const char *name, module_t *origin,
 	return NULL;
 }
 
+/** Find the definition of a symbol referenced by a module.
+ *
+ * Same as symbol_def_find() with @c ssf_none, but the symbol is given
+ * by its index in the symbol table of @a origin and the result is kept
+ * in the symbol cache of @a origin, so that it is searched for only once.
+ *
+ * @param sym_idx	Index of the symbol in the symbol table of @a origin.
+ * @param origin	Module in which the dependency originates.
+ * @param mod		(output) Will be filled with a pointer to the module
+ *			that contains the symbol.
+ */
+elf_symbol_t *symbol_def_find_idx(elf_word sym_idx, module_t *origin,
+    module_t **mod)
+{
+	elf_symbol_t *sym_table = origin->dyn.sym_tab;
+	const char *name = origin->dyn.str_tab + sym_table[sym_idx].st_name;
+
+	if (origin->sym_cache == NULL || sym_idx >= origin->dyn.sym_count)
+		return symbol_def_find(name, origin, ssf_none, mod);
+
+	symbol_cache_t *entry = &origin->sym_cache[sym_idx];
+	if (entry->sym == NULL) {
+		module_t *dest;
+		elf_symbol_t *sym = symbol_def_find(name, origin, ssf_none,
+		    &dest);
+		if (sym == NULL)
+			return NULL;
+
+		/* Lazy binding can race here, publish the module first. */
+		entry->mod = dest;
+		write_barrier();
+		entry->sym = sym;
+	}
+
+	*mod = entry->mod;
+	return entry->sym;
+}
+
 /** Get symbol address.
  *
  * @param sym Symbol
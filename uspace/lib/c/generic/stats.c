@@ -39,9 +39,13 @@
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <mem.h>
 
 #define SYSINFO_STATS_MAX_PATH  64
 
+/** Number of attempts to get consistent incremental statistics */
+#define STATS_DELTA_ATTEMPTS  4
+
 /** Thread states
  *
  */
@@ -210,6 +214,215 @@ stats_thread_t *stats_get_thread(thread_id_t thread_id)
 	return stats_thread;
 }
 
+/** Get incremental statistics
+ *
+ * @param item        Sysinfo subtree of the incremental statistics.
+ * @param since       Generation returned by the previous query or zero.
+ * @param record_size Size of a statistics record.
+ *
+ * @return Pointer to the stats_delta_t structure followed by the records.
+ *         If non-NULL then it should be eventually freed by free().
+ *
+ */
+static stats_delta_t *stats_get_delta(const char *item, uint64_t since,
+    size_t record_size)
+{
+	char name[SYSINFO_STATS_MAX_PATH];
+	snprintf(name, SYSINFO_STATS_MAX_PATH, "%s.%" PRIu64, item, since);
+
+	/*
+	 * The number of changed objects might grow between getting
+	 * the size and getting the data, in which case the data is
+	 * truncated. Repeating the query with the same generation
+	 * is safe, it just reports the objects again.
+	 */
+	for (unsigned int i = 0; i < STATS_DELTA_ATTEMPTS; i++) {
+		size_t size = 0;
+		stats_delta_t *delta =
+		    (stats_delta_t *) sysinfo_get_data(name, &size);
+
+		if ((size >= sizeof(stats_delta_t)) &&
+		    (size == sizeof(stats_delta_t) +
+		    delta->changed * record_size +
+		    delta->removed * sizeof(uint64_t)))
+			return delta;
+
+		if (delta != NULL)
+			free(delta);
+	}
+
+	return NULL;
+}
+
+/** Get ID of a statistics record
+ *
+ * Both stats_task_t and stats_thread_t start with the ID.
+ *
+ */
+static uint64_t stats_record_id(const void *record)
+{
+	uint64_t id;
+	memcpy(&id, record, sizeof(id));
+	return id;
+}
+
+/** Check whether an ID is among the removed IDs of incremental statistics */
+static bool stats_delta_removed(stats_delta_t *delta, const uint64_t *removed,
+    uint64_t id)
+{
+	for (size_t i = 0; i < delta->removed; i++) {
+		if (removed[i] == id)
+			return true;
+	}
+
+	return false;
+}
+
+/** Merge incremental statistics into an array of statistics records
+ *
+ * Both the array and the records in the incremental statistics are
+ * sorted by the ID, the result is sorted by the ID as well.
+ *
+ * @param records     Array of statistics records (might be NULL).
+ * @param count       Number of records in the array, updated to the
+ *                    number of records in the resulting array.
+ * @param delta       Incremental statistics.
+ * @param record_size Size of a statistics record.
+ *
+ * @return Resulting array of statistics records. The original array is
+ *         freed. NULL on memory allocation failure, in which case the
+ *         original array is left intact.
+ *
+ */
+static void *stats_merge(void *records, size_t *count, stats_delta_t *delta,
+    size_t record_size)
+{
+	const uint8_t *changed = (const uint8_t *) (delta + 1);
+	const uint64_t *removed =
+	    (const uint64_t *) (changed + delta->changed * record_size);
+
+	size_t old_count = delta->full ? 0 : *count;
+	size_t size = (old_count + delta->changed) * record_size;
+	uint8_t *merged = malloc(size);
+	if ((merged == NULL) && (size != 0))
+		return NULL;
+
+	const uint8_t *old = (const uint8_t *) records;
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	while ((i < old_count) || (j < delta->changed)) {
+		const uint8_t *record;
+
+		if (j == delta->changed) {
+			record = old + (i++) * record_size;
+		} else if (i == old_count) {
+			record = changed + (j++) * record_size;
+		} else {
+			uint64_t old_id = stats_record_id(old + i * record_size);
+			uint64_t new_id =
+			    stats_record_id(changed + j * record_size);
+
+			if (old_id < new_id) {
+				record = old + (i++) * record_size;
+			} else {
+				/* A changed record replaces the old one */
+				if (old_id == new_id)
+					i++;
+
+				record = changed + (j++) * record_size;
+			}
+		}
+
+		if (stats_delta_removed(delta, removed,
+		    stats_record_id(record)))
+			continue;
+
+		memcpy(merged + (k++) * record_size, record, record_size);
+	}
+
+	if (records != NULL)
+		free(records);
+
+	*count = k;
+	return merged;
+}
+
+/** Get incremental task statistics.
+ *
+ * @param since Generation returned by the previous query (the
+ *              @c generation member of stats_delta_t) or zero to get
+ *              statistics of all tasks.
+ *
+ * @return Pointer to the stats_delta_t structure followed by the
+ *         stats_task_t records of the changed tasks and the IDs of the
+ *         removed tasks. If non-NULL then it should be eventually freed
+ *         by free().
+ *
+ */
+stats_delta_t *stats_get_tasks_delta(uint64_t since)
+{
+	return stats_get_delta("system.tasks_delta", since,
+	    sizeof(stats_task_t));
+}
+
+/** Merge incremental task statistics into an array of task statistics.
+ *
+ * @param tasks Array of task statistics sorted by the task ID (might be
+ *              NULL). It is freed on success.
+ * @param count Number of records in the array, updated to the number
+ *              of records in the resulting array.
+ * @param delta Incremental task statistics.
+ *
+ * @return Resulting array of task statistics sorted by the task ID.
+ *         NULL on memory allocation failure.
+ *
+ */
+stats_task_t *stats_merge_tasks(stats_task_t *tasks, size_t *count,
+    stats_delta_t *delta)
+{
+	return (stats_task_t *) stats_merge(tasks, count, delta,
+	    sizeof(stats_task_t));
+}
+
+/** Get incremental thread statistics.
+ *
+ * @param since Generation returned by the previous query (the
+ *              @c generation member of stats_delta_t) or zero to get
+ *              statistics of all threads.
+ *
+ * @return Pointer to the stats_delta_t structure followed by the
+ *         stats_thread_t records of the changed threads and the IDs of
+ *         the removed threads. If non-NULL then it should be eventually
+ *         freed by free().
+ *
+ */
+stats_delta_t *stats_get_threads_delta(uint64_t since)
+{
+	return stats_get_delta("system.threads_delta", since,
+	    sizeof(stats_thread_t));
+}
+
+/** Merge incremental thread statistics into an array of thread statistics.
+ *
+ * @param threads Array of thread statistics sorted by the thread ID
+ *                (might be NULL). It is freed on success.
+ * @param count   Number of records in the array, updated to the number
+ *                of records in the resulting array.
+ * @param delta   Incremental thread statistics.
+ *
+ * @return Resulting array of thread statistics sorted by the thread ID.
+ *         NULL on memory allocation failure.
+ *
+ */
+stats_thread_t *stats_merge_threads(stats_thread_t *threads, size_t *count,
+    stats_delta_t *delta)
+{
+	return (stats_thread_t *) stats_merge(threads, count, delta,
+	    sizeof(stats_thread_t));
+}
+
 /** Get exception statistics.
  *
  * @param count Number of records returned.
@@ -236,6 +449,35 @@ stats_exc_t *stats_get_exceptions(size_t *count)
 	return stats_exceptions;
 }
 
+/** Get syscall statistics.
+ *
+ * The statistics are only available if the kernel was compiled
+ * with CONFIG_SYSCALL_STATS.
+ *
+ * @param count Number of records returned.
+ *
+ * @return Array of stats_syscall_t structures indexed by syscall number.
+ *         If non-NULL then it should be eventually freed
+ *         by free().
+ *
+ */
+stats_syscall_t *stats_get_syscalls(size_t *count)
+{
+	size_t size = 0;
+	stats_syscall_t *stats_syscalls =
+	    (stats_syscall_t *) sysinfo_get_data("system.syscalls", &size);
+
+	if ((size % sizeof(stats_syscall_t)) != 0) {
+		if (stats_syscalls != NULL)
+			free(stats_syscalls);
+		*count = 0;
+		return NULL;
+	}
+
+	*count = size / sizeof(stats_syscall_t);
+	return stats_syscalls;
+}
+
 /** Get single exception statistics
  *
  * @param excn Exception number we are interested in.
@@ -141,5 +141,17 @@ errno_t udebug_stop(async_sess_t *sess, thash_t tid)
 	return async_req_2_0(exch, IPC_M_DEBUG, UDEBUG_M_STOP, tid);
 }
 
+errno_t udebug_prof_start(async_sess_t *sess)
+{
+	async_exch_t *exch = async_exchange_begin(sess);
+	return async_req_1_0(exch, IPC_M_DEBUG, UDEBUG_M_PROF_START);
+}
+
+errno_t udebug_prof_stop(async_sess_t *sess)
+{
+	async_exch_t *exch = async_exchange_begin(sess);
+	return async_req_1_0(exch, IPC_M_DEBUG, UDEBUG_M_PROF_STOP);
+}
+
 /** @}
  */
@@ -36,6 +36,7 @@
 #define LIBC_BD_H_
 
 #include <async.h>
+#include <ipc/loc.h>
 #include <offset.h>
 
 typedef struct {
@@ -50,6 +51,10 @@ extern errno_t bd_write_blocks(bd_t *, aoff64_t, size_t, const void *, size_t);
 extern errno_t bd_sync_cache(bd_t *, aoff64_t, size_t);
 extern errno_t bd_get_block_size(bd_t *, size_t *);
 extern errno_t bd_get_num_blocks(bd_t *, aoff64_t *);
+extern errno_t bd_get_passthrough(bd_t *, service_id_t *, sysarg_t *);
+extern errno_t bd_window_create(bd_t *, aoff64_t, aoff64_t, sysarg_t *);
+extern errno_t bd_window_destroy(bd_t *, sysarg_t);
+extern errno_t bd_window_attach(bd_t *, sysarg_t);
 
 #endif
 
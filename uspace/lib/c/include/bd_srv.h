@@ -41,12 +41,42 @@
 #include <stdbool.h>
 #include <offset.h>
 
+#include <ipc/loc.h>
+
 typedef struct bd_ops bd_ops_t;
 
+/** Block address window (per service) */
+typedef struct {
+	/** Link to bd_srvs_t.windows */
+	link_t lwindows;
+	/** Window ID */
+	sysarg_t id;
+	/** Session which created the window */
+	void *owner;
+	/** First block of the window */
+	aoff64_t ba;
+	/** Number of blocks in the window */
+	aoff64_t nblocks;
+	/** Block size */
+	size_t block_size;
+	/** Window has been destroyed */
+	bool revoked;
+	/** Held for reading during I/O, for writing during revocation */
+	fibril_rwlock_t lock;
+	/** Number of references, protected by bd_srvs_t.lock */
+	unsigned refcnt;
+} bd_window_t;
+
 /** Service setup (per sevice) */
 typedef struct {
 	bd_ops_t *ops;
 	void *sarg;
+	/** Protects windows */
+	fibril_mutex_t lock;
+	/** Block address windows */
+	list_t windows; /* of bd_window_t */
+	/** Next window ID */
+	sysarg_t next_window_id;
 } bd_srvs_t;
 
 /** Server structure (per client session) */
@@ -54,6 +84,8 @@ typedef struct {
 	bd_srvs_t *srvs;
 	async_sess_t *client_sess;
 	void *carg;
+	/** Window the session is restricted to or @c NULL */
+	bd_window_t *window;
 } bd_srv_t;
 
 struct bd_ops {
@@ -65,6 +97,7 @@ struct bd_ops {
 	errno_t (*write_blocks)(bd_srv_t *, aoff64_t, size_t, const void *, size_t);
 	errno_t (*get_block_size)(bd_srv_t *, size_t *);
 	errno_t (*get_num_blocks)(bd_srv_t *, aoff64_t *);
+	errno_t (*get_passthrough)(bd_srv_t *, service_id_t *, sysarg_t *);
 };
 
 extern void bd_srvs_init(bd_srvs_t *);
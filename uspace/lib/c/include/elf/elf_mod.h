@@ -38,8 +38,10 @@
 #define ELF_MOD_H_
 
 #include <elf/elf.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <offset.h>
 #include <loader/pcb.h>
 
 /**
@@ -99,12 +101,21 @@ typedef struct {
 	/** Filedescriptor of the file from which we are loading */
 	int fd;
 
+	/** Size of the file */
+	aoff64_t size;
+
 	/** Difference between run-time addresses and link-time addresses */
 	uintptr_t bias;
 
 	/** Flags passed to the ELF loader. */
 	eld_flags_t flags;
 
+	/** The binary contains relocations of read-only segments */
+	bool text_rel;
+
+	/** Some segments are mapped from the file via the VFS pager */
+	bool mapped;
+
 	/** Store extracted info here */
 	elf_finfo_t *info;
 } elf_ld_t;
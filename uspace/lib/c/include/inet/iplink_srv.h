@@ -51,6 +51,16 @@ typedef struct {
 	async_sess_t *client_sess;
 } iplink_srv_t;
 
+/** Batch of received datagrams to be delivered using a single IPC */
+typedef struct {
+	/** Buffer of iplink_ev_recv_hdr_t headers and datagrams */
+	void *buf;
+	/** Number of bytes used in @c buf */
+	size_t size;
+	/** Number of datagrams in @c buf */
+	size_t count;
+} iplink_recv_batch_t;
+
 typedef struct iplink_ops {
 	errno_t (*open)(iplink_srv_t *);
 	errno_t (*close)(iplink_srv_t *);
@@ -69,6 +79,13 @@ extern errno_t iplink_conn(cap_call_handle_t, ipc_call_t *, void *);
 extern errno_t iplink_ev_recv(iplink_srv_t *, iplink_recv_sdu_t *, ip_ver_t);
 extern errno_t iplink_ev_change_addr(iplink_srv_t *, addr48_t *);
 
+extern errno_t iplink_recv_batch_init(iplink_recv_batch_t *);
+extern void iplink_recv_batch_fini(iplink_recv_batch_t *);
+extern errno_t iplink_ev_recv_batch_add(iplink_srv_t *, iplink_recv_batch_t *,
+    iplink_recv_sdu_t *, ip_ver_t);
+extern errno_t iplink_ev_recv_batch_flush(iplink_srv_t *,
+    iplink_recv_batch_t *);
+
 #endif
 
 /** @}
@@ -43,7 +43,11 @@ typedef enum {
 	BD_READ_BLOCKS,
 	BD_SYNC_CACHE,
 	BD_WRITE_BLOCKS,
-	BD_READ_TOC
+	BD_READ_TOC,
+	BD_GET_PASSTHROUGH,
+	BD_WINDOW_CREATE,
+	BD_WINDOW_DESTROY,
+	BD_WINDOW_ATTACH
 } bd_request_t;
 
 #endif
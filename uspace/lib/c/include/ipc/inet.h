@@ -35,6 +35,7 @@
 #ifndef LIBC_IPC_INET_H_
 #define LIBC_IPC_INET_H_
 
+#include <inet/addr.h>
 #include <ipc/common.h>
 
 /** Requests on Inet default port */
@@ -50,6 +51,14 @@ typedef enum {
 	INET_EV_RECV = IPC_FIRST_USER_METHOD
 } inet_event_t;
 
+/** Addresses sent before the datagram data in INET_EV_RECV */
+typedef struct {
+	/** Source address */
+	inet_addr_t src;
+	/** Destination address */
+	inet_addr_t dest;
+} inet_ev_recv_hdr_t;
+
 /** Requests on Inet configuration port */
 typedef enum {
 	INETCFG_ADDR_CREATE_STATIC = IPC_FIRST_USER_METHOD,
@@ -50,8 +50,21 @@ typedef enum {
 typedef enum {
 	IPLINK_EV_RECV = IPC_FIRST_USER_METHOD,
 	IPLINK_EV_CHANGE_ADDR,
+	IPLINK_EV_RECV_BATCH
 } iplink_event_t;
 
+/** Header of a datagram in an IPLINK_EV_RECV_BATCH buffer.
+ *
+ * Each header is followed by the datagram, padded to a multiple
+ * of the header size.
+ */
+typedef struct {
+	/** Size of the datagram in bytes */
+	size_t size;
+	/** IP version (ip_ver_t) */
+	sysarg_t ver;
+} iplink_ev_recv_hdr_t;
+
 #endif
 
 /**
@@ -109,6 +109,10 @@ typedef enum {
 	VFS_OUT_LAST
 } vfs_out_request_t;
 
+typedef enum {
+	VFS_PAGER_READ = IPC_FIRST_USER_METHOD
+} vfs_pager_request_t;
+
 /*
  * Lookup flags.
  */
@@ -69,6 +69,9 @@ typedef struct dyn_info {
 	/** Hash table */
 	elf_word *hash;
 
+	/** GNU hash table */
+	elf_word *gnu_hash;
+
 	/** String table */
 	char *str_tab;
 	size_t str_sz;
@@ -76,6 +79,8 @@ typedef struct dyn_info {
 	/** Symbol table */
 	void *sym_tab;
 	size_t sym_ent;
+	/** Number of entries in the symbol table */
+	size_t sym_count;
 
 	void *init;		/**< Module initialization code */
 	void *fini;		/**< Module cleanup code */
@@ -98,6 +103,7 @@ typedef struct dyn_info {
 } dyn_info_t;
 
 void dynamic_parse(elf_dyn_t *dyn_ptr, size_t bias, dyn_info_t *info);
+size_t dynamic_sym_count(dyn_info_t *info);
 void dyn_parse_arch(elf_dyn_t *dp, size_t bias, dyn_info_t *info);
 
 #endif
@@ -94,9 +94,17 @@ typedef struct elf32_rela elf_rela_t;
 #define DT_TEXTREL	22
 #define DT_JMPREL	23
 #define DT_BIND_NOW	24
+#define DT_FLAGS	30
+#define DT_GNU_HASH	0x6ffffef5
 #define DT_LOPROC	0x70000000
 #define DT_HIPROC	0x7fffffff
 
+/*
+ * Values of the DT_FLAGS entry
+ */
+#define DF_TEXTREL	0x4
+#define DF_BIND_NOW	0x8
+
 /*
  * Special section indexes
  */
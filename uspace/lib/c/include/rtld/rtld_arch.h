@@ -39,6 +39,8 @@
 #include <loader/pcb.h>
 
 void module_process_pre_arch(module_t *m);
+bool module_process_lazy_arch(module_t *m);
+void *rtld_bind(module_t *m, size_t reloc_off);
 
 void rel_table_process(module_t *m, elf_rel_t *rt, size_t rt_size);
 void rela_table_process(module_t *m, elf_rela_t *rt, size_t rt_size);
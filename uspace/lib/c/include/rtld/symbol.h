@@ -50,6 +50,7 @@ typedef enum {
 extern elf_symbol_t *symbol_bfs_find(const char *, module_t *, module_t **);
 extern elf_symbol_t *symbol_def_find(const char *, module_t *,
     symbol_search_flags_t, module_t **);
+extern elf_symbol_t *symbol_def_find_idx(elf_word, module_t *, module_t **);
 extern void *symbol_get_addr(elf_symbol_t *, module_t *, tcb_t *);
 
 #endif
@@ -54,9 +54,18 @@ extern stats_task_t *stats_get_task(task_id_t);
 extern stats_thread_t *stats_get_threads(size_t *);
 extern stats_thread_t *stats_get_thread(thread_id_t);
 
+extern stats_delta_t *stats_get_tasks_delta(uint64_t);
+extern stats_task_t *stats_merge_tasks(stats_task_t *, size_t *,
+    stats_delta_t *);
+extern stats_delta_t *stats_get_threads_delta(uint64_t);
+extern stats_thread_t *stats_merge_threads(stats_thread_t *, size_t *,
+    stats_delta_t *);
+
 extern stats_exc_t *stats_get_exceptions(size_t *);
 extern stats_exc_t *stats_get_exception(unsigned int);
 
+extern stats_syscall_t *stats_get_syscalls(size_t *);
+
 extern void stats_print_load_fragment(load_t, unsigned int);
 extern const char *thread_get_state(state_t);
 
@@ -36,6 +36,7 @@
 #define LIBC_TYPES_RTLD_MODULE_H_
 
 #include <adt/list.h>
+#include <elf/elf.h>
 #include <stddef.h>
 
 typedef enum {
@@ -43,6 +44,16 @@ typedef enum {
 	mlf_local = 0x1
 } mlflags_t;
 
+struct module;
+
+/** Cached definition of a symbol referenced by a module */
+typedef struct {
+	/** Symbol definition or @c NULL if not resolved yet */
+	elf_symbol_t *sym;
+	/** Module containing the definition */
+	struct module *mod;
+} symbol_cache_t;
+
 /** Dynamically linked module */
 typedef struct module {
 	/** Module ID */
@@ -74,6 +85,14 @@ typedef struct module {
 	/** True iff relocations have already been processed in this module. */
 	bool relocated;
 
+	/**
+	 * Definitions of the symbols referenced by this module, indexed by
+	 * the symbol table index. Avoids repeating the search for every
+	 * relocation referring to the same symbol and keeps the results
+	 * for lazy binding.
+	 */
+	symbol_cache_t *sym_cache;
+
 	/** Link to list of all modules in runtime environment */
 	link_t modules_link;
 	/** Link to list of initial modules */
@@ -57,6 +57,8 @@ extern errno_t udebug_regs_read(async_sess_t *, thash_t, void *);
 extern errno_t udebug_go(async_sess_t *, thash_t, udebug_event_t *, sysarg_t *,
     sysarg_t *);
 extern errno_t udebug_stop(async_sess_t *, thash_t);
+extern errno_t udebug_prof_start(async_sess_t *);
+extern errno_t udebug_prof_stop(async_sess_t *);
 
 #endif
 
@@ -26,6 +26,8 @@
  * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <errno.h>
@@ -61,6 +63,28 @@ typedef struct {
 	uint32_t size;
 } __attribute__((packed)) gzip_footer_t;
 
+/** Stream decoder states */
+typedef enum {
+	GZIP_HEADER,     /**< Fixed header */
+	GZIP_EXTRA_LEN,  /**< Length of extra metadata */
+	GZIP_EXTRA,      /**< Extra metadata */
+	GZIP_NAME,       /**< Original file name */
+	GZIP_COMMENT,    /**< File comment */
+	GZIP_HCRC,       /**< Header CRC */
+	GZIP_BODY        /**< Compressed data */
+} gzip_mode_t;
+
+/** Incremental GZIP decoder state */
+struct gzip_stream {
+	gzip_mode_t mode;
+	gzip_header_t header;
+	/** Bytes of the current header field read so far */
+	size_t cnt;
+	/** Length of the extra metadata */
+	uint16_t extra_length;
+	inflate_stream_t *inflate;
+};
+
 /** Expand GZIP compressed data
  *
  * The routine allocates the output buffer based
@@ -175,9 +199,227 @@ errno_t gzip_expand(void *src, size_t srclen, void **dest, size_t *destlen)
 
 	errno_t ret = inflate(stream, stream_length, *dest, *destlen);
 	if (ret != EOK) {
-		free(dest);
+		free(*dest);
 		return ret;
 	}
 
 	return EOK;
 }
+
+/** Create incremental GZIP decoder
+ *
+ * Unlike gzip_expand(), the stream decoder does not need the entire
+ * compressed data nor the output buffer in memory. The trailer is
+ * ignored, no CRC nor size check is performed.
+ *
+ * @param[out] stream Place to store the new stream.
+ *
+ * @return EOK on success.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t gzip_stream_create(gzip_stream_t **stream)
+{
+	gzip_stream_t *s = malloc(sizeof(gzip_stream_t));
+	if (s == NULL)
+		return ENOMEM;
+
+	errno_t ret = inflate_stream_create(&s->inflate);
+	if (ret != EOK) {
+		free(s);
+		return ret;
+	}
+
+	s->mode = GZIP_HEADER;
+	s->cnt = 0;
+	s->extra_length = 0;
+
+	*stream = s;
+	return EOK;
+}
+
+/** Destroy incremental GZIP decoder
+ *
+ * @param stream Stream to destroy.
+ *
+ */
+void gzip_stream_destroy(gzip_stream_t *stream)
+{
+	inflate_stream_destroy(stream->inflate);
+	free(stream);
+}
+
+/** Get the header field following the given one
+ *
+ * @param flags Header flags.
+ * @param mode  Current header field.
+ *
+ * @return Next header field present in the stream.
+ *
+ */
+static gzip_mode_t gzip_next_mode(uint8_t flags, gzip_mode_t mode)
+{
+	switch (mode) {
+	case GZIP_HEADER:
+		if ((flags & GZIP_FLAG_FEXTRA) != 0)
+			return GZIP_EXTRA_LEN;
+		/* Fallthrough */
+	case GZIP_EXTRA_LEN:
+	case GZIP_EXTRA:
+		if ((flags & GZIP_FLAG_FNAME) != 0)
+			return GZIP_NAME;
+		/* Fallthrough */
+	case GZIP_NAME:
+		if ((flags & GZIP_FLAG_FCOMMENT) != 0)
+			return GZIP_COMMENT;
+		/* Fallthrough */
+	case GZIP_COMMENT:
+		if ((flags & GZIP_FLAG_FHCRC) != 0)
+			return GZIP_HCRC;
+		/* Fallthrough */
+	default:
+		return GZIP_BODY;
+	}
+}
+
+/** Parse one byte of the GZIP header
+ *
+ * @param stream GZIP stream.
+ * @param byte   Next byte of the stream.
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression method or invalid stream.
+ *
+ */
+static errno_t gzip_stream_header(gzip_stream_t *stream, uint8_t byte)
+{
+	uint8_t flags = stream->header.flags;
+	bool next = false;
+
+	switch (stream->mode) {
+	case GZIP_HEADER:
+		((uint8_t *) &stream->header)[stream->cnt] = byte;
+		stream->cnt++;
+
+		if (stream->cnt == sizeof(stream->header)) {
+			flags = stream->header.flags;
+			if ((stream->header.id1 != GZIP_ID1) ||
+			    (stream->header.id2 != GZIP_ID2) ||
+			    (stream->header.method != GZIP_METHOD_DEFLATE) ||
+			    ((flags & (~GZIP_FLAGS_MASK)) != 0))
+				return EINVAL;
+
+			next = true;
+		}
+		break;
+	case GZIP_EXTRA_LEN:
+		stream->extra_length |= (uint16_t) byte << (8 * stream->cnt);
+		stream->cnt++;
+
+		if (stream->cnt == sizeof(stream->extra_length)) {
+			stream->mode = GZIP_EXTRA;
+			stream->cnt = 0;
+			next = (stream->extra_length == 0);
+		}
+		break;
+	case GZIP_EXTRA:
+		stream->cnt++;
+		next = (stream->cnt == stream->extra_length);
+		break;
+	case GZIP_NAME:
+	case GZIP_COMMENT:
+		next = (byte == 0);
+		break;
+	case GZIP_HCRC:
+		stream->cnt++;
+		next = (stream->cnt == 2);
+		break;
+	case GZIP_BODY:
+		assert(false);
+	}
+
+	if (next) {
+		stream->mode = gzip_next_mode(flags, stream->mode);
+		stream->cnt = 0;
+	}
+
+	return EOK;
+}
+
+/** Feed GZIP compressed data to the stream
+ *
+ * @param[in]  stream   GZIP stream.
+ * @param[in]  src      Compressed data.
+ * @param[in]  srclen   Size of the compressed data (bytes).
+ * @param[out] accepted Number of bytes accepted.
+ *
+ * @return EOK on success.
+ * @return EINVAL on invalid compression method or invalid stream.
+ *
+ */
+errno_t gzip_stream_feed(gzip_stream_t *stream, const void *src,
+    size_t srclen, size_t *accepted)
+{
+	const uint8_t *data = (const uint8_t *) src;
+	size_t cnt = 0;
+
+	while ((cnt < srclen) && (stream->mode != GZIP_BODY)) {
+		errno_t ret = gzip_stream_header(stream, data[cnt]);
+		if (ret != EOK)
+			return ret;
+
+		cnt++;
+	}
+
+	if (cnt < srclen) {
+		if (inflate_stream_done(stream->inflate)) {
+			/* Ignore the trailer */
+			cnt = srclen;
+		} else {
+			size_t len;
+			inflate_stream_feed(stream->inflate, data + cnt,
+			    srclen - cnt, &len);
+			cnt += len;
+		}
+	}
+
+	*accepted = cnt;
+	return EOK;
+}
+
+/** Drain decompressed data from the stream
+ *
+ * @param[in]  stream  GZIP stream.
+ * @param[out] dest    Destination buffer.
+ * @param[in]  destlen Destination buffer size (bytes).
+ * @param[out] drained Number of bytes stored to @a dest.
+ *
+ * @return EOK on success.
+ * @return ENOENT on distance too large.
+ * @return EINVAL on invalid Huffman code or invalid deflate data.
+ *
+ */
+errno_t gzip_stream_drain(gzip_stream_t *stream, void *dest, size_t destlen,
+    size_t *drained)
+{
+	if (stream->mode != GZIP_BODY) {
+		*drained = 0;
+		return EOK;
+	}
+
+	return inflate_stream_drain(stream->inflate, dest, destlen, drained);
+}
+
+/** Check whether all data were decompressed
+ *
+ * @param stream GZIP stream.
+ *
+ * @return True if the end of the compressed data was reached and all
+ *         decompressed data were drained.
+ *
+ */
+bool gzip_stream_done(gzip_stream_t *stream)
+{
+	return (stream->mode == GZIP_BODY) &&
+	    inflate_stream_done(stream->inflate);
+}
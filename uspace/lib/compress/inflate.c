@@ -30,12 +30,18 @@
 /** @file
  * @brief Implementation of inflate decompression
  *
- * A simple inflate implementation (decompression of `deflate' stream as
- * described by RFC 1951) based on puff.c by Mark Adler. This code is
- * currently not optimized for speed but for readability.
+ * An inflate implementation (decompression of `deflate' stream as
+ * described by RFC 1951) originally based on puff.c by Mark Adler.
  *
- * All dynamically allocated memory memory is taken from the stack. The
- * stack usage should be typically bounded by 2 KB.
+ * Huffman codes are decoded using two-level lookup tables indexed by
+ * the next input bits (a root table and sub-tables for long codes),
+ * the bit buffer is refilled with whole 64-bit words and matches are
+ * copied in 8-byte chunks where the distance allows.
+ *
+ * The decoder is a resumable state machine: it stops whenever it runs
+ * out of input or output and continues from the same point once more
+ * input is fed or output drained. This allows both the one-shot
+ * inflate() and the incremental inflate_stream_t interface.
  *
  * Original copyright notice:
  *
@@ -63,11 +69,15 @@
  *
  */
 
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <mem.h>
+#include <macros.h>
+#include <byteorder.h>
 #include "inflate.h"
 
 /** Maximum bits in the Huffman code */
@@ -83,43 +93,114 @@
 #define MAX_LITLEN        286
 /** Number of fixed literal/length codes */
 #define MAX_FIXED_LITLEN  288
+/** Number of fixed distance codes */
+#define MAX_FIXED_DIST    32
 
 /** Number of all codes */
 #define MAX_CODE  (MAX_LITLEN + MAX_DIST)
 
-/** Check for input buffer overrun condition */
-#define CHECK_OVERRUN(state) \
-	do { \
-		if ((state).overrun) \
-			return ELIMIT; \
-	} while (false)
+/** Longest match */
+#define MAX_MATCH  258
 
+/** Root table bits for literal/length codes */
+#define LEN_ROOT_BITS    9
+/** Root table bits for distance codes */
+#define DIST_ROOT_BITS   6
+/** Root table bits for code length codes */
+#define ORDER_ROOT_BITS  7
 
-/** Inflate algorithm state
+/*
+ * Upper bounds on the size of the root table plus all sub-tables for
+ * any valid code (as computed by zlib's enough.c for the root sizes
+ * above).
+ */
+#define LEN_TABLE_SIZE   852
+#define DIST_TABLE_SIZE  592
+
+/** Output space needed by one iteration of the fast decoding loop */
+#define FAST_OUT  (MAX_MATCH + 8)
+/** Input needed by one iteration of the fast decoding loop */
+#define FAST_IN   8
+
+/** Size of the history window */
+#define WINDOW_SIZE  32768
+/** Size of the stream input buffer */
+#define INPUT_SIZE   16384
+
+/** Huffman lookup table entry
+ *
+ * Either a decoded symbol and the number of bits it uses, or a link to
+ * a sub-table (@c sub non-zero) which is indexed by the next @c sub bits.
+ * Entries with zero length represent invalid codes.
  *
  */
 typedef struct {
-	uint8_t *dest;    /**< Output buffer */
-	size_t destlen;   /**< Output buffer size */
-	size_t destcnt;   /**< Position in the output buffer */
+	uint16_t sym;  /**< Symbol or sub-table offset */
+	uint8_t len;   /**< Number of bits used */
+	uint8_t sub;   /**< Sub-table index bits */
+} huffman_entry_t;
 
-	uint8_t *src;     /**< Input buffer */
-	size_t srclen;    /**< Input buffer size */
-	size_t srccnt;    /**< Position in the input buffer */
-
-	uint16_t bitbuf;  /**< Bit buffer */
-	size_t bitlen;    /**< Number of bits in the bit buffer */
+/** Decoder states
+ *
+ */
+typedef enum {
+	INFLATE_HEADER,      /**< Block header */
+	INFLATE_STORED_LEN,  /**< Stored block length */
+	INFLATE_STORED,      /**< Stored block data */
+	INFLATE_TABLE,       /**< Dynamic block table sizes */
+	INFLATE_CODELENS,    /**< Code length code lengths */
+	INFLATE_LENLENS,     /**< Literal/length and distance code lengths */
+	INFLATE_CODES,       /**< Compressed data */
+	INFLATE_MATCH,       /**< Match interrupted by full output */
+	INFLATE_DONE         /**< Last block decoded */
+} inflate_mode_t;
 
-	bool overrun;     /**< Overrun condition */
+/** Inflate algorithm state
+ *
+ */
+typedef struct {
+	const uint8_t *src;  /**< Input buffer */
+	size_t srclen;       /**< Input buffer size */
+	size_t srccnt;       /**< Position in the input buffer */
+
+	uint8_t *dest;       /**< Output buffer */
+	size_t destlen;      /**< Output buffer size */
+	size_t destcnt;      /**< Position in the output buffer */
+
+	uint64_t bitbuf;     /**< Bit buffer */
+	unsigned bitlen;     /**< Number of valid bits in the bit buffer */
+
+	inflate_mode_t mode;  /**< Current state */
+	bool last;            /**< Decoding the last block */
+
+	size_t stored_left;  /**< Remaining bytes of a stored block */
+	size_t match_len;    /**< Remaining bytes of an interrupted match */
+	size_t match_dist;   /**< Distance of an interrupted match */
+
+	uint16_t nlen;   /**< Number of literal/length codes */
+	uint16_t ndist;  /**< Number of distance codes */
+	uint16_t ncode;  /**< Number of code length codes */
+	uint16_t index;  /**< Number of code lengths read so far */
+	uint16_t length[MAX_CODE];  /**< Code lengths */
+
+	huffman_entry_t len_code[LEN_TABLE_SIZE];    /**< Literal/length */
+	huffman_entry_t dist_code[DIST_TABLE_SIZE];  /**< Distance */
+	unsigned len_bits;   /**< Root bits of len_code */
+	unsigned dist_bits;  /**< Root bits of dist_code */
 } inflate_state_t;
 
-/** Huffman code description
+/** Incremental inflate state
+ *
+ * Decoded data are kept in a window twice the size of the maximal
+ * match distance; once drained, the older half is discarded.
  *
  */
-typedef struct {
-	uint16_t *count;   /**< Array of symbol counts */
-	uint16_t *symbol;  /**< Array of symbols */
-} huffman_t;
+struct inflate_stream {
+	inflate_state_t state;
+	uint8_t input[INPUT_SIZE];
+	uint8_t window[2 * WINDOW_SIZE];
+	size_t drained;  /**< Window position up to which data were drained */
+};
 
 /** Length codes
  *
@@ -132,7 +213,7 @@ static const uint16_t lens[MAX_LEN] = {
 /** Extended length codes
  *
  */
-static const uint16_t lens_ext[MAX_LEN] = {
+static const uint8_t lens_ext[MAX_LEN] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
 	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
 };
@@ -149,7 +230,7 @@ static const uint16_t dists[MAX_DIST] = {
 /** Extended distance codes
  *
  */
-static const uint16_t dists_ext[MAX_DIST] = {
+static const uint8_t dists_ext[MAX_DIST] = {
 	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
 	7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
 	12, 12, 13, 13
@@ -162,253 +243,449 @@ static const short order[MAX_ORDER] = {
 	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
 };
 
-/** Static length symbol counts
+/** Refill the bit buffer
+ *
+ * Loads as many whole bytes as fit into the bit buffer. With at least
+ * 8 bytes of input left a single unaligned 64-bit load is used. Bits
+ * above bitlen may be set, but always to the value of the input bits
+ * at that position, so reloading the same bytes is harmless.
+ *
+ * @param state Inflate state.
  *
  */
-static uint16_t len_count[MAX_HUFFMAN_BIT + 1] = {
-	0, 0, 0, 0, 0, 0, 0, 24, 152, 112, 0, 0, 0, 0, 0, 0
-};
+static inline void refill(inflate_state_t *state)
+{
+	if (state->srclen - state->srccnt >= 8) {
+		uint64_t val;
+		memcpy(&val, state->src + state->srccnt, sizeof(val));
+		state->bitbuf |= uint64_t_le2host(val) << state->bitlen;
+		state->srccnt += (63 - state->bitlen) >> 3;
+		state->bitlen |= 56;
+		return;
+	}
 
-/** Static length symbols
- *
- */
-static uint16_t len_symbol[MAX_FIXED_LITLEN] = {
-	256, 257, 258, 259, 260, 261, 262, 263, 264, 265, 266, 267, 268,
-	269, 270, 271, 272, 273, 274, 275, 276, 277, 278, 279, 0, 1, 2,
-	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
-	21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36,
-	37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52,
-	53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
-	69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84,
-	85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100,
-	101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113,
-	114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126,
-	127, 128, 129, 130, 131, 132, 133, 134, 135, 136, 137, 138, 139,
-	140, 141, 142, 143, 280, 281, 282, 283, 284, 285, 286, 287, 144,
-	145, 146, 147, 148, 149, 150, 151, 152, 153, 154, 155, 156, 157,
-	158, 159, 160, 161, 162, 163, 164, 165, 166, 167, 168, 169, 170,
-	171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181, 182, 183,
-	184, 185, 186, 187, 188, 189, 190, 191, 192, 193, 194, 195, 196,
-	197, 198, 199, 200, 201, 202, 203, 204, 205, 206, 207, 208, 209,
-	210, 211, 212, 213, 214, 215, 216, 217, 218, 219, 220, 221, 222,
-	223, 224, 225, 226, 227, 228, 229, 230, 231, 232, 233, 234, 235,
-	236, 237, 238, 239, 240, 241, 242, 243, 244, 245, 246, 247, 248,
-	249, 250, 251, 252, 253, 254, 255
-};
+	while ((state->bitlen < 56) && (state->srccnt < state->srclen)) {
+		state->bitbuf |=
+		    ((uint64_t) state->src[state->srccnt]) << state->bitlen;
+		state->srccnt++;
+		state->bitlen += 8;
+	}
+}
 
-/** Static distance symbol counts
+/** Make sure the bit buffer holds enough bits
  *
- */
-static uint16_t dist_count[MAX_HUFFMAN_BIT + 1] = {
-	0, 0, 0, 0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-};
-
-/** Static distance symbols
+ * @param state Inflate state.
+ * @param cnt   Number of bits needed.
  *
- */
-static uint16_t dist_symbol[MAX_DIST] = {
-	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
-	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29
-};
-
-/** Huffman code for lengths
+ * @return True if at least @a cnt bits are available.
  *
  */
-static huffman_t len_code = {
-	.count = len_count,
-	.symbol = len_symbol
-};
+static inline bool need_bits(inflate_state_t *state, unsigned cnt)
+{
+	if (state->bitlen < cnt)
+		refill(state);
 
-/** Huffman code for distances
- *
- */
-static huffman_t dist_code = {
-	.count = dist_count,
-	.symbol = dist_symbol
-};
+	return (state->bitlen >= cnt);
+}
 
 /** Get bits from the bit buffer
+ *
+ * The caller has to make sure enough bits are available.
  *
  * @param state Inflate state.
- * @param cnt   Number of bits to return (at most 16).
+ * @param cnt   Number of bits to return (at most 32).
  *
  * @return Returned bits.
  *
  */
-static inline uint16_t get_bits(inflate_state_t *state, size_t cnt)
+static inline uint32_t get_bits(inflate_state_t *state, unsigned cnt)
 {
-	/* Bit accumulator for at least 20 bits */
-	uint32_t val = state->bitbuf;
+	uint32_t val = (uint32_t) (state->bitbuf & ((UINT64_C(1) << cnt) - 1));
+	state->bitbuf >>= cnt;
+	state->bitlen -= cnt;
+	return val;
+}
 
-	while (state->bitlen < cnt) {
-		if (state->srccnt == state->srclen) {
-			state->overrun = true;
-			return 0;
-		}
+/** Reverse bit order of a Huffman code
+ *
+ */
+static uint16_t bit_reverse(uint16_t code, unsigned len)
+{
+	uint16_t rev = 0;
 
-		/* Load 8 more bits */
-		val |= ((uint32_t) state->src[state->srccnt]) << state->bitlen;
-		state->srccnt++;
-		state->bitlen += 8;
+	while (len > 0) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+		len--;
 	}
 
-	/* Update bits in the buffer */
-	state->bitbuf = (uint16_t) (val >> cnt);
-	state->bitlen -= cnt;
-
-	return ((uint16_t) (val & ((1 << cnt) - 1)));
+	return rev;
 }
 
-/** Decode `stored' block
+/** Construct Huffman lookup tables from canonical Huffman code
  *
- * @param state Inflate state.
+ * Codes of at most @a root bits are replicated in the root table, longer
+ * codes sharing the same root prefix are placed in a common sub-table
+ * sized for the longest of them.
+ *
+ * @param table  Constructed lookup table.
+ * @param size   Number of entries available in @a table.
+ * @param root   Root table bits.
+ * @param length Lengths of the canonical Huffman code.
+ * @param n      Number of lengths.
+ * @param single Accept an incomplete code consisting of a single symbol.
  *
  * @return EOK on success.
- * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
- * @return EINVAL on invalid data.
+ * @return EINVAL on over-subscribed or incomplete code set.
  *
  */
-static errno_t inflate_stored(inflate_state_t *state)
+static errno_t huffman_construct(huffman_entry_t *table, size_t size,
+    unsigned root, const uint16_t *length, size_t n, bool single)
 {
-	/* Discard bits in the bit buffer */
-	state->bitbuf = 0;
-	state->bitlen = 0;
+	/* Count number of codes for each length */
+	uint16_t count[MAX_HUFFMAN_BIT + 1];
+	size_t len;
+	for (len = 0; len <= MAX_HUFFMAN_BIT; len++)
+		count[len] = 0;
 
-	if (state->srccnt + 4 > state->srclen)
-		return ELIMIT;
+	/* We assume that the lengths are within bounds */
+	size_t symbol;
+	for (symbol = 0; symbol < n; symbol++)
+		count[length[symbol]]++;
+
+	const huffman_entry_t invalid = { 0, 0, 0 };
+	for (size_t i = 0; i < (1U << root); i++)
+		table[i] = invalid;
+
+	if (count[0] == n) {
+		/* The code is complete, but decoding will fail */
+		return EOK;
+	}
 
-	uint16_t len =
-	    state->src[state->srccnt] | (state->src[state->srccnt + 1] << 8);
-	uint16_t len_compl =
-	    state->src[state->srccnt + 2] | (state->src[state->srccnt + 3] << 8);
+	/* Check for an over-subscribed or incomplete set of lengths */
+	int16_t left = 1;
+	unsigned max = 0;
+	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
+		left <<= 1;
+		left -= count[len];
+		if (left < 0)
+			return EINVAL;
+
+		if (count[len] != 0)
+			max = len;
+	}
 
-	/* Check block length and its complement */
-	if (((int16_t) len) != ~((int16_t) len_compl))
+	if ((left > 0) && ((!single) || ((size_t) count[0] + 1 != n)))
 		return EINVAL;
 
-	state->srccnt += 4;
+	/* Sort symbols by code length */
+	uint16_t offs[MAX_HUFFMAN_BIT + 1];
+	uint16_t sorted[MAX_FIXED_LITLEN];
 
-	/* Check input buffer size */
-	if (state->srccnt + len > state->srclen)
-		return ELIMIT;
+	offs[1] = 0;
+	for (len = 1; len < MAX_HUFFMAN_BIT; len++)
+		offs[len + 1] = offs[len] + count[len];
 
-	/* Check output buffer size */
-	if (state->destcnt + len > state->destlen)
-		return ENOMEM;
+	for (symbol = 0; symbol < n; symbol++) {
+		if (length[symbol] != 0) {
+			sorted[offs[length[symbol]]] = symbol;
+			offs[length[symbol]]++;
+		}
+	}
+
+	/* First canonical code of each length */
+	uint16_t next[MAX_HUFFMAN_BIT + 1];
+	uint16_t code = 0;
+	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
+		next[len] = code;
+		code = (code + count[len]) << 1;
+	}
+
+	size_t used = 1U << root;
+	size_t sub_base = 0;
+	unsigned sub_bits = 0;
+	int prefix = -1;
+
+	for (size_t i = 0; i < n - count[0]; i++) {
+		symbol = sorted[i];
+		len = length[symbol];
+		code = next[len]++;
+
+		if (len <= root) {
+			huffman_entry_t entry = { symbol, len, 0 };
+			for (size_t j = bit_reverse(code, len); j < (1U << root);
+			    j += 1U << len)
+				table[j] = entry;
+		} else {
+			const unsigned rem = len - root;
+
+			if ((code >> rem) != prefix) {
+				/*
+				 * New sub-table; the remaining codes are
+				 * sorted so the ones sharing this prefix
+				 * come first.
+				 */
+				prefix = code >> rem;
+				sub_bits = rem;
+				int32_t avail = 1 << sub_bits;
+				while (root + sub_bits < max) {
+					avail -= count[root + sub_bits];
+					if (avail <= 0)
+						break;
+
+					sub_bits++;
+					avail <<= 1;
+				}
+
+				if (used + (1U << sub_bits) > size)
+					return EINVAL;
+
+				sub_base = used;
+				used += 1U << sub_bits;
+				for (size_t j = 0; j < (1U << sub_bits); j++)
+					table[sub_base + j] = invalid;
 
-	/* Copy data */
-	memcpy(state->dest + state->destcnt, state->src + state->srccnt, len);
-	state->srccnt += len;
-	state->destcnt += len;
+				huffman_entry_t link = { sub_base, root, sub_bits };
+				table[bit_reverse(prefix, root)] = link;
+			}
+
+			huffman_entry_t entry = { symbol, rem, 0 };
+			for (size_t j = bit_reverse(code & ((1U << rem) - 1), rem);
+			    j < (1U << sub_bits); j += 1U << rem)
+				table[sub_base + j] = entry;
+		}
+
+		/* Codes not yet placed, used for sub-table sizing */
+		count[len]--;
+	}
 
 	return EOK;
 }
 
-/** Decode a symbol using the Huffman code
+/** Decode a symbol using the Huffman lookup table
  *
- * @param state   Inflate state.
- * @param huffman Huffman code.
- * @param symbol  Decoded symbol.
+ * @param state  Inflate state.
+ * @param table  Huffman lookup table.
+ * @param root   Root table bits.
+ * @param symbol Decoded symbol.
  *
- * @param EOK on success.
- * @param EINVAL on invalid Huffman code.
+ * @return EOK on success.
+ * @return EINVAL on invalid Huffman code.
+ * @return ELIMIT if the bit buffer does not hold the entire code.
  *
  */
-static errno_t huffman_decode(inflate_state_t *state, huffman_t *huffman,
-    uint16_t *symbol)
+static inline errno_t huffman_decode(inflate_state_t *state,
+    const huffman_entry_t *table, unsigned root, uint16_t *symbol)
 {
-	uint16_t code = 0; /* Decoded bits */
-	size_t first = 0;  /* First code of the given length */
-	size_t index = 0;  /* Index of the first code of the given length
-	                      in the symbol table */
+	const uint32_t bits = (uint32_t) state->bitbuf;
+	huffman_entry_t entry = table[bits & ((1U << root) - 1)];
+	unsigned used = entry.len;
+
+	if (entry.sub != 0) {
+		entry = table[entry.sym +
+		    ((bits >> root) & ((1U << entry.sub) - 1))];
+		used = root + entry.len;
+	}
 
-	size_t len;  /* Current number of bits in the code */
-	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
-		/* Get next bit */
-		code |= get_bits(state, 1);
-		CHECK_OVERRUN(*state);
-
-		uint16_t count = huffman->count[len];
-		if (code < first + count) {
-			/* Return decoded symbol */
-			*symbol = huffman->symbol[index + code - first];
-			return EOK;
-		}
+	if ((entry.len == 0) || (used > state->bitlen)) {
+		/* Missing bits might make the code valid */
+		if (state->bitlen < MAX_HUFFMAN_BIT)
+			return ELIMIT;
 
-		/* Update for next length */
-		index += count;
-		first += count;
-		first <<= 1;
-		code <<= 1;
+		return EINVAL;
 	}
 
-	return EINVAL;
+	state->bitbuf >>= used;
+	state->bitlen -= used;
+	*symbol = entry.sym;
+	return EOK;
 }
 
-/** Construct Huffman tables from canonical Huffman code
+/** Copy a match
  *
- * @param huffman Constructed Huffman tables.
- * @param length  Lengths of the canonical Huffman code.
- * @param n       Number of lengths.
+ * For distances of at least 8 bytes the match is copied in 8-byte chunks
+ * and up to 7 bytes past the end of the match might be overwritten.
  *
- * @return 0 if the Huffman code set is complete.
- * @return Negative value for an over-subscribed code set.
- * @return Positive value for an incomplete code set.
+ * @param dest Destination of the match.
+ * @param dist Distance of the match source.
+ * @param len  Length of the match.
  *
  */
-static int16_t huffman_construct(huffman_t *huffman, uint16_t *length, size_t n)
+static inline void copy_match(uint8_t *dest, size_t dist, size_t len)
 {
-	/* Count number of codes for each length */
-	size_t len;
-	for (len = 0; len <= MAX_HUFFMAN_BIT; len++)
-		huffman->count[len] = 0;
+	const uint8_t *src = dest - dist;
 
-	/* We assume that the lengths are within bounds */
-	size_t symbol;
-	for (symbol = 0; symbol < n; symbol++)
-		huffman->count[length[symbol]]++;
+	if (dist >= 8) {
+		while (true) {
+			memcpy(dest, src, 8);
+			if (len <= 8)
+				break;
 
-	if (huffman->count[0] == n) {
-		/* The code is complete, but decoding will fail */
-		return 0;
+			dest += 8;
+			src += 8;
+			len -= 8;
+		}
+	} else if (dist == 1) {
+		memset(dest, *src, len);
+	} else {
+		while (len > 0) {
+			*dest++ = *src++;
+			len--;
+		}
 	}
+}
 
-	/* Check for an over-subscribed or incomplete set of lengths */
-	int16_t left = 1;
-	for (len = 1; len <= MAX_HUFFMAN_BIT; len++) {
-		left <<= 1;
-		left -= huffman->count[len];
-		if (left < 0) {
-			/* Over-subscribed */
-			return left;
+/** Decode literal/length and distance codes at full speed
+ *
+ * Decodes while there is enough input and output space for any symbol
+ * so that no bounds need to be checked within the loop.
+ *
+ * @param state Inflate state.
+ *
+ * @return EOK on end-of-block code.
+ * @return EAGAIN when close to the end of input or output.
+ * @return ENOENT on distance too large.
+ * @return EINVAL on invalid Huffman code.
+ *
+ */
+static errno_t inflate_fast(inflate_state_t *state)
+{
+	if ((state->srclen < FAST_IN) || (state->destlen < FAST_OUT))
+		return EAGAIN;
+
+	const uint8_t *src = state->src;
+	uint8_t *dest = state->dest;
+	const size_t src_limit = state->srclen - FAST_IN;
+	const size_t dest_limit = state->destlen - FAST_OUT;
+	const huffman_entry_t *len_code = state->len_code;
+	const huffman_entry_t *dist_code = state->dist_code;
+	const uint32_t len_mask = (1U << state->len_bits) - 1;
+	const uint32_t dist_mask = (1U << state->dist_bits) - 1;
+
+	uint64_t bitbuf = state->bitbuf;
+	unsigned bitlen = state->bitlen;
+	size_t srccnt = state->srccnt;
+	size_t destcnt = state->destcnt;
+	errno_t ret = EAGAIN;
+
+	while ((srccnt <= src_limit) && (destcnt <= dest_limit)) {
+		/* At least 56 bits, enough for any length and distance */
+		uint64_t val;
+		memcpy(&val, src + srccnt, sizeof(val));
+		bitbuf |= uint64_t_le2host(val) << bitlen;
+		srccnt += (63 - bitlen) >> 3;
+		bitlen |= 56;
+
+		huffman_entry_t entry = len_code[bitbuf & len_mask];
+		if (entry.sub != 0) {
+			bitbuf >>= entry.len;
+			bitlen -= entry.len;
+			entry = len_code[entry.sym +
+			    (bitbuf & ((1U << entry.sub) - 1))];
 		}
-	}
 
-	/* Generate offsets into symbol table */
-	uint16_t offs[MAX_HUFFMAN_BIT + 1];
+		if (entry.len == 0) {
+			ret = EINVAL;
+			break;
+		}
 
-	offs[1] = 0;
-	for (len = 1; len < MAX_HUFFMAN_BIT; len++)
-		offs[len + 1] = offs[len] + huffman->count[len];
+		bitbuf >>= entry.len;
+		bitlen -= entry.len;
 
-	for (symbol = 0; symbol < n; symbol++) {
-		if (length[symbol] != 0) {
-			huffman->symbol[offs[length[symbol]]] = symbol;
-			offs[length[symbol]]++;
+		uint16_t symbol = entry.sym;
+		if (symbol < 256) {
+			dest[destcnt] = (uint8_t) symbol;
+			destcnt++;
+			continue;
+		}
+
+		if (symbol == 256) {
+			ret = EOK;
+			break;
 		}
+
+		/* Compute length */
+		symbol -= 257;
+		if (symbol >= MAX_LEN) {
+			ret = EINVAL;
+			break;
+		}
+
+		size_t len = lens[symbol] +
+		    (bitbuf & ((1U << lens_ext[symbol]) - 1));
+		bitbuf >>= lens_ext[symbol];
+		bitlen -= lens_ext[symbol];
+
+		/* Get distance */
+		entry = dist_code[bitbuf & dist_mask];
+		if (entry.sub != 0) {
+			bitbuf >>= entry.len;
+			bitlen -= entry.len;
+			entry = dist_code[entry.sym +
+			    (bitbuf & ((1U << entry.sub) - 1))];
+		}
+
+		if ((entry.len == 0) || (entry.sym >= MAX_DIST)) {
+			ret = EINVAL;
+			break;
+		}
+
+		bitbuf >>= entry.len;
+		bitlen -= entry.len;
+
+		symbol = entry.sym;
+		size_t dist = dists[symbol] +
+		    (bitbuf & ((1U << dists_ext[symbol]) - 1));
+		bitbuf >>= dists_ext[symbol];
+		bitlen -= dists_ext[symbol];
+
+		if (dist > destcnt) {
+			ret = ENOENT;
+			break;
+		}
+
+		copy_match(dest + destcnt, dist, len);
+		destcnt += len;
+	}
+
+	state->bitbuf = bitbuf;
+	state->bitlen = bitlen;
+	state->srccnt = srccnt;
+	state->destcnt = destcnt;
+
+	return ret;
+}
+
+/** Finish a match interrupted by full output
+ *
+ * @param state Inflate state.
+ *
+ * @return EOK on success.
+ * @return ENOMEM on output buffer overrun.
+ *
+ */
+static errno_t inflate_match(inflate_state_t *state)
+{
+	while (state->match_len > 0) {
+		if (state->destcnt == state->destlen)
+			return ENOMEM;
+
+		state->dest[state->destcnt] =
+		    state->dest[state->destcnt - state->match_dist];
+		state->destcnt++;
+		state->match_len--;
 	}
 
-	return left;
+	return EOK;
 }
 
 /** Decode literal/length and distance codes
  *
- * Decode until end-of-block code.
+ * Decode until end-of-block code. Close to the end of the input or
+ * output buffer the symbols are decoded one by one; a symbol that cannot
+ * be decoded entirely is left in the input for the next call.
  *
- * @param state     Inflate state.
- * @param len_code  Huffman code for literal/length.
- * @param dist_code Huffman code for distance.
+ * @param state Inflate state.
  *
  * @return EOK on success.
  * @return ENOENT on distance too large.
@@ -417,190 +694,417 @@ static int16_t huffman_construct(huffman_t *huffman, uint16_t *length, size_t n)
  * @return ENOMEM on output buffer overrun.
  *
  */
-static errno_t inflate_codes(inflate_state_t *state, huffman_t *len_code,
-    huffman_t *dist_code)
+static errno_t inflate_codes(inflate_state_t *state)
 {
-	uint16_t symbol;
+	if (state->mode == INFLATE_MATCH) {
+		errno_t ret = inflate_match(state);
+		if (ret != EOK)
+			return ret;
 
-	do {
-		errno_t err = huffman_decode(state, len_code, &symbol);
-		if (err != EOK) {
-			/* Error decoding */
-			return err;
-		}
+		state->mode = INFLATE_CODES;
+	}
+
+	while (true) {
+		errno_t ret = inflate_fast(state);
+		if (ret != EAGAIN)
+			return ret;
+
+		refill(state);
+
+		/* Checkpoint for symbols that cannot be decoded entirely */
+		const uint64_t bitbuf = state->bitbuf;
+		const unsigned bitlen = state->bitlen;
+
+		uint16_t symbol;
+		ret = huffman_decode(state, state->len_code, state->len_bits,
+		    &symbol);
+		if (ret != EOK)
+			return ret;
 
 		if (symbol < 256) {
 			/* Write out literal */
-			if (state->destcnt == state->destlen)
+			if (state->destcnt == state->destlen) {
+				state->bitbuf = bitbuf;
+				state->bitlen = bitlen;
 				return ENOMEM;
+			}
 
 			state->dest[state->destcnt] = (uint8_t) symbol;
 			state->destcnt++;
-		} else if (symbol > 256) {
-			/* Compute length */
-			symbol -= 257;
-			if (symbol >= 29)
-				return EINVAL;
+			continue;
+		}
 
-			size_t len = lens[symbol] + get_bits(state, lens_ext[symbol]);
-			CHECK_OVERRUN(*state);
+		if (symbol == 256)
+			return EOK;
 
-			/* Get distance */
-			err = huffman_decode(state, dist_code, &symbol);
-			if (err != EOK)
-				return err;
+		/* Compute length */
+		symbol -= 257;
+		if (symbol >= MAX_LEN)
+			return EINVAL;
 
-			size_t dist = dists[symbol] + get_bits(state, dists_ext[symbol]);
-			if (dist > state->destcnt)
-				return ENOENT;
+		if (state->bitlen < lens_ext[symbol])
+			goto rollback;
 
-			if (state->destcnt + len > state->destlen)
-				return ENOMEM;
+		size_t len = lens[symbol] + get_bits(state, lens_ext[symbol]);
 
-			while (len > 0) {
-				/* Copy len bytes from distance bytes back */
-				state->dest[state->destcnt] =
-				    state->dest[state->destcnt - dist];
-				state->destcnt++;
-				len--;
-			}
-		}
-	} while (symbol != 256);
+		/* Get distance */
+		ret = huffman_decode(state, state->dist_code, state->dist_bits,
+		    &symbol);
+		if (ret == ELIMIT)
+			goto rollback;
 
-	return EOK;
+		if (ret != EOK)
+			return ret;
+
+		if (symbol >= MAX_DIST)
+			return EINVAL;
+
+		if (state->bitlen < dists_ext[symbol])
+			goto rollback;
+
+		size_t dist = dists[symbol] + get_bits(state, dists_ext[symbol]);
+		if (dist > state->destcnt)
+			return ENOENT;
+
+		state->match_len = len;
+		state->match_dist = dist;
+		state->mode = INFLATE_MATCH;
+
+		ret = inflate_match(state);
+		if (ret != EOK)
+			return ret;
+
+		state->mode = INFLATE_CODES;
+		continue;
+
+	rollback:
+		state->bitbuf = bitbuf;
+		state->bitlen = bitlen;
+		return ELIMIT;
+	}
 }
 
-/** Decode `fixed codes' block
+/** Decode `stored' block data
  *
- * @param state     Inflate state.
- * @param len_code  Huffman code for literal/length.
- * @param dist_code Huffman code for distance.
+ * @param state Inflate state.
  *
  * @return EOK on success.
- * @return ENOENT on distance too large.
- * @return EINVAL on invalid Huffman code.
  * @return ELIMIT on input buffer overrun.
  * @return ENOMEM on output buffer overrun.
  *
  */
-static errno_t inflate_fixed(inflate_state_t *state, huffman_t *len_code,
-    huffman_t *dist_code)
+static errno_t inflate_stored(inflate_state_t *state)
+{
+	/* Bytes already loaded in the bit buffer come first */
+	while ((state->stored_left > 0) && (state->bitlen >= 8)) {
+		if (state->destcnt == state->destlen)
+			return ENOMEM;
+
+		state->dest[state->destcnt] = (uint8_t) get_bits(state, 8);
+		state->destcnt++;
+		state->stored_left--;
+	}
+
+	if (state->stored_left == 0)
+		return EOK;
+
+	/* The input is going to be consumed behind the bit buffer's back */
+	state->bitbuf = 0;
+
+	while (state->stored_left > 0) {
+		if (state->srccnt == state->srclen)
+			return ELIMIT;
+
+		if (state->destcnt == state->destlen)
+			return ENOMEM;
+
+		size_t len = min(state->stored_left,
+		    min(state->srclen - state->srccnt,
+		    state->destlen - state->destcnt));
+
+		memcpy(state->dest + state->destcnt, state->src + state->srccnt,
+		    len);
+		state->srccnt += len;
+		state->destcnt += len;
+		state->stored_left -= len;
+	}
+
+	return EOK;
+}
+
+/** Build Huffman lookup tables for a `fixed codes' block
+ *
+ * @param state Inflate state.
+ *
+ */
+static void inflate_fixed(inflate_state_t *state)
 {
-	return inflate_codes(state, len_code, dist_code);
+	uint16_t *length = state->length;
+	size_t symbol;
+
+	for (symbol = 0; symbol < 144; symbol++)
+		length[symbol] = 8;
+	for (; symbol < 256; symbol++)
+		length[symbol] = 9;
+	for (; symbol < 280; symbol++)
+		length[symbol] = 7;
+	for (; symbol < MAX_FIXED_LITLEN; symbol++)
+		length[symbol] = 8;
+
+	state->len_bits = LEN_ROOT_BITS;
+	(void) huffman_construct(state->len_code, LEN_TABLE_SIZE,
+	    LEN_ROOT_BITS, length, MAX_FIXED_LITLEN, false);
+
+	/* Distance codes 30 and 31 are never used in valid data */
+	for (symbol = 0; symbol < MAX_FIXED_DIST; symbol++)
+		length[symbol] = 5;
+
+	state->dist_bits = DIST_ROOT_BITS;
+	(void) huffman_construct(state->dist_code, DIST_TABLE_SIZE,
+	    DIST_ROOT_BITS, length, MAX_FIXED_DIST, false);
 }
 
-/** Decode `dynamic codes' block
+/** Read literal/length and distance code lengths of a dynamic block
  *
- * @param state     Inflate state.
+ * @param state Inflate state.
  *
  * @return EOK on success.
- * @return ENOENT on distance too large.
  * @return EINVAL on invalid Huffman code.
  * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
  *
  */
-static errno_t inflate_dynamic(inflate_state_t *state)
+static errno_t inflate_lenlens(inflate_state_t *state)
 {
-	uint16_t length[MAX_CODE];
-	uint16_t dyn_len_count[MAX_HUFFMAN_BIT + 1];
-	uint16_t dyn_len_symbol[MAX_LITLEN];
-	uint16_t dyn_dist_count[MAX_HUFFMAN_BIT + 1];
-	uint16_t dyn_dist_symbol[MAX_DIST];
-	huffman_t dyn_len_code;
-	huffman_t dyn_dist_code;
+	uint16_t *length = state->length;
+	const size_t total = state->nlen + state->ndist;
 
-	dyn_len_code.count = dyn_len_count;
-	dyn_len_code.symbol = dyn_len_symbol;
+	while (state->index < total) {
+		refill(state);
 
-	dyn_dist_code.count = dyn_dist_count;
-	dyn_dist_code.symbol = dyn_dist_symbol;
+		const uint64_t bitbuf = state->bitbuf;
+		const unsigned bitlen = state->bitlen;
 
-	/* Get number of bits in each table */
-	uint16_t nlen = get_bits(state, 5) + 257;
-	CHECK_OVERRUN(*state);
+		uint16_t symbol;
+		errno_t ret = huffman_decode(state, state->len_code,
+		    state->len_bits, &symbol);
+		if (ret != EOK)
+			return ret;
 
-	uint16_t ndist = get_bits(state, 5) + 1;
-	CHECK_OVERRUN(*state);
+		if (symbol < 16) {
+			length[state->index] = symbol;
+			state->index++;
+			continue;
+		}
 
-	uint16_t ncode = get_bits(state, 4) + 4;
-	CHECK_OVERRUN(*state);
+		uint16_t len = 0;
+		unsigned extra;
+		uint16_t repeat;
 
-	if ((nlen > MAX_LITLEN) || (ndist > MAX_DIST) ||
-	    (ncode > MAX_ORDER))
-		return EINVAL;
+		if (symbol == 16) {
+			if (state->index == 0)
+				return EINVAL;
 
-	/* Read code length code lengths */
-	uint16_t index;
-	for (index = 0; index < ncode; index++) {
-		length[order[index]] = get_bits(state, 3);
-		CHECK_OVERRUN(*state);
-	}
+			len = length[state->index - 1];
+			extra = 2;
+			repeat = 3;
+		} else if (symbol == 17) {
+			extra = 3;
+			repeat = 3;
+		} else {
+			extra = 7;
+			repeat = 11;
+		}
 
-	/* Set missing lengths to zero */
-	for (index = ncode; index < MAX_ORDER; index++)
-		length[order[index]] = 0;
+		if (state->bitlen < extra) {
+			state->bitbuf = bitbuf;
+			state->bitlen = bitlen;
+			return ELIMIT;
+		}
+
+		repeat += get_bits(state, extra);
+		if (state->index + repeat > total)
+			return EINVAL;
+
+		while (repeat > 0) {
+			length[state->index] = len;
+			state->index++;
+			repeat--;
+		}
+	}
 
-	/* Build Huffman code */
-	int16_t rc = huffman_construct(&dyn_len_code, length, MAX_ORDER);
-	if (rc != 0)
+	/* Check for end-of-block code */
+	if (length[256] == 0)
 		return EINVAL;
 
-	/* Read length/literal and distance code length tables */
-	index = 0;
-	while (index < nlen + ndist) {
-		uint16_t symbol;
-		errno_t err = huffman_decode(state, &dyn_len_code, &symbol);
-		if (err != EOK)
-			return EOK;
+	/* Build Huffman tables for literal/length codes */
+	state->len_bits = LEN_ROOT_BITS;
+	errno_t ret = huffman_construct(state->len_code, LEN_TABLE_SIZE,
+	    LEN_ROOT_BITS, length, state->nlen, true);
+	if (ret != EOK)
+		return ret;
 
-		if (symbol < 16) {
-			length[index] = symbol;
-			index++;
-		} else {
-			uint16_t len = 0;
+	/* Build Huffman tables for distance codes */
+	state->dist_bits = DIST_ROOT_BITS;
+	return huffman_construct(state->dist_code, DIST_TABLE_SIZE,
+	    DIST_ROOT_BITS, length + state->nlen, state->ndist, true);
+}
 
-			if (symbol == 16) {
-				if (index == 0)
-					return EINVAL;
+/** Run the decoder
+ *
+ * Decodes blocks until the last one is finished or until the decoder
+ * runs out of input or output space.
+ *
+ * @param state Inflate state.
+ *
+ * @return EOK when the last block was decoded.
+ * @return ENOENT on distance too large.
+ * @return EINVAL on invalid Huffman code or invalid deflate data.
+ * @return ELIMIT on input buffer overrun.
+ * @return ENOMEM on output buffer overrun.
+ *
+ */
+static errno_t inflate_run(inflate_state_t *state)
+{
+	errno_t ret;
+
+	while (true) {
+		switch (state->mode) {
+		case INFLATE_HEADER:
+			if (state->last) {
+				state->mode = INFLATE_DONE;
+				break;
+			}
 
-				len = length[index - 1];
-				symbol = get_bits(state, 2) + 3;
-				CHECK_OVERRUN(*state);
-			} else if (symbol == 17) {
-				symbol = get_bits(state, 3) + 3;
-				CHECK_OVERRUN(*state);
-			} else {
-				symbol = get_bits(state, 7) + 11;
-				CHECK_OVERRUN(*state);
+			if (!need_bits(state, 3))
+				return ELIMIT;
+
+			/* Last block is indicated by a non-zero bit */
+			state->last = get_bits(state, 1);
+
+			/* Block type */
+			switch (get_bits(state, 2)) {
+			case 0:
+				/* Discard bits up to the byte boundary */
+				get_bits(state, state->bitlen & 7);
+				state->mode = INFLATE_STORED_LEN;
+				break;
+			case 1:
+				inflate_fixed(state);
+				state->mode = INFLATE_CODES;
+				break;
+			case 2:
+				state->mode = INFLATE_TABLE;
+				break;
+			default:
+				return EINVAL;
 			}
+			break;
+		case INFLATE_STORED_LEN:
+			if (!need_bits(state, 32))
+				return ELIMIT;
+
+			uint16_t len = get_bits(state, 16);
+			uint16_t len_compl = get_bits(state, 16);
+
+			/* Check block length and its complement */
+			if ((len ^ len_compl) != 0xffff)
+				return EINVAL;
+
+			state->stored_left = len;
+			state->mode = INFLATE_STORED;
+			break;
+		case INFLATE_STORED:
+			ret = inflate_stored(state);
+			if (ret != EOK)
+				return ret;
+
+			state->mode = INFLATE_HEADER;
+			break;
+		case INFLATE_TABLE:
+			/* Get number of bits in each table */
+			if (!need_bits(state, 14))
+				return ELIMIT;
 
-			if (index + symbol > nlen + ndist)
+			state->nlen = get_bits(state, 5) + 257;
+			state->ndist = get_bits(state, 5) + 1;
+			state->ncode = get_bits(state, 4) + 4;
+
+			if ((state->nlen > MAX_LITLEN) ||
+			    (state->ndist > MAX_DIST))
 				return EINVAL;
 
-			while (symbol > 0) {
-				length[index] = len;
-				index++;
-				symbol--;
+			state->index = 0;
+			state->mode = INFLATE_CODELENS;
+			break;
+		case INFLATE_CODELENS:
+			/* Read code length code lengths */
+			while (state->index < state->ncode) {
+				if (!need_bits(state, 3))
+					return ELIMIT;
+
+				state->length[order[state->index]] =
+				    get_bits(state, 3);
+				state->index++;
 			}
+
+			/* Set missing lengths to zero */
+			for (; state->index < MAX_ORDER; state->index++)
+				state->length[order[state->index]] = 0;
+
+			/* Build Huffman code, borrowing the length table */
+			state->len_bits = ORDER_ROOT_BITS;
+			ret = huffman_construct(state->len_code, LEN_TABLE_SIZE,
+			    ORDER_ROOT_BITS, state->length, MAX_ORDER, false);
+			if (ret != EOK)
+				return ret;
+
+			state->index = 0;
+			state->mode = INFLATE_LENLENS;
+			break;
+		case INFLATE_LENLENS:
+			ret = inflate_lenlens(state);
+			if (ret != EOK)
+				return ret;
+
+			state->mode = INFLATE_CODES;
+			break;
+		case INFLATE_CODES:
+		case INFLATE_MATCH:
+			ret = inflate_codes(state);
+			if (ret != EOK)
+				return ret;
+
+			state->mode = INFLATE_HEADER;
+			break;
+		case INFLATE_DONE:
+			return EOK;
 		}
 	}
+}
 
-	/* Check for end-of-block code */
-	if (length[256] == 0)
-		return EINVAL;
+/** Initialize the decoder state
+ *
+ * @param state Inflate state.
+ *
+ */
+static void inflate_init(inflate_state_t *state)
+{
+	state->src = NULL;
+	state->srclen = 0;
+	state->srccnt = 0;
 
-	/* Build Huffman tables for literal/length codes */
-	rc = huffman_construct(&dyn_len_code, length, nlen);
-	if ((rc < 0) || ((rc > 0) && (dyn_len_code.count[0] + 1 != nlen)))
-		return EINVAL;
+	state->dest = NULL;
+	state->destlen = 0;
+	state->destcnt = 0;
 
-	/* Build Huffman tables for distance codes */
-	rc = huffman_construct(&dyn_dist_code, length + nlen, ndist);
-	if ((rc < 0) || ((rc > 0) && (dyn_dist_code.count[0] + 1 != ndist)))
-		return EINVAL;
+	state->bitbuf = 0;
+	state->bitlen = 0;
 
-	return inflate_codes(state, &dyn_len_code, &dyn_dist_code);
+	state->mode = INFLATE_HEADER;
+	state->last = false;
+	state->stored_left = 0;
+	state->match_len = 0;
+	state->match_dist = 0;
 }
 
 /** Inflate data
@@ -614,53 +1118,167 @@ static errno_t inflate_dynamic(inflate_state_t *state)
  * @return ENOENT on distance too large.
  * @return EINVAL on invalid Huffman code or invalid deflate data.
  * @return ELIMIT on input buffer overrun.
- * @return ENOMEM on output buffer overrun.
+ * @return ENOMEM on output buffer overrun or if the decoder
+ *                state cannot be allocated.
  *
  */
 errno_t inflate(void *src, size_t srclen, void *dest, size_t destlen)
 {
-	/* Initialize the state */
-	inflate_state_t state;
+	/* The lookup tables are too large for the stack */
+	inflate_state_t *state = malloc(sizeof(inflate_state_t));
+	if (state == NULL)
+		return ENOMEM;
 
-	state.dest = (uint8_t *) dest;
-	state.destlen = destlen;
-	state.destcnt = 0;
+	inflate_init(state);
 
-	state.src = (uint8_t *) src;
-	state.srclen = srclen;
-	state.srccnt = 0;
+	state->src = (uint8_t *) src;
+	state->srclen = srclen;
 
-	state.bitbuf = 0;
-	state.bitlen = 0;
+	state->dest = (uint8_t *) dest;
+	state->destlen = destlen;
 
-	state.overrun = false;
+	errno_t ret = inflate_run(state);
 
-	uint16_t last;
-	errno_t ret = EOK;
+	free(state);
+	return ret;
+}
 
-	do {
-		/* Last block is indicated by a non-zero bit */
-		last = get_bits(&state, 1);
-		CHECK_OVERRUN(state);
+/** Create incremental inflate state
+ *
+ * @param stream Place to store the new stream.
+ *
+ * @return EOK on success.
+ * @return ENOMEM if out of memory.
+ *
+ */
+errno_t inflate_stream_create(inflate_stream_t **stream)
+{
+	inflate_stream_t *s = malloc(sizeof(inflate_stream_t));
+	if (s == NULL)
+		return ENOMEM;
 
-		/* Block type */
-		uint16_t type = get_bits(&state, 2);
-		CHECK_OVERRUN(state);
+	inflate_init(&s->state);
 
-		switch (type) {
-		case 0:
-			ret = inflate_stored(&state);
-			break;
-		case 1:
-			ret = inflate_fixed(&state, &len_code, &dist_code);
+	s->state.src = s->input;
+	s->state.dest = s->window;
+	s->state.destlen = sizeof(s->window);
+	s->drained = 0;
+
+	*stream = s;
+	return EOK;
+}
+
+/** Destroy incremental inflate state
+ *
+ * @param stream Stream to destroy.
+ *
+ */
+void inflate_stream_destroy(inflate_stream_t *stream)
+{
+	free(stream);
+}
+
+/** Feed compressed data to the stream
+ *
+ * The data are copied into the stream's input buffer. Only a part of
+ * the data is accepted if the buffer is full; draining the stream makes
+ * room for more.
+ *
+ * @param stream   Inflate stream.
+ * @param src      Compressed data.
+ * @param srclen   Size of the compressed data (bytes).
+ * @param accepted Number of bytes accepted.
+ *
+ */
+void inflate_stream_feed(inflate_stream_t *stream, const void *src,
+    size_t srclen, size_t *accepted)
+{
+	inflate_state_t *state = &stream->state;
+
+	if (state->srccnt > 0) {
+		memmove(stream->input, stream->input + state->srccnt,
+		    state->srclen - state->srccnt);
+		state->srclen -= state->srccnt;
+		state->srccnt = 0;
+	}
+
+	size_t len = min(srclen, sizeof(stream->input) - state->srclen);
+	memcpy(stream->input + state->srclen, src, len);
+	state->srclen += len;
+
+	*accepted = len;
+}
+
+/** Drain decompressed data from the stream
+ *
+ * Decodes as much of the fed data as possible. Fewer bytes than
+ * requested are returned if more input is needed or if the end of
+ * the compressed stream was reached.
+ *
+ * @param stream  Inflate stream.
+ * @param dest    Destination buffer.
+ * @param destlen Destination buffer size (bytes).
+ * @param drained Number of bytes stored to @a dest.
+ *
+ * @return EOK on success.
+ * @return ENOENT on distance too large.
+ * @return EINVAL on invalid Huffman code or invalid deflate data.
+ *
+ */
+errno_t inflate_stream_drain(inflate_stream_t *stream, void *dest,
+    size_t destlen, size_t *drained)
+{
+	inflate_state_t *state = &stream->state;
+	size_t cnt = 0;
+	errno_t ret = EOK;
+
+	while (cnt < destlen) {
+		if (stream->drained < state->destcnt) {
+			size_t len = min(state->destcnt - stream->drained,
+			    destlen - cnt);
+			memcpy(dest + cnt, stream->window + stream->drained, len);
+			stream->drained += len;
+			cnt += len;
+			continue;
+		}
+
+		if (state->mode == INFLATE_DONE)
 			break;
-		case 2:
-			ret = inflate_dynamic(&state);
+
+		/* Everything drained, keep only the history window */
+		if (state->destcnt > WINDOW_SIZE) {
+			memmove(stream->window,
+			    stream->window + state->destcnt - WINDOW_SIZE,
+			    WINDOW_SIZE);
+			state->destcnt = WINDOW_SIZE;
+			stream->drained = WINDOW_SIZE;
+		}
+
+		ret = inflate_run(state);
+		if (ret == ELIMIT) {
+			ret = EOK;
+			if (stream->drained == state->destcnt)
+				break;
+		} else if (ret == ENOMEM) {
+			ret = EOK;
+		} else if (ret != EOK) {
 			break;
-		default:
-			ret = EINVAL;
 		}
-	} while ((!last) && (ret == 0));
+	}
 
+	*drained = cnt;
 	return ret;
 }
+
+/** Check whether the end of the compressed stream was reached
+ *
+ * @param stream Inflate stream.
+ *
+ * @return True if the last block was decoded and all data drained.
+ *
+ */
+bool inflate_stream_done(inflate_stream_t *stream)
+{
+	return (stream->state.mode == INFLATE_DONE) &&
+	    (stream->drained == stream->state.destcnt);
+}
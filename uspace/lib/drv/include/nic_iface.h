@@ -43,9 +43,20 @@
 typedef enum {
 	NIC_EV_ADDR_CHANGED = IPC_FIRST_USER_METHOD,
 	NIC_EV_RECEIVED,
-	NIC_EV_DEVICE_STATE
+	NIC_EV_DEVICE_STATE,
+	NIC_EV_RECEIVED_BATCH
 } nic_event_t;
 
+/** Header of a frame in a NIC_EV_RECEIVED_BATCH buffer.
+ *
+ * Each header is followed by the frame data, padded to a multiple
+ * of the header size.
+ */
+typedef struct {
+	/** Size of the frame in bytes */
+	size_t size;
+} nic_ev_frame_hdr_t;
+
 extern errno_t nic_send_frame(async_sess_t *, void *, size_t);
 extern errno_t nic_callback_create(async_sess_t *, async_port_handler_t, void *);
 extern errno_t nic_get_state(async_sess_t *, nic_device_state_t *);
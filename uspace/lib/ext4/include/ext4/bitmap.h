@@ -33,11 +33,16 @@
 #ifndef LIBEXT4_BITMAP_H_
 #define LIBEXT4_BITMAP_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 extern void ext4_bitmap_free_bit(uint8_t *, uint32_t);
 extern void ext4_bitmap_free_bits(uint8_t *, uint32_t, uint32_t);
 extern void ext4_bitmap_set_bit(uint8_t *, uint32_t);
+extern void ext4_bitmap_set_bits(uint8_t *, uint32_t, uint32_t);
+extern uint32_t ext4_bitmap_count_bits(uint8_t *, uint32_t, uint32_t, bool);
+extern uint32_t ext4_bitmap_count_bits_back(uint8_t *, uint32_t, uint32_t,
+    bool);
 extern bool ext4_bitmap_is_free_bit(uint8_t *, uint32_t);
 extern errno_t ext4_bitmap_find_free_byte_and_set_bit(uint8_t *, uint32_t,
     uint32_t *, uint32_t);
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/** @addtogroup libext4
+ * @{
+ */
+
+#ifndef LIBEXT4_DCACHE_H_
+#define LIBEXT4_DCACHE_H_
+
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cache of directory entries of one mounted filesystem.
+ *
+ * Maps a name in a directory to the i-node number it refers to,
+ * or records that the name does not exist (i-node number 0).
+ */
+typedef struct ext4_dcache {
+	fibril_mutex_t lock;
+	hash_table_t entries;
+	/** Entries ordered from the least recently used */
+	list_t lru;
+	size_t count;
+	/** Incremented by every change made on behalf of the directory */
+	uint64_t generation;
+} ext4_dcache_t;
+
+extern errno_t ext4_dcache_init(ext4_dcache_t *);
+extern void ext4_dcache_fini(ext4_dcache_t *);
+extern bool ext4_dcache_lookup(ext4_dcache_t *, uint32_t, const char *,
+    uint32_t *, uint64_t *);
+extern void ext4_dcache_insert(ext4_dcache_t *, uint32_t, const char *,
+    uint32_t, uint64_t);
+extern void ext4_dcache_update(ext4_dcache_t *, uint32_t, const char *,
+    uint32_t);
+extern void ext4_dcache_remove(ext4_dcache_t *, uint32_t, const char *);
+
+#endif
+
+/**
+ * @}
+ */
@@ -61,10 +61,14 @@ extern uint32_t ext4_extent_header_get_generation(ext4_extent_header_t *);
 extern void ext4_extent_header_set_generation(ext4_extent_header_t *, uint32_t);
 
 extern errno_t ext4_extent_find_block(ext4_inode_ref_t *, uint32_t, uint32_t *);
+extern errno_t ext4_extent_find_run(ext4_inode_ref_t *, uint32_t, uint32_t *,
+    uint32_t *);
 extern errno_t ext4_extent_release_blocks_from(ext4_inode_ref_t *, uint32_t);
 
 extern errno_t ext4_extent_append_block(ext4_inode_ref_t *, uint32_t *, uint32_t *,
     bool);
+extern errno_t ext4_extent_append_blocks(ext4_inode_ref_t *, uint32_t,
+    uint32_t *, uint32_t *, uint32_t *, bool);
 
 #endif
 
@@ -35,8 +35,10 @@
 #define LIBEXT4_FSTYPES_H_
 
 #include <adt/list.h>
+#include <fibril_synch.h>
 #include <libfs.h>
 #include <loc.h>
+#include "ext4/dcache.h"
 #include "ext4/types.h"
 
 /**
@@ -47,8 +49,36 @@ typedef struct ext4_instance {
 	service_id_t service_id;
 	ext4_filesystem_t *filesystem;
 	unsigned int open_nodes_count;
+
+	/** Cache of directory entries */
+	ext4_dcache_t dcache;
+
+	/** Serializes writes with delayed allocation */
+	fibril_mutex_t dalloc_lock;
+	/** List of ext4_dalloc_t with data waiting for allocation */
+	list_t dalloc_list;
+	/** Total number of bytes waiting for allocation */
+	size_t dalloc_size;
 } ext4_instance_t;
 
+/**
+ * Data appended to the end of a file which are not written yet.
+ * Blocks for the data are allocated at once when the data is flushed.
+ */
+typedef struct ext4_dalloc {
+	link_t link;
+	fs_index_t index;
+	/** File position of the first byte, equal to the i-node size */
+	aoff64_t pos;
+	/** Number of bytes waiting for allocation */
+	size_t size;
+	/** Size of the data buffer */
+	size_t capacity;
+	/** Number of blocks reserved for the data */
+	uint64_t reserved;
+	uint8_t *data;
+} ext4_dalloc_t;
+
 /**
  * Type for wrapping common fs_node and add some useful pointers.
  */
@@ -224,11 +224,27 @@ typedef struct ext4_superblock {
 	EXT4_FEATURE_RO_COMPAT_GDT_CSUM | \
 	EXT4_FEATURE_RO_COMPAT_EXTRA_ISIZE)
 
+/** Number of free extent orders tracked for each block group */
+#define EXT4_BALLOC_ORDERS  17
+
+/*
+ * Summary of free extents in the block bitmap of one group,
+ * used by the block allocator to skip groups quickly
+ */
+typedef struct ext4_balloc_group {
+	bool valid;                                /* Summary matches bitmap */
+	int max_order;                             /* Order of longest extent or -1 */
+	uint32_t free_extents[EXT4_BALLOC_ORDERS]; /* Extents of 2^order blocks or more */
+} ext4_balloc_group_t;
+
 typedef struct ext4_filesystem {
 	service_id_t device;
 	ext4_superblock_t *superblock;
 	aoff64_t inode_block_limits[4];
 	aoff64_t inode_blocks_per_level[4];
+	ext4_balloc_group_t *balloc_groups;
+	/** Free blocks reserved for data waiting for delayed allocation */
+	uint64_t dalloc_reserved;
 } ext4_filesystem_t;
 
 
@@ -381,6 +397,7 @@ typedef struct ext4_inode_ref {
 	ext4_filesystem_t *fs;
 	uint32_t index;         /* Index number of this inode */
 	bool dirty;
+	bool dalloc;            /* May use blocks reserved for delayed data */
 } ext4_inode_ref_t;
 
 
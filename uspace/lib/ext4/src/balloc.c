@@ -34,7 +34,10 @@
  * @brief Physical block allocator.
  */
 
+#include <assert.h>
 #include <errno.h>
+#include <macros.h>
+#include <mem.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include "ext4/balloc.h"
@@ -45,6 +48,133 @@
 #include "ext4/superblock.h"
 #include "ext4/types.h"
 
+/** Get order of free extent length.
+ *
+ * @param count Number of blocks
+ *
+ * @return Binary logarithm of count rounded down, capped to the
+ *         number of tracked orders
+ *
+ */
+static int ext4_balloc_order(uint32_t count)
+{
+	int order = 0;
+
+	while ((count >>= 1) != 0)
+		order++;
+
+	return min(order, EXT4_BALLOC_ORDERS - 1);
+}
+
+/** Recompute summary of free extents of a block group.
+ *
+ * @param group  Summary to compute
+ * @param bitmap Block bitmap of the group
+ * @param first  Index of the first data block in the group
+ * @param blocks Number of blocks in the group
+ *
+ */
+static void ext4_balloc_group_summarize(ext4_balloc_group_t *group,
+    uint8_t *bitmap, uint32_t first, uint32_t blocks)
+{
+	memset(group->free_extents, 0, sizeof(group->free_extents));
+	group->max_order = -1;
+
+	uint32_t idx = first;
+	while (idx < blocks) {
+		idx += ext4_bitmap_count_bits(bitmap, idx, blocks, true);
+		if (idx >= blocks)
+			break;
+
+		uint32_t len = ext4_bitmap_count_bits(bitmap, idx, blocks, false);
+		int order = ext4_balloc_order(len);
+
+		group->free_extents[order]++;
+		group->max_order = max(group->max_order, order);
+		idx += len;
+	}
+
+	group->valid = true;
+}
+
+/** Update summary of free extents of a block group.
+ *
+ * Only the free extent adjacent to the changed range is considered,
+ * so the bitmap of the group does not need to be scanned. Must be called
+ * before the bitmap is modified.
+ *
+ * @param fs     Filesystem
+ * @param bg_ref Block group
+ * @param bitmap Block bitmap of the group
+ * @param idx    Index of the first block of the range in the group
+ * @param count  Number of blocks in the range
+ * @param alloc  True if the range is being allocated, false if freed
+ *
+ */
+static void ext4_balloc_group_update(ext4_filesystem_t *fs,
+    ext4_block_group_ref_t *bg_ref, uint8_t *bitmap, uint32_t idx,
+    uint32_t count, bool alloc)
+{
+	ext4_superblock_t *sb = fs->superblock;
+	ext4_balloc_group_t *group = &fs->balloc_groups[bg_ref->index];
+
+	if (!group->valid)
+		return;
+
+	uint32_t first = ext4_filesystem_blockaddr2_index_in_group(sb,
+	    ext4_balloc_get_first_data_block_in_group(sb, bg_ref));
+	uint32_t blocks = ext4_superblock_get_blocks_in_group(sb,
+	    bg_ref->index);
+
+	/* Free blocks adjacent to the range */
+	uint32_t before = (idx > first) ?
+	    ext4_bitmap_count_bits_back(bitmap, idx, first, false) : 0;
+	uint32_t after = ext4_bitmap_count_bits(bitmap, idx + count, blocks,
+	    false);
+
+	/*
+	 * Allocation splits one free extent into the parts before and after
+	 * the range, freeing merges them back into one.
+	 */
+	uint32_t whole = before + count + after;
+	uint32_t removed[2] = { before, after };
+	uint32_t added[2] = { before, after };
+	if (alloc) {
+		removed[0] = whole;
+		removed[1] = 0;
+	} else {
+		added[0] = whole;
+		added[1] = 0;
+	}
+
+	for (unsigned int i = 0; i < 2; i++) {
+		if (removed[i] == 0)
+			continue;
+
+		int order = ext4_balloc_order(removed[i]);
+		if (group->free_extents[order] == 0) {
+			/* Summary does not match the bitmap */
+			group->valid = false;
+			return;
+		}
+
+		group->free_extents[order]--;
+	}
+
+	for (unsigned int i = 0; i < 2; i++) {
+		if (added[i] == 0)
+			continue;
+
+		int order = ext4_balloc_order(added[i]);
+		group->free_extents[order]++;
+		group->max_order = max(group->max_order, order);
+	}
+
+	while ((group->max_order >= 0) &&
+	    (group->free_extents[group->max_order] == 0))
+		group->max_order--;
+}
+
 /** Free block.
  *
  * @param inode_ref  Inode, where the block is allocated
@@ -80,6 +210,8 @@ errno_t ext4_balloc_free_block(ext4_inode_ref_t *inode_ref, uint32_t block_addr)
 	}
 
 	/* Modify bitmap */
+	ext4_balloc_group_update(fs, bg_ref, bitmap_block->data,
+	    index_in_group, 1, false);
 	ext4_bitmap_free_bit(bitmap_block->data, index_in_group);
 	bitmap_block->dirty = true;
 
@@ -153,6 +285,8 @@ static errno_t ext4_balloc_free_blocks_internal(ext4_inode_ref_t *inode_ref,
 	}
 
 	/* Modify bitmap */
+	ext4_balloc_group_update(fs, bg_ref, bitmap_block->data,
+	    index_in_group_first, count, false);
 	ext4_bitmap_free_bits(bitmap_block->data, index_in_group_first, count);
 	bitmap_block->dirty = true;
 
@@ -312,7 +446,7 @@ static errno_t ext4_balloc_find_goal(ext4_inode_ref_t *inode_ref, uint32_t *goal
 		if (rc != EOK)
 			return rc;
 
-		if (goal != 0) {
+		if (*goal != 0) {
 			(*goal)++;
 			return EOK;
 		}
@@ -335,283 +469,298 @@ static errno_t ext4_balloc_find_goal(ext4_inode_ref_t *inode_ref, uint32_t *goal
 	return ext4_filesystem_put_block_group_ref(bg_ref);
 }
 
-/** Data block allocation algorithm.
+/** Find free extent in block bitmap.
  *
- * @param inode_ref Inode to allocate block for
- * @param fblock    Allocated block address
+ * The first free extent of at least count blocks is returned. If
+ * there is no such extent, the longest free extent is returned.
  *
- * @return Error code
+ * @param bitmap Block bitmap of the group
+ * @param start  Index to start searching at
+ * @param end    Index of the first block not to search
+ * @param count  Desired number of blocks
+ * @param idx    Input/output value - index of the best extent found
+ * @param len    Input/output value - length of the best extent found
+ *
+ * @return True if an extent of at least count blocks was found
  *
  */
-errno_t ext4_balloc_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t *fblock)
+static bool ext4_balloc_find_extent(uint8_t *bitmap, uint32_t start,
+    uint32_t end, uint32_t count, uint32_t *idx, uint32_t *len)
 {
-	uint32_t allocated_block = 0;
+	uint32_t i = start;
+	while (i < end) {
+		i += ext4_bitmap_count_bits(bitmap, i, end, true);
+		if (i >= end)
+			break;
 
-	uint32_t bitmap_block_addr;
-	block_t *bitmap_block;
-	uint32_t rel_block_idx = 0;
-	uint32_t free_blocks;
-	uint32_t goal;
-	uint32_t block_size;
+		uint32_t run = ext4_bitmap_count_bits(bitmap, i, end, false);
+		if (run > *len) {
+			*idx = i;
+			*len = run;
+		}
 
-	/* Find GOAL */
-	errno_t rc = ext4_balloc_find_goal(inode_ref, &goal);
-	if (rc != EOK)
-		return rc;
+		if (run >= count)
+			return true;
 
-	ext4_superblock_t *sb = inode_ref->fs->superblock;
+		i += run;
+	}
 
-	/* Load block group number for goal and relative index */
-	uint32_t block_group = ext4_filesystem_blockaddr2group(sb, goal);
-	uint32_t index_in_group =
-	    ext4_filesystem_blockaddr2_index_in_group(sb, goal);
+	return false;
+}
+
+/** Allocate run of blocks within one block group.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param bgid      Index of block group
+ * @param goal_idx  Preferred index of the first block in the group
+ * @param count     Desired number of blocks
+ * @param min_count Minimum acceptable number of blocks
+ * @param fblock    Output value - address of the first allocated block
+ * @param allocated Output value - number of allocated blocks
+ *
+ * @return Error code, ENOSPC if there is no suitable free extent
+ *
+ */
+static errno_t ext4_balloc_alloc_in_group(ext4_inode_ref_t *inode_ref,
+    uint32_t bgid, uint32_t goal_idx, uint32_t count, uint32_t min_count,
+    uint32_t *fblock, uint32_t *allocated)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
+	ext4_balloc_group_t *group = &fs->balloc_groups[bgid];
 
 	/* Load block group reference */
 	ext4_block_group_ref_t *bg_ref;
-	rc = ext4_filesystem_get_block_group_ref(inode_ref->fs,
-	    block_group, &bg_ref);
+	errno_t rc = ext4_filesystem_get_block_group_ref(fs, bgid, &bg_ref);
 	if (rc != EOK)
 		return rc;
 
-	free_blocks =
+	uint32_t free_blocks =
 	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
 	if (free_blocks == 0) {
 		/* This group has no free blocks */
-		goto goal_failed;
+		memset(group->free_extents, 0, sizeof(group->free_extents));
+		group->max_order = -1;
+		group->valid = true;
+
+		rc = ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc == EOK ? ENOSPC : rc;
 	}
 
 	/* Compute indexes */
-	uint32_t first_in_group =
-	    ext4_balloc_get_first_data_block_in_group(sb, bg_ref);
+	uint32_t first = ext4_filesystem_blockaddr2_index_in_group(sb,
+	    ext4_balloc_get_first_data_block_in_group(sb, bg_ref));
+	uint32_t blocks = ext4_superblock_get_blocks_in_group(sb, bgid);
 
-	uint32_t first_in_group_index =
-	    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
-
-	if (index_in_group < first_in_group_index)
-		index_in_group = first_in_group_index;
+	if ((goal_idx < first) || (goal_idx >= blocks))
+		goal_idx = first;
 
 	/* Load block with bitmap */
-	bitmap_block_addr =
+	uint32_t bitmap_block_addr =
 	    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
 
-	rc = block_get(&bitmap_block, inode_ref->fs->device,
-	    bitmap_block_addr, BLOCK_FLAGS_NONE);
+	block_t *bitmap_block;
+	rc = block_get(&bitmap_block, fs->device, bitmap_block_addr,
+	    BLOCK_FLAGS_NONE);
 	if (rc != EOK) {
 		ext4_filesystem_put_block_group_ref(bg_ref);
 		return rc;
 	}
 
-	/* Check if goal is free */
-	if (ext4_bitmap_is_free_bit(bitmap_block->data, index_in_group)) {
-		ext4_bitmap_set_bit(bitmap_block->data, index_in_group);
-		bitmap_block->dirty = true;
+	uint8_t *bitmap = bitmap_block->data;
+
+	if (!group->valid)
+		ext4_balloc_group_summarize(group, bitmap, first, blocks);
+
+	/* Prefer extending the run starting at goal */
+	uint32_t idx = goal_idx;
+	uint32_t len = ext4_bitmap_count_bits(bitmap, goal_idx,
+	    min(blocks, goal_idx + count), false);
+
+	/* Otherwise look behind the goal and then from the group start */
+	if (len < min_count) {
+		if (!ext4_balloc_find_extent(bitmap, goal_idx, blocks, count,
+		    &idx, &len))
+			(void) ext4_balloc_find_extent(bitmap, first, goal_idx,
+			    count, &idx, &len);
+	}
+
+	if (len < min_count) {
+		/* No suitable free extent */
 		rc = block_put(bitmap_block);
 		if (rc != EOK) {
 			ext4_filesystem_put_block_group_ref(bg_ref);
 			return rc;
 		}
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, index_in_group,
-		    block_group);
-
-		goto success;
+		rc = ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc == EOK ? ENOSPC : rc;
 	}
 
-	uint32_t blocks_in_group =
-	    ext4_superblock_get_blocks_in_group(sb, block_group);
+	len = min(len, count);
 
-	uint32_t end_idx = (index_in_group + 63) & ~63;
-	if (end_idx > blocks_in_group)
-		end_idx = blocks_in_group;
+	/* Modify bitmap */
+	ext4_balloc_group_update(fs, bg_ref, bitmap, idx, len, true);
+	ext4_bitmap_set_bits(bitmap, idx, len);
+	bitmap_block->dirty = true;
 
-	/* Try to find free block near to goal */
-	for (uint32_t tmp_idx = index_in_group + 1; tmp_idx < end_idx;
-	    ++tmp_idx) {
-		if (ext4_bitmap_is_free_bit(bitmap_block->data, tmp_idx)) {
-			ext4_bitmap_set_bit(bitmap_block->data, tmp_idx);
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
-			if (rc != EOK)
-				return rc;
+	rc = block_put(bitmap_block);
+	if (rc != EOK) {
+		ext4_filesystem_put_block_group_ref(bg_ref);
+		return rc;
+	}
 
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, tmp_idx,
-			    block_group);
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
 
-			goto success;
-		}
-	}
+	/* Update superblock free blocks count */
+	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
+	sb_free_blocks -= len;
+	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
 
-	/* Find free BYTE in bitmap */
-	rc = ext4_bitmap_find_free_byte_and_set_bit(bitmap_block->data,
-	    index_in_group, &rel_block_idx, blocks_in_group);
-	if (rc == EOK) {
-		bitmap_block->dirty = true;
-		rc = block_put(bitmap_block);
-		if (rc != EOK)
-			return rc;
+	/* Update inode blocks (different block size!) count */
+	uint64_t ino_blocks =
+	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
+	ino_blocks += (uint64_t) len * (block_size / EXT4_INODE_BLOCK_SIZE);
+	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
+	inode_ref->dirty = true;
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-		    block_group);
+	/* Update block group free blocks count */
+	free_blocks -= len;
+	ext4_block_group_set_free_blocks_count(bg_ref->block_group, sb,
+	    free_blocks);
+	bg_ref->dirty = true;
 
-		goto success;
-	}
+	*fblock = ext4_filesystem_index_in_group2blockaddr(sb, idx, bgid);
+	*allocated = len;
 
-	/* Find free bit in bitmap */
-	rc = ext4_bitmap_find_free_bit_and_set(bitmap_block->data,
-	    index_in_group, &rel_block_idx, blocks_in_group);
-	if (rc == EOK) {
-		bitmap_block->dirty = true;
-		rc = block_put(bitmap_block);
-		if (rc != EOK)
-			return rc;
+	return ext4_filesystem_put_block_group_ref(bg_ref);
+}
 
-		allocated_block =
-		    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-		    block_group);
+/** Limit allocation so that reserved blocks are not used.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param count     Number of blocks to allocate, lowered to the number
+ *                  of blocks which may be allocated
+ *
+ * @return EOK or ENOSPC if no block may be allocated
+ *
+ */
+static errno_t ext4_balloc_check_reserved(ext4_inode_ref_t *inode_ref,
+    uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
 
-		goto success;
-	}
+	if (inode_ref->dalloc)
+		return EOK;
 
-	/* No free block found yet */
-	rc = block_put(bitmap_block);
-	if (rc != EOK) {
-		ext4_filesystem_put_block_group_ref(bg_ref);
-		return rc;
-	}
+	uint64_t free_blocks =
+	    ext4_superblock_get_free_blocks_count(fs->superblock);
+	if (free_blocks <= fs->dalloc_reserved)
+		return ENOSPC;
 
-goal_failed:
+	*count = min(*count, free_blocks - fs->dalloc_reserved);
+	return EOK;
+}
 
-	rc = ext4_filesystem_put_block_group_ref(bg_ref);
-	if (rc != EOK)
-		return rc;
+/** Multiple data blocks allocation algorithm.
+ *
+ * Allocates a run of physically contiguous blocks. The run is placed
+ * at the goal if possible, otherwise in the first free extent long
+ * enough, searching from the goal group onwards. Groups which cannot
+ * hold the run are skipped by their free extent summaries without
+ * reading their bitmaps. If no free extent is long enough, the longest
+ * available one is used and fewer blocks are allocated. Blocks reserved
+ * for data waiting for delayed allocation are used only for such data.
+ *
+ * @param inode_ref Inode to allocate blocks for
+ * @param goal      Preferred address of the first block, 0 for default
+ * @param count     Number of blocks to allocate
+ * @param fblock    Output value - address of the first allocated block
+ * @param allocated Output value - number of allocated blocks (at least 1)
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_balloc_alloc_blocks(ext4_inode_ref_t *inode_ref, uint32_t goal,
+    uint32_t count, uint32_t *fblock, uint32_t *allocated)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	ext4_superblock_t *sb = fs->superblock;
+	errno_t rc;
 
-	/* Try other block groups */
-	uint32_t block_group_count = ext4_superblock_get_block_group_count(sb);
+	assert(count > 0);
 
-	uint32_t bgid = (block_group + 1) % block_group_count;
-	uint32_t count = block_group_count;
+	rc = ext4_balloc_check_reserved(inode_ref, &count);
+	if (rc != EOK)
+		return rc;
 
-	while (count > 0) {
-		rc = ext4_filesystem_get_block_group_ref(inode_ref->fs, bgid,
-		    &bg_ref);
+	/* Find GOAL */
+	if (goal == 0) {
+		rc = ext4_balloc_find_goal(inode_ref, &goal);
 		if (rc != EOK)
 			return rc;
+	}
 
-		free_blocks =
-		    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-		if (free_blocks == 0) {
-			/* This group has no free blocks */
-			goto next_group;
-		}
+	uint32_t group_count = ext4_superblock_get_block_group_count(sb);
+	uint32_t goal_group = ext4_filesystem_blockaddr2group(sb, goal);
+	uint32_t goal_idx =
+	    ext4_filesystem_blockaddr2_index_in_group(sb, goal);
 
-		/* Load block with bitmap */
-		bitmap_block_addr =
-		    ext4_block_group_get_block_bitmap(bg_ref->block_group, sb);
+	if (goal_group >= group_count) {
+		goal_group = 0;
+		goal_idx = 0;
+	}
 
-		rc = block_get(&bitmap_block, inode_ref->fs->device,
-		    bitmap_block_addr, 0);
-		if (rc != EOK) {
-			ext4_filesystem_put_block_group_ref(bg_ref);
-			return rc;
-		}
+	int order = ext4_balloc_order(count);
 
-		/* Compute indexes */
-		first_in_group =
-		    ext4_balloc_get_first_data_block_in_group(sb, bg_ref);
-		index_in_group =
-		    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
-		blocks_in_group = ext4_superblock_get_blocks_in_group(sb, bgid);
-
-		first_in_group_index =
-		    ext4_filesystem_blockaddr2_index_in_group(sb, first_in_group);
-
-		if (index_in_group < first_in_group_index)
-			index_in_group = first_in_group_index;
-
-		/* Try to find free byte in bitmap */
-		rc = ext4_bitmap_find_free_byte_and_set_bit(bitmap_block->data,
-		    index_in_group, &rel_block_idx, blocks_in_group);
-		if (rc == EOK) {
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
-			if (rc != EOK) {
-				ext4_filesystem_put_block_group_ref(bg_ref);
-				return rc;
-			}
-
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-			    bgid);
-
-			goto success;
-		}
+	/* Look for a long enough free extent, starting at the goal */
+	for (uint32_t i = 0; i < group_count; i++) {
+		uint32_t bgid = (goal_group + i) % group_count;
+		ext4_balloc_group_t *group = &fs->balloc_groups[bgid];
 
-		/* Try to find free bit in bitmap */
-		rc = ext4_bitmap_find_free_bit_and_set(bitmap_block->data,
-		    index_in_group, &rel_block_idx, blocks_in_group);
-		if (rc == EOK) {
-			bitmap_block->dirty = true;
-			rc = block_put(bitmap_block);
-			if (rc != EOK) {
-				ext4_filesystem_put_block_group_ref(bg_ref);
-				return rc;
-			}
-
-			allocated_block =
-			    ext4_filesystem_index_in_group2blockaddr(sb, rel_block_idx,
-			    bgid);
-
-			goto success;
-		}
+		if ((group->valid) && (group->max_order < order))
+			continue;
 
-		rc = block_put(bitmap_block);
-		if (rc != EOK) {
-			ext4_filesystem_put_block_group_ref(bg_ref);
+		rc = ext4_balloc_alloc_in_group(inode_ref, bgid,
+		    (i == 0) ? goal_idx : 0, count, count, fblock, allocated);
+		if (rc != ENOSPC)
 			return rc;
-		}
-
-	next_group:
-		rc = ext4_filesystem_put_block_group_ref(bg_ref);
-		if (rc != EOK)
-			return rc;
-
-		/* Goto next group */
-		bgid = (bgid + 1) % block_group_count;
-		count--;
 	}
 
-	return ENOSPC;
+	/* Settle for the longest free extent */
+	uint32_t best = group_count;
+	for (uint32_t i = 0; i < group_count; i++) {
+		uint32_t bgid = (goal_group + i) % group_count;
+		ext4_balloc_group_t *group = &fs->balloc_groups[bgid];
 
-success:
-	block_size = ext4_superblock_get_block_size(sb);
+		if ((!group->valid) || (group->max_order < 0))
+			continue;
 
-	/* Update superblock free blocks count */
-	uint32_t sb_free_blocks = ext4_superblock_get_free_blocks_count(sb);
-	sb_free_blocks--;
-	ext4_superblock_set_free_blocks_count(sb, sb_free_blocks);
+		if ((best == group_count) ||
+		    (group->max_order > fs->balloc_groups[best].max_order))
+			best = bgid;
+	}
 
-	/* Update inode blocks (different block size!) count */
-	uint64_t ino_blocks =
-	    ext4_inode_get_blocks_count(sb, inode_ref->inode);
-	ino_blocks += block_size / EXT4_INODE_BLOCK_SIZE;
-	ext4_inode_set_blocks_count(sb, inode_ref->inode, ino_blocks);
-	inode_ref->dirty = true;
+	if (best == group_count)
+		return ENOSPC;
 
-	/* Update block group free blocks count */
-	uint32_t bg_free_blocks =
-	    ext4_block_group_get_free_blocks_count(bg_ref->block_group, sb);
-	bg_free_blocks--;
-	ext4_block_group_set_free_blocks_count(bg_ref->block_group, sb,
-	    bg_free_blocks);
-	bg_ref->dirty = true;
+	return ext4_balloc_alloc_in_group(inode_ref, best, 0, count, 1,
+	    fblock, allocated);
+}
 
-	rc = ext4_filesystem_put_block_group_ref(bg_ref);
+/** Data block allocation algorithm.
+ *
+ * @param inode_ref Inode to allocate block for
+ * @param fblock    Allocated block address
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_balloc_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t *fblock)
+{
+	uint32_t allocated;
 
-	*fblock = allocated_block;
-	return rc;
+	return ext4_balloc_alloc_blocks(inode_ref, 0, 1, fblock, &allocated);
 }
 
 /** Try to allocate concrete block.
@@ -657,6 +806,8 @@ errno_t ext4_balloc_try_alloc_block(ext4_inode_ref_t *inode_ref, uint32_t fblock
 
 	/* Allocate block if possible */
 	if (*free) {
+		ext4_balloc_group_update(fs, bg_ref, bitmap_block->data,
+		    index_in_group, 1, true);
 		ext4_bitmap_set_bit(bitmap_block->data, index_in_group);
 		bitmap_block->dirty = true;
 	}
@@ -134,6 +134,111 @@ void ext4_bitmap_set_bit(uint8_t *bitmap, uint32_t index)
 	*target |= 1 << bit_index;
 }
 
+/** Set continous set of bits (set to 1).
+ *
+ * Index and count must be checked by caller, if they aren't out of bounds.
+ *
+ * @param bitmap Pointer to bitmap
+ * @param index  Index of first bit to set
+ * @param count  Number of bits to be set
+ *
+ */
+void ext4_bitmap_set_bits(uint8_t *bitmap, uint32_t index, uint32_t count)
+{
+	uint32_t idx = index;
+	uint32_t remaining = count;
+
+	/* Align index to multiple of 8 */
+	while (((idx % 8) != 0) && (remaining > 0)) {
+		bitmap[idx / 8] |= 1 << (idx % 8);
+		idx++;
+		remaining--;
+	}
+
+	/* Set the whole bytes */
+	while (remaining >= 8) {
+		bitmap[idx / 8] = 0xff;
+		idx += 8;
+		remaining -= 8;
+	}
+
+	/* Set remaining bits */
+	while (remaining != 0) {
+		bitmap[idx / 8] |= 1 << (idx % 8);
+		idx++;
+		remaining--;
+	}
+}
+
+/** Count bits of the same state.
+ *
+ * @param bitmap Pointer to bitmap
+ * @param index  Index of first bit to check
+ * @param max    Index of the first bit not to check
+ * @param used   Count bits set to 1 (true) or to 0 (false)
+ *
+ * @return Number of consecutive bits in the requested state
+ *
+ */
+uint32_t ext4_bitmap_count_bits(uint8_t *bitmap, uint32_t index,
+    uint32_t max, bool used)
+{
+	uint8_t full = used ? 0xff : 0x00;
+	uint32_t idx = index;
+
+	while (idx < max) {
+		/* Skip whole bytes when possible */
+		if (((idx % 8) == 0) && (max - idx >= 8) &&
+		    (bitmap[idx / 8] == full)) {
+			idx += 8;
+			continue;
+		}
+
+		bool set = (bitmap[idx / 8] & (1 << (idx % 8))) != 0;
+		if (set != used)
+			break;
+
+		idx++;
+	}
+
+	return idx - index;
+}
+
+/** Count bits of the same state preceding an index.
+ *
+ * @param bitmap Pointer to bitmap
+ * @param index  Index of the first bit not to check
+ * @param min    Index of the last bit to check
+ * @param used   Count bits set to 1 (true) or to 0 (false)
+ *
+ * @return Number of consecutive bits in the requested state ending
+ *         right before @a index
+ *
+ */
+uint32_t ext4_bitmap_count_bits_back(uint8_t *bitmap, uint32_t index,
+    uint32_t min, bool used)
+{
+	uint8_t full = used ? 0xff : 0x00;
+	uint32_t idx = index;
+
+	while (idx > min) {
+		/* Skip whole bytes when possible */
+		if (((idx % 8) == 0) && (idx - min >= 8) &&
+		    (bitmap[idx / 8 - 1] == full)) {
+			idx -= 8;
+			continue;
+		}
+
+		bool set = (bitmap[(idx - 1) / 8] & (1 << ((idx - 1) % 8))) != 0;
+		if (set != used)
+			break;
+
+		idx--;
+	}
+
+	return index - idx;
+}
+
 /** Check if requested bit is free.
  *
  * @param bitmap Pointer to bitmap
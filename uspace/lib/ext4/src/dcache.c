@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/** @addtogroup libext4
+ * @{
+ */
+/**
+ * @file  dcache.c
+ * @brief Cache of directory entries.
+ *
+ * Entries are looked up by directory i-node number and name. Both
+ * found and missing names are cached. The cache is kept coherent by
+ * updating the entry whenever a name is linked or unlinked, and results
+ * of searches which could have overlapped such change are not cached.
+ *
+ * '.' and '..' are never cached, so a removed directory leaves behind
+ * only negative entries, which are also valid for a new empty directory
+ * reusing its i-node.
+ */
+
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <errno.h>
+#include <mem.h>
+#include <stdlib.h>
+#include <str.h>
+#include "ext4/dcache.h"
+
+/** Maximum number of cached entries of one filesystem */
+#define EXT4_DCACHE_MAX_ENTRIES  16384
+
+typedef struct {
+	ht_link_t link;
+	link_t lru_link;
+	uint32_t dir;
+	/** Referenced i-node, 0 if the name does not exist */
+	uint32_t inode;
+	size_t name_len;
+	char name[];
+} ext4_dcache_entry_t;
+
+typedef struct {
+	uint32_t dir;
+	const char *name;
+	size_t name_len;
+} ext4_dcache_key_t;
+
+static size_t ext4_dcache_hash_name(uint32_t dir, const char *name,
+    size_t name_len)
+{
+	size_t hash = dir;
+
+	for (size_t i = 0; i < name_len; i++)
+		hash = hash * 31 + (uint8_t) name[i];
+
+	return hash_mix(hash);
+}
+
+static size_t ext4_dcache_key_hash(void *arg)
+{
+	ext4_dcache_key_t *key = (ext4_dcache_key_t *) arg;
+	return ext4_dcache_hash_name(key->dir, key->name, key->name_len);
+}
+
+static size_t ext4_dcache_hash(const ht_link_t *item)
+{
+	ext4_dcache_entry_t *entry =
+	    hash_table_get_inst(item, ext4_dcache_entry_t, link);
+	return ext4_dcache_hash_name(entry->dir, entry->name, entry->name_len);
+}
+
+static bool ext4_dcache_key_equal(void *arg, const ht_link_t *item)
+{
+	ext4_dcache_key_t *key = (ext4_dcache_key_t *) arg;
+	ext4_dcache_entry_t *entry =
+	    hash_table_get_inst(item, ext4_dcache_entry_t, link);
+
+	return (key->dir == entry->dir) && (key->name_len == entry->name_len) &&
+	    (memcmp(key->name, entry->name, key->name_len) == 0);
+}
+
+static void ext4_dcache_remove_callback(ht_link_t *item)
+{
+	ext4_dcache_entry_t *entry =
+	    hash_table_get_inst(item, ext4_dcache_entry_t, link);
+
+	list_remove(&entry->lru_link);
+	free(entry);
+}
+
+static hash_table_ops_t ext4_dcache_ops = {
+	.hash = ext4_dcache_hash,
+	.key_hash = ext4_dcache_key_hash,
+	.key_equal = ext4_dcache_key_equal,
+	.equal = NULL,
+	.remove_callback = ext4_dcache_remove_callback
+};
+
+static bool ext4_dcache_is_dots(const char *name, size_t name_len)
+{
+	if ((name_len == 0) || (name_len > 2) || (name[0] != '.'))
+		return false;
+
+	return (name_len == 1) || (name[1] == '.');
+}
+
+/** Initialize empty directory entry cache.
+ *
+ * @param dcache Cache to initialize
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_dcache_init(ext4_dcache_t *dcache)
+{
+	if (!hash_table_create(&dcache->entries, 0, 0, &ext4_dcache_ops))
+		return ENOMEM;
+
+	fibril_mutex_initialize(&dcache->lock);
+	list_initialize(&dcache->lru);
+	dcache->count = 0;
+	dcache->generation = 0;
+
+	return EOK;
+}
+
+/** Destroy directory entry cache and all its entries.
+ *
+ * @param dcache Cache to destroy
+ *
+ */
+void ext4_dcache_fini(ext4_dcache_t *dcache)
+{
+	hash_table_clear(&dcache->entries);
+	hash_table_destroy(&dcache->entries);
+	dcache->count = 0;
+}
+
+/** Look up name in directory.
+ *
+ * @param dcache     Cache to look into
+ * @param dir        Directory i-node number
+ * @param name       Name to look up
+ * @param inode      Output i-node number, 0 if the name is known not to exist
+ * @param generation Output generation of the cache to be passed to
+ *                   ext4_dcache_insert() after the directory is searched
+ *
+ * @return True if the result is known, false if the directory
+ *         has to be searched
+ *
+ */
+bool ext4_dcache_lookup(ext4_dcache_t *dcache, uint32_t dir,
+    const char *name, uint32_t *inode, uint64_t *generation)
+{
+	ext4_dcache_key_t key = {
+		.dir = dir,
+		.name = name,
+		.name_len = str_size(name)
+	};
+
+	fibril_mutex_lock(&dcache->lock);
+
+	*generation = dcache->generation;
+
+	ht_link_t *item = hash_table_find(&dcache->entries, &key);
+	if (item == NULL) {
+		fibril_mutex_unlock(&dcache->lock);
+		return false;
+	}
+
+	ext4_dcache_entry_t *entry =
+	    hash_table_get_inst(item, ext4_dcache_entry_t, link);
+
+	/* Move to the most recently used end */
+	list_remove(&entry->lru_link);
+	list_append(&entry->lru_link, &dcache->lru);
+
+	*inode = entry->inode;
+
+	fibril_mutex_unlock(&dcache->lock);
+	return true;
+}
+
+/** Set cached entry, the cache must be locked.
+ *
+ * Replaces previous entry with the same name. If the cache is full,
+ * the least recently used entry is dropped. Failure to allocate
+ * the entry is not an error, the name is just not cached.
+ *
+ * @param dcache Cache to insert to
+ * @param dir    Directory i-node number
+ * @param name   Name in the directory
+ * @param inode  I-node number the name refers to, 0 if it does not exist
+ *
+ */
+static void ext4_dcache_set(ext4_dcache_t *dcache, uint32_t dir,
+    const char *name, uint32_t inode)
+{
+	size_t name_len = str_size(name);
+	if (ext4_dcache_is_dots(name, name_len))
+		return;
+
+	ext4_dcache_key_t key = {
+		.dir = dir,
+		.name = name,
+		.name_len = name_len
+	};
+
+	ht_link_t *item = hash_table_find(&dcache->entries, &key);
+	if (item != NULL) {
+		ext4_dcache_entry_t *entry =
+		    hash_table_get_inst(item, ext4_dcache_entry_t, link);
+
+		entry->inode = inode;
+		list_remove(&entry->lru_link);
+		list_append(&entry->lru_link, &dcache->lru);
+		return;
+	}
+
+	/* Drop the least recently used entry if the cache is full */
+	if (dcache->count >= EXT4_DCACHE_MAX_ENTRIES) {
+		ext4_dcache_entry_t *lru = list_get_instance(
+		    list_first(&dcache->lru), ext4_dcache_entry_t, lru_link);
+
+		hash_table_remove_item(&dcache->entries, &lru->link);
+		dcache->count--;
+	}
+
+	ext4_dcache_entry_t *entry =
+	    malloc(sizeof(ext4_dcache_entry_t) + name_len);
+	if (entry == NULL)
+		return;
+
+	link_initialize(&entry->lru_link);
+	entry->dir = dir;
+	entry->inode = inode;
+	entry->name_len = name_len;
+	memcpy(entry->name, name, name_len);
+
+	hash_table_insert(&dcache->entries, &entry->link);
+	list_append(&entry->lru_link, &dcache->lru);
+	dcache->count++;
+}
+
+/** Remember result of a directory search.
+ *
+ * The result is dropped if the directory could have changed since
+ * the failed lookup, which returned the generation.
+ *
+ * @param dcache     Cache to insert to
+ * @param dir        Directory i-node number
+ * @param name       Name in the directory
+ * @param inode      I-node number the name refers to, 0 if it does not exist
+ * @param generation Generation returned by ext4_dcache_lookup()
+ *
+ */
+void ext4_dcache_insert(ext4_dcache_t *dcache, uint32_t dir,
+    const char *name, uint32_t inode, uint64_t generation)
+{
+	fibril_mutex_lock(&dcache->lock);
+
+	if (dcache->generation == generation)
+		ext4_dcache_set(dcache, dir, name, inode);
+
+	fibril_mutex_unlock(&dcache->lock);
+}
+
+/** Record name linked to or unlinked from directory.
+ *
+ * @param dcache Cache to update
+ * @param dir    Directory i-node number
+ * @param name   Name in the directory
+ * @param inode  I-node number the name refers to, 0 if it was removed
+ *
+ */
+void ext4_dcache_update(ext4_dcache_t *dcache, uint32_t dir,
+    const char *name, uint32_t inode)
+{
+	fibril_mutex_lock(&dcache->lock);
+
+	dcache->generation++;
+	ext4_dcache_set(dcache, dir, name, inode);
+
+	fibril_mutex_unlock(&dcache->lock);
+}
+
+/** Forget name in directory before it is changed.
+ *
+ * @param dcache Cache to remove from
+ * @param dir    Directory i-node number
+ * @param name   Name in the directory
+ *
+ */
+void ext4_dcache_remove(ext4_dcache_t *dcache, uint32_t dir,
+    const char *name)
+{
+	ext4_dcache_key_t key = {
+		.dir = dir,
+		.name = name,
+		.name_len = str_size(name)
+	};
+
+	fibril_mutex_lock(&dcache->lock);
+
+	dcache->generation++;
+	dcache->count -= hash_table_remove(&dcache->entries, &key);
+
+	fibril_mutex_unlock(&dcache->lock);
+}
+
+/**
+ * @}
+ */
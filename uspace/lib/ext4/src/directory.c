@@ -168,6 +168,22 @@ void ext4_directory_entry_ll_set_inode_type(ext4_superblock_t *sb,
 	/* Else do nothing */
 }
 
+/** Check if name is '.' or '..'.
+ *
+ * @param name     Name to check
+ * @param name_len Length of the name
+ *
+ * @return True if the name is one of dot entries
+ *
+ */
+static bool ext4_directory_is_dots(const char *name, size_t name_len)
+{
+	if ((name_len == 0) || (name_len > 2) || (name[0] != '.'))
+		return false;
+
+	return (name_len == 1) || (name[1] == '.');
+}
+
 static errno_t ext4_directory_iterator_seek(ext4_directory_iterator_t *, aoff64_t);
 static errno_t ext4_directory_iterator_set(ext4_directory_iterator_t *, uint32_t);
 
@@ -442,6 +458,21 @@ errno_t ext4_directory_add_entry(ext4_inode_ref_t *parent, const char *name,
 			return EOK;
 	}
 
+	/*
+	 * The only block is full - convert the directory to indexed
+	 * one instead of growing it linearly (as Linux does)
+	 */
+	if ((total_blocks == 1) &&
+	    (ext4_superblock_has_feature_compatible(fs->superblock,
+	    EXT4_FEATURE_COMPAT_DIR_INDEX)) &&
+	    (!ext4_inode_has_flag(parent->inode, EXT4_INODE_FLAG_INDEX))) {
+		errno_t rc = ext4_directory_dx_make_indexed(parent);
+		if (rc != EOK)
+			return rc;
+
+		return ext4_directory_dx_add_entry(parent, child, name);
+	}
+
 	/* No free block found - needed to allocate next data block */
 
 	iblock = 0;
@@ -485,10 +516,14 @@ errno_t ext4_directory_find_entry(ext4_directory_search_result_t *result,
 
 	ext4_superblock_t *sb = parent->fs->superblock;
 
-	/* Index search */
+	/*
+	 * Index search ('.' and '..' are not in the index, they are
+	 * found by the linear search in the first block)
+	 */
 	if ((ext4_superblock_has_feature_compatible(sb,
 	    EXT4_FEATURE_COMPAT_DIR_INDEX)) &&
-	    (ext4_inode_has_flag(parent->inode, EXT4_INODE_FLAG_INDEX))) {
+	    (ext4_inode_has_flag(parent->inode, EXT4_INODE_FLAG_INDEX)) &&
+	    (!ext4_directory_is_dots(name, name_len))) {
 		errno_t rc = ext4_directory_dx_find_entry(result, parent, name_len,
 		    name);
 
@@ -34,6 +34,7 @@
  * @brief Ext4 directory index operations.
  */
 
+#include <align.h>
 #include <byteorder.h>
 #include <errno.h>
 #include <mem.h>
@@ -237,6 +238,9 @@ void ext4_directory_dx_entry_set_block(ext4_directory_dx_entry_t *entry,
  */
 errno_t ext4_directory_dx_init(ext4_inode_ref_t *dir)
 {
+	uint32_t block_size =
+	    ext4_superblock_get_block_size(dir->fs->superblock);
+
 	/* Load block 0, where will be index root located */
 	uint32_t fblock;
 	errno_t rc = ext4_filesystem_get_inode_data_block_index(dir, 0,
@@ -257,6 +261,10 @@ errno_t ext4_directory_dx_init(ext4_inode_ref_t *dir)
 	uint8_t hash_version =
 	    ext4_superblock_get_default_hash_version(dir->fs->superblock);
 
+	/* The '..' entry covers the rest of the block for linear readers */
+	root->dots[1].entry_length = host2uint16_t_le(block_size -
+	    sizeof(ext4_directory_dx_dot_entry_t));
+
 	ext4_directory_dx_root_info_set_hash_version(info, hash_version);
 	ext4_directory_dx_root_info_set_indirect_levels(info, 0);
 	ext4_directory_dx_root_info_set_info_length(info, 8);
@@ -266,8 +274,6 @@ errno_t ext4_directory_dx_init(ext4_inode_ref_t *dir)
 	    (ext4_directory_dx_countlimit_t *) &root->entries;
 	ext4_directory_dx_countlimit_set_count(countlimit, 1);
 
-	uint32_t block_size =
-	    ext4_superblock_get_block_size(dir->fs->superblock);
 	uint32_t entry_space =
 	    block_size - 2 * sizeof(ext4_directory_dx_dot_entry_t) -
 	    sizeof(ext4_directory_dx_root_info_t);
@@ -310,6 +316,125 @@ errno_t ext4_directory_dx_init(ext4_inode_ref_t *dir)
 	return block_put(block);
 }
 
+/** Convert linear directory with single full block to indexed directory.
+ *
+ * Entries following '.' and '..' are moved to a new block which becomes
+ * the only leaf of the index, and block 0 is turned into the index root.
+ *
+ * @param dir Pointer to directory i-node
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_directory_dx_make_indexed(ext4_inode_ref_t *dir)
+{
+	ext4_superblock_t *sb = dir->fs->superblock;
+	uint32_t block_size = ext4_superblock_get_block_size(sb);
+
+	uint32_t fblock;
+	errno_t rc = ext4_filesystem_get_inode_data_block_index(dir, 0,
+	    &fblock);
+	if (rc != EOK)
+		return rc;
+
+	uint8_t *buffer = calloc(1, block_size);
+	if (buffer == NULL)
+		return ENOMEM;
+
+	block_t *block;
+	rc = block_get(&block, dir->fs->device, fblock, BLOCK_FLAGS_NONE);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+
+	/* Skip '.' and '..' which always come first */
+	uint32_t offset = 0;
+	for (unsigned int i = 0; i < 2; i++) {
+		ext4_directory_entry_ll_t *dentry = block->data + offset;
+		uint16_t entry_length =
+		    ext4_directory_entry_ll_get_entry_length(dentry);
+		if ((entry_length == 0) || (offset + entry_length > block_size)) {
+			block_put(block);
+			free(buffer);
+			return EINVAL;
+		}
+
+		offset += entry_length;
+	}
+
+	/* Pack remaining valid entries to the buffer */
+	ext4_directory_entry_ll_t *last = NULL;
+	uint32_t used = 0;
+	while (offset + 8 <= block_size) {
+		ext4_directory_entry_ll_t *dentry = block->data + offset;
+		uint16_t entry_length =
+		    ext4_directory_entry_ll_get_entry_length(dentry);
+		if ((entry_length == 0) || (offset + entry_length > block_size))
+			break;
+
+		if (ext4_directory_entry_ll_get_inode(dentry) != 0) {
+			uint16_t name_len =
+			    ext4_directory_entry_ll_get_name_length(sb, dentry);
+			uint32_t rec_len = ALIGN_UP(8 + name_len, 4);
+
+			last = (ext4_directory_entry_ll_t *) (buffer + used);
+			memcpy(last, dentry, rec_len);
+			ext4_directory_entry_ll_set_entry_length(last, rec_len);
+			used += rec_len;
+		}
+
+		offset += entry_length;
+	}
+
+	rc = block_put(block);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+
+	/* The last entry covers the rest of the block */
+	if (last != NULL) {
+		ext4_directory_entry_ll_set_entry_length(last,
+		    block_size - ((uint8_t *) last - buffer));
+	} else {
+		ext4_directory_entry_ll_set_entry_length(
+		    (ext4_directory_entry_ll_t *) buffer, block_size);
+	}
+
+	/* Create root in block 0 and the empty leaf in block 1 */
+	rc = ext4_directory_dx_init(dir);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+
+	rc = ext4_filesystem_get_inode_data_block_index(dir, 1, &fblock);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+
+	rc = block_get(&block, dir->fs->device, fblock, BLOCK_FLAGS_NOREAD);
+	if (rc != EOK) {
+		free(buffer);
+		return rc;
+	}
+
+	memcpy(block->data, buffer, block_size);
+	block->dirty = true;
+	free(buffer);
+
+	rc = block_put(block);
+	if (rc != EOK)
+		return rc;
+
+	ext4_inode_set_flag(dir->inode, EXT4_INODE_FLAG_INDEX);
+	dir->dirty = true;
+
+	return EOK;
+}
+
 /** Initialize hash info structure necessary for index operations.
  *
  * @param hinfo      Pointer to hinfo to be initialized
@@ -480,7 +605,8 @@ static errno_t ext4_directory_dx_get_leaf(ext4_hash_info_t *hinfo,
  * @param dx_block  Current block
  * @param dx_blocks Array with path from root to leaf node
  *
- * @return Error code
+ * @return ENOENT if the next leaf has to be searched too,
+ *         EOK if the search is finished, other error code on failure
  *
  */
 static errno_t ext4_directory_dx_next_block(ext4_inode_ref_t *inode_ref,
@@ -510,7 +636,7 @@ static errno_t ext4_directory_dx_next_block(ext4_inode_ref_t *inode_ref,
 	uint32_t current_hash = ext4_directory_dx_entry_get_hash(p->position);
 	if ((hash & 1) == 0) {
 		if ((current_hash & ~1) != hash)
-			return 0;
+			return EOK;
 	}
 
 	/* Fill new path */
@@ -638,7 +764,7 @@ errno_t ext4_directory_dx_find_entry(ext4_directory_search_result_t *result,
 		/* check if the next block could be checked */
 		rc = ext4_directory_dx_next_block(inode_ref, hinfo.hash,
 		    dx_block, &dx_blocks[0]);
-		if (rc != EOK)
+		if ((rc != EOK) && (rc != ENOENT))
 			goto cleanup;
 
 	} while (rc == ENOENT);
@@ -833,7 +959,7 @@ static errno_t ext4_directory_dx_split_data(ext4_inode_ref_t *inode_ref,
 
 	/* Check hash collision */
 	uint32_t continued = 0;
-	if (new_hash == sort_array[mid - 1].hash)
+	if ((mid > 0) && (new_hash == sort_array[mid - 1].hash))
 		continued = 1;
 
 	uint32_t offset = 0;
@@ -887,25 +1013,50 @@ static errno_t ext4_directory_dx_split_data(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
+/** Initialize empty index node.
+ *
+ * The node starts with a fake directory entry covering the whole block,
+ * so that linear readers skip it.
+ *
+ * @param block      Block holding the node
+ * @param block_size Size of the block
+ *
+ * @return Pointer to entries of the node
+ *
+ */
+static ext4_directory_dx_entry_t *ext4_directory_dx_node_init(block_t *block,
+    uint32_t block_size)
+{
+	ext4_directory_dx_node_t *node = block->data;
+
+	memset(&node->fake, 0, sizeof(ext4_fake_directory_entry_t));
+	node->fake.entry_length = host2uint16_t_le(block_size);
+
+	uint32_t entry_space = block_size - sizeof(ext4_fake_directory_entry_t);
+	uint32_t node_limit = entry_space / sizeof(ext4_directory_dx_entry_t);
+	ext4_directory_dx_countlimit_set_limit(
+	    (ext4_directory_dx_countlimit_t *) node->entries, node_limit);
+
+	return node->entries;
+}
+
 /** Split index node and maybe some parent nodes in the tree hierarchy.
+ *
+ * If a second level of the index is created, the path in dx_blocks
+ * is extended and dx_block is moved to the new node.
  *
  * @param inode_ref Directory i-node
  * @param dx_blocks Array with path from root to leaf node
- * @param dx_block  Leaf block to be split if needed
+ * @param dx_block  Leaf block to be split if needed, updated on output
  *
  * @return Error code
  *
  */
 static errno_t ext4_directory_dx_split_index(ext4_inode_ref_t *inode_ref,
-    ext4_directory_dx_block_t *dx_blocks, ext4_directory_dx_block_t *dx_block)
+    ext4_directory_dx_block_t *dx_blocks, ext4_directory_dx_block_t **dx_block)
 {
-	ext4_directory_dx_entry_t *entries;
-	if (dx_block == dx_blocks)
-		entries =
-		    ((ext4_directory_dx_root_t *) dx_block->block->data)->entries;
-	else
-		entries =
-		    ((ext4_directory_dx_node_t *) dx_block->block->data)->entries;
+	ext4_directory_dx_block_t *leaf = *dx_block;
+	ext4_directory_dx_entry_t *entries = leaf->entries;
 
 	ext4_directory_dx_countlimit_t *countlimit =
 	    (ext4_directory_dx_countlimit_t *) entries;
@@ -916,122 +1067,110 @@ static errno_t ext4_directory_dx_split_index(ext4_inode_ref_t *inode_ref,
 	    ext4_directory_dx_countlimit_get_count(countlimit);
 
 	/* Check if is necessary to split index block */
-	if (leaf_limit == leaf_count) {
-		size_t levels = dx_block - dx_blocks;
-
-		ext4_directory_dx_entry_t *root_entries =
-		    ((ext4_directory_dx_root_t *) dx_blocks[0].block->data)->entries;
-
-		ext4_directory_dx_countlimit_t *root_countlimit =
-		    (ext4_directory_dx_countlimit_t *) root_entries;
-		uint16_t root_limit =
-		    ext4_directory_dx_countlimit_get_limit(root_countlimit);
-		uint16_t root_count =
-		    ext4_directory_dx_countlimit_get_count(root_countlimit);
-
-		/* Linux limitation */
-		if ((levels > 0) && (root_limit == root_count))
-			return ENOSPC;
-
-		/* Add new block to directory */
-		uint32_t new_fblock;
-		uint32_t new_iblock;
-		errno_t rc = ext4_filesystem_append_inode_block(inode_ref,
-		    &new_fblock, &new_iblock);
-		if (rc != EOK)
-			return rc;
+	if (leaf_limit != leaf_count)
+		return EOK;
 
-		/* load new block */
-		block_t *new_block;
-		rc = block_get(&new_block, inode_ref->fs->device,
-		    new_fblock, BLOCK_FLAGS_NOREAD);
-		if (rc != EOK)
-			return rc;
+	size_t levels = leaf - dx_blocks;
+
+	ext4_directory_dx_entry_t *root_entries = dx_blocks[0].entries;
+	ext4_directory_dx_countlimit_t *root_countlimit =
+	    (ext4_directory_dx_countlimit_t *) root_entries;
+	uint16_t root_limit =
+	    ext4_directory_dx_countlimit_get_limit(root_countlimit);
+	uint16_t root_count =
+	    ext4_directory_dx_countlimit_get_count(root_countlimit);
 
-		ext4_directory_dx_node_t *new_node = new_block->data;
-		ext4_directory_dx_entry_t *new_entries = new_node->entries;
+	/* Linux limitation */
+	if ((levels > 0) && (root_limit == root_count))
+		return ENOSPC;
 
-		uint32_t block_size =
-		    ext4_superblock_get_block_size(inode_ref->fs->superblock);
+	/* Add new block to directory */
+	uint32_t new_fblock;
+	uint32_t new_iblock;
+	errno_t rc = ext4_filesystem_append_inode_block(inode_ref,
+	    &new_fblock, &new_iblock);
+	if (rc != EOK)
+		return rc;
 
+	/* load new block */
+	block_t *new_block;
+	rc = block_get(&new_block, inode_ref->fs->device,
+	    new_fblock, BLOCK_FLAGS_NOREAD);
+	if (rc != EOK)
+		return rc;
+
+	uint32_t block_size =
+	    ext4_superblock_get_block_size(inode_ref->fs->superblock);
+	ext4_directory_dx_entry_t *new_entries =
+	    ext4_directory_dx_node_init(new_block, block_size);
+	ext4_directory_dx_countlimit_t *new_countlimit =
+	    (ext4_directory_dx_countlimit_t *) new_entries;
+
+	new_block->dirty = true;
+	leaf->block->dirty = true;
+
+	if (levels > 0) {
 		/* Split leaf node */
-		if (levels > 0) {
-			uint32_t count_left = leaf_count / 2;
-			uint32_t count_right = leaf_count - count_left;
-			uint32_t hash_right =
-			    ext4_directory_dx_entry_get_hash(entries + count_left);
-
-			/* Copy data to new node */
-			memcpy((void *) new_entries, (void *) (entries + count_left),
-			    count_right * sizeof(ext4_directory_dx_entry_t));
-
-			/* Initialize new node */
-			ext4_directory_dx_countlimit_t *left_countlimit =
-			    (ext4_directory_dx_countlimit_t *) entries;
-			ext4_directory_dx_countlimit_t *right_countlimit =
-			    (ext4_directory_dx_countlimit_t *) new_entries;
-
-			ext4_directory_dx_countlimit_set_count(left_countlimit, count_left);
-			ext4_directory_dx_countlimit_set_count(right_countlimit, count_right);
-
-			uint32_t entry_space =
-			    block_size - sizeof(ext4_fake_directory_entry_t);
-			uint32_t node_limit =
-			    entry_space / sizeof(ext4_directory_dx_entry_t);
-			ext4_directory_dx_countlimit_set_limit(right_countlimit, node_limit);
-
-			/* Which index block is target for new entry */
-			uint32_t position_index = (dx_block->position - dx_block->entries);
-			if (position_index >= count_left) {
-				dx_block->block->dirty = true;
-
-				block_t *block_tmp = dx_block->block;
-				dx_block->block = new_block;
-				dx_block->position =
-				    new_entries + position_index - count_left;
-				dx_block->entries = new_entries;
-
-				new_block = block_tmp;
-			}
-
-			/* Finally insert new entry */
-			ext4_directory_dx_insert_entry(dx_blocks, hash_right, new_iblock);
-
-			return block_put(new_block);
-		} else {
-			/* Create second level index */
-
-			/* Copy data from root to child block */
-			memcpy((void *) new_entries, (void *) entries,
-			    leaf_count * sizeof(ext4_directory_dx_entry_t));
-
-			ext4_directory_dx_countlimit_t *new_countlimit =
-			    (ext4_directory_dx_countlimit_t *) new_entries;
-
-			uint32_t entry_space =
-			    block_size - sizeof(ext4_fake_directory_entry_t);
-			uint32_t node_limit =
-			    entry_space / sizeof(ext4_directory_dx_entry_t);
-			ext4_directory_dx_countlimit_set_limit(new_countlimit, node_limit);
-
-			/* Set values in root node */
-			ext4_directory_dx_countlimit_t *new_root_countlimit =
-			    (ext4_directory_dx_countlimit_t *) entries;
-
-			ext4_directory_dx_countlimit_set_count(new_root_countlimit, 1);
-			ext4_directory_dx_entry_set_block(entries, new_iblock);
-
-			((ext4_directory_dx_root_t *)
-			    dx_blocks[0].block->data)->info.indirect_levels = 1;
-
-			/* Add new entry to the path */
-			dx_block = dx_blocks + 1;
-			dx_block->position = dx_block->position - entries + new_entries;
-			dx_block->entries = new_entries;
-			dx_block->block = new_block;
+		uint32_t count_left = leaf_count / 2;
+		uint32_t count_right = leaf_count - count_left;
+		uint32_t hash_right =
+		    ext4_directory_dx_entry_get_hash(entries + count_left);
+
+		/*
+		 * Copy data to new node, keeping its limit which
+		 * shares space with the first entry
+		 */
+		uint16_t node_limit =
+		    ext4_directory_dx_countlimit_get_limit(new_countlimit);
+		memcpy((void *) new_entries, (void *) (entries + count_left),
+		    count_right * sizeof(ext4_directory_dx_entry_t));
+		ext4_directory_dx_countlimit_set_limit(new_countlimit, node_limit);
+
+		ext4_directory_dx_countlimit_set_count(countlimit, count_left);
+		ext4_directory_dx_countlimit_set_count(new_countlimit, count_right);
+
+		/* Which index block is target for new entry */
+		uint32_t position_index = leaf->position - leaf->entries;
+		if (position_index >= count_left) {
+			block_t *block_tmp = leaf->block;
+			leaf->block = new_block;
+			leaf->position = new_entries + position_index - count_left;
+			leaf->entries = new_entries;
+
+			new_block = block_tmp;
 		}
+
+		/* Finally insert new entry */
+		ext4_directory_dx_insert_entry(dx_blocks, hash_right, new_iblock);
+
+		return block_put(new_block);
 	}
 
+	/* Create second level index */
+
+	/* Move all entries from root to the new node */
+	uint16_t node_limit =
+	    ext4_directory_dx_countlimit_get_limit(new_countlimit);
+	memcpy((void *) new_entries, (void *) entries,
+	    leaf_count * sizeof(ext4_directory_dx_entry_t));
+	ext4_directory_dx_countlimit_set_limit(new_countlimit, node_limit);
+
+	/* Root now has the only entry pointing to the new node */
+	ext4_directory_dx_countlimit_set_count(countlimit, 1);
+	ext4_directory_dx_entry_set_block(entries, new_iblock);
+
+	ext4_directory_dx_root_t *root = dx_blocks[0].block->data;
+	ext4_directory_dx_root_info_set_indirect_levels(&root->info, 1);
+
+	/* Add new node to the path */
+	ext4_directory_dx_block_t *node = dx_blocks + 1;
+	node->block = new_block;
+	node->entries = new_entries;
+	node->position = new_entries + (dx_blocks[0].position - entries);
+
+	dx_blocks[0].position = entries;
+
+	*dx_block = node;
 	return EOK;
 }
 
@@ -1114,7 +1253,7 @@ errno_t ext4_directory_dx_add_entry(ext4_inode_ref_t *parent,
 	 * Check if there is needed to split index node
 	 * (and recursively also parent nodes)
 	 */
-	rc = ext4_directory_dx_split_index(parent, dx_blocks, dx_block);
+	rc = ext4_directory_dx_split_index(parent, dx_blocks, &dx_block);
 	if (rc != EOK)
 		goto release_target_index;
 
@@ -1138,9 +1277,9 @@ errno_t ext4_directory_dx_add_entry(ext4_inode_ref_t *parent,
 		    child, name, name_len);
 
 	/* Cleanup */
-	rc = block_put(new_block);
-	if (rc != EOK)
-		return rc;
+	rc2 = block_put(new_block);
+	if (rc == EOK)
+		rc = rc2;
 
 	/* Cleanup operations */
 
@@ -373,6 +373,30 @@ static void ext4_extent_binsearch(ext4_extent_header_t *header,
  */
 errno_t ext4_extent_find_block(ext4_inode_ref_t *inode_ref, uint32_t iblock,
     uint32_t *fblock)
+{
+	uint32_t count;
+	return ext4_extent_find_run(inode_ref, iblock, fblock, &count);
+}
+
+/** Find run of physically contiguous blocks in the extent tree.
+ *
+ * Maps logical block iblock and reports how many following logical
+ * blocks are mapped contiguously by the same extent. Blocks not covered
+ * by any extent are reported as a run with physical address 0.
+ *
+ * There is no need to save path in the tree during this algorithm.
+ *
+ * @param inode_ref I-node to load blocks from
+ * @param iblock    Logical number of the first block of the run
+ * @param fblock    Output value for physical number of the first block,
+ *                  0 if the run is not allocated
+ * @param count     Output value for number of blocks in the run (at least 1)
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_extent_find_run(ext4_inode_ref_t *inode_ref, uint32_t iblock,
+    uint32_t *fblock, uint32_t *count)
 {
 	errno_t rc = EOK;
 	/* Compute bound defined by i-node size */
@@ -384,11 +408,12 @@ errno_t ext4_extent_find_block(ext4_inode_ref_t *inode_ref, uint32_t iblock,
 
 	uint32_t last_idx = (inode_size - 1) / block_size;
 
+	*fblock = 0;
+	*count = 1;
+
 	/* Check if requested iblock is not over size of i-node */
-	if (iblock > last_idx) {
-		*fblock = 0;
+	if ((inode_size == 0) || (iblock > last_idx))
 		return EOK;
-	}
 
 	block_t *block = NULL;
 
@@ -423,17 +448,30 @@ errno_t ext4_extent_find_block(ext4_inode_ref_t *inode_ref, uint32_t iblock,
 	ext4_extent_binsearch(header, &extent, iblock);
 
 	/* Prevent empty leaf */
-	if (extent == NULL) {
-		*fblock = 0;
-	} else {
-		/* Compute requested physical block address */
-		uint32_t phys_block;
+	if (extent != NULL) {
 		uint32_t first = ext4_extent_get_first_block(extent);
-		phys_block = ext4_extent_get_start(extent) + iblock - first;
-
-		*fblock = phys_block;
+		uint32_t length = ext4_extent_get_block_count(extent);
+		ext4_extent_t *next = extent + 1;
+		ext4_extent_t *end = EXT4_EXTENT_FIRST(header) +
+		    ext4_extent_header_get_entries_count(header);
+
+		if (iblock < first) {
+			/* Hole before the first extent of the leaf */
+			*count = first - iblock;
+		} else if (iblock - first < length) {
+			/* Compute requested physical block address */
+			*fblock = ext4_extent_get_start(extent) + iblock - first;
+			*count = length - (iblock - first);
+		} else if (next < end) {
+			/* Hole between two extents */
+			*count = ext4_extent_get_first_block(next) - iblock;
+		}
 	}
 
+	/* Do not report blocks beyond the end of the i-node */
+	if (*count > last_idx - iblock + 1)
+		*count = last_idx - iblock + 1;
+
 	/* Cleanup */
 	if (block != NULL)
 		rc = block_put(block);
@@ -948,25 +986,31 @@ static errno_t ext4_extent_append_extent(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
-/** Append data block to the i-node.
+/** Append data blocks to the i-node.
  *
- * This function allocates data block, tries to append it
- * to some existing extent or creates new extents.
- * It includes possible extent tree modifications (splitting).
- *<
- * @param inode_ref I-node to append block to
- * @param iblock    Output logical number of newly allocated block
- * @param fblock    Output physical block address of newly allocated block
+ * This function allocates a run of contiguous data blocks, tries to
+ * append it to the last extent or creates a new extent. It includes
+ * possible extent tree modifications (splitting). Fewer blocks than
+ * requested are appended if the allocator finds no long enough free
+ * extent or the run would not fit in one extent.
+ *
+ * @param inode_ref I-node to append blocks to
+ * @param count     Number of blocks to append
+ * @param iblock    Output logical number of the first appended block
+ * @param fblock    Output physical address of the first appended block
+ * @param appended  Output number of appended blocks
+ * @param update_size Extend i-node size to cover the appended blocks
  *
  * @return Error code
  *
  */
-errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
-    uint32_t *fblock, bool update_size)
+errno_t ext4_extent_append_blocks(ext4_inode_ref_t *inode_ref, uint32_t count,
+    uint32_t *iblock, uint32_t *fblock, uint32_t *appended, bool update_size)
 {
 	ext4_superblock_t *sb = inode_ref->fs->superblock;
 	uint64_t inode_size = ext4_inode_get_size(sb, inode_ref->inode);
 	uint32_t block_size = ext4_superblock_get_block_size(sb);
+	const uint16_t block_limit = (1 << 15);
 
 	/* Calculate number of new logical block */
 	uint32_t new_block_idx = 0;
@@ -989,81 +1033,70 @@ errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
 	while (path_ptr->depth != 0)
 		path_ptr++;
 
+	uint32_t phys_block = 0;
+	uint32_t allocated = 0;
+
 	/* Add new extent to the node if not present */
 	if (path_ptr->extent == NULL)
 		goto append_extent;
 
 	uint16_t block_count = ext4_extent_get_block_count(path_ptr->extent);
-	uint16_t block_limit = (1 << 15);
 
-	uint32_t phys_block = 0;
 	if (block_count < block_limit) {
-		/* There is space for new block in the extent */
+		/* There is space for new blocks in the extent */
 		if (block_count == 0) {
 			/* Existing extent is empty */
-			rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
+			rc = ext4_balloc_alloc_blocks(inode_ref, 0,
+			    min(count, block_limit), &phys_block, &allocated);
 			if (rc != EOK)
 				goto finish;
 
 			/* Initialize extent */
 			ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
 			ext4_extent_set_start(path_ptr->extent, phys_block);
-			ext4_extent_set_block_count(path_ptr->extent, 1);
-
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
+			ext4_extent_set_block_count(path_ptr->extent, allocated);
 
 			path_ptr->block->dirty = true;
-
-			goto finish;
+			goto update_size;
 		} else {
 			/* Existing extent contains some blocks */
-			phys_block = ext4_extent_get_start(path_ptr->extent);
-			phys_block += ext4_extent_get_block_count(path_ptr->extent);
+			uint32_t goal = ext4_extent_get_start(path_ptr->extent) +
+			    block_count;
 
-			/* Check if the following block is free for allocation */
-			bool free;
-			rc = ext4_balloc_try_alloc_block(inode_ref, phys_block, &free);
+			rc = ext4_balloc_alloc_blocks(inode_ref, goal,
+			    min(count, (uint32_t) (block_limit - block_count)),
+			    &phys_block, &allocated);
 			if (rc != EOK)
 				goto finish;
 
-			if (!free) {
-				/* Target is not free, new block must be appended to new extent */
+			if (phys_block != goal) {
+				/* Blocks are elsewhere, a new extent is needed */
 				goto append_extent;
 			}
 
 			/* Update extent */
-			ext4_extent_set_block_count(path_ptr->extent, block_count + 1);
-
-			/* Update i-node */
-			if (update_size) {
-				ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
-				inode_ref->dirty = true;
-			}
+			ext4_extent_set_block_count(path_ptr->extent,
+			    block_count + allocated);
 
 			path_ptr->block->dirty = true;
-
-			goto finish;
+			goto update_size;
 		}
 	}
 
-
 append_extent:
-	/* Append new extent to the tree */
-	phys_block = 0;
-
-	/* Allocate new data block */
-	rc = ext4_balloc_alloc_block(inode_ref, &phys_block);
-	if (rc != EOK)
-		goto finish;
+	/* Allocate new data blocks unless done already */
+	if (allocated == 0) {
+		rc = ext4_balloc_alloc_blocks(inode_ref, 0,
+		    min(count, block_limit), &phys_block, &allocated);
+		if (rc != EOK)
+			goto finish;
+	}
 
-	/* Append extent for new block (includes tree splitting if needed) */
+	/* Append extent for new blocks (includes tree splitting if needed) */
 	rc = ext4_extent_append_extent(inode_ref, path, new_block_idx);
 	if (rc != EOK) {
-		ext4_balloc_free_block(inode_ref, phys_block);
+		ext4_balloc_free_blocks(inode_ref, phys_block, allocated);
+		allocated = 0;
 		goto finish;
 	}
 
@@ -1071,24 +1104,27 @@ append_extent:
 	path_ptr = path + tree_depth;
 
 	/* Initialize newly created extent */
-	ext4_extent_set_block_count(path_ptr->extent, 1);
+	ext4_extent_set_block_count(path_ptr->extent, allocated);
 	ext4_extent_set_first_block(path_ptr->extent, new_block_idx);
 	ext4_extent_set_start(path_ptr->extent, phys_block);
 
+	path_ptr->block->dirty = true;
+
+update_size:
 	/* Update i-node */
 	if (update_size) {
-		ext4_inode_set_size(inode_ref->inode, inode_size + block_size);
+		ext4_inode_set_size(inode_ref->inode,
+		    inode_size + (uint64_t) allocated * block_size);
 		inode_ref->dirty = true;
 	}
 
-	path_ptr->block->dirty = true;
-
 finish:
 	rc2 = EOK;
 
 	/* Set return values */
 	*iblock = new_block_idx;
 	*fblock = phys_block;
+	*appended = allocated;
 
 	/*
 	 * Put loaded blocks
@@ -1108,6 +1144,28 @@ finish:
 	return rc;
 }
 
+/** Append data block to the i-node.
+ *
+ * This function allocates data block, tries to append it
+ * to some existing extent or creates new extents.
+ * It includes possible extent tree modifications (splitting).
+ *
+ * @param inode_ref I-node to append block to
+ * @param iblock    Output logical number of newly allocated block
+ * @param fblock    Output physical block address of newly allocated block
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_extent_append_block(ext4_inode_ref_t *inode_ref, uint32_t *iblock,
+    uint32_t *fblock, bool update_size)
+{
+	uint32_t appended;
+
+	return ext4_extent_append_blocks(inode_ref, 1, iblock, fblock,
+	    &appended, update_size);
+}
+
 /**
  * @}
  */
@@ -39,9 +39,11 @@
 #include <errno.h>
 #include <mem.h>
 #include <align.h>
+#include <assert.h>
 #include <crypto.h>
 #include <ipc/vfs.h>
 #include <libfs.h>
+#include <macros.h>
 #include <stdlib.h>
 #include "ext4/balloc.h"
 #include "ext4/bitmap.h"
@@ -130,8 +132,20 @@ static errno_t ext4_filesystem_init(ext4_filesystem_t *fs, service_id_t service_
 	if (rc != EOK)
 		goto err_2;
 
+	/* Free extent summaries are computed lazily by the block allocator */
+	fs->balloc_groups = calloc(
+	    ext4_superblock_get_block_group_count(fs->superblock),
+	    sizeof(ext4_balloc_group_t));
+	if (fs->balloc_groups == NULL) {
+		rc = ENOMEM;
+		goto err_2;
+	}
+
+	fs->dalloc_reserved = 0;
+
 	return EOK;
 err_2:
+	fs->superblock = NULL;
 	block_cache_fini(fs->device);
 err_1:
 	block_fini(fs->device);
@@ -150,6 +164,7 @@ static void ext4_filesystem_fini(ext4_filesystem_t *fs)
 {
 	/* Release memory space for superblock */
 	free(fs->superblock);
+	free(fs->balloc_groups);
 
 	/* Finish work with block library */
 	block_cache_fini(fs->device);
@@ -895,6 +910,7 @@ errno_t ext4_filesystem_get_inode_ref(ext4_filesystem_t *fs, uint32_t index,
 	newref->index = index + 1;
 	newref->fs = fs;
 	newref->dirty = false;
+	newref->dalloc = false;
 
 	*ref = newref;
 
@@ -1347,6 +1363,64 @@ errno_t ext4_filesystem_get_inode_data_block_index(ext4_inode_ref_t *inode_ref,
 	return EOK;
 }
 
+/** Get run of contiguous physical blocks for the logical block address.
+ *
+ * Maps logical block iblock and counts how many following logical
+ * blocks (at most max_count in total) are stored in physically
+ * contiguous blocks. A run of unallocated blocks is reported with
+ * physical address 0.
+ *
+ * @param inode_ref I-node to read block addresses from
+ * @param iblock    Logical index of the first block
+ * @param max_count Maximum number of blocks of the run
+ * @param fblock    Output pointer for physical address of the first block
+ * @param count     Output pointer for number of blocks in the run
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_filesystem_get_inode_data_block_run(ext4_inode_ref_t *inode_ref,
+    aoff64_t iblock, uint32_t max_count, uint32_t *fblock, uint32_t *count)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	errno_t rc;
+
+	assert(max_count > 0);
+
+	/* Extents describe the runs directly */
+	if ((ext4_superblock_has_feature_incompatible(fs->superblock,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
+	    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
+		rc = ext4_extent_find_run(inode_ref, iblock, fblock, count);
+		if (rc != EOK)
+			return rc;
+
+		*count = min(*count, max_count);
+		return EOK;
+	}
+
+	/* Otherwise the block map is probed block by block */
+	rc = ext4_filesystem_get_inode_data_block_index(inode_ref, iblock,
+	    fblock);
+	if (rc != EOK)
+		return rc;
+
+	uint32_t n;
+	for (n = 1; n < max_count; n++) {
+		uint32_t next;
+		rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
+		    iblock + n, &next);
+		if (rc != EOK)
+			return rc;
+
+		if (*fblock == 0 ? next != 0 : next != *fblock + n)
+			break;
+	}
+
+	*count = n;
+	return EOK;
+}
+
 /** Set physical block address for the block logical address into the i-node.
  *
  * @param inode_ref I-node to set block address to
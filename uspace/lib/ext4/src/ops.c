@@ -37,6 +37,8 @@
 
 #include <adt/hash_table.h>
 #include <adt/hash.h>
+#include <align.h>
+#include <assert.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <libfs.h>
@@ -46,6 +48,7 @@
 #include <str.h>
 #include <ipc/loc.h>
 #include "ext4/balloc.h"
+#include "ext4/dcache.h"
 #include "ext4/directory.h"
 #include "ext4/directory_index.h"
 #include "ext4/extent.h"
@@ -55,6 +58,24 @@
 #include "ext4/fstypes.h"
 #include "ext4/superblock.h"
 
+/** Maximum number of bytes transferred by one read or write request */
+#define EXT4_MAX_TRANSFER  (1024 * 1024)
+
+/** Minimum number of contiguous blocks transferred bypassing block cache */
+#define EXT4_DIRECT_MIN_BLOCKS  8
+
+/** Initial size of buffer for data waiting for allocation */
+#define EXT4_DALLOC_MIN  (64 * 1024)
+
+/** Maximum number of bytes of one file waiting for allocation */
+#define EXT4_DALLOC_MAX  (4 * 1024 * 1024)
+
+/** Maximum number of bytes of all files waiting for allocation */
+#define EXT4_DALLOC_TOTAL_MAX  (16 * 1024 * 1024)
+
+/** Blocks reserved for each file with delayed data for extent tree growth */
+#define EXT4_DALLOC_META_BLOCKS  2
+
 /* Forward declarations of auxiliary functions */
 
 static errno_t ext4_read_directory(cap_call_handle_t, aoff64_t, size_t,
@@ -63,6 +84,10 @@ static errno_t ext4_read_file(cap_call_handle_t, aoff64_t, size_t, ext4_instance
     ext4_inode_ref_t *, size_t *);
 static bool ext4_is_dots(const uint8_t *, size_t);
 static errno_t ext4_instance_get(service_id_t, ext4_instance_t **);
+static ext4_dalloc_t *ext4_dalloc_find(ext4_instance_t *, fs_index_t);
+static errno_t ext4_dalloc_flush(ext4_instance_t *, ext4_inode_ref_t *);
+static errno_t ext4_dalloc_flush_all(ext4_instance_t *);
+static void ext4_dalloc_destroy(ext4_instance_t *, ext4_dalloc_t *);
 
 /* Forward declarations of ext4 libfs operations. */
 
@@ -217,19 +242,36 @@ errno_t ext4_root_get(fs_node_t **rfn, service_id_t service_id)
 errno_t ext4_match(fs_node_t **rfn, fs_node_t *pfn, const char *component)
 {
 	ext4_node_t *eparent = EXT4_NODE(pfn);
-	ext4_filesystem_t *fs = eparent->instance->filesystem;
+	ext4_instance_t *inst = eparent->instance;
+	ext4_filesystem_t *fs = inst->filesystem;
+	uint32_t parent_index = eparent->inode_ref->index;
+	uint32_t inode;
+	uint64_t generation;
 	errno_t rc2;
 
 	if (!ext4_inode_is_type(fs->superblock, eparent->inode_ref->inode,
 	    EXT4_INODE_MODE_DIRECTORY))
 		return ENOTDIR;
 
+	/* Try the cache first */
+	if (ext4_dcache_lookup(&inst->dcache, parent_index, component,
+	    &inode, &generation)) {
+		if (inode == 0) {
+			*rfn = NULL;
+			return EOK;
+		}
+
+		return ext4_node_get_core(rfn, inst, inode);
+	}
+
 	/* Try to find entry */
 	ext4_directory_search_result_t result;
 	errno_t rc = ext4_directory_find_entry(&result, eparent->inode_ref,
 	    component);
 	if (rc != EOK) {
 		if (rc == ENOENT) {
+			ext4_dcache_insert(&inst->dcache, parent_index,
+			    component, 0, generation);
 			*rfn = NULL;
 			return EOK;
 		}
@@ -238,8 +280,11 @@ errno_t ext4_match(fs_node_t **rfn, fs_node_t *pfn, const char *component)
 	}
 
 	/* Load node from search result */
-	uint32_t inode = ext4_directory_entry_ll_get_inode(result.dentry);
-	rc = ext4_node_get_core(rfn, eparent->instance, inode);
+	inode = ext4_directory_entry_ll_get_inode(result.dentry);
+	ext4_dcache_insert(&inst->dcache, parent_index, component, inode,
+	    generation);
+
+	rc = ext4_node_get_core(rfn, inst, inode);
 	if (rc != EOK)
 		goto exit;
 
@@ -544,6 +589,10 @@ errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
 	ext4_node_t *parent = EXT4_NODE(pfn);
 	ext4_node_t *child = EXT4_NODE(cfn);
 	ext4_filesystem_t *fs = parent->instance->filesystem;
+	ext4_dcache_t *dcache = &parent->instance->dcache;
+
+	/* Not cached until the entry is complete */
+	ext4_dcache_remove(dcache, parent->inode_ref->index, name);
 
 	/* Add entry to parent directory */
 	errno_t rc = ext4_directory_add_entry(parent->inode_ref, name,
@@ -596,6 +645,9 @@ errno_t ext4_link(fs_node_t *pfn, fs_node_t *cfn, const char *name)
 
 	child->inode_ref->dirty = true;
 
+	ext4_dcache_update(dcache, parent->inode_ref->index, name,
+	    child->inode_ref->index);
+
 	return EOK;
 }
 
@@ -621,10 +673,16 @@ errno_t ext4_unlink(fs_node_t *pfn, fs_node_t *cfn, const char *name)
 
 	/* Remove entry from parent directory */
 	ext4_inode_ref_t *parent = EXT4_NODE(pfn)->inode_ref;
+	ext4_dcache_t *dcache = &EXT4_NODE(pfn)->instance->dcache;
+
+	ext4_dcache_remove(dcache, parent->index, name);
+
 	rc = ext4_directory_remove_entry(parent, name);
 	if (rc != EOK)
 		return rc;
 
+	ext4_dcache_update(dcache, parent->index, name, 0);
+
 	/* Decrement links count */
 	ext4_inode_ref_t *child_inode_ref = EXT4_NODE(cfn)->inode_ref;
 
@@ -751,7 +809,15 @@ aoff64_t ext4_size_get(fs_node_t *fn)
 {
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_superblock_t *sb = enode->instance->filesystem->superblock;
-	return ext4_inode_get_size(sb, enode->inode_ref->inode);
+	aoff64_t size = ext4_inode_get_size(sb, enode->inode_ref->inode);
+
+	/* Account for data waiting for allocation */
+	ext4_dalloc_t *dalloc = ext4_dalloc_find(enode->instance,
+	    enode->inode_ref->index);
+	if (dalloc != NULL)
+		size = max(size, dalloc->pos + dalloc->size);
+
+	return size;
 }
 
 /** Get number of links to specified node.
@@ -861,8 +927,12 @@ errno_t ext4_free_block_count(service_id_t service_id, uint64_t *count)
 	if (rc != EOK)
 		return rc;
 
-	ext4_superblock_t *sb = inst->filesystem->superblock;
-	*count = ext4_superblock_get_free_blocks_count(sb);
+	/* Blocks reserved for delayed allocation are not available */
+	ext4_filesystem_t *fs = inst->filesystem;
+	uint64_t free_blocks =
+	    ext4_superblock_get_free_blocks_count(fs->superblock);
+	*count = (free_blocks > fs->dalloc_reserved) ?
+	    free_blocks - fs->dalloc_reserved : 0;
 
 	return EOK;
 }
@@ -943,11 +1013,21 @@ static errno_t ext4_mounted(service_id_t service_id, const char *opts,
 	link_initialize(&inst->link);
 	inst->service_id = service_id;
 	inst->open_nodes_count = 0;
+	fibril_mutex_initialize(&inst->dalloc_lock);
+	list_initialize(&inst->dalloc_list);
+	inst->dalloc_size = 0;
+
+	errno_t rc = ext4_dcache_init(&inst->dcache);
+	if (rc != EOK) {
+		free(inst);
+		return rc;
+	}
 
 	/* Initialize the filesystem */
 	aoff64_t rnsize;
-	errno_t rc = ext4_filesystem_open(inst, service_id, cmode, &rnsize, &fs);
+	rc = ext4_filesystem_open(inst, service_id, cmode, &rnsize, &fs);
 	if (rc != EOK) {
+		ext4_dcache_fini(&inst->dcache);
 		free(inst);
 		return rc;
 	}
@@ -979,6 +1059,11 @@ static errno_t ext4_unmounted(service_id_t service_id)
 	if (rc != EOK)
 		return rc;
 
+	/* Write out data waiting for allocation */
+	rc = ext4_dalloc_flush_all(inst);
+	if (rc != EOK)
+		return rc;
+
 	fibril_mutex_lock(&open_nodes_lock);
 
 	if (inst->open_nodes_count != 0) {
@@ -1000,6 +1085,7 @@ static errno_t ext4_unmounted(service_id_t service_id)
 		fibril_mutex_unlock(&instance_list_mutex);
 	}
 
+	ext4_dcache_fini(&inst->dcache);
 	free(inst);
 	return EOK;
 }
@@ -1045,6 +1131,18 @@ static errno_t ext4_read(service_id_t service_id, fs_index_t index, aoff64_t pos
 	/* Read from i-node by type */
 	if (ext4_inode_is_type(inst->filesystem->superblock, inode_ref->inode,
 	    EXT4_INODE_MODE_FILE)) {
+		/* Data waiting for allocation must be written first */
+		if (ext4_dalloc_find(inst, index) != NULL) {
+			fibril_mutex_lock(&inst->dalloc_lock);
+			rc = ext4_dalloc_flush(inst, inode_ref);
+			fibril_mutex_unlock(&inst->dalloc_lock);
+			if (rc != EOK) {
+				async_answer_0(chandle, rc);
+				ext4_filesystem_put_inode_ref(inode_ref);
+				return rc;
+			}
+		}
+
 		rc = ext4_read_file(chandle, pos, size, inst, inode_ref,
 		    rbytes);
 	} else if (ext4_inode_is_type(inst->filesystem->superblock,
@@ -1172,7 +1270,50 @@ errno_t ext4_read_directory(cap_call_handle_t chandle, aoff64_t pos, size_t size
 	}
 }
 
+/** Read data from file blocks through the block cache.
+ *
+ * @param service_id Device to read data from
+ * @param fblock     Physical address of the first block
+ * @param offset     Offset of data in the first block
+ * @param buf        Buffer to store data to
+ * @param size       Number of bytes to read from consecutive blocks
+ * @param block_size Size of filesystem block
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_read_blocks_cached(service_id_t service_id,
+    uint32_t fblock, uint32_t offset, uint8_t *buf, size_t size,
+    uint32_t block_size)
+{
+	while (size > 0) {
+		block_t *block;
+		errno_t rc = block_get(&block, service_id, fblock,
+		    BLOCK_FLAGS_NONE);
+		if (rc != EOK)
+			return rc;
+
+		size_t bytes = min(size, block_size - offset);
+		memcpy(buf, block->data + offset, bytes);
+
+		rc = block_put(block);
+		if (rc != EOK)
+			return rc;
+
+		buf += bytes;
+		size -= bytes;
+		offset = 0;
+		fblock++;
+	}
+
+	return EOK;
+}
+
 /** Read data from file.
+ *
+ * Up to EXT4_MAX_TRANSFER bytes are returned at once. The file is
+ * read by runs of physically contiguous blocks, long runs are read
+ * directly from the device bypassing the block cache.
  *
  * @param chandle    IPC id of call (for communication)
  * @param pos       Position to start reading from
@@ -1197,72 +1338,557 @@ errno_t ext4_read_file(cap_call_handle_t chandle, aoff64_t pos, size_t size,
 		return EOK;
 	}
 
-	/* For now, we only read data from one block at a time */
 	uint32_t block_size = ext4_superblock_get_block_size(sb);
-	aoff64_t file_block = pos / block_size;
-	uint32_t offset_in_block = pos % block_size;
-	uint32_t bytes = min(block_size - offset_in_block, size);
+	size_t bytes = min(size, EXT4_MAX_TRANSFER);
 
 	/* Handle end of file */
 	if (pos + bytes > file_size)
 		bytes = file_size - pos;
 
-	/* Get the real block number */
-	uint32_t fs_block;
+	uint8_t *buffer = malloc(bytes);
+	if (buffer == NULL) {
+		async_answer_0(chandle, ENOMEM);
+		return ENOMEM;
+	}
+
+	errno_t rc;
+	size_t done = 0;
+	while (done < bytes) {
+		aoff64_t file_block = (pos + done) / block_size;
+		uint32_t offset_in_block = (pos + done) % block_size;
+		uint32_t max_count = (offset_in_block + bytes - done +
+		    block_size - 1) / block_size;
+
+		/* Get the real address of the run of blocks */
+		uint32_t fs_block;
+		uint32_t count;
+		rc = ext4_filesystem_get_inode_data_block_run(inode_ref,
+		    file_block, max_count, &fs_block, &count);
+		if (rc != EOK)
+			goto error;
+
+		size_t run = min((size_t) count * block_size - offset_in_block,
+		    bytes - done);
+
+		if (fs_block == 0) {
+			/*
+			 * Sparse file, the blocks are not allocated
+			 * and read as zeros
+			 */
+			memset(buffer + done, 0, run);
+		} else if ((offset_in_block == 0) &&
+		    (run / block_size >= EXT4_DIRECT_MIN_BLOCKS)) {
+			/* Long contiguous run, do not pollute the cache */
+			run -= run % block_size;
+			rc = block_cache_read_direct(inst->service_id, fs_block,
+			    run / block_size, buffer + done);
+		} else {
+			rc = ext4_read_blocks_cached(inst->service_id, fs_block,
+			    offset_in_block, buffer + done, run, block_size);
+		}
+
+		if (rc != EOK)
+			goto error;
+
+		done += run;
+	}
+
+	rc = async_data_read_finalize(chandle, buffer, bytes);
+	free(buffer);
+	if (rc != EOK)
+		return rc;
+
+	*rbytes = bytes;
+	return EOK;
+
+error:
+	async_answer_0(chandle, rc);
+	free(buffer);
+	return rc;
+}
+
+/** Zero newly allocated block.
+ *
+ * @param service_id Device identifier
+ * @param fblock     Physical block address
+ * @param block_size Size of filesystem block
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_write_zero_block(service_id_t service_id, uint32_t fblock,
+    uint32_t block_size)
+{
+	block_t *block;
+	errno_t rc = block_get(&block, service_id, fblock, BLOCK_FLAGS_NOREAD);
+	if (rc != EOK)
+		return rc;
+
+	memset(block->data, 0, block_size);
+	block->dirty = true;
+
+	return block_put(block);
+}
+
+/** Get physical block for writing to file, allocate it if necessary.
+ *
+ * If the block is beyond the end of file, a run of up to count blocks
+ * is allocated at once, so that the following blocks of the write are
+ * physically contiguous. The size of an i-node using extents is
+ * extended to cover the allocated blocks. The caller is responsible
+ * for setting the final size.
+ *
+ * @param inode_ref I-node of file
+ * @param iblock    Logical block number
+ * @param count     Number of blocks going to be written from iblock on
+ * @param fblock    Output value - physical block number
+ * @param fresh     Output value - true if the block was allocated
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_write_map_block(ext4_inode_ref_t *inode_ref,
+    uint32_t iblock, uint32_t count, uint32_t *fblock, bool *fresh)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+
+	*fresh = false;
+
 	errno_t rc = ext4_filesystem_get_inode_data_block_index(inode_ref,
-	    file_block, &fs_block);
-	if (rc != EOK) {
-		async_answer_0(chandle, rc);
+	    iblock, fblock);
+	if (rc != EOK)
 		return rc;
+
+	/* Check for sparse file */
+	if (*fblock != 0)
+		return EOK;
+
+	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
+	uint64_t size = ext4_inode_get_size(fs->superblock, inode_ref->inode);
+	uint32_t end_iblock = (size + block_size - 1) / block_size;
+
+	if ((ext4_superblock_has_feature_incompatible(fs->superblock,
+	    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
+	    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
+		/* Holes inside files using extents cannot be filled */
+		if (iblock < end_iblock)
+			return ENOTSUP;
+
+		/* Allocate blocks up to iblock, zero those in the gap */
+		while (true) {
+			uint32_t want = (end_iblock < iblock) ?
+			    iblock - end_iblock : count;
+			uint32_t first;
+			uint32_t phys;
+			uint32_t appended;
+			rc = ext4_extent_append_blocks(inode_ref, want, &first,
+			    &phys, &appended, true);
+			if (rc != EOK)
+				return rc;
+
+			for (uint32_t i = 0; (i < appended) &&
+			    (first + i < iblock); i++) {
+				rc = ext4_write_zero_block(fs->device, phys + i,
+				    block_size);
+				if (rc != EOK)
+					return rc;
+			}
+
+			if (first + appended > iblock) {
+				*fblock = phys + (iblock - first);
+				break;
+			}
+
+			end_iblock = first + appended;
+		}
+	} else {
+		/* Blocks beyond the end of file are not mapped */
+		if (iblock < end_iblock)
+			count = 1;
+
+		uint32_t allocated;
+		rc = ext4_balloc_alloc_blocks(inode_ref, 0, count, fblock,
+		    &allocated);
+		if (rc != EOK)
+			return rc;
+
+		for (uint32_t i = 0; i < allocated; i++) {
+			rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
+			    iblock + i, *fblock + i);
+			if (rc != EOK) {
+				ext4_balloc_free_blocks(inode_ref, *fblock + i,
+				    allocated - i);
+				if (i == 0) {
+					*fblock = 0;
+					return rc;
+				}
+				break;
+			}
+		}
+	}
+
+	*fresh = true;
+	inode_ref->dirty = true;
+	return EOK;
+}
+
+/** Write data to file.
+ *
+ * Long runs of whole blocks that are physically contiguous are written
+ * directly to the device bypassing the block cache.
+ *
+ * @param inode_ref I-node of file
+ * @param pos       Position in file to start writing at
+ * @param buffer    Data to write
+ * @param bytes     Number of bytes to write
+ * @param wbytes    Output value - number of bytes written, can be
+ *                  non-zero even if an error is returned
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_write_data(ext4_inode_ref_t *inode_ref, aoff64_t pos,
+    const uint8_t *buffer, size_t bytes, size_t *wbytes)
+{
+	ext4_filesystem_t *fs = inode_ref->fs;
+	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
+	uint64_t old_inode_size = ext4_inode_get_size(fs->superblock,
+	    inode_ref->inode);
+
+	/* Blocks starting here are allocated by this write */
+	uint64_t alloc_end = ALIGN_UP(old_inode_size, block_size);
+
+	errno_t rc = EOK;
+	size_t done = 0;
+	while (done < bytes) {
+		uint32_t iblock = (pos + done) / block_size;
+		uint32_t offset = (pos + done) % block_size;
+		uint32_t count = (offset + bytes - done + block_size - 1) /
+		    block_size;
+
+		uint32_t fblock;
+		bool fresh;
+		rc = ext4_write_map_block(inode_ref, iblock, count, &fblock,
+		    &fresh);
+		if (rc != EOK)
+			break;
+
+		uint32_t max_count = (bytes - done) / block_size;
+		if ((offset == 0) && (max_count >= EXT4_DIRECT_MIN_BLOCKS)) {
+			/* Collect whole blocks physically following fblock */
+			uint32_t run = 1;
+			while (run < max_count) {
+				uint32_t next;
+				bool next_fresh;
+				rc = ext4_write_map_block(inode_ref, iblock + run,
+				    count - run, &next, &next_fresh);
+				if ((rc != EOK) || (next != fblock + run))
+					break;
+
+				run++;
+			}
+
+			if (rc != EOK)
+				break;
+
+			if (run >= EXT4_DIRECT_MIN_BLOCKS) {
+				/* Long contiguous run, do not pollute the cache */
+				rc = block_cache_write_direct(fs->device, fblock,
+				    run, buffer + done);
+				if (rc != EOK)
+					break;
+
+				done += (size_t) run * block_size;
+				continue;
+			}
+		}
+
+		/* Write the block through the cache */
+		size_t chunk = min(bytes - done, block_size - offset);
+		int flags = BLOCK_FLAGS_NONE;
+		if ((fresh) || ((uint64_t) iblock * block_size >= alloc_end) ||
+		    (chunk == block_size))
+			flags = BLOCK_FLAGS_NOREAD;
+
+		block_t *write_block;
+		rc = block_get(&write_block, fs->device, fblock, flags);
+		if (rc != EOK)
+			break;
+
+		if (flags == BLOCK_FLAGS_NOREAD)
+			memset(write_block->data, 0, block_size);
+
+		memcpy(write_block->data + offset, buffer + done, chunk);
+		write_block->dirty = true;
+
+		rc = block_put(write_block);
+		if (rc != EOK)
+			break;
+
+		done += chunk;
 	}
 
 	/*
-	 * Check for sparse file.
-	 * If ext4_filesystem_get_inode_data_block_index returned
-	 * fs_block == 0, it means that the given block is not allocated for the
-	 * file and we need to return a buffer of zeros
+	 * Do some counting. Allocation might have extended the i-node
+	 * up to the block boundary, so the size is always recomputed.
 	 */
-	uint8_t *buffer;
-	if (fs_block == 0) {
-		buffer = malloc(bytes);
-		if (buffer == NULL) {
-			async_answer_0(chandle, ENOMEM);
-			return ENOMEM;
-		}
+	uint64_t new_inode_size = max(old_inode_size, pos + done);
+	if (ext4_inode_get_size(fs->superblock, inode_ref->inode) !=
+	    new_inode_size) {
+		ext4_inode_set_size(inode_ref->inode, new_inode_size);
+		inode_ref->dirty = true;
+	}
+
+	*wbytes = done;
+	return rc;
+}
+
+/** Find data of file waiting for allocation.
+ *
+ * @param inst  Filesystem instance
+ * @param index I-node number of file
+ *
+ * @return Delayed allocation buffer or NULL if there is none
+ *
+ */
+static ext4_dalloc_t *ext4_dalloc_find(ext4_instance_t *inst,
+    fs_index_t index)
+{
+	list_foreach(inst->dalloc_list, link, ext4_dalloc_t, dalloc) {
+		if (dalloc->index == index)
+			return dalloc;
+	}
+
+	return NULL;
+}
+
+/** Destroy delayed allocation buffer without writing its data.
+ *
+ * @param inst   Filesystem instance
+ * @param dalloc Delayed allocation buffer
+ *
+ */
+static void ext4_dalloc_destroy(ext4_instance_t *inst, ext4_dalloc_t *dalloc)
+{
+	list_remove(&dalloc->link);
+	inst->dalloc_size -= dalloc->size;
+	inst->filesystem->dalloc_reserved -= dalloc->reserved;
+	free(dalloc->data);
+	free(dalloc);
+}
 
-		memset(buffer, 0, bytes);
+/** Get number of blocks to reserve for data waiting for allocation.
+ *
+ * @param inst Filesystem instance
+ * @param pos  File position of the first byte, equal to the i-node size
+ * @param size Number of bytes
+ *
+ * @return Number of blocks needed to write the data
+ *
+ */
+static uint64_t ext4_dalloc_blocks(ext4_instance_t *inst, aoff64_t pos,
+    size_t size)
+{
+	uint32_t block_size =
+	    ext4_superblock_get_block_size(inst->filesystem->superblock);
+
+	/* The block holding the end of file is allocated already */
+	uint64_t first = (pos + block_size - 1) / block_size;
+	uint64_t end = (pos + size + block_size - 1) / block_size;
+	if (end == first)
+		return 0;
+
+	return end - first + EXT4_DALLOC_META_BLOCKS;
+}
+
+/** Write data of file waiting for allocation.
+ *
+ * All blocks for the data are requested from the allocator at once.
+ * If the data cannot be written, whatever has not been written stays
+ * in the buffer, so that it is not lost and the error can be reported
+ * again by a later flush.
+ *
+ * Must be called with the dalloc_lock of the instance held.
+ *
+ * @param inst      Filesystem instance
+ * @param inode_ref I-node of file
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_dalloc_flush(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref)
+{
+	assert(fibril_mutex_is_locked(&inst->dalloc_lock));
 
-		rc = async_data_read_finalize(chandle, buffer, bytes);
-		*rbytes = bytes;
+	ext4_dalloc_t *dalloc = ext4_dalloc_find(inst, inode_ref->index);
+	if (dalloc == NULL)
+		return EOK;
 
-		free(buffer);
+	/* The data may use the blocks reserved for them */
+	size_t done;
+	inode_ref->dalloc = true;
+	errno_t rc = ext4_write_data(inode_ref, dalloc->pos, dalloc->data,
+	    dalloc->size, &done);
+	inode_ref->dalloc = false;
+	if ((rc == EOK) && (done < dalloc->size))
+		rc = EIO;
+
+	if (done == dalloc->size) {
+		ext4_dalloc_destroy(inst, dalloc);
 		return rc;
 	}
 
-	/* Usual case - we need to read a block from device */
-	block_t *block;
-	rc = block_get(&block, inst->service_id, fs_block, BLOCK_FLAGS_NONE);
-	if (rc != EOK) {
-		async_answer_0(chandle, rc);
-		return rc;
+	/* Keep the data which have not been written */
+	memmove(dalloc->data, dalloc->data + done, dalloc->size - done);
+	dalloc->pos += done;
+	dalloc->size -= done;
+	inst->dalloc_size -= done;
+
+	uint64_t reserved = ext4_dalloc_blocks(inst, dalloc->pos,
+	    dalloc->size);
+	inst->filesystem->dalloc_reserved -= dalloc->reserved - reserved;
+	dalloc->reserved = reserved;
+
+	return rc;
+}
+
+/** Write data of all files of the instance waiting for allocation.
+ *
+ * @param inst Filesystem instance
+ *
+ * @return Error code
+ *
+ */
+static errno_t ext4_dalloc_flush_all(ext4_instance_t *inst)
+{
+	errno_t rc = EOK;
+
+	fibril_mutex_lock(&inst->dalloc_lock);
+
+	/* Buffers which cannot be written out are kept */
+	link_t *link = list_first(&inst->dalloc_list);
+	while (link != NULL) {
+		ext4_dalloc_t *dalloc = list_get_instance(link, ext4_dalloc_t,
+		    link);
+		link = list_next(link, &inst->dalloc_list);
+
+		fs_node_t *fn;
+		errno_t rc2 = ext4_node_get_core(&fn, inst, dalloc->index);
+		if (rc2 != EOK) {
+			rc = rc2;
+			continue;
+		}
+
+		rc2 = ext4_dalloc_flush(inst, EXT4_NODE(fn)->inode_ref);
+		if (rc2 != EOK)
+			rc = rc2;
+
+		rc2 = ext4_node_put(fn);
+		if (rc2 != EOK)
+			rc = rc2;
 	}
 
-	assert(offset_in_block + bytes <= block_size);
-	rc = async_data_read_finalize(chandle, block->data + offset_in_block, bytes);
-	if (rc != EOK) {
-		block_put(block);
-		return rc;
+	fibril_mutex_unlock(&inst->dalloc_lock);
+	return rc;
+}
+
+/** Append data to the end of file without allocating blocks.
+ *
+ * Must be called with the dalloc_lock of the instance held.
+ *
+ * @param inst      Filesystem instance
+ * @param inode_ref I-node of file
+ * @param pos       Position in file, must be the current end of file
+ * @param buffer    Data to append
+ * @param bytes     Number of bytes to append
+ *
+ * Blocks for the data are reserved, so that the data can be allocated
+ * when the buffer is written out.
+ *
+ * @return EOK on success, ELIMIT if the data should be written
+ *         immediately, ENOSPC if there is not enough free space, other
+ *         error code on failure
+ *
+ */
+static errno_t ext4_dalloc_append(ext4_instance_t *inst,
+    ext4_inode_ref_t *inode_ref, aoff64_t pos, const uint8_t *buffer,
+    size_t bytes)
+{
+	assert(fibril_mutex_is_locked(&inst->dalloc_lock));
+
+	ext4_dalloc_t *dalloc = ext4_dalloc_find(inst, inode_ref->index);
+
+	/* Write out the buffer once it is full */
+	if ((dalloc != NULL) && (dalloc->size + bytes > EXT4_DALLOC_MAX)) {
+		errno_t rc = ext4_dalloc_flush(inst, inode_ref);
+		if (rc != EOK)
+			return rc;
+
+		dalloc = NULL;
 	}
 
-	rc = block_put(block);
-	if (rc != EOK)
-		return rc;
+	if ((bytes > EXT4_DALLOC_MAX) ||
+	    (inst->dalloc_size + bytes > EXT4_DALLOC_TOTAL_MAX))
+		return ELIMIT;
+
+	/* Check that the blocks can be reserved */
+	uint64_t reserved = (dalloc != NULL) ? dalloc->reserved : 0;
+	uint64_t reserve = (dalloc != NULL) ?
+	    ext4_dalloc_blocks(inst, dalloc->pos, dalloc->size + bytes) :
+	    ext4_dalloc_blocks(inst, pos, bytes);
+	ext4_filesystem_t *fs = inst->filesystem;
+	uint64_t free_blocks =
+	    ext4_superblock_get_free_blocks_count(fs->superblock);
+	if (fs->dalloc_reserved + reserve - reserved > free_blocks)
+		return ENOSPC;
+
+	if (dalloc == NULL) {
+		dalloc = calloc(1, sizeof(ext4_dalloc_t));
+		if (dalloc == NULL)
+			return ELIMIT;
+
+		link_initialize(&dalloc->link);
+		dalloc->index = inode_ref->index;
+		dalloc->pos = pos;
+		list_append(&dalloc->link, &inst->dalloc_list);
+	}
+
+	assert(dalloc->pos + dalloc->size == pos);
+
+	if (dalloc->size + bytes > dalloc->capacity) {
+		size_t capacity = max(2 * dalloc->capacity,
+		    max(dalloc->size + bytes, (size_t) EXT4_DALLOC_MIN));
+		capacity = min(capacity, (size_t) EXT4_DALLOC_MAX);
+
+		uint8_t *data = realloc(dalloc->data, capacity);
+		if (data == NULL) {
+			/* Keep what is buffered, write the rest immediately */
+			if (dalloc->size == 0)
+				ext4_dalloc_destroy(inst, dalloc);
+
+			return ELIMIT;
+		}
+
+		dalloc->data = data;
+		dalloc->capacity = capacity;
+	}
+
+	memcpy(dalloc->data + dalloc->size, buffer, bytes);
+	dalloc->size += bytes;
+	inst->dalloc_size += bytes;
+
+	fs->dalloc_reserved += reserve - reserved;
+	dalloc->reserved = reserve;
 
-	*rbytes = bytes;
 	return EOK;
 }
 
 /** Write bytes to file
+ *
+ * Up to EXT4_MAX_TRANSFER bytes are accepted at once. Data appended to
+ * the end of file are buffered and written later, when blocks for many
+ * of them can be allocated at once. Other writes are done immediately.
  *
  * @param service_id Device identifier
  * @param index      I-node number of file
@@ -1282,6 +1908,8 @@ static errno_t ext4_write(service_id_t service_id, fs_index_t index, aoff64_t po
 	if (rc != EOK)
 		return rc;
 
+	uint8_t *buffer = NULL;
+
 	cap_call_handle_t chandle;
 	size_t len;
 	if (!async_data_write_receive(&chandle, &len)) {
@@ -1291,109 +1919,65 @@ static errno_t ext4_write(service_id_t service_id, fs_index_t index, aoff64_t po
 	}
 
 	ext4_node_t *enode = EXT4_NODE(fn);
-	ext4_filesystem_t *fs = enode->instance->filesystem;
-
-	uint32_t block_size = ext4_superblock_get_block_size(fs->superblock);
-
-	/* Prevent writing to more than one block */
-	uint32_t bytes = min(len, block_size - (pos % block_size));
-
-	int flags = BLOCK_FLAGS_NONE;
-	if (bytes == block_size)
-		flags = BLOCK_FLAGS_NOREAD;
+	ext4_instance_t *inst = enode->instance;
+	ext4_filesystem_t *fs = inst->filesystem;
+	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 
-	uint32_t iblock =  pos / block_size;
-	uint32_t fblock;
+	size_t bytes = min(len, EXT4_MAX_TRANSFER);
 
-	/* Load inode */
-	ext4_inode_ref_t *inode_ref = enode->inode_ref;
-	rc = ext4_filesystem_get_inode_data_block_index(inode_ref, iblock,
-	    &fblock);
-	if (rc != EOK) {
+	buffer = malloc(bytes);
+	if (buffer == NULL) {
+		rc = ENOMEM;
 		async_answer_0(chandle, rc);
 		goto exit;
 	}
 
-	/* Check for sparse file */
-	if (fblock == 0) {
-		if ((ext4_superblock_has_feature_incompatible(fs->superblock,
-		    EXT4_FEATURE_INCOMPAT_EXTENTS)) &&
-		    (ext4_inode_has_flag(inode_ref->inode, EXT4_INODE_FLAG_EXTENTS))) {
-			uint32_t last_iblock =
-			    ext4_inode_get_size(fs->superblock, inode_ref->inode) /
-			    block_size;
-
-			while (last_iblock < iblock) {
-				rc = ext4_extent_append_block(inode_ref, &last_iblock,
-				    &fblock, true);
-				if (rc != EOK) {
-					async_answer_0(chandle, rc);
-					goto exit;
-				}
-			}
+	rc = async_data_write_finalize(chandle, buffer, bytes);
+	if (rc != EOK)
+		goto exit;
 
-			rc = ext4_extent_append_block(inode_ref, &last_iblock,
-			    &fblock, false);
-			if (rc != EOK) {
-				async_answer_0(chandle, rc);
-				goto exit;
-			}
-		} else {
-			rc = ext4_balloc_alloc_block(inode_ref, &fblock);
-			if (rc != EOK) {
-				async_answer_0(chandle, rc);
-				goto exit;
-			}
+	fibril_mutex_lock(&inst->dalloc_lock);
 
-			rc = ext4_filesystem_set_inode_data_block_index(inode_ref,
-			    iblock, fblock);
-			if (rc != EOK) {
-				ext4_balloc_free_block(inode_ref, fblock);
-				async_answer_0(chandle, rc);
-				goto exit;
-			}
+	/* Try to delay appending to the end of file */
+	if (pos == ext4_size_get(fn)) {
+		rc = ext4_dalloc_append(inst, inode_ref, pos, buffer, bytes);
+		if (rc == EOK) {
+			*nsize = ext4_size_get(fn);
+			*wbytes = bytes;
+			fibril_mutex_unlock(&inst->dalloc_lock);
+			goto exit;
 		}
 
-		flags = BLOCK_FLAGS_NOREAD;
-		inode_ref->dirty = true;
+		if (rc != ELIMIT) {
+			fibril_mutex_unlock(&inst->dalloc_lock);
+			goto exit;
+		}
 	}
 
-	/* Load target block */
-	block_t *write_block;
-	rc = block_get(&write_block, service_id, fblock, flags);
+	/* Delayed data must precede this write */
+	rc = ext4_dalloc_flush(inst, inode_ref);
 	if (rc != EOK) {
-		async_answer_0(chandle, rc);
+		fibril_mutex_unlock(&inst->dalloc_lock);
 		goto exit;
 	}
 
-	if (flags == BLOCK_FLAGS_NOREAD)
-		memset(write_block->data, 0, block_size);
+	size_t done;
+	rc = ext4_write_data(inode_ref, pos, buffer, bytes, &done);
 
-	rc = async_data_write_finalize(chandle, write_block->data +
-	    (pos % block_size), bytes);
-	if (rc != EOK) {
-		block_put(write_block);
-		goto exit;
-	}
+	fibril_mutex_unlock(&inst->dalloc_lock);
 
-	write_block->dirty = true;
+	/* Partial write is a success */
+	if (done > 0)
+		rc = EOK;
 
-	rc = block_put(write_block);
 	if (rc != EOK)
 		goto exit;
 
-	/* Do some counting */
-	uint32_t old_inode_size = ext4_inode_get_size(fs->superblock,
-	    inode_ref->inode);
-	if (pos + bytes > old_inode_size) {
-		ext4_inode_set_size(inode_ref->inode, pos + bytes);
-		inode_ref->dirty = true;
-	}
-
 	*nsize = ext4_inode_get_size(fs->superblock, inode_ref->inode);
-	*wbytes = bytes;
+	*wbytes = done;
 
 exit:
+	free(buffer);
 	rc2 = ext4_node_put(fn);
 	return rc == EOK ? rc2 : rc;
 }
@@ -1420,7 +2004,12 @@ static errno_t ext4_truncate(service_id_t service_id, fs_index_t index,
 	ext4_node_t *enode = EXT4_NODE(fn);
 	ext4_inode_ref_t *inode_ref = enode->inode_ref;
 
-	rc = ext4_filesystem_truncate_inode(inode_ref, new_size);
+	fibril_mutex_lock(&enode->instance->dalloc_lock);
+	rc = ext4_dalloc_flush(enode->instance, inode_ref);
+	fibril_mutex_unlock(&enode->instance->dalloc_lock);
+
+	if (rc == EOK)
+		rc = ext4_filesystem_truncate_inode(inode_ref, new_size);
 	errno_t const rc2 = ext4_node_put(fn);
 
 	return rc == EOK ? rc2 : rc;
@@ -1436,7 +2025,26 @@ static errno_t ext4_truncate(service_id_t service_id, fs_index_t index,
  */
 static errno_t ext4_close(service_id_t service_id, fs_index_t index)
 {
-	return EOK;
+	ext4_instance_t *inst;
+	errno_t rc = ext4_instance_get(service_id, &inst);
+	if (rc != EOK)
+		return rc;
+
+	/* Nothing to do unless there is data waiting for allocation */
+	if (ext4_dalloc_find(inst, index) == NULL)
+		return EOK;
+
+	fs_node_t *fn;
+	rc = ext4_node_get(&fn, service_id, index);
+	if (rc != EOK)
+		return rc;
+
+	fibril_mutex_lock(&inst->dalloc_lock);
+	rc = ext4_dalloc_flush(inst, EXT4_NODE(fn)->inode_ref);
+	fibril_mutex_unlock(&inst->dalloc_lock);
+
+	errno_t const rc2 = ext4_node_put(fn);
+	return rc == EOK ? rc2 : rc;
 }
 
 /** Destroy node specified by index.
@@ -1454,6 +2062,14 @@ static errno_t ext4_destroy(service_id_t service_id, fs_index_t index)
 	if (rc != EOK)
 		return rc;
 
+	/* Data waiting for allocation are not needed any more */
+	ext4_instance_t *inst = EXT4_NODE(fn)->instance;
+	fibril_mutex_lock(&inst->dalloc_lock);
+	ext4_dalloc_t *dalloc = ext4_dalloc_find(inst, index);
+	if (dalloc != NULL)
+		ext4_dalloc_destroy(inst, dalloc);
+	fibril_mutex_unlock(&inst->dalloc_lock);
+
 	/* Destroy the inode */
 	return ext4_destroy_node(fn);
 }
@@ -1472,9 +2088,15 @@ static errno_t ext4_sync(service_id_t service_id, fs_index_t index)
 		return rc;
 
 	ext4_node_t *enode = EXT4_NODE(fn);
+
+	fibril_mutex_lock(&enode->instance->dalloc_lock);
+	rc = ext4_dalloc_flush(enode->instance, enode->inode_ref);
+	fibril_mutex_unlock(&enode->instance->dalloc_lock);
+
 	enode->inode_ref->dirty = true;
 
-	return ext4_node_put(fn);
+	errno_t const rc2 = ext4_node_put(fn);
+	return rc == EOK ? rc2 : rc;
 }
 
 /** VFS operations
@@ -126,6 +126,7 @@ void http_destroy(http_t *http)
 {
 	(void) http_close(http);
 	recv_buffer_fini(&http->recv_buffer);
+	free(http->host);
 	free(http);
 }
 
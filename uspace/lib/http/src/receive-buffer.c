@@ -173,7 +173,11 @@ errno_t recv_char(receive_buffer_t *rb, char *c, bool consume)
 		if (rc != EOK)
 			return rc;
 
-		rb->in = nrecv;
+		/* End of stream */
+		if (nrecv == 0)
+			return EIO;
+
+		rb->in += nrecv;
 	}
 
 	*c = rb->buffer[rb->out];
@@ -65,6 +65,8 @@ http_request_t *http_request_create(const char *method, const char *path)
 		return NULL;
 	}
 
+	req->version.major = 1;
+	req->version.minor = 1;
 	http_headers_init(&req->headers);
 
 	return req;
@@ -154,5 +156,172 @@ errno_t http_send_request(http_t *http, http_request_t *req)
 	return rc;
 }
 
+static bool is_digit(char c)
+{
+	return (c >= '0' && c <= '9');
+}
+
+static bool is_not_space(char c)
+{
+	return (c != ' ' && c != '\r' && c != '\n');
+}
+
+/** Receive a request line token delimited by space or end of line. */
+static errno_t receive_token(receive_buffer_t *rb, char **out_str)
+{
+	receive_buffer_mark_t start;
+	receive_buffer_mark_t end;
+
+	recv_mark(rb, &start);
+	errno_t rc = recv_while(rb, is_not_space);
+	if (rc != EOK) {
+		recv_unmark(rb, &start);
+		return rc;
+	}
+	recv_mark(rb, &end);
+
+	if (end.offset == start.offset)
+		rc = HTTP_EPARSE;
+	else
+		rc = recv_cut_str(rb, &start, &end, out_str);
+
+	recv_unmark(rb, &start);
+	recv_unmark(rb, &end);
+	return rc;
+}
+
+static errno_t receive_version_number(receive_buffer_t *rb, uint8_t *out_value)
+{
+	unsigned value = 0;
+	bool any = false;
+
+	while (true) {
+		char c = 0;
+		errno_t rc = recv_char(rb, &c, false);
+		if (rc != EOK)
+			return rc;
+		if (!is_digit(c))
+			break;
+
+		value = value * 10 + (c - '0');
+		if (value > UINT8_MAX)
+			return HTTP_EPARSE;
+		any = true;
+
+		rc = recv_char(rb, &c, true);
+		if (rc != EOK)
+			return rc;
+	}
+
+	if (!any)
+		return HTTP_EPARSE;
+
+	*out_value = value;
+	return EOK;
+}
+
+static errno_t expect(receive_buffer_t *rb, const char *expect)
+{
+	size_t ndisc;
+	errno_t rc = recv_discard_str(rb, expect, &ndisc);
+	if (rc != EOK)
+		return rc;
+	if (ndisc < str_length(expect))
+		return HTTP_EPARSE;
+	return EOK;
+}
+
+/** Receive and parse HTTP request header.
+ *
+ * Receives the request line, the headers and the empty line terminating
+ * them. The request body (if any) is left in the receive buffer. Data
+ * following the request (e.g. further pipelined requests) are left in
+ * the receive buffer as well.
+ *
+ * @param rb Receive buffer
+ * @param out_req Place to store pointer to the new request
+ * @param max_headers_size Maximum total size of headers
+ * @param max_headers_count Maximum number of headers
+ *
+ * @return EOK on success, HTTP_EPARSE if the request is malformed or
+ *         another error code
+ */
+errno_t http_receive_request(receive_buffer_t *rb, http_request_t **out_req,
+    size_t max_headers_size, unsigned max_headers_count)
+{
+	http_request_t *req = malloc(sizeof(http_request_t));
+	if (req == NULL)
+		return ENOMEM;
+	memset(req, 0, sizeof(http_request_t));
+	http_headers_init(&req->headers);
+
+	errno_t rc = receive_token(rb, &req->method);
+	if (rc != EOK)
+		goto error;
+
+	rc = expect(rb, " ");
+	if (rc != EOK)
+		goto error;
+
+	rc = receive_token(rb, &req->path);
+	if (rc != EOK)
+		goto error;
+
+	/* HTTP/0.9 requests have no version */
+	req->version.major = 0;
+	req->version.minor = 9;
+
+	size_t nrecv;
+	rc = recv_discard(rb, ' ', &nrecv);
+	if (rc != EOK)
+		goto error;
+
+	if (nrecv > 0) {
+		rc = expect(rb, "HTTP/");
+		if (rc != EOK)
+			goto error;
+
+		rc = receive_version_number(rb, &req->version.major);
+		if (rc != EOK)
+			goto error;
+
+		rc = expect(rb, ".");
+		if (rc != EOK)
+			goto error;
+
+		rc = receive_version_number(rb, &req->version.minor);
+		if (rc != EOK)
+			goto error;
+	}
+
+	rc = recv_eol(rb, &nrecv);
+	if (rc == EOK && nrecv == 0)
+		rc = HTTP_EPARSE;
+	if (rc != EOK)
+		goto error;
+
+	if (req->version.major == 0) {
+		*out_req = req;
+		return EOK;
+	}
+
+	rc = http_headers_receive(rb, &req->headers, max_headers_size,
+	    max_headers_count);
+	if (rc != EOK)
+		goto error;
+
+	rc = recv_eol(rb, &nrecv);
+	if (rc == EOK && nrecv == 0)
+		rc = HTTP_EPARSE;
+	if (rc != EOK)
+		goto error;
+
+	*out_req = req;
+	return EOK;
+error:
+	http_request_destroy(req);
+	return rc;
+}
+
 /** @}
  */
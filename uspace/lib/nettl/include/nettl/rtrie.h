@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libnettl
+ * @{
+ */
+/**
+ * @file Longest prefix match trie
+ */
+
+#ifndef LIBNETTL_RTRIE_H_
+#define LIBNETTL_RTRIE_H_
+
+#include <atomic.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Number of key bits consumed by one trie node */
+#define RTRIE_STRIDE 4
+
+/** Trie node
+ *
+ * Nodes are immutable once published, except that child and value
+ * pointers may be replaced in place. Any other change creates a new copy
+ * of the node and retires the old one.
+ */
+typedef struct rtrie_node {
+	/** Bit @c i is set if there is a child for the next nibble @c i */
+	uint16_t child_bm;
+	/** Bit @c (1 << l) - 1 + b is set if there is a value for prefix
+	 * of @c l more bits with value @c b */
+	uint16_t value_bm;
+	/** Next retired node */
+	struct rtrie_node *retired;
+	/** Children followed by values, both in bitmap order */
+	void *slot[];
+} rtrie_node_t;
+
+/** Longest prefix match trie
+ *
+ * Lookups do not lock and run concurrently with changes. Changes must be
+ * serialized by the user.
+ */
+typedef struct {
+	/** Length of keys in bits, a multiple of RTRIE_STRIDE */
+	size_t key_bits;
+	/** Root node */
+	rtrie_node_t *root;
+	/** Number of values */
+	size_t count;
+	/** Nodes waiting for readers to leave before they are freed */
+	rtrie_node_t *retired;
+	/** Current reader epoch */
+	size_t epoch;
+	/** Number of readers in each epoch */
+	atomic_t readers[2];
+} rtrie_t;
+
+extern errno_t rtrie_init(rtrie_t *, size_t);
+extern void rtrie_fini(rtrie_t *);
+extern errno_t rtrie_insert(rtrie_t *, const uint8_t *, size_t, void *);
+extern errno_t rtrie_remove(rtrie_t *, const uint8_t *, size_t);
+extern errno_t rtrie_set(rtrie_t *, const uint8_t *, size_t, void *);
+extern void rtrie_synchronize(rtrie_t *);
+extern size_t rtrie_read_begin(rtrie_t *);
+extern void rtrie_read_end(rtrie_t *, size_t);
+extern void *rtrie_lookup(rtrie_t *, const uint8_t *);
+extern void *rtrie_find(rtrie_t *, const uint8_t *, size_t);
+
+#endif
+
+/** @}
+ */
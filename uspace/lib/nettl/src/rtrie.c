@@ -0,0 +1,581 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup libnettl
+ * @{
+ */
+/**
+ * @file Longest prefix match trie
+ *
+ * Multibit trie with bitmap-compressed nodes (tree bitmap). Every node
+ * consumes RTRIE_STRIDE bits of the key and stores the values of the
+ * prefixes which end within it, so a lookup visits at most
+ * key_bits / RTRIE_STRIDE + 1 nodes regardless of the number of prefixes.
+ *
+ * Readers do not lock. Nodes are replaced rather than changed and the old
+ * copies are freed by rtrie_synchronize() once all readers which could
+ * have seen them have left.
+ */
+
+#include <assert.h>
+#include <async.h>
+#include <bitops.h>
+#include <compiler/barrier.h>
+#include <errno.h>
+#include <libarch/barrier.h>
+#include <nettl/rtrie.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** Number of children of a node */
+#define RTRIE_FANOUT (1 << RTRIE_STRIDE)
+/** Maximum key length in bits */
+#define RTRIE_MAX_KEY_BITS 128
+/** Maximum trie depth */
+#define RTRIE_MAX_DEPTH (RTRIE_MAX_KEY_BITS / RTRIE_STRIDE + 1)
+/** Delay between checks for readers to leave in microseconds */
+#define RTRIE_SYNC_DELAY 1000
+
+static unsigned rtrie_popcount(uint16_t bm)
+{
+	bm = bm - ((bm >> 1) & 0x5555);
+	bm = (bm & 0x3333) + ((bm >> 2) & 0x3333);
+	bm = (bm + (bm >> 4)) & 0x0f0f;
+	return (bm + (bm >> 8)) & 0x1f;
+}
+
+/** Get nibble of @a key at trie depth @a depth. */
+static unsigned rtrie_nibble(const uint8_t *key, size_t depth)
+{
+	uint8_t b = key[depth / 2];
+
+	return (depth % 2 == 0) ? b >> 4 : b & 0x0f;
+}
+
+/** Get bitmap of all prefixes in a node covering nibble @a n.
+ *
+ * Longer prefixes have higher bit indices.
+ */
+static uint16_t rtrie_cover(unsigned n)
+{
+	return 1 | (1 << (1 + (n >> 3))) | (1 << (3 + (n >> 2))) |
+	    (1 << (7 + (n >> 1)));
+}
+
+/** Get value bit index of prefix of @a len bits continuing at @a depth. */
+static unsigned rtrie_value_idx(rtrie_t *trie, const uint8_t *key,
+    size_t depth, size_t len)
+{
+	unsigned l = len % RTRIE_STRIDE;
+
+	if (l == 0)
+		return 0;
+
+	assert(depth < trie->key_bits / RTRIE_STRIDE);
+	return (1 << l) - 1 + (rtrie_nibble(key, depth) >> (RTRIE_STRIDE - l));
+}
+
+/** Get slot of child for nibble @a n. */
+static void **rtrie_child_slot(rtrie_node_t *node, unsigned n)
+{
+	return &node->slot[rtrie_popcount(node->child_bm & ((1 << n) - 1))];
+}
+
+/** Get slot of value with index @a idx. */
+static void **rtrie_value_slot(rtrie_node_t *node, unsigned idx)
+{
+	return &node->slot[rtrie_popcount(node->child_bm) +
+	    rtrie_popcount(node->value_bm & ((1 << idx) - 1))];
+}
+
+static rtrie_node_t *rtrie_node_create(uint16_t child_bm, uint16_t value_bm)
+{
+	rtrie_node_t *node;
+	size_t nslots;
+
+	nslots = rtrie_popcount(child_bm) + rtrie_popcount(value_bm);
+	node = malloc(sizeof(rtrie_node_t) + nslots * sizeof(void *));
+	if (node == NULL)
+		return NULL;
+
+	node->child_bm = child_bm;
+	node->value_bm = value_bm;
+	node->retired = NULL;
+	return node;
+}
+
+/** Create copy of node with different bitmaps.
+ *
+ * Slots present in both @a old and the new bitmaps are copied, slots
+ * only present in the new bitmaps need to be filled in by the caller.
+ */
+static rtrie_node_t *rtrie_node_copy(rtrie_node_t *old, uint16_t child_bm,
+    uint16_t value_bm)
+{
+	rtrie_node_t *node;
+	unsigned i;
+
+	node = rtrie_node_create(child_bm, value_bm);
+	if (node == NULL)
+		return NULL;
+
+	for (i = 0; i < RTRIE_FANOUT; i++) {
+		if ((old->child_bm & child_bm & (1 << i)) != 0)
+			*rtrie_child_slot(node, i) = *rtrie_child_slot(old, i);
+	}
+
+	for (i = 0; i < RTRIE_FANOUT - 1; i++) {
+		if ((old->value_bm & value_bm & (1 << i)) != 0)
+			*rtrie_value_slot(node, i) = *rtrie_value_slot(old, i);
+	}
+
+	return node;
+}
+
+/** Free node and all its descendants. */
+static void rtrie_node_destroy(rtrie_node_t *node)
+{
+	unsigned i;
+
+	for (i = 0; i < RTRIE_FANOUT; i++) {
+		if ((node->child_bm & (1 << i)) != 0)
+			rtrie_node_destroy(*rtrie_child_slot(node, i));
+	}
+
+	free(node);
+}
+
+/** Replace node visible to readers with a new one. */
+static void rtrie_publish(rtrie_t *trie, rtrie_node_t **loc,
+    rtrie_node_t *node)
+{
+	rtrie_node_t *old = *loc;
+
+	/* Readers must not see the node before its contents */
+	write_barrier();
+	ACCESS_ONCE(*loc) = node;
+
+	old->retired = trie->retired;
+	trie->retired = old;
+}
+
+/** Build path of new nodes leading to a single value.
+ *
+ * @param trie  Trie
+ * @param key   Key
+ * @param depth Depth of the first node of the path
+ * @param len   Prefix length in bits
+ * @param value Value
+ *
+ * @return First node of the path or NULL if out of memory
+ */
+static rtrie_node_t *rtrie_path_create(rtrie_t *trie, const uint8_t *key,
+    size_t depth, size_t len, void *value)
+{
+	rtrie_node_t *node;
+	rtrie_node_t *child;
+	size_t d = len / RTRIE_STRIDE;
+
+	node = rtrie_node_create(0, 1 << rtrie_value_idx(trie, key, d, len));
+	if (node == NULL)
+		return NULL;
+
+	node->slot[0] = value;
+
+	while (d > depth) {
+		--d;
+		child = node;
+		node = rtrie_node_create(1 << rtrie_nibble(key, d), 0);
+		if (node == NULL) {
+			rtrie_node_destroy(child);
+			return NULL;
+		}
+
+		node->slot[0] = child;
+	}
+
+	return node;
+}
+
+/** Initialize trie.
+ *
+ * @param trie     Trie
+ * @param key_bits Length of keys in bits, a multiple of RTRIE_STRIDE
+ *
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t rtrie_init(rtrie_t *trie, size_t key_bits)
+{
+	assert(key_bits % RTRIE_STRIDE == 0);
+	assert(key_bits <= RTRIE_MAX_KEY_BITS);
+
+	trie->root = rtrie_node_create(0, 0);
+	if (trie->root == NULL)
+		return ENOMEM;
+
+	trie->key_bits = key_bits;
+	trie->count = 0;
+	trie->retired = NULL;
+	trie->epoch = 0;
+	atomic_set(&trie->readers[0], 0);
+	atomic_set(&trie->readers[1], 0);
+	return EOK;
+}
+
+/** Finalize trie.
+ *
+ * There must be no readers.
+ */
+void rtrie_fini(rtrie_t *trie)
+{
+	rtrie_node_t *node;
+
+	rtrie_node_destroy(trie->root);
+	trie->root = NULL;
+
+	while (trie->retired != NULL) {
+		node = trie->retired;
+		trie->retired = node->retired;
+		free(node);
+	}
+}
+
+/** Insert prefix.
+ *
+ * Nodes replaced by the insertion are freed by the next call to
+ * rtrie_synchronize().
+ *
+ * @param trie  Trie
+ * @param key   Key, its bits past @a len are ignored
+ * @param len   Prefix length in bits
+ * @param value Value, must not be NULL
+ *
+ * @return EOK on success, EEXIST if the prefix is already present,
+ *         ENOMEM if out of memory
+ */
+errno_t rtrie_insert(rtrie_t *trie, const uint8_t *key, size_t len,
+    void *value)
+{
+	rtrie_node_t **loc = &trie->root;
+	rtrie_node_t *node;
+	rtrie_node_t *child;
+	size_t depth = 0;
+	unsigned idx;
+	unsigned n;
+
+	assert(len <= trie->key_bits);
+	assert(value != NULL);
+
+	while (depth < len / RTRIE_STRIDE) {
+		node = *loc;
+		n = rtrie_nibble(key, depth);
+		if ((node->child_bm & (1 << n)) == 0) {
+			/* Build the rest of the path privately, then link it */
+			child = rtrie_path_create(trie, key, depth + 1, len,
+			    value);
+			if (child == NULL)
+				return ENOMEM;
+
+			node = rtrie_node_copy(node, node->child_bm | (1 << n),
+			    node->value_bm);
+			if (node == NULL) {
+				rtrie_node_destroy(child);
+				return ENOMEM;
+			}
+
+			*rtrie_child_slot(node, n) = child;
+			rtrie_publish(trie, loc, node);
+			++trie->count;
+			return EOK;
+		}
+
+		loc = (rtrie_node_t **) rtrie_child_slot(node, n);
+		++depth;
+	}
+
+	node = *loc;
+	idx = rtrie_value_idx(trie, key, depth, len);
+	if ((node->value_bm & (1 << idx)) != 0)
+		return EEXIST;
+
+	node = rtrie_node_copy(node, node->child_bm,
+	    node->value_bm | (1 << idx));
+	if (node == NULL)
+		return ENOMEM;
+
+	*rtrie_value_slot(node, idx) = value;
+	rtrie_publish(trie, loc, node);
+	++trie->count;
+	return EOK;
+}
+
+/** Remove prefix.
+ *
+ * The value and the nodes replaced by the removal may still be in use by
+ * readers until the next call to rtrie_synchronize() returns.
+ *
+ * @param trie Trie
+ * @param key  Key, its bits past @a len are ignored
+ * @param len  Prefix length in bits
+ *
+ * @return EOK on success, ENOENT if the prefix is not present,
+ *         ENOMEM if out of memory
+ */
+errno_t rtrie_remove(rtrie_t *trie, const uint8_t *key, size_t len)
+{
+	rtrie_node_t **locs[RTRIE_MAX_DEPTH];
+	rtrie_node_t *node;
+	rtrie_node_t *empty;
+	uint16_t child_bm;
+	uint16_t value_bm;
+	size_t depth = 0;
+	size_t d;
+	unsigned idx;
+	unsigned n;
+
+	assert(len <= trie->key_bits);
+
+	locs[0] = &trie->root;
+	while (depth < len / RTRIE_STRIDE) {
+		node = *locs[depth];
+		n = rtrie_nibble(key, depth);
+		if ((node->child_bm & (1 << n)) == 0)
+			return ENOENT;
+
+		locs[depth + 1] = (rtrie_node_t **) rtrie_child_slot(node, n);
+		++depth;
+	}
+
+	node = *locs[depth];
+	idx = rtrie_value_idx(trie, key, depth, len);
+	if ((node->value_bm & (1 << idx)) == 0)
+		return ENOENT;
+
+	/* Find the topmost node which does not become empty */
+	d = depth;
+	child_bm = node->child_bm;
+	value_bm = node->value_bm & ~(1 << idx);
+	while (child_bm == 0 && value_bm == 0 && d > 0) {
+		--d;
+		node = *locs[d];
+		child_bm = node->child_bm & ~(1 << rtrie_nibble(key, d));
+		value_bm = node->value_bm;
+	}
+
+	node = rtrie_node_copy(node, child_bm, value_bm);
+	if (node == NULL)
+		return ENOMEM;
+
+	/* The nodes below stay reachable for readers of the old copy */
+	empty = (d < depth) ? *locs[d + 1] : NULL;
+	rtrie_publish(trie, locs[d], node);
+
+	while (d < depth) {
+		++d;
+		node = empty;
+		empty = (d < depth) ? *locs[d + 1] : NULL;
+		node->retired = trie->retired;
+		trie->retired = node;
+	}
+
+	--trie->count;
+	return EOK;
+}
+
+/** Replace value of prefix.
+ *
+ * The old value may still be in use by readers until the next call to
+ * rtrie_synchronize() returns.
+ *
+ * @param trie  Trie
+ * @param key   Key, its bits past @a len are ignored
+ * @param len   Prefix length in bits
+ * @param value New value, must not be NULL
+ *
+ * @return EOK on success, ENOENT if the prefix is not present
+ */
+errno_t rtrie_set(rtrie_t *trie, const uint8_t *key, size_t len, void *value)
+{
+	rtrie_node_t *node = trie->root;
+	size_t depth = 0;
+	unsigned idx;
+	unsigned n;
+
+	assert(len <= trie->key_bits);
+	assert(value != NULL);
+
+	while (depth < len / RTRIE_STRIDE) {
+		n = rtrie_nibble(key, depth);
+		if ((node->child_bm & (1 << n)) == 0)
+			return ENOENT;
+
+		node = *(rtrie_node_t **) rtrie_child_slot(node, n);
+		++depth;
+	}
+
+	idx = rtrie_value_idx(trie, key, depth, len);
+	if ((node->value_bm & (1 << idx)) == 0)
+		return ENOENT;
+
+	ACCESS_ONCE(*rtrie_value_slot(node, idx)) = value;
+	return EOK;
+}
+
+/** Wait for readers and free replaced nodes.
+ *
+ * Waits until all readers which started before the call have left.
+ * Values removed from the trie before the call can then be freed.
+ */
+void rtrie_synchronize(rtrie_t *trie)
+{
+	rtrie_node_t *node;
+	size_t epoch = trie->epoch;
+
+	ACCESS_ONCE(trie->epoch) = epoch + 1;
+	memory_barrier();
+
+	while (atomic_get(&trie->readers[epoch % 2]) != 0)
+		async_usleep(RTRIE_SYNC_DELAY);
+
+	while (trie->retired != NULL) {
+		node = trie->retired;
+		trie->retired = node->retired;
+		free(node);
+	}
+}
+
+/** Enter read section.
+ *
+ * Lookups must be enclosed in a read section. Read sections are short
+ * and must not block.
+ *
+ * @param trie Trie
+ * @return Epoch to pass to rtrie_read_end()
+ */
+size_t rtrie_read_begin(rtrie_t *trie)
+{
+	size_t epoch;
+
+	while (true) {
+		epoch = ACCESS_ONCE(trie->epoch);
+		atomic_inc(&trie->readers[epoch % 2]);
+		memory_barrier();
+
+		/* The writer may have missed us, try again */
+		if (ACCESS_ONCE(trie->epoch) == epoch)
+			return epoch;
+
+		atomic_dec(&trie->readers[epoch % 2]);
+	}
+}
+
+/** Leave read section.
+ *
+ * @param trie  Trie
+ * @param epoch Value returned by rtrie_read_begin()
+ */
+void rtrie_read_end(rtrie_t *trie, size_t epoch)
+{
+	memory_barrier();
+	atomic_dec(&trie->readers[epoch % 2]);
+}
+
+/** Find value of the longest prefix matching key.
+ *
+ * @param trie Trie
+ * @param key  Key of key_bits bits
+ *
+ * @return Value or NULL if no prefix matches
+ */
+void *rtrie_lookup(rtrie_t *trie, const uint8_t *key)
+{
+	rtrie_node_t *node = ACCESS_ONCE(trie->root);
+	size_t depth_max = trie->key_bits / RTRIE_STRIDE;
+	size_t depth = 0;
+	void *best = NULL;
+	uint16_t match;
+	unsigned n = 0;
+
+	while (true) {
+		if (depth < depth_max) {
+			n = rtrie_nibble(key, depth);
+			match = node->value_bm & rtrie_cover(n);
+		} else {
+			match = node->value_bm & 1;
+		}
+
+		if (match != 0) {
+			best = ACCESS_ONCE(*rtrie_value_slot(node,
+			    fnzb32(match)));
+		}
+
+		if (depth == depth_max || (node->child_bm & (1 << n)) == 0)
+			break;
+
+		node = ACCESS_ONCE(*(rtrie_node_t **) rtrie_child_slot(node, n));
+		++depth;
+	}
+
+	return best;
+}
+
+/** Find value of exact prefix.
+ *
+ * @param trie Trie
+ * @param key  Key, its bits past @a len are ignored
+ * @param len  Prefix length in bits
+ *
+ * @return Value or NULL if the prefix is not present
+ */
+void *rtrie_find(rtrie_t *trie, const uint8_t *key, size_t len)
+{
+	rtrie_node_t *node = ACCESS_ONCE(trie->root);
+	size_t depth = 0;
+	unsigned idx;
+	unsigned n;
+
+	assert(len <= trie->key_bits);
+
+	while (depth < len / RTRIE_STRIDE) {
+		n = rtrie_nibble(key, depth);
+		if ((node->child_bm & (1 << n)) == 0)
+			return NULL;
+
+		node = ACCESS_ONCE(*(rtrie_node_t **) rtrie_child_slot(node, n));
+		++depth;
+	}
+
+	idx = rtrie_value_idx(trie, key, depth, len);
+	if ((node->value_bm & (1 << idx)) == 0)
+		return NULL;
+
+	return ACCESS_ONCE(*rtrie_value_slot(node, idx));
+}
+
+/** @}
+ */
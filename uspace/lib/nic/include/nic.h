@@ -68,6 +68,8 @@ typedef struct {
 	link_t link;
 	void *data;
 	size_t size;
+	/** Size of the buffer allocated for data */
+	size_t capacity;
 } nic_frame_t;
 
 typedef list_t nic_frame_list_t;
@@ -119,6 +119,10 @@ struct nic {
 	 * should be locked, the main_lock must be locked as the first.
 	 */
 	fibril_rwlock_t wv_lock;
+	/** Buffer for batching received frames, allocated on first use */
+	void *rx_batch;
+	/** Serializes use of rx_batch */
+	fibril_mutex_t rx_batch_lock;
 	/**
 	 * Function really sending the data. This MUST be filled in if the
 	 * nic_send_message_impl function is used for sending messages (filled
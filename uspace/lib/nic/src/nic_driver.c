@@ -36,6 +36,7 @@
  * @brief Internal implementation of general NIC operations
  */
 
+#include <align.h>
 #include <assert.h>
 #include <fibril_synch.h>
 #include <ns.h>
@@ -46,6 +47,9 @@
 #include <ddf/interrupt.h>
 #include <ops/nic.h>
 #include <errno.h>
+#include <macros.h>
+#include <mem.h>
+#include <nic_iface.h>
 
 #include "nic_driver.h"
 #include "nic_ev.h"
@@ -53,6 +57,12 @@
 
 #define NIC_GLOBALS_MAX_CACHE_SIZE 16
 
+/** Number of released frames kept with their buffers for reuse */
+#define NIC_FRAME_CACHE_SIZE 256
+
+/** Minimum frame buffer size, fits any Ethernet or 802.11 frame */
+#define NIC_FRAME_BUFFER_SIZE 2560
+
 nic_globals_t nic_globals;
 
 /**
@@ -278,12 +288,19 @@ nic_frame_t *nic_alloc_frame(nic_t *nic_data, size_t size)
 			return NULL;
 
 		link_initialize(&frame->link);
+		frame->data = NULL;
+		frame->capacity = 0;
 	}
 
-	frame->data = malloc(size);
-	if (frame->data == NULL) {
-		free(frame);
-		return NULL;
+	/* Cached frames usually come with a buffer large enough */
+	if (frame->capacity < size) {
+		free(frame->data);
+		frame->capacity = max(size, NIC_FRAME_BUFFER_SIZE);
+		frame->data = malloc(frame->capacity);
+		if (frame->data == NULL) {
+			free(frame);
+			return NULL;
+		}
 	}
 
 	frame->size = size;
@@ -300,15 +317,13 @@ void nic_release_frame(nic_t *nic_data, nic_frame_t *frame)
 	if (!frame)
 		return;
 
-	if (frame->data != NULL) {
-		free(frame->data);
-		frame->data = NULL;
-		frame->size = 0;
-	}
+	frame->size = 0;
 
+	/* Keep the buffer with the frame so that it can be reused */
 	fibril_mutex_lock(&nic_globals.lock);
-	if (nic_globals.frame_cache_size >= NIC_GLOBALS_MAX_CACHE_SIZE) {
+	if (nic_globals.frame_cache_size >= NIC_FRAME_CACHE_SIZE) {
 		fibril_mutex_unlock(&nic_globals.lock);
+		free(frame->data);
 		free(frame);
 	} else {
 		list_prepend(&frame->link, &nic_globals.frame_cache);
@@ -507,18 +522,15 @@ void nic_set_tx_busy(nic_t *nic_data, int busy)
 	nic_data->tx_busy = busy;
 }
 
-/**
- * This is the function that the driver should call when it receives a frame.
- * The frame is checked by filters and then sent up to the NIL layer or
- * discarded. The frame is released.
+/** Check received frame against filters and update statistics.
  *
  * @param nic_data
  * @param frame		The received frame
+ *
+ * @return True if the frame should be passed to the NIL layer
  */
-void nic_received_frame(nic_t *nic_data, nic_frame_t *frame)
+static bool nic_rx_accept(nic_t *nic_data, nic_frame_t *frame)
 {
-	/* Note: this function must not lock main lock, because loopback driver
-	 * 		 calls it inside send_frame handler (with locked main lock) */
 	fibril_rwlock_read_lock(&nic_data->rxc_lock);
 	nic_frame_type_t frame_type;
 	bool check = nic_rxc_check(&nic_data->rx_control, frame->data,
@@ -541,45 +553,114 @@ void nic_received_frame(nic_t *nic_data, nic_frame_t *frame)
 			break;
 		}
 		fibril_rwlock_write_unlock(&nic_data->stats_lock);
+		return true;
+	}
+
+	switch (frame_type) {
+	case NIC_FRAME_UNICAST:
+		nic_data->stats.receive_filtered_unicast++;
+		break;
+	case NIC_FRAME_MULTICAST:
+		nic_data->stats.receive_filtered_multicast++;
+		break;
+	case NIC_FRAME_BROADCAST:
+		nic_data->stats.receive_filtered_broadcast++;
+		break;
+	}
+	fibril_rwlock_write_unlock(&nic_data->stats_lock);
+	return false;
+}
+
+/**
+ * This is the function that the driver should call when it receives a frame.
+ * The frame is checked by filters and then sent up to the NIL layer or
+ * discarded. The frame is released.
+ *
+ * @param nic_data
+ * @param frame		The received frame
+ */
+void nic_received_frame(nic_t *nic_data, nic_frame_t *frame)
+{
+	/* Note: this function must not lock main lock, because loopback driver
+	 * 		 calls it inside send_frame handler (with locked main lock) */
+	if (nic_rx_accept(nic_data, frame)) {
 		nic_ev_received(nic_data->client_session, frame->data,
 		    frame->size);
-	} else {
-		switch (frame_type) {
-		case NIC_FRAME_UNICAST:
-			nic_data->stats.receive_filtered_unicast++;
-			break;
-		case NIC_FRAME_MULTICAST:
-			nic_data->stats.receive_filtered_multicast++;
-			break;
-		case NIC_FRAME_BROADCAST:
-			nic_data->stats.receive_filtered_broadcast++;
-			break;
-		}
-		fibril_rwlock_write_unlock(&nic_data->stats_lock);
 	}
 	nic_release_frame(nic_data, frame);
 }
 
 /**
  * Some NICs can receive multiple frames during single interrupt. These can
- * send them in whole list of frames (actually nic_frame_t structures), then
- * the list is deallocated and each frame is passed to the
- * nic_received_packet function.
+ * send them in whole list of frames (actually nic_frame_t structures). The
+ * frames are checked by filters and those passing are sent up to the NIL
+ * layer in as few IPC calls as possible. The list and the frames are
+ * released.
  *
  * @param nic_data
  * @param frames		List of received frames
  */
 void nic_received_frame_list(nic_t *nic_data, nic_frame_list_t *frames)
 {
+	nic_ev_frame_hdr_t *hdr;
+	size_t bsize = 0;
+	size_t count = 0;
+	size_t rsize;
+
 	if (frames == NULL)
 		return;
+
+	fibril_mutex_lock(&nic_data->rx_batch_lock);
+
+	if (nic_data->rx_batch == NULL)
+		nic_data->rx_batch = malloc(DATA_XFER_LIMIT);
+
 	while (!list_empty(frames)) {
 		nic_frame_t *frame =
 		    list_get_instance(list_first(frames), nic_frame_t, link);
 
 		list_remove(&frame->link);
-		nic_received_frame(nic_data, frame);
+
+		if (!nic_rx_accept(nic_data, frame)) {
+			nic_release_frame(nic_data, frame);
+			continue;
+		}
+
+		rsize = sizeof(nic_ev_frame_hdr_t) +
+		    ALIGN_UP(frame->size, sizeof(nic_ev_frame_hdr_t));
+
+		if (count > 0 && bsize + rsize > DATA_XFER_LIMIT) {
+			nic_ev_received_batch(nic_data->client_session,
+			    nic_data->rx_batch, bsize, count);
+			bsize = 0;
+			count = 0;
+		}
+
+		if (nic_data->rx_batch == NULL || rsize > DATA_XFER_LIMIT) {
+			/* Cannot batch this frame */
+			nic_ev_received(nic_data->client_session, frame->data,
+			    frame->size);
+			nic_release_frame(nic_data, frame);
+			continue;
+		}
+
+		hdr = (nic_ev_frame_hdr_t *) ((uint8_t *) nic_data->rx_batch +
+		    bsize);
+		hdr->size = frame->size;
+		memcpy(hdr + 1, frame->data, frame->size);
+		bsize += rsize;
+		count++;
+
+		nic_release_frame(nic_data, frame);
 	}
+
+	if (count > 0) {
+		nic_ev_received_batch(nic_data->client_session,
+		    nic_data->rx_batch, bsize, count);
+	}
+
+	fibril_mutex_unlock(&nic_data->rx_batch_lock);
+
 	nic_driver_release_frame_list(frames);
 }
 
@@ -614,11 +695,13 @@ static nic_t *nic_create(ddf_dev_t *dev)
 	nic_data->on_going_down = NULL;
 	nic_data->on_stopping = NULL;
 	nic_data->specific = NULL;
+	nic_data->rx_batch = NULL;
 
 	fibril_rwlock_initialize(&nic_data->main_lock);
 	fibril_rwlock_initialize(&nic_data->stats_lock);
 	fibril_rwlock_initialize(&nic_data->rxc_lock);
 	fibril_rwlock_initialize(&nic_data->wv_lock);
+	fibril_mutex_initialize(&nic_data->rx_batch_lock);
 
 	memset(&nic_data->mac, 0, sizeof(nic_address_t));
 	memset(&nic_data->default_mac, 0, sizeof(nic_address_t));
@@ -656,6 +739,7 @@ nic_t *nic_create_and_bind(ddf_dev_t *device)
  */
 static void nic_destroy(nic_t *nic_data)
 {
+	free(nic_data->rx_batch);
 	free(nic_data->specific);
 }
 
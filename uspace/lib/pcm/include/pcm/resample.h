@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup audio
+ * @brief HelenOS sound server
+ * @{
+ */
+/** @file
+ * Streaming sample rate converter.
+ */
+
+#ifndef PCM_RESAMPLE_H_
+#define PCM_RESAMPLE_H_
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pcm/format.h>
+
+/** Resampler quality modes */
+typedef enum {
+	/** Linear interpolation, cheapest */
+	PCM_RESAMPLE_FAST,
+	/** Polyphase windowed-sinc filter */
+	PCM_RESAMPLE_QUALITY,
+} pcm_resample_quality_t;
+
+/** Streaming resampler state.
+ *
+ * Input may be pushed in chunks of arbitrary size, filter history and
+ * the fractional position carry over from one chunk to the next.
+ */
+typedef struct {
+	/** Number of interleaved channels */
+	unsigned channels;
+	/** Input sampling rate */
+	unsigned in_rate;
+	/** Output sampling rate */
+	unsigned out_rate;
+	/** Conversion quality */
+	pcm_resample_quality_t quality;
+	/** Reduced output rate (interpolation factor) */
+	uint32_t up;
+	/** Reduced input rate (decimation factor) */
+	uint32_t down;
+	/** Position between two input frames, in 1/up units */
+	uint32_t phase;
+	/** Filter length in frames */
+	unsigned taps;
+	/** Number of tabulated filter phases */
+	unsigned phases;
+	/** Filter coefficients, (phases + 1) * taps entries */
+	float *coefs;
+	/** Input history, interleaved float samples */
+	float *buffer;
+	/** Capacity of the history buffer in frames */
+	size_t buffer_frames;
+	/** Valid frames in the history buffer */
+	size_t filled;
+	/** Input frames to drop before buffering more */
+	size_t skip;
+} pcm_resampler_t;
+
+extern errno_t pcm_resampler_init(pcm_resampler_t *, unsigned, unsigned,
+    unsigned, pcm_resample_quality_t);
+extern void pcm_resampler_fini(pcm_resampler_t *);
+extern void pcm_resampler_reset(pcm_resampler_t *);
+extern size_t pcm_resampler_out_frames(const pcm_resampler_t *, size_t);
+extern size_t pcm_resampler_in_frames(const pcm_resampler_t *, size_t);
+extern errno_t pcm_resampler_process(pcm_resampler_t *, const void *, size_t,
+    const pcm_format_t *, float *, size_t, size_t *);
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup audio
+ * @brief HelenOS sound server
+ * @{
+ */
+/** @file
+ * Streaming sample rate converter.
+ *
+ * The conversion ratio is reduced to a fraction up/down and the output
+ * position is tracked exactly as an input frame index and a phase in 1/up
+ * units, so there is no drift between input and output regardless of the
+ * chunk sizes the data arrive in.
+ *
+ * Fast mode interpolates linearly between neighbouring frames.  Quality
+ * mode uses a windowed-sinc low pass filter tabulated for a fixed number of
+ * phases (polyphase decomposition); the phase nearest to the exact output
+ * position is used.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <macros.h>
+#include <mem.h>
+#include <stdlib.h>
+
+#include "format.h"
+#include "resample.h"
+
+/** Input frames converted to float at once */
+#define RESAMPLE_CHUNK  256
+/** Filter length of the quality mode */
+#define RESAMPLE_TAPS  16
+/** Upper bound on tabulated filter phases */
+#define RESAMPLE_MAX_PHASES  256
+/** Filter cutoff relative to the lower of the two Nyquist frequencies */
+#define RESAMPLE_CUTOFF  0.9
+
+#define PI  3.14159265358979323846
+
+static uint32_t gcd(uint32_t a, uint32_t b)
+{
+	while (b != 0) {
+		const uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/** Sine good enough for filter design, avoids dependency on libmath */
+static double resample_sin(double x)
+{
+	while (x > PI)
+		x -= 2 * PI;
+	while (x < -PI)
+		x += 2 * PI;
+
+	double term = x;
+	double sum = x;
+	for (unsigned n = 1; n < 12; ++n) {
+		term *= -x * x / ((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+static double resample_cos(double x)
+{
+	return resample_sin(x + PI / 2);
+}
+
+static double sinc(double x)
+{
+	if (x == 0.0)
+		return 1.0;
+	return resample_sin(PI * x) / (PI * x);
+}
+
+/** Blackman window over <-half, half> */
+static double blackman(double t, double half)
+{
+	return 0.42 + 0.5 * resample_cos(PI * t / half) +
+	    0.08 * resample_cos(2 * PI * t / half);
+}
+
+/** Tabulate filter coefficients for all phases.
+ *
+ * Row @a p holds the filter for output positions p/phases past the centre
+ * tap.  Every row is normalized to unity gain.
+ */
+static void resampler_design(pcm_resampler_t *r)
+{
+	const double half = r->taps / 2;
+	double cutoff = RESAMPLE_CUTOFF;
+	if (r->up < r->down)
+		cutoff = cutoff * r->up / r->down;
+
+	for (unsigned p = 0; p <= r->phases; ++p) {
+		float *row = &r->coefs[p * r->taps];
+		const double frac = (double) p / r->phases;
+		double sum = 0.0;
+		for (unsigned k = 0; k < r->taps; ++k) {
+			const double t = (double) k - (half - 1) - frac;
+			const double h = cutoff * sinc(cutoff * t) *
+			    blackman(t, half);
+			row[k] = h;
+			sum += h;
+		}
+		for (unsigned k = 0; k < r->taps; ++k)
+			row[k] /= sum;
+	}
+}
+
+/**
+ * Initialize resampler.
+ * @param r Resampler to initialize.
+ * @param channels Number of interleaved channels.
+ * @param in_rate Input sampling rate.
+ * @param out_rate Output sampling rate.
+ * @param quality Conversion quality.
+ * @return Error code.
+ */
+errno_t pcm_resampler_init(pcm_resampler_t *r, unsigned channels,
+    unsigned in_rate, unsigned out_rate, pcm_resample_quality_t quality)
+{
+	assert(r);
+	if (channels == 0 || in_rate == 0 || out_rate == 0)
+		return EINVAL;
+
+	const uint32_t g = gcd(in_rate, out_rate);
+	r->channels = channels;
+	r->in_rate = in_rate;
+	r->out_rate = out_rate;
+	r->quality = quality;
+	r->up = out_rate / g;
+	r->down = in_rate / g;
+	r->coefs = NULL;
+
+	if (quality == PCM_RESAMPLE_QUALITY) {
+		r->taps = RESAMPLE_TAPS;
+		r->phases = min(r->up, RESAMPLE_MAX_PHASES);
+		r->coefs = malloc((r->phases + 1) * r->taps * sizeof(float));
+		if (!r->coefs)
+			return ENOMEM;
+		resampler_design(r);
+	} else {
+		r->taps = 2;
+		r->phases = 0;
+	}
+
+	r->buffer_frames = r->taps + RESAMPLE_CHUNK;
+	r->buffer = malloc(r->buffer_frames * channels * sizeof(float));
+	if (!r->buffer) {
+		free(r->coefs);
+		r->coefs = NULL;
+		return ENOMEM;
+	}
+	pcm_resampler_reset(r);
+	return EOK;
+}
+
+/**
+ * Release resources claimed by initialization.
+ * @param r The resampler to release.
+ */
+void pcm_resampler_fini(pcm_resampler_t *r)
+{
+	assert(r);
+	free(r->coefs);
+	free(r->buffer);
+	r->coefs = NULL;
+	r->buffer = NULL;
+}
+
+/**
+ * Drop buffered input and restart from silence.
+ * @param r The resampler.
+ */
+void pcm_resampler_reset(pcm_resampler_t *r)
+{
+	assert(r);
+	/* Centre tap sits on the first input frame */
+	r->filled = r->taps / 2 - 1;
+	r->skip = 0;
+	r->phase = 0;
+	memset(r->buffer, 0, r->filled * r->channels * sizeof(float));
+}
+
+/**
+ * Upper bound on frames produced from the given input.
+ * @param r The resampler.
+ * @param in_frames Number of input frames.
+ * @return Maximum number of output frames.
+ */
+size_t pcm_resampler_out_frames(const pcm_resampler_t *r, size_t in_frames)
+{
+	assert(r);
+	return ((uint64_t) in_frames * r->up) / r->down + 2;
+}
+
+/**
+ * Number of input frames needed to produce the given output.
+ * @param r The resampler.
+ * @param out_frames Number of output frames requested.
+ * @return Number of input frames.
+ */
+size_t pcm_resampler_in_frames(const pcm_resampler_t *r, size_t out_frames)
+{
+	assert(r);
+	return ((uint64_t) out_frames * r->down + r->up - 1) / r->up;
+}
+
+/** Produce all output frames the buffered input allows.
+ * @return Number of frames written to @p dst.
+ */
+static size_t resampler_run(pcm_resampler_t *r, float *dst)
+{
+	const unsigned ch = r->channels;
+	size_t pos = 0;
+	size_t produced = 0;
+
+	while (pos + r->taps <= r->filled) {
+		const float *in = &r->buffer[pos * ch];
+		if (r->phases == 0) {
+			const float frac = (float) r->phase / r->up;
+			for (unsigned c = 0; c < ch; ++c)
+				dst[c] = in[c] + (in[ch + c] - in[c]) * frac;
+		} else {
+			const unsigned p = ((uint64_t) r->phase * r->phases +
+			    r->up / 2) / r->up;
+			const float *row = &r->coefs[p * r->taps];
+			for (unsigned c = 0; c < ch; ++c) {
+				float acc = 0.0f;
+				for (unsigned k = 0; k < r->taps; ++k)
+					acc += row[k] * in[k * ch + c];
+				dst[c] = acc;
+			}
+		}
+		dst += ch;
+		++produced;
+
+		r->phase += r->down;
+		pos += r->phase / r->up;
+		r->phase %= r->up;
+	}
+
+	if (pos > r->filled) {
+		/* Large decimation ratio stepped past the buffered input */
+		r->skip = pos - r->filled;
+		r->filled = 0;
+	} else {
+		memmove(r->buffer, &r->buffer[pos * ch],
+		    (r->filled - pos) * ch * sizeof(float));
+		r->filled -= pos;
+	}
+	return produced;
+}
+
+/**
+ * Convert a chunk of audio data.
+ * @param r The resampler.
+ * @param src Source audio buffer.
+ * @param src_size Size of the source buffer.
+ * @param sf Source format, must match resampler channel count.
+ * @param dst Destination buffer, native float samples.
+ * @param dst_frames Capacity of the destination buffer in frames.
+ * @param produced Number of frames written to @p dst.
+ * @return Error code.
+ *
+ * The entire input is consumed; frames needed as filter history are kept
+ * for the next call.  The destination must hold at least
+ * pcm_resampler_out_frames() frames.
+ */
+errno_t pcm_resampler_process(pcm_resampler_t *r, const void *src,
+    size_t src_size, const pcm_format_t *sf, float *dst, size_t dst_frames,
+    size_t *produced)
+{
+	assert(r);
+	assert(produced);
+	if (!src || !sf || !dst || sf->channels != r->channels)
+		return EINVAL;
+
+	const size_t frame_size = pcm_format_frame_size(sf);
+	if ((src_size % frame_size) != 0)
+		return EINVAL;
+
+	size_t in_frames = src_size / frame_size;
+	if (dst_frames < pcm_resampler_out_frames(r, in_frames))
+		return EOVERFLOW;
+
+	const pcm_format_t ff = {
+		.channels = r->channels,
+		.sampling_rate = sf->sampling_rate,
+		.sample_format = PCM_SAMPLE_FLOAT32,
+	};
+	const size_t ff_frame_size = pcm_format_frame_size(&ff);
+	size_t out = 0;
+
+	while (in_frames > 0) {
+		if (r->skip > 0) {
+			const size_t drop = min(r->skip, in_frames);
+			src += drop * frame_size;
+			in_frames -= drop;
+			r->skip -= drop;
+			continue;
+		}
+
+		const size_t chunk = min(in_frames, r->buffer_frames - r->filled);
+		float *tail = &r->buffer[r->filled * r->channels];
+		memset(tail, 0, chunk * ff_frame_size);
+		const errno_t ret = pcm_format_convert_and_mix(tail,
+		    chunk * ff_frame_size, src, chunk * frame_size, sf, &ff);
+		if (ret != EOK)
+			return ret;
+
+		r->filled += chunk;
+		src += chunk * frame_size;
+		in_frames -= chunk;
+		out += resampler_run(r, &dst[out * r->channels]);
+	}
+	*produced = out;
+	return EOK;
+}
+
+/**
+ * @}
+ */
@@ -39,6 +39,18 @@
 #include "log.h"
 #include "connection.h"
 
+/** Quality of rate conversion for newly created resamplers */
+static pcm_resample_quality_t resample_quality = PCM_RESAMPLE_QUALITY;
+
+/**
+ * Select sample rate conversion quality.
+ * @param quality Quality used by connections that start resampling later.
+ */
+void connection_set_resample_quality(pcm_resample_quality_t quality)
+{
+	resample_quality = quality;
+}
+
 /**
  * Create connection between source and sink.
  * @param source Valid source structure.
@@ -59,6 +71,7 @@ connection_t *connection_create(audio_source_t *source, audio_sink_t *sink)
 		link_initialize(&conn->hound_link);
 		conn->sink = sink;
 		conn->source = source;
+		conn->resampler = NULL;
 		list_append(&conn->source_link, &source->connections);
 		list_append(&conn->sink_link, &sink->connections);
 		audio_sink_set_format(sink, audio_source_format(source));
@@ -88,6 +101,10 @@ void connection_destroy(connection_t *connection)
 	if (connection->source && connection->source->connection_change)
 		connection->source->connection_change(connection->source, false);
 	audio_pipe_fini(&connection->fifo);
+	if (connection->resampler) {
+		pcm_resampler_fini(connection->resampler);
+		free(connection->resampler);
+	}
 	log_debug("DISCONNECTED: %s -> %s",
 	    connection->source->name, connection->sink->name);
 	free(connection);
@@ -109,9 +126,20 @@ errno_t connection_add_source_data(connection_t *connection, void *data,
 	const size_t needed_frames = pcm_format_size_to_frames(size, &format);
 	if (needed_frames > audio_pipe_frames(&connection->fifo) &&
 	    connection->source->update_available_data) {
+		/* Ask for the amount that resamples to the needed frames */
+		const pcm_format_t *sf =
+		    audio_source_format(connection->source);
+		size_t request = size;
+		if (!pcm_format_is_any(sf) &&
+		    sf->sampling_rate != format.sampling_rate) {
+			const size_t frames = ((uint64_t) needed_frames *
+			    sf->sampling_rate + format.sampling_rate - 1) /
+			    format.sampling_rate;
+			request = frames * pcm_format_frame_size(sf);
+		}
 		log_debug("Asking source to provide more data");
 		connection->source->update_available_data(
-		    connection->source, size);
+		    connection->source, request);
 	}
 	log_verbose("Data available after update: %zu",
 	    audio_pipe_bytes(&connection->fifo));
@@ -122,6 +150,77 @@ errno_t connection_add_source_data(connection_t *connection, void *data,
 		    ret, size);
 	return EOK;
 }
+
+/**
+ * Convert data to the sampling rate of the connected sink.
+ * @param connection Target connection.
+ * @param adata Audio data in the source rate.
+ * @param[out] out Resampled audio data, NULL if no output was produced yet.
+ * @return Error code.
+ *
+ * The resampler is created on first use and recreated if the source
+ * changes its rate or channel layout.  Output is native float so that
+ * the final mix into the sink format is the only quantization step.
+ */
+static errno_t connection_resample(connection_t *connection,
+    audio_data_t *adata, audio_data_t **out)
+{
+	const pcm_format_t *in = &adata->format;
+	const unsigned out_rate = connection->sink->format.sampling_rate;
+	pcm_resampler_t *r = connection->resampler;
+
+	*out = NULL;
+	if (r && (r->channels != in->channels || r->in_rate !=
+	    in->sampling_rate || r->out_rate != out_rate)) {
+		pcm_resampler_fini(r);
+		free(r);
+		r = connection->resampler = NULL;
+	}
+	if (!r) {
+		r = malloc(sizeof(pcm_resampler_t));
+		if (!r)
+			return ENOMEM;
+		const errno_t ret = pcm_resampler_init(r, in->channels,
+		    in->sampling_rate, out_rate, resample_quality);
+		if (ret != EOK) {
+			free(r);
+			return ret;
+		}
+		connection->resampler = r;
+		log_verbose("Resampling %s -> %s: %uHz -> %uHz",
+		    connection_source_name(connection),
+		    connection_sink_name(connection), in->sampling_rate,
+		    out_rate);
+	}
+
+	const pcm_format_t f = {
+		.channels = in->channels,
+		.sampling_rate = out_rate,
+		.sample_format = PCM_SAMPLE_FLOAT32,
+	};
+	const size_t frames = pcm_resampler_out_frames(r,
+	    pcm_format_size_to_frames(adata->size, in));
+	float *buffer = malloc(frames * pcm_format_frame_size(&f));
+	if (!buffer)
+		return ENOMEM;
+
+	size_t produced = 0;
+	const errno_t ret = pcm_resampler_process(r, adata->data, adata->size,
+	    in, buffer, frames, &produced);
+	if (ret != EOK || produced == 0) {
+		free(buffer);
+		return ret;
+	}
+
+	*out = audio_data_create(buffer, produced * pcm_format_frame_size(&f),
+	    f);
+	if (!*out) {
+		free(buffer);
+		return ENOMEM;
+	}
+	return EOK;
+}
+
 /**
  * Add new data to the connection buffer.
  * @param connection Target conneciton.
@@ -133,7 +232,19 @@ errno_t connection_push_data(connection_t *connection,
 {
 	assert(connection);
 	assert(adata);
-	const errno_t ret = audio_pipe_push(&connection->fifo, adata);
+	const pcm_format_t *sink_format = &connection->sink->format;
+	errno_t ret;
+	if (!pcm_format_is_any(sink_format) &&
+	    adata->format.sampling_rate != sink_format->sampling_rate) {
+		audio_data_t *resampled;
+		ret = connection_resample(connection, adata, &resampled);
+		if (ret != EOK || !resampled)
+			return ret;
+		ret = audio_pipe_push(&connection->fifo, resampled);
+		audio_data_unref(resampled);
+	} else {
+		ret = audio_pipe_push(&connection->fifo, adata);
+	}
 	if (ret == EOK && connection->sink->data_available)
 		connection->sink->data_available(connection->sink);
 	return ret;
@@ -39,6 +39,7 @@
 #include <assert.h>
 #include <adt/list.h>
 #include <pcm/format.h>
+#include <pcm/resample.h>
 
 #include "audio_data.h"
 #include "audio_source.h"
@@ -58,6 +59,8 @@ typedef struct {
 	audio_sink_t *sink;
 	/** Target source */
 	audio_source_t *source;
+	/** Rate converter, NULL if source and sink rates match */
+	pcm_resampler_t *resampler;
 } connection_t;
 
 /**
@@ -88,6 +91,8 @@ errno_t connection_add_source_data(connection_t *connection, void *data,
 
 errno_t connection_push_data(connection_t *connection, audio_data_t *adata);
 
+void connection_set_resample_quality(pcm_resample_quality_t quality);
+
 /**
  * Source name getter.
  * @param connection Connection to the source.
@@ -39,11 +39,13 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <str.h>
 #include <str_error.h>
 #include <hound/server.h>
 #include <hound/protocol.h>
 #include <task.h>
 
+#include "connection.h"
 #include "hound.h"
 
 #define NAMESPACE "audio"
@@ -70,6 +72,10 @@ int main(int argc, char **argv)
 {
 	printf("%s: HelenOS sound service\n", NAME);
 
+	/* Trade conversion quality for CPU time on slow machines */
+	if (argc > 1 && str_cmp(argv[1], "--fast-resample") == 0)
+		connection_set_resample_quality(PCM_RESAMPLE_FAST);
+
 	if (log_init(NAME) != EOK) {
 		printf(NAME ": Failed to initialize logging.\n");
 		return 1;
@@ -34,6 +34,7 @@
  */
 
 #include <adt/list.h>
+#include <assert.h>
 #include <bd_srv.h>
 #include <block.h>
 #include <errno.h>
@@ -68,6 +69,7 @@ static errno_t vbds_bd_write_blocks(bd_srv_t *, aoff64_t, size_t, const void *,
     size_t);
 static errno_t vbds_bd_get_block_size(bd_srv_t *, size_t *);
 static errno_t vbds_bd_get_num_blocks(bd_srv_t *, aoff64_t *);
+static errno_t vbds_bd_get_passthrough(bd_srv_t *, service_id_t *, sysarg_t *);
 
 static errno_t vbds_bsa_translate(vbds_part_t *, aoff64_t, size_t, aoff64_t *);
 
@@ -90,7 +92,8 @@ static bd_ops_t vbds_bd_ops = {
 	.sync_cache = vbds_bd_sync_cache,
 	.write_blocks = vbds_bd_write_blocks,
 	.get_block_size = vbds_bd_get_block_size,
-	.get_num_blocks = vbds_bd_get_num_blocks
+	.get_num_blocks = vbds_bd_get_num_blocks,
+	.get_passthrough = vbds_bd_get_passthrough
 };
 
 /** Provide disk access to liblabel */
@@ -299,6 +302,44 @@ static errno_t vbds_part_by_svcid(service_id_t svcid, vbds_part_t **rpart)
 	return ENOENT;
 }
 
+/** Create pass-through window for partition.
+ *
+ * Lets clients access the disk directly, confined to the partition. If the
+ * disk does not support it, all I/O goes through us.
+ *
+ * @param part Partition, must be locked for writing
+ */
+static void vbds_part_window_create(vbds_part_t *part)
+{
+	errno_t rc;
+
+	assert(fibril_rwlock_is_write_locked(&part->lock));
+
+	rc = block_window_create(part->disk->svc_id, part->block0,
+	    part->nblocks, &part->window);
+	if (rc != EOK) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "No pass-through "
+		    "for partition (%s).", str_error(rc));
+		part->window = 0;
+	}
+}
+
+/** Destroy pass-through window of partition, if any.
+ *
+ * Clients still attached to the window are cut off.
+ *
+ * @param part Partition, must be locked for writing
+ */
+static void vbds_part_window_destroy(vbds_part_t *part)
+{
+	assert(fibril_rwlock_is_write_locked(&part->lock));
+
+	if (part->window != 0) {
+		(void) block_window_destroy(part->disk->svc_id, part->window);
+		part->window = 0;
+	}
+}
+
 /** Add partition to our inventory based on liblabel partition structure */
 static errno_t vbds_part_add(vbds_disk_t *disk, label_part_t *lpart,
     vbds_part_t **rpart)
@@ -334,11 +375,18 @@ static errno_t vbds_part_add(vbds_disk_t *disk, label_part_t *lpart,
 	part->bds.sarg = part;
 
 	if (lpinfo.pkind != lpk_extended) {
+		fibril_rwlock_write_lock(&part->lock);
+		vbds_part_window_create(part);
+
 		rc = vbds_part_svc_register(part);
 		if (rc != EOK) {
+			vbds_part_window_destroy(part);
+			fibril_rwlock_write_unlock(&part->lock);
 			free(part);
 			return EIO;
 		}
+
+		fibril_rwlock_write_unlock(&part->lock);
 	}
 
 	list_append(&part->ldisk, &disk->parts);
@@ -387,6 +435,9 @@ static errno_t vbds_part_remove(vbds_part_t *part, vbds_rem_flag_t flag,
 		}
 	}
 
+	/* Cut off pass-through clients left behind by forced removal */
+	vbds_part_window_destroy(part);
+
 	list_remove(&part->ldisk);
 	fibril_mutex_lock(&vbds_parts_lock);
 	list_remove(&part->lparts);
@@ -1067,6 +1118,27 @@ static errno_t vbds_bd_get_num_blocks(bd_srv_t *bd, aoff64_t *rnb)
 	return EOK;
 }
 
+static errno_t vbds_bd_get_passthrough(bd_srv_t *bd, service_id_t *rsid,
+    sysarg_t *rwindow)
+{
+	vbds_part_t *part = bd_srv_part(bd);
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "vbds_bd_get_passthrough()");
+
+	fibril_rwlock_read_lock(&part->lock);
+	if (part->window != 0) {
+		*rsid = part->disk->svc_id;
+		*rwindow = part->window;
+		rc = EOK;
+	} else {
+		rc = ENOTSUP;
+	}
+	fibril_rwlock_read_unlock(&part->lock);
+
+	return rc;
+}
+
 void vbds_bd_conn(cap_call_handle_t icall_handle, ipc_call_t *icall, void *arg)
 {
 	vbds_part_t *part;
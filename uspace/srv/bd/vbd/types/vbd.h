@@ -81,6 +81,8 @@ typedef struct {
 	aoff64_t block0;
 	/** Number of blocks */
 	aoff64_t nblocks;
+	/** Pass-through window on the disk or 0, protected by lock */
+	sysarg_t window;
 	/** Reference count */
 	atomic_t refcnt;
 } vbds_part_t;
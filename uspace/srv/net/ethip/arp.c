@@ -38,6 +38,7 @@
 #include <io/log.h>
 #include <inet/iplink_srv.h>
 #include <inet/addr.h>
+#include <mem.h>
 #include <stdlib.h>
 #include "arp.h"
 #include "atrans.h"
@@ -46,11 +47,30 @@
 #include "pdu.h"
 #include "std.h"
 
-/** Time to wait for ARP reply in microseconds */
-#define ARP_REQUEST_TIMEOUT (3 * 1000 * 1000)
-
 static errno_t arp_send_packet(ethip_nic_t *nic, arp_eth_packet_t *packet);
 
+/** Send frames which have been waiting for address resolution.
+ *
+ * @param frames   List of ethip_atrans_frame_t, empty on return
+ * @param mac_addr Resolved destination MAC address
+ */
+static void arp_send_queued(list_t *frames, addr48_t mac_addr)
+{
+	ethip_atrans_frame_t *frame;
+
+	while (!list_empty(frames)) {
+		frame = list_get_instance(list_first(frames),
+		    ethip_atrans_frame_t, lqueue);
+		list_remove(&frame->lqueue);
+
+		addr48(mac_addr, ((eth_header_t *) frame->data)->dest);
+		(void) ethip_nic_send(frame->nic, frame->data, frame->size);
+
+		free(frame->data);
+		free(frame);
+	}
+}
+
 void arp_received(ethip_nic_t *nic, eth_frame_t *frame)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "arp_received()");
@@ -77,8 +97,12 @@ void arp_received(ethip_nic_t *nic, eth_frame_t *frame)
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "Request/reply to my address");
 
-	(void) atrans_add(packet.sender_proto_addr,
-	    packet.sender_hw_addr);
+	list_t frames;
+	list_initialize(&frames);
+
+	(void) atrans_add(nic, laddr_v4, packet.sender_proto_addr,
+	    packet.sender_hw_addr, &frames);
+	arp_send_queued(&frames, packet.sender_hw_addr);
 
 	if (packet.opcode == aop_request) {
 		arp_eth_packet_t reply;
@@ -93,19 +117,16 @@ void arp_received(ethip_nic_t *nic, eth_frame_t *frame)
 	}
 }
 
-errno_t arp_translate(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr,
-    addr48_t mac_addr)
+/** Send ARP request.
+ *
+ * @param nic      NIC
+ * @param src_addr Source IPv4 address
+ * @param ip_addr  IPv4 address to resolve
+ *
+ * @return EOK on success or an error code
+ */
+errno_t arp_request(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr)
 {
-	/* Broadcast address */
-	if (ip_addr == addr32_broadcast_all_hosts) {
-		addr48(addr48_broadcast, mac_addr);
-		return EOK;
-	}
-
-	errno_t rc = atrans_lookup(ip_addr, mac_addr);
-	if (rc == EOK)
-		return EOK;
-
 	arp_eth_packet_t packet;
 
 	packet.opcode = aop_request;
@@ -114,11 +135,59 @@ errno_t arp_translate(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr,
 	addr48(addr48_broadcast, packet.target_hw_addr);
 	packet.target_proto_addr = ip_addr;
 
-	rc = arp_send_packet(nic, &packet);
+	return arp_send_packet(nic, &packet);
+}
+
+/** Send IPv4 datagram to a neighbour.
+ *
+ * If the destination MAC address is not known yet, the frame is queued
+ * and sent once the address is resolved.
+ *
+ * @param nic      NIC
+ * @param src_addr Source IPv4 address
+ * @param ip_addr  Destination IPv4 address
+ * @param frame    Ethernet frame, the destination address is filled in
+ *
+ * @return EOK on success or an error code
+ */
+errno_t arp_send_dgram(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr,
+    eth_frame_t *frame)
+{
+	addr48_t mac_addr;
+	bool resolved = true;
+	void *data;
+	size_t size;
+	errno_t rc;
+
+	if (ip_addr == addr32_broadcast_all_hosts) {
+		/* Broadcast address */
+		addr48(addr48_broadcast, frame->dest);
+	} else if (atrans_lookup(ip_addr, frame->dest) != EOK) {
+		memset(frame->dest, 0, sizeof(addr48_t));
+		resolved = false;
+	}
+
+	rc = eth_pdu_encode(frame, &data, &size);
 	if (rc != EOK)
 		return rc;
 
-	return atrans_lookup_timeout(ip_addr, ARP_REQUEST_TIMEOUT, mac_addr);
+	if (!resolved) {
+		rc = atrans_queue(nic, src_addr, ip_addr, data, size, mac_addr);
+		if (rc == EOK)
+			return EOK;
+
+		if (rc != EEXIST) {
+			free(data);
+			return rc;
+		}
+
+		addr48(mac_addr, ((eth_header_t *) data)->dest);
+	}
+
+	rc = ethip_nic_send(nic, data, size);
+	free(data);
+
+	return rc;
 }
 
 static errno_t arp_send_packet(ethip_nic_t *nic, arp_eth_packet_t *packet)
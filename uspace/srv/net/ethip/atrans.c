@@ -35,130 +35,465 @@
  */
 
 #include <adt/list.h>
+#include <async.h>
+#include <compiler/barrier.h>
 #include <errno.h>
+#include <fibril.h>
 #include <fibril_synch.h>
 #include <inet/iplink_srv.h>
+#include <io/log.h>
+#include <libarch/barrier.h>
 #include <stdlib.h>
 
+#include "arp.h"
 #include "atrans.h"
 #include "ethip.h"
 
-/** Address translation list (of ethip_atrans_t) */
-static FIBRIL_MUTEX_INITIALIZE(atrans_list_lock);
-static LIST_INITIALIZE(atrans_list);
-static FIBRIL_CONDVAR_INITIALIZE(atrans_cv);
+/** Number of bits of the hash table index */
+#define ATRANS_HASH_BITS 6
+/** Number of hash table buckets */
+#define ATRANS_HASH_SIZE (1 << ATRANS_HASH_BITS)
 
-static ethip_atrans_t *atrans_find(addr32_t ip_addr)
+/** Maximum number of table entries */
+#define ATRANS_MAX_ENTRIES 1024
+/** Maximum number of frames waiting for resolution of one address */
+#define ATRANS_QUEUE_MAX 8
+
+/** Aging period in microseconds */
+#define ATRANS_TICK (1000 * 1000)
+/** Number of aging periods a confirmed address is valid for */
+#define ATRANS_REACHABLE_TICKS 300
+/** Number of ARP requests sent before giving up, one per aging period */
+#define ATRANS_REQUEST_RETRIES 3
+
+/** Serializes changes to the address translation table */
+static FIBRIL_MUTEX_INITIALIZE(atrans_lock);
+/** Hash table of address translation entries (of ethip_atrans_t) */
+static ethip_atrans_t *atrans_hash[ATRANS_HASH_SIZE];
+/** Free entries (of ethip_atrans_t) */
+static ethip_atrans_t *atrans_free;
+/** Number of allocated entries */
+static size_t atrans_count;
+/** Current aging pass */
+static unsigned atrans_gen;
+
+static size_t atrans_hash_key(addr32_t ip_addr)
 {
-	list_foreach(atrans_list, atrans_list, ethip_atrans_t, atrans) {
-		if (atrans->ip_addr == ip_addr)
-			return atrans;
-	}
+	return (ip_addr * 2654435761U) >> (32 - ATRANS_HASH_BITS);
+}
 
-	return NULL;
+/** Start changing entry fields visible to lockless readers. */
+static void atrans_write_begin(ethip_atrans_t *atrans)
+{
+	ACCESS_ONCE(atrans->seq) = atrans->seq + 1;
+	write_barrier();
 }
 
-errno_t atrans_add(addr32_t ip_addr, addr48_t mac_addr)
+/** Finish changing entry fields visible to lockless readers. */
+static void atrans_write_end(ethip_atrans_t *atrans)
+{
+	write_barrier();
+	ACCESS_ONCE(atrans->seq) = atrans->seq + 1;
+}
+
+/** Find link pointing to entry, table lock must be held. */
+static ethip_atrans_t **atrans_find_link(addr32_t ip_addr)
+{
+	ethip_atrans_t **link = &atrans_hash[atrans_hash_key(ip_addr)];
+
+	while (*link != NULL && (*link)->ip_addr != ip_addr)
+		link = &(*link)->next;
+
+	return link;
+}
+
+/** Find entry, table lock must be held. */
+static ethip_atrans_t *atrans_find(addr32_t ip_addr)
+{
+	return *atrans_find_link(ip_addr);
+}
+
+/** Create incomplete entry, table lock must be held.
+ *
+ * @return New entry or NULL if out of memory or the table is full
+ */
+static ethip_atrans_t *atrans_create(addr32_t ip_addr)
 {
 	ethip_atrans_t *atrans;
-	ethip_atrans_t *prev;
+	size_t key = atrans_hash_key(ip_addr);
 
-	atrans = calloc(1, sizeof(ethip_atrans_t));
-	if (atrans == NULL)
-		return ENOMEM;
+	if (atrans_free != NULL) {
+		atrans = atrans_free;
+		atrans_free = atrans->next;
+	} else {
+		if (atrans_count >= ATRANS_MAX_ENTRIES)
+			return NULL;
 
-	atrans->ip_addr = ip_addr;
-	addr48(mac_addr, atrans->mac_addr);
+		atrans = calloc(1, sizeof(ethip_atrans_t));
+		if (atrans == NULL)
+			return NULL;
 
-	fibril_mutex_lock(&atrans_list_lock);
-	prev = atrans_find(ip_addr);
-	if (prev != NULL) {
-		list_remove(&prev->atrans_list);
-		free(prev);
+		list_initialize(&atrans->queue);
+		++atrans_count;
 	}
 
-	list_append(&atrans->atrans_list, &atrans_list);
-	fibril_mutex_unlock(&atrans_list_lock);
-	fibril_condvar_broadcast(&atrans_cv);
+	atrans_write_begin(atrans);
+	atrans->ip_addr = ip_addr;
+	atrans->state = ats_incomplete;
+	atrans->next = atrans_hash[key];
+	atrans_write_end(atrans);
+
+	atrans->used = false;
+	atrans->nic = NULL;
+	atrans->src_addr = 0;
+	atrans->ticks = 1;
+	atrans->retries = 0;
+	atrans->gen = atrans_gen;
+	atrans->queue_len = 0;
 
-	return EOK;
+	/* Publish the fully initialized entry */
+	write_barrier();
+	ACCESS_ONCE(atrans_hash[key]) = atrans;
+	return atrans;
 }
 
-errno_t atrans_remove(addr32_t ip_addr)
+/** Remove entry from the table, table lock must be held.
+ *
+ * The entry goes to the free list. Lockless readers may still be looking
+ * at it, but they will notice the change of its sequence number.
+ *
+ * @param atrans  Entry
+ * @param link    Link pointing to the entry
+ * @param dropped List to move frames waiting for resolution to
+ */
+static void atrans_destroy(ethip_atrans_t *atrans, ethip_atrans_t **link,
+    list_t *dropped)
+{
+	ACCESS_ONCE(*link) = atrans->next;
+
+	atrans_write_begin(atrans);
+	atrans->state = ats_free;
+	atrans_write_end(atrans);
+
+	list_concat(dropped, &atrans->queue);
+	atrans->queue_len = 0;
+
+	atrans->next = atrans_free;
+	atrans_free = atrans;
+}
+
+/** Free list of frames (of ethip_atrans_frame_t). */
+static void atrans_frames_free(list_t *frames)
+{
+	ethip_atrans_frame_t *frame;
+
+	while (!list_empty(frames)) {
+		frame = list_get_instance(list_first(frames),
+		    ethip_atrans_frame_t, lqueue);
+		list_remove(&frame->lqueue);
+		free(frame->data);
+		free(frame);
+	}
+}
+
+/** Add or confirm address translation.
+ *
+ * @param nic      NIC the translation was learned on
+ * @param src_addr Local address to use for ARP requests
+ * @param ip_addr  IPv4 address
+ * @param mac_addr MAC address
+ * @param frames   List to move frames waiting for the address to. The
+ *                 caller is responsible for sending them.
+ *
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t atrans_add(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr,
+    addr48_t mac_addr, list_t *frames)
 {
 	ethip_atrans_t *atrans;
 
-	fibril_mutex_lock(&atrans_list_lock);
+	fibril_mutex_lock(&atrans_lock);
+
 	atrans = atrans_find(ip_addr);
 	if (atrans == NULL) {
-		fibril_mutex_unlock(&atrans_list_lock);
-		return ENOENT;
+		atrans = atrans_create(ip_addr);
+		if (atrans == NULL) {
+			fibril_mutex_unlock(&atrans_lock);
+			return ENOMEM;
+		}
 	}
 
-	list_remove(&atrans->atrans_list);
-	fibril_mutex_unlock(&atrans_list_lock);
-	free(atrans);
+	/* Do not disturb readers if nothing changes for them */
+	if (atrans->state != ats_reachable ||
+	    !addr48_compare(atrans->mac_addr, mac_addr)) {
+		atrans_write_begin(atrans);
+		addr48(mac_addr, atrans->mac_addr);
+		atrans->state = ats_reachable;
+		atrans_write_end(atrans);
+	}
 
+	atrans->nic = nic;
+	atrans->src_addr = src_addr;
+	atrans->ticks = ATRANS_REACHABLE_TICKS;
+	atrans->retries = 0;
+	atrans->used = false;
+
+	list_concat(frames, &atrans->queue);
+	atrans->queue_len = 0;
+
+	fibril_mutex_unlock(&atrans_lock);
 	return EOK;
 }
 
-static errno_t atrans_lookup_locked(addr32_t ip_addr, addr48_t mac_addr)
+errno_t atrans_remove(addr32_t ip_addr)
 {
-	ethip_atrans_t *atrans = atrans_find(ip_addr);
-	if (atrans == NULL)
+	ethip_atrans_t **link;
+	list_t dropped;
+
+	list_initialize(&dropped);
+
+	fibril_mutex_lock(&atrans_lock);
+	link = atrans_find_link(ip_addr);
+	if (*link == NULL) {
+		fibril_mutex_unlock(&atrans_lock);
 		return ENOENT;
+	}
+
+	atrans_destroy(*link, link, &dropped);
+	fibril_mutex_unlock(&atrans_lock);
 
-	addr48(atrans->mac_addr, mac_addr);
+	atrans_frames_free(&dropped);
 	return EOK;
 }
 
+/** Look up address translation without locking.
+ *
+ * This is the fast path for every transmitted datagram. It can fail
+ * spuriously if the table is being changed at the same time, callers
+ * then fall back to atrans_queue(), which looks again under the lock.
+ *
+ * @param ip_addr  IPv4 address
+ * @param mac_addr Place to store MAC address
+ *
+ * @return EOK on success, ENOENT if not found
+ */
 errno_t atrans_lookup(addr32_t ip_addr, addr48_t mac_addr)
 {
-	errno_t rc;
+	ethip_atrans_t *atrans;
+	ethip_atrans_state_t state;
+	size_t steps = 0;
+	size_t seq;
+
+	atrans = ACCESS_ONCE(atrans_hash[atrans_hash_key(ip_addr)]);
+
+	/* Recycled entries may lead us astray, bound the walk */
+	while (atrans != NULL && steps++ < ATRANS_MAX_ENTRIES) {
+		seq = ACCESS_ONCE(atrans->seq);
+		read_barrier();
 
-	fibril_mutex_lock(&atrans_list_lock);
-	rc = atrans_lookup_locked(ip_addr, mac_addr);
-	fibril_mutex_unlock(&atrans_list_lock);
+		if (atrans->ip_addr == ip_addr) {
+			state = atrans->state;
+			addr48(atrans->mac_addr, mac_addr);
 
-	return rc;
+			read_barrier();
+			if ((seq & 1) != 0 || ACCESS_ONCE(atrans->seq) != seq)
+				return ENOENT;
+
+			if (state != ats_reachable && state != ats_probe)
+				return ENOENT;
+
+			if (!atrans->used)
+				ACCESS_ONCE(atrans->used) = true;
+			return EOK;
+		}
+
+		atrans = ACCESS_ONCE(atrans->next);
+	}
+
+	return ENOENT;
 }
 
-static void atrans_lookup_timeout_handler(void *arg)
+/** Queue frame until address is resolved.
+ *
+ * If there is no entry for the address, one is created and an ARP request
+ * is sent. The frame is sent by whoever receives the ARP reply, the
+ * sending fibril does not wait. If too many frames are waiting for the
+ * address, the oldest one is dropped.
+ *
+ * @param nic      NIC to send the frame through
+ * @param src_addr Source IPv4 address for ARP requests
+ * @param ip_addr  Destination IPv4 address
+ * @param data     Encoded Ethernet frame, on success owned by the queue
+ * @param size     Size of @a data in bytes
+ * @param mac_addr Place to store the MAC address if it is already known
+ *
+ * @return EOK if the frame was queued, EEXIST if the address is known
+ *         and the caller should send the frame itself, ENOMEM if out
+ *         of memory
+ */
+errno_t atrans_queue(ethip_nic_t *nic, addr32_t src_addr, addr32_t ip_addr,
+    void *data, size_t size, addr48_t mac_addr)
 {
-	bool *timedout = (bool *)arg;
+	ethip_atrans_t *atrans;
+	ethip_atrans_frame_t *frame;
+	ethip_atrans_frame_t *old = NULL;
+	bool request = false;
+
+	frame = calloc(1, sizeof(ethip_atrans_frame_t));
+	if (frame == NULL)
+		return ENOMEM;
+
+	link_initialize(&frame->lqueue);
+	frame->nic = nic;
+	frame->data = data;
+	frame->size = size;
+
+	fibril_mutex_lock(&atrans_lock);
+
+	atrans = atrans_find(ip_addr);
+	if (atrans != NULL && (atrans->state == ats_reachable ||
+	    atrans->state == ats_probe)) {
+		addr48(atrans->mac_addr, mac_addr);
+		atrans->used = true;
+		fibril_mutex_unlock(&atrans_lock);
+		free(frame);
+		return EEXIST;
+	}
+
+	if (atrans == NULL) {
+		atrans = atrans_create(ip_addr);
+		if (atrans == NULL) {
+			fibril_mutex_unlock(&atrans_lock);
+			free(frame);
+			return ENOMEM;
+		}
+
+		atrans->nic = nic;
+		atrans->src_addr = src_addr;
+		atrans->retries = 1;
+		request = true;
+	}
+
+	if (atrans->queue_len >= ATRANS_QUEUE_MAX) {
+		old = list_get_instance(list_first(&atrans->queue),
+		    ethip_atrans_frame_t, lqueue);
+		list_remove(&old->lqueue);
+		--atrans->queue_len;
+	}
+
+	list_append(&frame->lqueue, &atrans->queue);
+	++atrans->queue_len;
+
+	fibril_mutex_unlock(&atrans_lock);
 
-	fibril_mutex_lock(&atrans_list_lock);
-	*timedout = true;
-	fibril_mutex_unlock(&atrans_list_lock);
-	fibril_condvar_broadcast(&atrans_cv);
+	if (old != NULL) {
+		free(old->data);
+		free(old);
+	}
+
+	/* Not under the lock, sending can loop back to arp_received() */
+	if (request)
+		(void) arp_request(nic, src_addr, ip_addr);
+
+	return EOK;
 }
 
-errno_t atrans_lookup_timeout(addr32_t ip_addr, suseconds_t timeout,
-    addr48_t mac_addr)
+/** Age address translation entries.
+ *
+ * Retransmits ARP requests for unresolved addresses and gives up on them
+ * after ATRANS_REQUEST_RETRIES attempts. Expired entries which have been
+ * used since they were confirmed are probed, the others are removed.
+ */
+static void atrans_age(void)
 {
-	fibril_timer_t *t;
-	bool timedout;
-	errno_t rc;
+	ethip_atrans_t **link;
+	ethip_atrans_t *atrans;
+	ethip_nic_t *nic;
+	addr32_t src_addr;
+	addr32_t ip_addr;
+	list_t dropped;
+	size_t i;
 
-	t = fibril_timer_create(NULL);
-	if (t == NULL)
-		return ENOMEM;
+	list_initialize(&dropped);
+
+	fibril_mutex_lock(&atrans_lock);
+	++atrans_gen;
+
+restart:
+	for (i = 0; i < ATRANS_HASH_SIZE; i++) {
+		link = &atrans_hash[i];
+		while ((atrans = *link) != NULL) {
+			if (atrans->gen == atrans_gen || atrans->ticks > 1) {
+				if (atrans->gen != atrans_gen)
+					--atrans->ticks;
+				atrans->gen = atrans_gen;
+				link = &atrans->next;
+				continue;
+			}
+
+			atrans->gen = atrans_gen;
+
+			if (atrans->state == ats_reachable && atrans->used) {
+				atrans_write_begin(atrans);
+				atrans->state = ats_probe;
+				atrans_write_end(atrans);
+				atrans->retries = 0;
+			} else if (atrans->state == ats_reachable ||
+			    atrans->retries >= ATRANS_REQUEST_RETRIES ||
+			    atrans->nic == NULL) {
+				atrans_destroy(atrans, link, &dropped);
+				continue;
+			}
+
+			++atrans->retries;
+			atrans->ticks = 1;
+			nic = atrans->nic;
+			src_addr = atrans->src_addr;
+			ip_addr = atrans->ip_addr;
+
+			/* Not under the lock, sending can loop back to us */
+			fibril_mutex_unlock(&atrans_lock);
+			(void) arp_request(nic, src_addr, ip_addr);
+			fibril_mutex_lock(&atrans_lock);
 
-	timedout = false;
-	fibril_timer_set(t, timeout, atrans_lookup_timeout_handler, &timedout);
+			/* The table may have changed */
+			goto restart;
+		}
+	}
 
-	fibril_mutex_lock(&atrans_list_lock);
+	fibril_mutex_unlock(&atrans_lock);
 
-	while ((rc = atrans_lookup_locked(ip_addr, mac_addr)) == ENOENT &&
-	    !timedout) {
-		fibril_condvar_wait(&atrans_cv, &atrans_list_lock);
+	if (!list_empty(&dropped)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Dropping frames for "
+		    "unresolved addresses.");
+		atrans_frames_free(&dropped);
 	}
+}
+
+static errno_t atrans_aging_fibril(void *arg)
+{
+	while (true) {
+		async_usleep(ATRANS_TICK);
+		atrans_age();
+	}
+
+	return EOK;
+}
 
-	fibril_mutex_unlock(&atrans_list_lock);
-	(void) fibril_timer_clear(t);
-	fibril_timer_destroy(t);
+/** Initialize address translation.
+ *
+ * @return EOK on success, ENOMEM if out of memory
+ */
+errno_t atrans_init(void)
+{
+	fid_t fid;
 
-	return rc;
+	fid = fibril_create(atrans_aging_fibril, NULL);
+	if (fid == 0)
+		return ENOMEM;
+
+	fibril_add_ready(fid);
+	return EOK;
 }
 
 /** @}
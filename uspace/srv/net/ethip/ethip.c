@@ -45,6 +45,7 @@
 #include <stdlib.h>
 #include <task.h>
 #include "arp.h"
+#include "atrans.h"
 #include "ethip.h"
 #include "ethip_nic.h"
 #include "pdu.h"
@@ -86,6 +87,10 @@ static errno_t ethip_init(void)
 		return rc;
 	}
 
+	rc = atrans_init();
+	if (rc != EOK)
+		return rc;
+
 	rc = ethip_nic_discovery_start();
 	if (rc != EOK)
 		return rc;
@@ -176,26 +181,16 @@ static errno_t ethip_send(iplink_srv_t *srv, iplink_sdu_t *sdu)
 	ethip_nic_t *nic = (ethip_nic_t *) srv->arg;
 	eth_frame_t frame;
 
-	errno_t rc = arp_translate(nic, sdu->src, sdu->dest, frame.dest);
-	if (rc != EOK) {
-		log_msg(LOG_DEFAULT, LVL_WARN, "Failed to look up IPv4 address 0x%"
-		    PRIx32, sdu->dest);
-		return rc;
-	}
-
 	addr48(nic->mac_addr, frame.src);
 	frame.etype_len = ETYPE_IP;
 	frame.data = sdu->data;
 	frame.size = sdu->size;
 
-	void *data;
-	size_t size;
-	rc = eth_pdu_encode(&frame, &data, &size);
-	if (rc != EOK)
-		return rc;
-
-	rc = ethip_nic_send(nic, data, size);
-	free(data);
+	errno_t rc = arp_send_dgram(nic, sdu->src, sdu->dest, &frame);
+	if (rc != EOK) {
+		log_msg(LOG_DEFAULT, LVL_WARN, "Failed to send to IPv4 address "
+		    "0x%" PRIx32, sdu->dest);
+	}
 
 	return rc;
 }
@@ -225,7 +220,28 @@ static errno_t ethip_send6(iplink_srv_t *srv, iplink_sdu6_t *sdu)
 	return rc;
 }
 
-errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
+/** Pass received datagram to inetsrv, possibly as part of a batch. */
+static errno_t ethip_recv_sdu(ethip_nic_t *nic, iplink_recv_sdu_t *sdu,
+    ip_ver_t ver, iplink_recv_batch_t *batch)
+{
+	if (batch != NULL)
+		return iplink_ev_recv_batch_add(&nic->iplink, batch, sdu, ver);
+
+	return iplink_ev_recv(&nic->iplink, sdu, ver);
+}
+
+/** Process received Ethernet frame.
+ *
+ * @param srv   IP link server
+ * @param data  Frame data
+ * @param size  Frame size in bytes
+ * @param batch Batch to add IP datagrams to or @c NULL to deliver
+ *              them to inetsrv right away
+ *
+ * @return EOK on success or an error code
+ */
+errno_t ethip_received_batched(iplink_srv_t *srv, void *data, size_t size,
+    iplink_recv_batch_t *batch)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_received(): srv=%p", srv);
 	ethip_nic_t *nic = (ethip_nic_t *) srv->arg;
@@ -250,24 +266,28 @@ errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
 		sdu.data = frame.data;
 		sdu.size = frame.size;
 		log_msg(LOG_DEFAULT, LVL_DEBUG, " - call iplink_ev_recv");
-		rc = iplink_ev_recv(&nic->iplink, &sdu, ip_v4);
+		rc = ethip_recv_sdu(nic, &sdu, ip_v4, batch);
 		break;
 	case ETYPE_IPV6:
 		log_msg(LOG_DEFAULT, LVL_DEBUG, " - construct SDU IPv6");
 		sdu.data = frame.data;
 		sdu.size = frame.size;
 		log_msg(LOG_DEFAULT, LVL_DEBUG, " - call iplink_ev_recv");
-		rc = iplink_ev_recv(&nic->iplink, &sdu, ip_v6);
+		rc = ethip_recv_sdu(nic, &sdu, ip_v6, batch);
 		break;
 	default:
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "Unknown ethertype 0x%" PRIx16,
 		    frame.etype_len);
 	}
 
-	free(frame.data);
 	return rc;
 }
 
+errno_t ethip_received(iplink_srv_t *srv, void *data, size_t size)
+{
+	return ethip_received_batched(srv, data, size, NULL);
+}
+
 static errno_t ethip_get_mtu(iplink_srv_t *srv, size_t *mtu)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_get_mtu()");
@@ -67,6 +67,9 @@ typedef struct ethip_nic {
 	 * (of the type ethip_link_addr_t)
 	 */
 	list_t addr_list;
+
+	/** Datagrams received in a frame batch, passed on to inetsrv at once */
+	iplink_recv_batch_t rx_batch;
 } ethip_nic_t;
 
 /** Ethernet frame */
@@ -108,15 +111,70 @@ typedef struct {
 	addr32_t target_proto_addr;
 } arp_eth_packet_t;
 
-/** Address translation table element */
-typedef struct {
-	link_t atrans_list;
+/** Address translation entry state */
+typedef enum {
+	/** Entry is on the free list */
+	ats_free,
+	/** Waiting for ARP reply, no address yet */
+	ats_incomplete,
+	/** Address is valid */
+	ats_reachable,
+	/** Address is valid, but being confirmed after expiration */
+	ats_probe
+} ethip_atrans_state_t;
+
+/** Address translation table element
+ *
+ * Elements are never freed, only recycled through the free list, so that
+ * lookups can traverse the table without locking. Readers validate what
+ * they have read against @c seq.
+ */
+typedef struct ethip_atrans {
+	/** Next element in hash chain or free list */
+	struct ethip_atrans *next;
+	/** Sequence number, odd while the element is being changed */
+	size_t seq;
+	/** Entry state */
+	ethip_atrans_state_t state;
 	addr32_t ip_addr;
 	addr48_t mac_addr;
+	/** Entry has been used for sending since it was last confirmed */
+	bool used;
+
+	/*
+	 * The fields below are protected by the table lock.
+	 */
+
+	/** NIC to send ARP requests through */
+	ethip_nic_t *nic;
+	/** Source address for ARP requests */
+	addr32_t src_addr;
+	/** Ticks until expiration or next ARP request */
+	unsigned ticks;
+	/** Number of ARP requests sent without reply */
+	unsigned retries;
+	/** Aging pass which processed the entry last */
+	unsigned gen;
+	/** Frames waiting for address resolution (of ethip_atrans_frame_t) */
+	list_t queue;
+	/** Number of frames in @c queue */
+	size_t queue_len;
 } ethip_atrans_t;
 
+/** Frame waiting for address resolution */
+typedef struct {
+	link_t lqueue;
+	/** NIC to send the frame through */
+	ethip_nic_t *nic;
+	/** Encoded Ethernet frame with destination address to be filled in */
+	void *data;
+	size_t size;
+} ethip_atrans_frame_t;
+
 extern errno_t ethip_iplink_init(ethip_nic_t *);
 extern errno_t ethip_received(iplink_srv_t *, void *, size_t);
+extern errno_t ethip_received_batched(iplink_srv_t *, void *, size_t,
+    iplink_recv_batch_t *);
 
 #endif
 
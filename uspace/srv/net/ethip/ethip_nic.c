@@ -35,6 +35,7 @@
  */
 
 #include <adt/list.h>
+#include <align.h>
 #include <async.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -138,6 +139,9 @@ static void ethip_nic_delete(ethip_nic_t *nic)
 	if (nic->svc_name != NULL)
 		free(nic->svc_name);
 
+	if (nic->rx_batch.buf != NULL)
+		iplink_recv_batch_fini(&nic->rx_batch);
+
 	free(nic);
 }
 
@@ -284,6 +288,65 @@ static void ethip_nic_received(ethip_nic_t *nic, cap_call_handle_t chandle,
 	async_answer_0(chandle, rc);
 }
 
+static void ethip_nic_received_batch(ethip_nic_t *nic,
+    cap_call_handle_t chandle, ipc_call_t *call)
+{
+	nic_ev_frame_hdr_t *hdr;
+	errno_t rc;
+	void *data;
+	size_t size;
+	size_t rsize;
+	size_t off;
+	size_t count;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "ethip_nic_received_batch() nic=%p",
+	    nic);
+
+	count = IPC_GET_ARG1(*call);
+
+	rc = async_data_write_accept(&data, false, 0, 0, 0, &size);
+	if (rc != EOK) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "data_write_accept() failed");
+		async_answer_0(chandle, rc);
+		return;
+	}
+
+	/* Without a batch buffer datagrams are passed on one by one */
+	if (nic->rx_batch.buf == NULL)
+		(void) iplink_recv_batch_init(&nic->rx_batch);
+
+	off = 0;
+	while (count > 0) {
+		if (size - off < sizeof(nic_ev_frame_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		hdr = (nic_ev_frame_hdr_t *) ((uint8_t *) data + off);
+		if (hdr->size > size - off - sizeof(nic_ev_frame_hdr_t)) {
+			rc = EINVAL;
+			break;
+		}
+
+		(void) ethip_received_batched(&nic->iplink, hdr + 1, hdr->size,
+		    nic->rx_batch.buf != NULL ? &nic->rx_batch : NULL);
+
+		rsize = sizeof(nic_ev_frame_hdr_t) +
+		    ALIGN_UP(hdr->size, sizeof(nic_ev_frame_hdr_t));
+		if (rsize > size - off)
+			rsize = size - off;
+
+		off += rsize;
+		--count;
+	}
+
+	if (nic->rx_batch.buf != NULL)
+		(void) iplink_ev_recv_batch_flush(&nic->iplink, &nic->rx_batch);
+
+	free(data);
+	async_answer_0(chandle, rc);
+}
+
 static void ethip_nic_device_state(ethip_nic_t *nic, cap_call_handle_t chandle,
     ipc_call_t *call)
 {
@@ -316,6 +379,9 @@ static void ethip_nic_cb_conn(cap_call_handle_t icall_handle, ipc_call_t *icall,
 		case NIC_EV_DEVICE_STATE:
 			ethip_nic_device_state(nic, chandle, &call);
 			break;
+		case NIC_EV_RECEIVED_BATCH:
+			ethip_nic_received_batch(nic, chandle, &call);
+			break;
 		default:
 			log_msg(LOG_DEFAULT, LVL_DEBUG, "unknown IPC method: %" PRIun, IPC_GET_IMETHOD(call));
 			async_answer_0(chandle, ENOTSUP);
@@ -87,18 +87,14 @@ errno_t eth_pdu_decode(void *data, size_t size, eth_frame_t *frame)
 
 	hdr = (eth_header_t *)data;
 
+	/* The payload is not copied, it stays valid as long as @a data */
 	frame->size = size - sizeof(eth_header_t);
-	frame->data = calloc(frame->size, 1);
-	if (frame->data == NULL)
-		return ENOMEM;
+	frame->data = (uint8_t *)data + sizeof(eth_header_t);
 
 	addr48(hdr->src, frame->src);
 	addr48(hdr->dest, frame->dest);
 	frame->etype_len = uint16_t_be2host(hdr->etype_len);
 
-	memcpy(frame->data, (uint8_t *)data + sizeof(eth_header_t),
-	    frame->size);
-
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "Decoded Ethernet frame payload (%zu bytes)", frame->size);
 
 	return EOK;
@@ -193,6 +193,7 @@ static errno_t inetcfg_sroute_create(char *name, inet_naddr_t *dest,
     inet_addr_t *router, sysarg_t *sroute_id)
 {
 	inet_sroute_t *sroute;
+	errno_t rc;
 
 	sroute = inet_sroute_new();
 	if (sroute == NULL) {
@@ -203,7 +204,13 @@ static errno_t inetcfg_sroute_create(char *name, inet_naddr_t *dest,
 	sroute->dest = *dest;
 	sroute->router = *router;
 	sroute->name = str_dup(name);
-	inet_sroute_add(sroute);
+
+	rc = inet_sroute_add(sroute);
+	if (rc != EOK) {
+		inet_sroute_delete(sroute);
+		*sroute_id = 0;
+		return rc;
+	}
 
 	*sroute_id = sroute->id;
 	return EOK;
@@ -212,12 +219,16 @@ static errno_t inetcfg_sroute_create(char *name, inet_naddr_t *dest,
 static errno_t inetcfg_sroute_delete(sysarg_t sroute_id)
 {
 	inet_sroute_t *sroute;
+	errno_t rc;
 
 	sroute = inet_sroute_get_by_id(sroute_id);
 	if (sroute == NULL)
 		return ENOENT;
 
-	inet_sroute_remove(sroute);
+	rc = inet_sroute_remove(sroute);
+	if (rc != EOK)
+		return rc;
+
 	inet_sroute_delete(sroute);
 
 	return EOK;
@@ -35,6 +35,7 @@
  */
 
 #include <adt/list.h>
+#include <assert.h>
 #include <async.h>
 #include <errno.h>
 #include <str_error.h>
@@ -43,6 +44,7 @@
 #include <ipc/inet.h>
 #include <ipc/services.h>
 #include <loc.h>
+#include <mem.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -57,6 +59,7 @@
 #include "inetcfg.h"
 #include "inetping.h"
 #include "inet_link.h"
+#include "ntrans.h"
 #include "reass.h"
 #include "sroute.h"
 
@@ -103,6 +106,18 @@ static errno_t inet_init(void)
 	if (rc != EOK)
 		return rc;
 
+	rc = ntrans_init();
+	if (rc != EOK)
+		return rc;
+
+	rc = inet_sroute_init();
+	if (rc != EOK)
+		return rc;
+
+	rc = inet_reass_init();
+	if (rc != EOK)
+		return rc;
+
 	rc = loc_server_register(NAME);
 	if (rc != EOK) {
 		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed registering server: %s.", str_error(rc));
@@ -137,7 +152,7 @@ static void inet_callback_create_srv(inet_client_t *client, cap_call_handle_t ch
 static errno_t inet_find_dir(inet_addr_t *src, inet_addr_t *dest, uint8_t tos,
     inet_dir_t *dir)
 {
-	inet_sroute_t *sr;
+	inet_addr_t router;
 
 	/* XXX Handle case where source address is specified */
 	(void) src;
@@ -148,10 +163,9 @@ static errno_t inet_find_dir(inet_addr_t *src, inet_addr_t *dest, uint8_t tos,
 		dir->dtype = dt_direct;
 	} else {
 		/* No direct path, try using a static route */
-		sr = inet_sroute_find(dest);
-		if (sr != NULL) {
-			dir->aobj = inet_addrobj_find(&sr->router, iaf_net);
-			dir->ldest = sr->router;
+		if (inet_sroute_find(dest, &router) == EOK) {
+			dir->aobj = inet_addrobj_find(&router, iaf_net);
+			dir->ldest = router;
 			dir->dtype = dt_router;
 		}
 	}
@@ -444,36 +458,64 @@ static inet_client_t *inet_client_find(uint8_t proto)
 	return NULL;
 }
 
-errno_t inet_ev_recv(inet_client_t *client, inet_dgram_t *dgram)
+/** Send datagram with data in pieces to client.
+ *
+ * @param client Client
+ * @param dgram  Datagram, its data pointer is ignored
+ * @param segs   Pieces of data, @a dgram->size bytes in total
+ * @param nsegs  Number of pieces
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t inet_ev_recv_sg(inet_client_t *client, inet_dgram_t *dgram,
+    inet_dgram_seg_t *segs, size_t nsegs)
 {
-	async_exch_t *exch = async_exchange_begin(client->sess);
-
-	ipc_call_t answer;
+	inet_ev_recv_hdr_t hdr;
+	const void *data;
+	uint8_t *buf;
+	uint8_t *dp;
+	size_t i;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_ev_recv: iplink=%zu",
 	    dgram->iplink);
 
-	aid_t req = async_send_2(exch, INET_EV_RECV, dgram->tos,
-	    dgram->iplink, &answer);
+	/* Only a datagram in pieces needs to be copied together */
+	if (nsegs == 1) {
+		data = segs[0].data;
+	} else {
+		buf = malloc(dgram->size);
+		if (buf == NULL)
+			return ENOMEM;
+
+		dp = buf;
+		for (i = 0; i < nsegs; i++) {
+			assert(dp + segs[i].size <= buf + dgram->size);
+			memcpy(dp, segs[i].data, segs[i].size);
+			dp += segs[i].size;
+		}
 
-	errno_t rc = async_data_write_start(exch, &dgram->src, sizeof(inet_addr_t));
-	if (rc != EOK) {
-		async_exchange_end(exch);
-		async_forget(req);
-		return rc;
+		data = buf;
 	}
 
-	rc = async_data_write_start(exch, &dgram->dest, sizeof(inet_addr_t));
-	if (rc != EOK) {
-		async_exchange_end(exch);
-		async_forget(req);
-		return rc;
-	}
+	/* Send both addresses in one transfer to save a round trip */
+	hdr.src = dgram->src;
+	hdr.dest = dgram->dest;
+
+	async_exch_t *exch = async_exchange_begin(client->sess);
 
-	rc = async_data_write_start(exch, dgram->data, dgram->size);
+	ipc_call_t answer;
+	aid_t req = async_send_2(exch, INET_EV_RECV, dgram->tos,
+	    dgram->iplink, &answer);
+
+	errno_t rc = async_data_write_start(exch, &hdr, sizeof(hdr));
+	if (rc == EOK)
+		rc = async_data_write_start(exch, data, dgram->size);
 
 	async_exchange_end(exch);
 
+	if (nsegs != 1)
+		free(buf);
+
 	if (rc != EOK) {
 		async_forget(req);
 		return rc;
@@ -485,6 +527,63 @@ errno_t inet_ev_recv(inet_client_t *client, inet_dgram_t *dgram)
 	return retval;
 }
 
+errno_t inet_ev_recv(inet_client_t *client, inet_dgram_t *dgram)
+{
+	inet_dgram_seg_t seg;
+
+	seg.data = dgram->data;
+	seg.size = dgram->size;
+
+	return inet_ev_recv_sg(client, dgram, &seg, 1);
+}
+
+/** Deliver datagram with data in pieces locally.
+ *
+ * The pieces are copied together before they are handed over.
+ *
+ * @param dgram Datagram, its data pointer is ignored
+ * @param segs  Pieces of data, @a dgram->size bytes in total
+ * @param nsegs Number of pieces
+ * @param proto Protocol
+ *
+ * @return EOK on success or an error code
+ */
+errno_t inet_recv_dgram_local_sg(inet_dgram_t *dgram, inet_dgram_seg_t *segs,
+    size_t nsegs, uint8_t proto)
+{
+	inet_client_t *client;
+	inet_dgram_t ldgram;
+	uint8_t *dp;
+	size_t i;
+	errno_t rc;
+
+	if (proto != IP_PROTO_ICMP && proto != IP_PROTO_ICMPV6) {
+		client = inet_client_find(proto);
+		if (client == NULL) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "No client found for "
+			    "protocol 0x%" PRIx8, proto);
+			return ENOENT;
+		}
+
+		return inet_ev_recv_sg(client, dgram, segs, nsegs);
+	}
+
+	ldgram = *dgram;
+	ldgram.data = malloc(dgram->size);
+	if (ldgram.data == NULL)
+		return ENOMEM;
+
+	dp = ldgram.data;
+	for (i = 0; i < nsegs; i++) {
+		memcpy(dp, segs[i].data, segs[i].size);
+		dp += segs[i].size;
+	}
+
+	rc = inet_recv_dgram_local(&ldgram, proto);
+	free(ldgram.data);
+	return rc;
+}
+
 errno_t inet_recv_dgram_local(inet_dgram_t *dgram, uint8_t proto)
 {
 	inet_client_t *client;
@@ -44,9 +44,6 @@
 #include "inet_link.h"
 #include "ndp.h"
 
-/** Time to wait for NDP reply in microseconds */
-#define NDP_REQUEST_TIMEOUT  (3 * 1000 * 1000)
-
 static addr128_t solicited_node_ip =
     { 0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xff, 0, 0, 0 };
 
@@ -76,6 +73,22 @@ static errno_t ndp_send_packet(inet_link_t *link, ndp_packet_t *packet)
 	return EOK;
 }
 
+/** Send datagrams which were waiting for address resolution
+ *
+ * @param dgrams   Datagrams (of inet_ntrans_dgram_t), freed
+ * @param mac_addr Resolved MAC address
+ *
+ */
+static void ndp_send_queued(list_t *dgrams, addr48_t mac_addr)
+{
+	list_foreach(*dgrams, lqueue, inet_ntrans_dgram_t, qdgram) {
+		(void) inet_link_send_dgram6(qdgram->ilink, mac_addr,
+		    &qdgram->dgram, qdgram->proto, qdgram->ttl, qdgram->df);
+	}
+
+	ntrans_dgrams_free(dgrams);
+}
+
 static errno_t ndp_router_advertisement(inet_dgram_t *dgram, inet_addr_t *router)
 {
 	// FIXME TODO
@@ -98,6 +111,10 @@ errno_t ndp_received(inet_dgram_t *dgram)
 	inet_addr_set6(packet.target_proto_addr, &target);
 
 	inet_addrobj_t *laddr;
+	addr128_t laddr_v6;
+	list_t queued;
+
+	list_initialize(&queued);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "NDP PDU decoded; opcode: %d",
 	    packet.opcode);
@@ -106,11 +123,14 @@ errno_t ndp_received(inet_dgram_t *dgram)
 	case ICMPV6_NEIGHBOUR_SOLICITATION:
 		laddr = inet_addrobj_find(&target, iaf_addr);
 		if (laddr != NULL) {
-			rc = ntrans_add(packet.sender_proto_addr,
-			    packet.sender_hw_addr);
+			rc = ntrans_add(laddr->ilink, packet.target_proto_addr,
+			    packet.sender_proto_addr, packet.sender_hw_addr,
+			    &queued);
 			if (rc != EOK)
 				return rc;
 
+			ndp_send_queued(&queued, packet.sender_hw_addr);
+
 			ndp_packet_t reply;
 
 			reply.opcode = ICMPV6_NEIGHBOUR_ADVERTISEMENT;
@@ -125,9 +145,19 @@ errno_t ndp_received(inet_dgram_t *dgram)
 		break;
 	case ICMPV6_NEIGHBOUR_ADVERTISEMENT:
 		laddr = inet_addrobj_find(&dgram->dest, iaf_addr);
-		if (laddr != NULL)
-			return ntrans_add(packet.sender_proto_addr,
-			    packet.sender_hw_addr);
+		if (laddr != NULL) {
+			if (inet_addr_get(&dgram->dest, NULL, &laddr_v6) !=
+			    ip_v6)
+				return EINVAL;
+
+			rc = ntrans_add(laddr->ilink, laddr_v6,
+			    packet.sender_proto_addr, packet.sender_hw_addr,
+			    &queued);
+			if (rc != EOK)
+				return rc;
+
+			ndp_send_queued(&queued, packet.sender_hw_addr);
+		}
 
 		break;
 	case ICMPV6_ROUTER_ADVERTISEMENT:
@@ -139,30 +169,17 @@ errno_t ndp_received(inet_dgram_t *dgram)
 	return EOK;
 }
 
-/** Translate IPv6 to MAC address
+/** Send neighbour solicitation
  *
- * @param src  Source IPv6 address
- * @param dest Destination IPv6 address
- * @param mac  Target MAC address to be assigned
- * @param link Network interface
+ * @param ilink    Network interface
+ * @param src_addr Source IPv6 address
+ * @param ip_addr  IPv6 address to resolve
  *
- * @return EOK on success
- * @return ENOENT when NDP translation failed
+ * @return EOK on success or an error code
  *
  */
-errno_t ndp_translate(addr128_t src_addr, addr128_t ip_addr, addr48_t mac_addr,
-    inet_link_t *ilink)
+errno_t ndp_solicit(inet_link_t *ilink, addr128_t src_addr, addr128_t ip_addr)
 {
-	if (!ilink->mac_valid) {
-		/* The link does not support NDP */
-		memset(mac_addr, 0, 6);
-		return EOK;
-	}
-
-	errno_t rc = ntrans_lookup(ip_addr, mac_addr);
-	if (rc == EOK)
-		return EOK;
-
 	ndp_packet_t packet;
 
 	packet.opcode = ICMPV6_NEIGHBOUR_SOLICITATION;
@@ -172,11 +189,48 @@ errno_t ndp_translate(addr128_t src_addr, addr128_t ip_addr, addr48_t mac_addr,
 	addr48_solicited_node(ip_addr, packet.target_hw_addr);
 	ndp_solicited_node_ip(ip_addr, packet.target_proto_addr);
 
-	rc = ndp_send_packet(ilink, &packet);
-	if (rc != EOK)
-		return rc;
+	return ndp_send_packet(ilink, &packet);
+}
+
+/** Send datagram to IPv6 neighbour
+ *
+ * If the MAC address of the neighbour is not known yet, the datagram is
+ * queued and sent once the neighbour advertises its address. The calling
+ * fibril does not wait for the resolution.
+ *
+ * @param src_addr Source IPv6 address
+ * @param ip_addr  Destination IPv6 address of the neighbour
+ * @param ilink    Network interface
+ * @param dgram    Datagram
+ * @param proto    Protocol
+ * @param ttl      Time to live
+ * @param df       Do not fragment
+ *
+ * @return EOK on success or when the datagram was queued
+ * @return ENOMEM if out of memory
+ *
+ */
+errno_t ndp_send_dgram(addr128_t src_addr, addr128_t ip_addr,
+    inet_link_t *ilink, inet_dgram_t *dgram, uint8_t proto, uint8_t ttl,
+    int df)
+{
+	addr48_t mac_addr;
+	errno_t rc;
 
-	(void) ntrans_wait_timeout(NDP_REQUEST_TIMEOUT);
+	if (!ilink->mac_valid) {
+		/* The link does not support NDP */
+		memset(mac_addr, 0, sizeof(addr48_t));
+		return inet_link_send_dgram6(ilink, mac_addr, dgram, proto,
+		    ttl, df);
+	}
+
+	rc = ntrans_lookup(ip_addr, mac_addr);
+	if (rc != EOK) {
+		rc = ntrans_queue(ilink, src_addr, ip_addr, dgram, proto, ttl,
+		    df, mac_addr);
+		if (rc != EEXIST)
+			return rc;
+	}
 
-	return ntrans_lookup(ip_addr, mac_addr);
+	return inet_link_send_dgram6(ilink, mac_addr, dgram, proto, ttl, df);
 }
@@ -63,6 +63,8 @@ typedef struct {
 } ndp_packet_t;
 
 extern errno_t ndp_received(inet_dgram_t *);
-extern errno_t ndp_translate(addr128_t, addr128_t, addr48_t, inet_link_t *);
+extern errno_t ndp_solicit(inet_link_t *, addr128_t, addr128_t);
+extern errno_t ndp_send_dgram(addr128_t, addr128_t, inet_link_t *,
+    inet_dgram_t *, uint8_t, uint8_t, int);
 
 #endif
@@ -35,70 +35,229 @@
  */
 
 #include <adt/list.h>
+#include <async.h>
+#include <compiler/barrier.h>
 #include <errno.h>
+#include <fibril.h>
 #include <fibril_synch.h>
 #include <inet/iplink_srv.h>
+#include <io/log.h>
+#include <libarch/barrier.h>
+#include <mem.h>
 #include <stdlib.h>
+#include "ndp.h"
 #include "ntrans.h"
 
-/** Address translation list (of inet_ntrans_t) */
-static FIBRIL_MUTEX_INITIALIZE(ntrans_list_lock);
-static LIST_INITIALIZE(ntrans_list);
-static FIBRIL_CONDVAR_INITIALIZE(ntrans_cv);
+/** Number of bits of the hash table index */
+#define NTRANS_HASH_BITS 6
+/** Number of hash table buckets */
+#define NTRANS_HASH_SIZE (1 << NTRANS_HASH_BITS)
 
-/** Look for address in translation table
- *
- * @param ip_addr IPv6 address
+/** Maximum number of table entries */
+#define NTRANS_MAX_ENTRIES 1024
+/** Maximum number of datagrams waiting for resolution of one address */
+#define NTRANS_QUEUE_MAX 8
+
+/** Aging period in microseconds */
+#define NTRANS_TICK (1000 * 1000)
+/** Number of aging periods a confirmed address is valid for */
+#define NTRANS_REACHABLE_TICKS 30
+/** Number of solicitations sent before giving up, one per aging period */
+#define NTRANS_REQUEST_RETRIES 3
+
+/** Serializes changes to the address translation table */
+static FIBRIL_MUTEX_INITIALIZE(ntrans_lock);
+/** Hash table of address translation entries (of inet_ntrans_t) */
+static inet_ntrans_t *ntrans_hash[NTRANS_HASH_SIZE];
+/** Free entries (of inet_ntrans_t) */
+static inet_ntrans_t *ntrans_free;
+/** Number of allocated entries */
+static size_t ntrans_count;
+/** Current aging pass */
+static unsigned ntrans_gen;
+
+/** Hash IPv6 address.
  *
- * @return inet_ntrans_t with the address on success
- * @return NULL if nothing found
+ * The interface identifier varies the most between neighbours, hash
+ * its low 32 bits.
  */
+static size_t ntrans_hash_key(addr128_t ip_addr)
+{
+	uint32_t low = ((uint32_t) ip_addr[12] << 24) |
+	    ((uint32_t) ip_addr[13] << 16) | ((uint32_t) ip_addr[14] << 8) |
+	    ip_addr[15];
+
+	return (low * 2654435761U) >> (32 - NTRANS_HASH_BITS);
+}
+
+/** Start changing entry fields visible to lockless readers. */
+static void ntrans_write_begin(inet_ntrans_t *ntrans)
+{
+	ACCESS_ONCE(ntrans->seq) = ntrans->seq + 1;
+	write_barrier();
+}
+
+/** Finish changing entry fields visible to lockless readers. */
+static void ntrans_write_end(inet_ntrans_t *ntrans)
+{
+	write_barrier();
+	ACCESS_ONCE(ntrans->seq) = ntrans->seq + 1;
+}
+
+/** Find link pointing to entry, table lock must be held. */
+static inet_ntrans_t **ntrans_find_link(addr128_t ip_addr)
+{
+	inet_ntrans_t **link = &ntrans_hash[ntrans_hash_key(ip_addr)];
+
+	while (*link != NULL && !addr128_compare((*link)->ip_addr, ip_addr))
+		link = &(*link)->next;
+
+	return link;
+}
+
+/** Find entry, table lock must be held. */
 static inet_ntrans_t *ntrans_find(addr128_t ip_addr)
 {
-	list_foreach(ntrans_list, ntrans_list, inet_ntrans_t, ntrans) {
-		if (addr128_compare(ntrans->ip_addr, ip_addr))
-			return ntrans;
+	return *ntrans_find_link(ip_addr);
+}
+
+/** Create incomplete entry, table lock must be held.
+ *
+ * @return New entry or NULL if out of memory or the table is full
+ */
+static inet_ntrans_t *ntrans_create(addr128_t ip_addr)
+{
+	inet_ntrans_t *ntrans;
+	size_t key = ntrans_hash_key(ip_addr);
+
+	if (ntrans_free != NULL) {
+		ntrans = ntrans_free;
+		ntrans_free = ntrans->next;
+	} else {
+		if (ntrans_count >= NTRANS_MAX_ENTRIES)
+			return NULL;
+
+		ntrans = calloc(1, sizeof(inet_ntrans_t));
+		if (ntrans == NULL)
+			return NULL;
+
+		list_initialize(&ntrans->queue);
+		++ntrans_count;
 	}
 
-	return NULL;
+	ntrans_write_begin(ntrans);
+	addr128(ip_addr, ntrans->ip_addr);
+	ntrans->state = nts_incomplete;
+	ntrans->next = ntrans_hash[key];
+	ntrans_write_end(ntrans);
+
+	ntrans->used = false;
+	ntrans->ilink = NULL;
+	memset(ntrans->src_addr, 0, sizeof(addr128_t));
+	ntrans->ticks = 1;
+	ntrans->retries = 0;
+	ntrans->gen = ntrans_gen;
+	ntrans->queue_len = 0;
+
+	/* Publish the fully initialized entry */
+	write_barrier();
+	ACCESS_ONCE(ntrans_hash[key]) = ntrans;
+	return ntrans;
 }
 
-/** Add entry to translation table
+/** Remove entry from the table, table lock must be held.
  *
- * @param ip_addr  IPv6 address of the new entry
- * @param mac_addr MAC address of the new entry
+ * The entry goes to the free list. Lockless readers may still be looking
+ * at it, but they will notice the change of its sequence number.
+ *
+ * @param ntrans  Entry
+ * @param link    Link pointing to the entry
+ * @param dropped List to move datagrams waiting for resolution to
+ */
+static void ntrans_destroy(inet_ntrans_t *ntrans, inet_ntrans_t **link,
+    list_t *dropped)
+{
+	ACCESS_ONCE(*link) = ntrans->next;
+
+	ntrans_write_begin(ntrans);
+	ntrans->state = nts_free;
+	ntrans_write_end(ntrans);
+
+	list_concat(dropped, &ntrans->queue);
+	ntrans->queue_len = 0;
+
+	ntrans->next = ntrans_free;
+	ntrans_free = ntrans;
+}
+
+/** Free list of datagrams (of inet_ntrans_dgram_t). */
+void ntrans_dgrams_free(list_t *dgrams)
+{
+	inet_ntrans_dgram_t *qdgram;
+
+	while (!list_empty(dgrams)) {
+		qdgram = list_get_instance(list_first(dgrams),
+		    inet_ntrans_dgram_t, lqueue);
+		list_remove(&qdgram->lqueue);
+		free(qdgram->dgram.data);
+		free(qdgram);
+	}
+}
+
+/** Add or confirm entry in translation table
+ *
+ * @param ilink    Link the translation was learned on
+ * @param src_addr Local address to use for neighbour solicitations
+ * @param ip_addr  IPv6 address of the entry
+ * @param mac_addr MAC address of the entry
+ * @param dgrams   List to move datagrams waiting for the address to.
+ *                 The caller is responsible for sending them.
  *
  * @return EOK on success
  * @return ENOMEM if not enough memory
  *
  */
-errno_t ntrans_add(addr128_t ip_addr, addr48_t mac_addr)
+errno_t ntrans_add(inet_link_t *ilink, addr128_t src_addr, addr128_t ip_addr,
+    addr48_t mac_addr, list_t *dgrams)
 {
 	inet_ntrans_t *ntrans;
-	inet_ntrans_t *prev;
 
-	ntrans = calloc(1, sizeof(inet_ntrans_t));
-	if (ntrans == NULL)
-		return ENOMEM;
+	fibril_mutex_lock(&ntrans_lock);
 
-	addr128(ip_addr, ntrans->ip_addr);
-	addr48(mac_addr, ntrans->mac_addr);
+	ntrans = ntrans_find(ip_addr);
+	if (ntrans == NULL) {
+		ntrans = ntrans_create(ip_addr);
+		if (ntrans == NULL) {
+			fibril_mutex_unlock(&ntrans_lock);
+			return ENOMEM;
+		}
+	}
 
-	fibril_mutex_lock(&ntrans_list_lock);
-	prev = ntrans_find(ip_addr);
-	if (prev != NULL) {
-		list_remove(&prev->ntrans_list);
-		free(prev);
+	/* Do not disturb readers if nothing changes for them */
+	if (ntrans->state != nts_reachable ||
+	    !addr48_compare(ntrans->mac_addr, mac_addr)) {
+		ntrans_write_begin(ntrans);
+		addr48(mac_addr, ntrans->mac_addr);
+		ntrans->state = nts_reachable;
+		ntrans_write_end(ntrans);
 	}
 
-	list_append(&ntrans->ntrans_list, &ntrans_list);
-	fibril_mutex_unlock(&ntrans_list_lock);
-	fibril_condvar_broadcast(&ntrans_cv);
+	ntrans->ilink = ilink;
+	addr128(src_addr, ntrans->src_addr);
+	ntrans->ticks = NTRANS_REACHABLE_TICKS;
+	ntrans->retries = 0;
+	ntrans->used = false;
+
+	list_concat(dgrams, &ntrans->queue);
+	ntrans->queue_len = 0;
 
+	fibril_mutex_unlock(&ntrans_lock);
 	return EOK;
 }
 
 /** Remove entry from translation table
+ *
+ * Datagrams waiting for the address are dropped.
  *
  * @param ip_addr IPv6 address of the entry to be removed
  *
@@ -108,23 +267,31 @@ errno_t ntrans_add(addr128_t ip_addr, addr48_t mac_addr)
  */
 errno_t ntrans_remove(addr128_t ip_addr)
 {
-	inet_ntrans_t *ntrans;
+	inet_ntrans_t **link;
+	list_t dropped;
 
-	fibril_mutex_lock(&ntrans_list_lock);
-	ntrans = ntrans_find(ip_addr);
-	if (ntrans == NULL) {
-		fibril_mutex_unlock(&ntrans_list_lock);
+	list_initialize(&dropped);
+
+	fibril_mutex_lock(&ntrans_lock);
+	link = ntrans_find_link(ip_addr);
+	if (*link == NULL) {
+		fibril_mutex_unlock(&ntrans_lock);
 		return ENOENT;
 	}
 
-	list_remove(&ntrans->ntrans_list);
-	fibril_mutex_unlock(&ntrans_list_lock);
-	free(ntrans);
+	ntrans_destroy(*link, link, &dropped);
+	fibril_mutex_unlock(&ntrans_lock);
 
+	ntrans_dgrams_free(&dropped);
 	return EOK;
 }
 
 /** Translate IPv6 address to MAC address using the translation table
+ *
+ * This is the fast path for every transmitted datagram and does not
+ * lock the table. It can fail spuriously if the table is being changed
+ * at the same time, callers then fall back to ntrans_queue(), which
+ * looks again under the lock.
  *
  * @param ip_addr  IPv6 address to be translated
  * @param mac_addr MAC address to be assigned
@@ -135,34 +302,243 @@ errno_t ntrans_remove(addr128_t ip_addr)
  */
 errno_t ntrans_lookup(addr128_t ip_addr, addr48_t mac_addr)
 {
-	fibril_mutex_lock(&ntrans_list_lock);
-	inet_ntrans_t *ntrans = ntrans_find(ip_addr);
+	inet_ntrans_t *ntrans;
+	inet_ntrans_state_t state;
+	size_t steps = 0;
+	size_t seq;
+	bool match;
+
+	ntrans = ACCESS_ONCE(ntrans_hash[ntrans_hash_key(ip_addr)]);
+
+	/* Recycled entries may lead us astray, bound the walk */
+	while (ntrans != NULL && steps++ < NTRANS_MAX_ENTRIES) {
+		seq = ACCESS_ONCE(ntrans->seq);
+		read_barrier();
+
+		match = addr128_compare(ntrans->ip_addr, ip_addr);
+		state = ntrans->state;
+		addr48(ntrans->mac_addr, mac_addr);
+
+		read_barrier();
+		if ((seq & 1) != 0 || ACCESS_ONCE(ntrans->seq) != seq)
+			return ENOENT;
+
+		if (match) {
+			if (state != nts_reachable && state != nts_probe)
+				return ENOENT;
+
+			if (!ntrans->used)
+				ACCESS_ONCE(ntrans->used) = true;
+			return EOK;
+		}
+
+		ntrans = ACCESS_ONCE(ntrans->next);
+	}
+
+	return ENOENT;
+}
+
+/** Queue datagram until address is resolved
+ *
+ * If there is no entry for the address, one is created and a neighbour
+ * solicitation is sent. The datagram is sent by whoever receives the
+ * neighbour advertisement, the sending fibril does not wait. If too many
+ * datagrams are waiting for the address, the oldest one is dropped.
+ *
+ * @param ilink    Link to send the datagram through
+ * @param src_addr Source IPv6 address for neighbour solicitations
+ * @param ip_addr  Destination IPv6 address
+ * @param dgram    Datagram, its data are copied
+ * @param proto    Protocol
+ * @param ttl      Time to live
+ * @param df       Do not fragment
+ * @param mac_addr Place to store the MAC address if it is already known
+ *
+ * @return EOK if the datagram was queued
+ * @return EEXIST if the address is known and the caller should send
+ *         the datagram itself
+ * @return ENOMEM if out of memory
+ *
+ */
+errno_t ntrans_queue(inet_link_t *ilink, addr128_t src_addr,
+    addr128_t ip_addr, inet_dgram_t *dgram, uint8_t proto, uint8_t ttl,
+    int df, addr48_t mac_addr)
+{
+	inet_ntrans_t *ntrans;
+	inet_ntrans_dgram_t *qdgram;
+	inet_ntrans_dgram_t *old = NULL;
+	bool solicit = false;
+
+	qdgram = calloc(1, sizeof(inet_ntrans_dgram_t));
+	if (qdgram == NULL)
+		return ENOMEM;
+
+	link_initialize(&qdgram->lqueue);
+	qdgram->ilink = ilink;
+	qdgram->dgram = *dgram;
+	qdgram->proto = proto;
+	qdgram->ttl = ttl;
+	qdgram->df = df;
+
+	qdgram->dgram.data = malloc(dgram->size);
+	if (qdgram->dgram.data == NULL) {
+		free(qdgram);
+		return ENOMEM;
+	}
+
+	memcpy(qdgram->dgram.data, dgram->data, dgram->size);
+
+	fibril_mutex_lock(&ntrans_lock);
+
+	ntrans = ntrans_find(ip_addr);
+	if (ntrans != NULL && (ntrans->state == nts_reachable ||
+	    ntrans->state == nts_probe)) {
+		addr48(ntrans->mac_addr, mac_addr);
+		ntrans->used = true;
+		fibril_mutex_unlock(&ntrans_lock);
+		free(qdgram->dgram.data);
+		free(qdgram);
+		return EEXIST;
+	}
+
 	if (ntrans == NULL) {
-		fibril_mutex_unlock(&ntrans_list_lock);
-		return ENOENT;
+		ntrans = ntrans_create(ip_addr);
+		if (ntrans == NULL) {
+			fibril_mutex_unlock(&ntrans_lock);
+			free(qdgram->dgram.data);
+			free(qdgram);
+			return ENOMEM;
+		}
+
+		ntrans->ilink = ilink;
+		addr128(src_addr, ntrans->src_addr);
+		ntrans->retries = 1;
+		solicit = true;
+	}
+
+	if (ntrans->queue_len >= NTRANS_QUEUE_MAX) {
+		old = list_get_instance(list_first(&ntrans->queue),
+		    inet_ntrans_dgram_t, lqueue);
+		list_remove(&old->lqueue);
+		--ntrans->queue_len;
+	}
+
+	list_append(&qdgram->lqueue, &ntrans->queue);
+	++ntrans->queue_len;
+
+	fibril_mutex_unlock(&ntrans_lock);
+
+	if (old != NULL) {
+		free(old->dgram.data);
+		free(old);
 	}
 
-	fibril_mutex_unlock(&ntrans_list_lock);
-	addr48(ntrans->mac_addr, mac_addr);
+	/* Not under the lock, sending can loop back to ndp_received() */
+	if (solicit)
+		(void) ndp_solicit(ilink, src_addr, ip_addr);
+
 	return EOK;
 }
 
-/** Wait on translation table CV for some time
+/** Age address translation entries
  *
- * @param timeout Timeout in microseconds
+ * Retransmits neighbour solicitations for unresolved addresses and gives
+ * up on them after NTRANS_REQUEST_RETRIES attempts. Expired entries which
+ * have been used since they were confirmed are probed, the others are
+ * removed.
+ */
+static void ntrans_age(void)
+{
+	inet_ntrans_t **link;
+	inet_ntrans_t *ntrans;
+	inet_link_t *ilink;
+	addr128_t src_addr;
+	addr128_t ip_addr;
+	list_t dropped;
+	size_t i;
+
+	list_initialize(&dropped);
+
+	fibril_mutex_lock(&ntrans_lock);
+	++ntrans_gen;
+
+restart:
+	for (i = 0; i < NTRANS_HASH_SIZE; i++) {
+		link = &ntrans_hash[i];
+		while ((ntrans = *link) != NULL) {
+			if (ntrans->gen == ntrans_gen || ntrans->ticks > 1) {
+				if (ntrans->gen != ntrans_gen)
+					--ntrans->ticks;
+				ntrans->gen = ntrans_gen;
+				link = &ntrans->next;
+				continue;
+			}
+
+			ntrans->gen = ntrans_gen;
+
+			if (ntrans->state == nts_reachable && ntrans->used) {
+				ntrans_write_begin(ntrans);
+				ntrans->state = nts_probe;
+				ntrans_write_end(ntrans);
+				ntrans->retries = 0;
+			} else if (ntrans->state == nts_reachable ||
+			    ntrans->retries >= NTRANS_REQUEST_RETRIES ||
+			    ntrans->ilink == NULL) {
+				ntrans_destroy(ntrans, link, &dropped);
+				continue;
+			}
+
+			++ntrans->retries;
+			ntrans->ticks = 1;
+			ilink = ntrans->ilink;
+			addr128(ntrans->src_addr, src_addr);
+			addr128(ntrans->ip_addr, ip_addr);
+
+			/* Not under the lock, sending can loop back to us */
+			fibril_mutex_unlock(&ntrans_lock);
+			(void) ndp_solicit(ilink, src_addr, ip_addr);
+			fibril_mutex_lock(&ntrans_lock);
+
+			/* The table may have changed */
+			goto restart;
+		}
+	}
+
+	fibril_mutex_unlock(&ntrans_lock);
+
+	if (!list_empty(&dropped)) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Dropping datagrams for "
+		    "unresolved addresses.");
+		ntrans_dgrams_free(&dropped);
+	}
+}
+
+static errno_t ntrans_aging_fibril(void *arg)
+{
+	while (true) {
+		async_usleep(NTRANS_TICK);
+		ntrans_age();
+	}
+
+	return EOK;
+}
+
+/** Initialize address translation
  *
- * @return EOK if woken up by another fibril
- * @return ETIMEOUT if timed out
+ * @return EOK on success
+ * @return ENOMEM if out of memory
  *
  */
-errno_t ntrans_wait_timeout(suseconds_t timeout)
+errno_t ntrans_init(void)
 {
-	fibril_mutex_lock(&ntrans_list_lock);
-	errno_t rc = fibril_condvar_wait_timeout(&ntrans_cv, &ntrans_list_lock,
-	    timeout);
-	fibril_mutex_unlock(&ntrans_list_lock);
+	fid_t fid;
 
-	return rc;
+	fid = fibril_create(ntrans_aging_fibril, NULL);
+	if (fid == 0)
+		return ENOMEM;
+
+	fibril_add_ready(fid);
+	return EOK;
 }
 
 /** @}
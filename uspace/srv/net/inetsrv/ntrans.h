@@ -37,20 +37,82 @@
 #ifndef NTRANS_H_
 #define NTRANS_H_
 
+#include <adt/list.h>
 #include <inet/iplink_srv.h>
 #include <inet/addr.h>
+#include <stdbool.h>
+#include "inetsrv.h"
 
-/** Address translation table element */
-typedef struct {
-	link_t ntrans_list;
+/** Neighbour cache entry state */
+typedef enum {
+	/** Entry is on the free list */
+	nts_free,
+	/** Address is being resolved */
+	nts_incomplete,
+	/** Address has been confirmed recently */
+	nts_reachable,
+	/** Address has expired and is being confirmed again */
+	nts_probe
+} inet_ntrans_state_t;
+
+/** Address translation table element
+ *
+ * Elements are never freed, only recycled through the free list, so that
+ * lookups can traverse the table without locking. Readers validate what
+ * they have read against @c seq.
+ */
+typedef struct inet_ntrans {
+	/** Next element in hash chain or free list */
+	struct inet_ntrans *next;
+	/** Sequence number, odd while the element is being changed */
+	size_t seq;
+	/** Entry state */
+	inet_ntrans_state_t state;
 	addr128_t ip_addr;
 	addr48_t mac_addr;
+	/** Entry has been used for sending since it was last confirmed */
+	bool used;
+
+	/*
+	 * The fields below are protected by the table lock.
+	 */
+
+	/** Link to send neighbour solicitations through */
+	inet_link_t *ilink;
+	/** Source address for neighbour solicitations */
+	addr128_t src_addr;
+	/** Ticks until expiration or next neighbour solicitation */
+	unsigned ticks;
+	/** Number of solicitations sent without advertisement */
+	unsigned retries;
+	/** Aging pass which processed the entry last */
+	unsigned gen;
+	/** Datagrams waiting for address resolution (of inet_ntrans_dgram_t) */
+	list_t queue;
+	/** Number of datagrams in @c queue */
+	size_t queue_len;
 } inet_ntrans_t;
 
-extern errno_t ntrans_add(addr128_t, addr48_t);
+/** Datagram waiting for address resolution */
+typedef struct {
+	link_t lqueue;
+	/** Link to send the datagram through */
+	inet_link_t *ilink;
+	/** Datagram, the data are owned by the queue */
+	inet_dgram_t dgram;
+	uint8_t proto;
+	uint8_t ttl;
+	int df;
+} inet_ntrans_dgram_t;
+
+extern errno_t ntrans_init(void);
+extern errno_t ntrans_add(inet_link_t *, addr128_t, addr128_t, addr48_t,
+    list_t *);
 extern errno_t ntrans_remove(addr128_t);
 extern errno_t ntrans_lookup(addr128_t, addr48_t);
-extern errno_t ntrans_wait_timeout(suseconds_t);
+extern errno_t ntrans_queue(inet_link_t *, addr128_t, addr128_t,
+    inet_dgram_t *, uint8_t, uint8_t, int, addr48_t);
+extern void ntrans_dgrams_free(list_t *);
 
 #endif
 
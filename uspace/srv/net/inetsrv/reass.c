@@ -34,245 +34,491 @@
  * @brief Datagram reassembly.
  */
 
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <io/log.h>
-#include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
 #include "inetsrv.h"
 #include "inet_std.h"
 #include "reass.h"
 
+/** Time limit for reassembly of one datagram in microseconds */
+#define REASS_TIMEOUT (15 * 1000 * 1000)
+/** Maximum number of datagrams being reassembled */
+#define REASS_DGRAMS_MAX 64
+/** Maximum number of bytes held by datagrams being reassembled */
+#define REASS_MEM_MAX (1024 * 1024)
+/** Maximum number of fragments of one datagram */
+#define REASS_FRAGS_MAX 128
+
 /** Datagram being reassembled.
  *
  * Uniquely identified by (source address, destination address, protocol,
  * identification) per RFC 791 sec. 2.3 / Fragmentation.
  */
 typedef struct {
-	link_t map_link;
-	/** List of fragments, @c reass_frag_t */
+	/** Link in @c reass_dgram_map */
+	ht_link_t map_link;
+	/** Link in @c reass_dgram_age */
+	link_t age_link;
+	inet_addr_t src;
+	inet_addr_t dest;
+	uint8_t proto;
+	uint32_t ident;
+	/** Link the first fragment came from */
+	service_id_t link_id;
+	/** Type of service of the first fragment */
+	uint8_t tos;
+	/** Fragments sorted by offset, not overlapping, @c reass_frag_t */
 	list_t frags;
+	/** Number of fragments */
+	size_t nfrags;
+	/** Number of data bytes received */
+	size_t received;
+	/** Size of the datagram, known once the last fragment arrives */
+	size_t total;
+	bool total_known;
+	/** Bytes of memory held */
+	size_t mem;
+	/** Time when reassembly is abandoned */
+	struct timeval deadline;
 } reass_dgram_t;
 
-/** One datagram fragment */
+/** One datagram fragment, followed by its data */
 typedef struct {
 	link_t dgram_link;
-	inet_packet_t packet;
+	/** Offset of data in datagram */
+	size_t offs;
+	/** Size of data */
+	size_t size;
 } reass_frag_t;
 
-/** Datagram map, list of reass_dgram_t */
-static LIST_INITIALIZE(reass_dgram_map);
+/** Key identifying datagram */
+typedef struct {
+	inet_addr_t *src;
+	inet_addr_t *dest;
+	uint8_t proto;
+	uint32_t ident;
+} reass_key_t;
+
+/** Datagram map, hash table of reass_dgram_t */
+static hash_table_t reass_dgram_map;
+/** Datagrams ordered by deadline, list of reass_dgram_t */
+static LIST_INITIALIZE(reass_dgram_age);
+/** Bytes of memory held by all datagrams */
+static size_t reass_mem;
+/** Expires datagrams */
+static fibril_timer_t *reass_timer;
 /** Protects access to @c reass_dgram_map */
 static FIBRIL_MUTEX_INITIALIZE(reass_dgram_map_lock);
 
-static reass_dgram_t *reass_dgram_new(void);
-static reass_dgram_t *reass_dgram_get(inet_packet_t *);
-static errno_t reass_dgram_insert_frag(reass_dgram_t *, inet_packet_t *);
-static bool reass_dgram_complete(reass_dgram_t *);
 static void reass_dgram_remove(reass_dgram_t *);
 static errno_t reass_dgram_deliver(reass_dgram_t *);
 static void reass_dgram_destroy(reass_dgram_t *);
 
-/** Queue packet for datagram reassembly.
+static size_t reass_addr_hash(inet_addr_t *addr)
+{
+	size_t hash = addr->version;
+	uint32_t word;
+	size_t i;
+
+	switch (addr->version) {
+	case ip_v4:
+		hash = hash_combine(hash, addr->addr);
+		break;
+	case ip_v6:
+		for (i = 0; i < sizeof(addr128_t); i += 4) {
+			memcpy(&word, &addr->addr6[i], sizeof(word));
+			hash = hash_combine(hash, word);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return hash;
+}
+
+static size_t reass_key_hash(void *arg)
+{
+	reass_key_t *key = (reass_key_t *) arg;
+	size_t hash;
+
+	hash = hash_combine(key->ident, key->proto);
+	hash = hash_combine(hash, reass_addr_hash(key->src));
+	return hash_combine(hash, reass_addr_hash(key->dest));
+}
+
+static size_t reass_dgram_hash(const ht_link_t *item)
+{
+	reass_dgram_t *rdg = hash_table_get_inst(item, reass_dgram_t,
+	    map_link);
+	reass_key_t key = {
+		.src = &rdg->src,
+		.dest = &rdg->dest,
+		.proto = rdg->proto,
+		.ident = rdg->ident
+	};
+
+	return reass_key_hash(&key);
+}
+
+static bool reass_key_equal(void *arg, const ht_link_t *item)
+{
+	reass_key_t *key = (reass_key_t *) arg;
+	reass_dgram_t *rdg = hash_table_get_inst(item, reass_dgram_t,
+	    map_link);
+
+	return rdg->ident == key->ident && rdg->proto == key->proto &&
+	    inet_addr_compare(&rdg->src, key->src) &&
+	    inet_addr_compare(&rdg->dest, key->dest);
+}
+
+static hash_table_ops_t reass_dgram_map_ops = {
+	.hash = reass_dgram_hash,
+	.key_hash = reass_key_hash,
+	.key_equal = reass_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+static void reass_timer_func(void *);
+
+/** Arm the timer for the oldest datagram.
  *
- * @param packet	Packet
- * @return		EOK on success or ENOMEM.
+ * The timer is left alone while it is active. It then expires no later
+ * than the oldest datagram, as datagrams are only added with later
+ * deadlines. If it expires early, the handler arms it again. The timer is
+ * not cleared when the last datagram goes away, the handler then just
+ * finds nothing to do.
+ *
+ * @param now		Current time
  */
-errno_t inet_reass_queue_packet(inet_packet_t *packet)
+static void reass_timer_update(struct timeval *now)
 {
 	reass_dgram_t *rdg;
-	errno_t rc;
 
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_reass_queue_packet()");
+	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-	fibril_mutex_lock(&reass_dgram_map_lock);
+	if (list_empty(&reass_dgram_age) ||
+	    (reass_timer->state == fts_active))
+		return;
 
-	/* Get existing or new datagram */
-	rdg = reass_dgram_get(packet);
-	if (rdg == NULL) {
-		/* Only happens when we are out of memory */
-		fibril_mutex_unlock(&reass_dgram_map_lock);
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "Allocation failed, packet dropped.");
-		return ENOMEM;
-	}
+	rdg = list_get_instance(list_first(&reass_dgram_age),
+	    reass_dgram_t, age_link);
+	fibril_timer_set_locked(reass_timer, tv_gt(&rdg->deadline, now) ?
+	    tv_sub_diff(&rdg->deadline, now) : 0, reass_timer_func, NULL);
+}
 
-	/* Insert fragment into the datagram */
-	rc = reass_dgram_insert_frag(rdg, packet);
-	if (rc != EOK)
-		return ENOMEM;
+/** Abandon reassembly of datagrams which have run out of time. */
+static void reass_timer_func(void *arg)
+{
+	reass_dgram_t *rdg;
+	struct timeval now;
 
-	/* Check if datagram is complete */
-	if (reass_dgram_complete(rdg)) {
-		/* Remove it from the map */
-		reass_dgram_remove(rdg);
-		fibril_mutex_unlock(&reass_dgram_map_lock);
+	fibril_mutex_lock(&reass_dgram_map_lock);
 
-		/* Deliver complete datagram */
-		rc = reass_dgram_deliver(rdg);
+	getuptime(&now);
+	while (!list_empty(&reass_dgram_age)) {
+		rdg = list_get_instance(list_first(&reass_dgram_age),
+		    reass_dgram_t, age_link);
+		if (tv_gt(&rdg->deadline, &now))
+			break;
+
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Datagram reassembly timed "
+		    "out.");
+		reass_dgram_remove(rdg);
 		reass_dgram_destroy(rdg);
-		return rc;
 	}
 
+	reass_timer_update(&now);
 	fibril_mutex_unlock(&reass_dgram_map_lock);
-	return EOK;
 }
 
-/** Get datagram reassembly structure for packet.
+/** Initialize datagram reassembly.
  *
- * @param packet	Packet
- * @return		Datagram reassembly structure matching @a packet
+ * @return EOK on success or ENOMEM.
  */
-static reass_dgram_t *reass_dgram_get(inet_packet_t *packet)
+errno_t inet_reass_init(void)
 {
-	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
-
-	list_foreach(reass_dgram_map, map_link, reass_dgram_t, rdg) {
-		link_t *f1_link = list_first(&rdg->frags);
-		assert(f1_link != NULL);
-
-		reass_frag_t *f1 = list_get_instance(f1_link, reass_frag_t,
-		    dgram_link);
+	if (!hash_table_create(&reass_dgram_map, 0, 0, &reass_dgram_map_ops))
+		return ENOMEM;
 
-		if ((inet_addr_compare(&f1->packet.src, &packet->src)) &&
-		    (inet_addr_compare(&f1->packet.dest, &packet->dest)) &&
-		    (f1->packet.proto == packet->proto) &&
-		    (f1->packet.ident == packet->ident)) {
-			/* Match */
-			return rdg;
-		}
+	reass_timer = fibril_timer_create(&reass_dgram_map_lock);
+	if (reass_timer == NULL) {
+		hash_table_destroy(&reass_dgram_map);
+		return ENOMEM;
 	}
 
-	/* No existing reassembly structure. Create a new one. */
-	return reass_dgram_new();
+	return EOK;
 }
 
-/** Create new datagram reassembly structure.
+/** Get datagram reassembly structure for packet.
  *
- * @return New datagram reassembly structure.
+ * Creates a new structure if there is none. If there are too many
+ * datagrams being reassembled, the oldest one is abandoned.
+ *
+ * @param packet	Packet
+ * @return		Datagram reassembly structure matching @a packet or
+ *			@c NULL if out of memory
  */
-static reass_dgram_t *reass_dgram_new(void)
+static reass_dgram_t *reass_dgram_get(inet_packet_t *packet)
 {
 	reass_dgram_t *rdg;
+	ht_link_t *link;
+	reass_key_t key = {
+		.src = &packet->src,
+		.dest = &packet->dest,
+		.proto = packet->proto,
+		.ident = packet->ident
+	};
+	struct timeval now;
+
+	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
+
+	link = hash_table_find(&reass_dgram_map, &key);
+	if (link != NULL)
+		return hash_table_get_inst(link, reass_dgram_t, map_link);
+
+	/* No existing reassembly structure. Create a new one. */
+	if (hash_table_size(&reass_dgram_map) >= REASS_DGRAMS_MAX) {
+		rdg = list_get_instance(list_first(&reass_dgram_age),
+		    reass_dgram_t, age_link);
+		reass_dgram_remove(rdg);
+		reass_dgram_destroy(rdg);
+	}
 
 	rdg = calloc(1, sizeof(reass_dgram_t));
 	if (rdg == NULL)
 		return NULL;
 
-	list_append(&rdg->map_link, &reass_dgram_map);
+	rdg->src = packet->src;
+	rdg->dest = packet->dest;
+	rdg->proto = packet->proto;
+	rdg->ident = packet->ident;
+	rdg->link_id = packet->link_id;
+	rdg->tos = packet->tos;
 	list_initialize(&rdg->frags);
+	rdg->mem = sizeof(reass_dgram_t);
 
-	return rdg;
-}
+	getuptime(&now);
+	rdg->deadline = now;
+	tv_add_diff(&rdg->deadline, REASS_TIMEOUT);
 
-static reass_frag_t *reass_frag_new(void)
-{
-	reass_frag_t *frag;
+	/* All datagrams have the same timeout, so the list stays sorted */
+	hash_table_insert(&reass_dgram_map, &rdg->map_link);
+	list_append(&rdg->age_link, &reass_dgram_age);
+	reass_mem += rdg->mem;
 
-	frag = calloc(1, sizeof(reass_frag_t));
-	if (frag == NULL)
-		return NULL;
+	reass_timer_update(&now);
 
-	link_initialize(&frag->dgram_link);
+	return rdg;
+}
 
-	return frag;
+static void reass_frag_remove(reass_dgram_t *rdg, reass_frag_t *frag)
+{
+	size_t mem = sizeof(reass_frag_t) + frag->size;
+
+	list_remove(&frag->dgram_link);
+	--rdg->nfrags;
+	rdg->received -= frag->size;
+	rdg->mem -= mem;
+	reass_mem -= mem;
+	free(frag);
 }
 
-static errno_t reass_dgram_insert_frag(reass_dgram_t *rdg, inet_packet_t *packet)
+/** Insert fragment into datagram.
+ *
+ * Only data not received yet are kept. Data overlapping fragments which
+ * are completely covered by the new fragment replace them.
+ *
+ * @param rdg		Datagram reassembly structure
+ * @param packet	Fragment
+ * @return		EOK on success, ENOMEM if out of memory, EINVAL if
+ *			the fragment does not fit the datagram, ELIMIT if
+ *			the datagram is too large or too fragmented
+ */
+static errno_t reass_dgram_insert_frag(reass_dgram_t *rdg,
+    inet_packet_t *packet)
 {
 	reass_frag_t *frag;
-	void *data_copy;
+	reass_frag_t *prev;
+	reass_frag_t *next;
 	link_t *link;
+	size_t fragoff_limit;
+	size_t begin;
+	size_t end;
 
 	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
 
-	frag = reass_frag_new();
+	begin = packet->offs;
+	end = packet->offs + packet->size;
 
-	/* Clone the packet */
+	/* Upper bound for fragment offset field */
+	fragoff_limit = 1 << (FF_FRAGOFF_h - FF_FRAGOFF_l + 1);
 
-	data_copy = malloc(packet->size);
-	if (data_copy == NULL) {
-		free(frag);
-		return ENOMEM;
+	/* Verify that total size of datagram is within reasonable bounds */
+	if (end > FRAG_OFFS_UNIT * fragoff_limit)
+		return ELIMIT;
+
+	link = list_last(&rdg->frags);
+	prev = (link != NULL) ?
+	    list_get_instance(link, reass_frag_t, dgram_link) : NULL;
+
+	if (!packet->mf) {
+		/* Last fragment determines the size of the datagram */
+		if (rdg->total_known && rdg->total != end)
+			return EINVAL;
+		if (prev != NULL && prev->offs + prev->size > end)
+			return EINVAL;
+
+		rdg->total = end;
+		rdg->total_known = true;
+	} else if (rdg->total_known && end > rdg->total) {
+		return EINVAL;
 	}
 
-	memcpy(data_copy, packet->data, packet->size);
+	/* Find the last fragment starting at or before the new one */
+	while (prev != NULL && prev->offs > begin) {
+		link = list_prev(&prev->dgram_link, &rdg->frags);
+		prev = (link != NULL) ?
+		    list_get_instance(link, reass_frag_t, dgram_link) : NULL;
+	}
 
-	frag->packet = *packet;
-	frag->packet.data = data_copy;
+	if (prev != NULL && prev->offs + prev->size > begin)
+		begin = prev->offs + prev->size;
 
-	/*
-	 * XXX Make resource-consuming attacks harder, eliminate any duplicate
-	 * data immediately. Possibly eliminate redundant packet headers.
-	 */
+	/* Drop fragments the new one covers completely */
+	while (true) {
+		link = (prev != NULL) ?
+		    list_next(&prev->dgram_link, &rdg->frags) :
+		    list_first(&rdg->frags);
+		next = (link != NULL) ?
+		    list_get_instance(link, reass_frag_t, dgram_link) : NULL;
+
+		if (next == NULL || next->offs + next->size > end ||
+		    begin >= end)
+			break;
 
-	/*
-	 * Insert into the list, which is sorted by offs member ascending.
-	 */
+		reass_frag_remove(rdg, next);
+	}
 
-	link = list_first(&rdg->frags);
-	while (link != NULL) {
-		reass_frag_t *qf = list_get_instance(link, reass_frag_t,
-		    dgram_link);
+	if (next != NULL && next->offs < end)
+		end = next->offs;
 
-		if (qf->packet.offs >= packet->offs)
-			break;
+	/* Nothing new */
+	if (begin >= end)
+		return EOK;
 
-		link = list_next(link, &rdg->frags);
-	}
+	if (rdg->nfrags >= REASS_FRAGS_MAX)
+		return ELIMIT;
 
-	if (link != NULL)
-		list_insert_after(&frag->dgram_link, link);
+	frag = malloc(sizeof(reass_frag_t) + end - begin);
+	if (frag == NULL)
+		return ENOMEM;
+
+	link_initialize(&frag->dgram_link);
+	frag->offs = begin;
+	frag->size = end - begin;
+	memcpy(frag + 1, packet->data + begin - packet->offs, frag->size);
+
+	if (prev != NULL)
+		list_insert_after(&frag->dgram_link, &prev->dgram_link);
 	else
-		list_append(&frag->dgram_link, &rdg->frags);
+		list_prepend(&frag->dgram_link, &rdg->frags);
+
+	++rdg->nfrags;
+	rdg->received += frag->size;
+	rdg->mem += sizeof(reass_frag_t) + frag->size;
+	reass_mem += sizeof(reass_frag_t) + frag->size;
 
 	return EOK;
 }
 
-/** Check if datagram is complete.
+/** Queue packet for datagram reassembly.
  *
- * @param rdg		Datagram reassembly structure
- * @return		@c true if complete, @c false if not
+ * @param packet	Packet
+ * @return		EOK on success or ENOMEM.
  */
-static bool reass_dgram_complete(reass_dgram_t *rdg)
+errno_t inet_reass_queue_packet(inet_packet_t *packet)
 {
-	reass_frag_t *frag, *prev;
-	link_t *link;
-
-	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
-	assert(!list_empty(&rdg->frags));
-
-	link = list_first(&rdg->frags);
-	assert(link != NULL);
+	reass_dgram_t *rdg;
+	reass_dgram_t *old;
+	errno_t rc;
 
-	frag = list_get_instance(link, reass_frag_t,
-	    dgram_link);
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_reass_queue_packet()");
 
-	/* First fragment must be at offset zero */
-	if (frag->packet.offs != 0)
-		return false;
+	fibril_mutex_lock(&reass_dgram_map_lock);
 
-	prev = frag;
+	/* Get existing or new datagram */
+	rdg = reass_dgram_get(packet);
+	if (rdg == NULL) {
+		/* Only happens when we are out of memory */
+		fibril_mutex_unlock(&reass_dgram_map_lock);
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Allocation failed, packet dropped.");
+		return ENOMEM;
+	}
 
-	while (true) {
-		link = list_next(link, &rdg->frags);
-		if (link == NULL)
-			break;
+	/* Insert fragment into the datagram */
+	rc = reass_dgram_insert_frag(rdg, packet);
+	if (rc != EOK && rc != ENOMEM) {
+		/* Malformed datagram, abandon it */
+		reass_dgram_remove(rdg);
+		reass_dgram_destroy(rdg);
+		fibril_mutex_unlock(&reass_dgram_map_lock);
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "Invalid fragment, datagram "
+		    "dropped.");
+		return rc;
+	}
 
-		/* Each next fragment must follow immediately or overlap */
-		frag = list_get_instance(link, reass_frag_t, dgram_link);
-		if (frag->packet.offs > prev->packet.offs + prev->packet.size)
-			return false;
+	/* Make room, oldest datagrams first */
+	while (reass_mem > REASS_MEM_MAX) {
+		old = list_get_instance(list_first(&reass_dgram_age),
+		    reass_dgram_t, age_link);
+		reass_dgram_remove(old);
+		reass_dgram_destroy(old);
+
+		if (old == rdg) {
+			fibril_mutex_unlock(&reass_dgram_map_lock);
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "Out of reassembly "
+			    "memory, datagram dropped.");
+			return ENOMEM;
+		}
+	}
 
-		/* No more fragments - datagram is complete */
-		if (!frag->packet.mf)
-			return true;
+	/* Check if datagram is complete */
+	if (rdg->total_known && rdg->received == rdg->total) {
+		/* Remove it from the map */
+		reass_dgram_remove(rdg);
+		fibril_mutex_unlock(&reass_dgram_map_lock);
 
-		prev = frag;
+		/* Deliver complete datagram */
+		rc = reass_dgram_deliver(rdg);
+		reass_dgram_destroy(rdg);
+		return rc;
 	}
 
-	return false;
+	fibril_mutex_unlock(&reass_dgram_map_lock);
+	return rc;
+}
+
+/** Get reassembly resource usage.
+ *
+ * @param ndgrams	Place to store number of datagrams being reassembled
+ * @param mem		Place to store number of bytes of memory held
+ */
+void inet_reass_get_usage(size_t *ndgrams, size_t *mem)
+{
+	fibril_mutex_lock(&reass_dgram_map_lock);
+	*ndgrams = hash_table_size(&reass_dgram_map);
+	*mem = reass_mem;
+	fibril_mutex_unlock(&reass_dgram_map_lock);
 }
 
 /** Remove datagram from reassembly map.
@@ -282,80 +528,45 @@ static bool reass_dgram_complete(reass_dgram_t *rdg)
 static void reass_dgram_remove(reass_dgram_t *rdg)
 {
 	assert(fibril_mutex_is_locked(&reass_dgram_map_lock));
-	list_remove(&rdg->map_link);
+	hash_table_remove_item(&reass_dgram_map, &rdg->map_link);
+	list_remove(&rdg->age_link);
+	reass_mem -= rdg->mem;
 }
 
 /** Deliver complete datagram.
+ *
+ * The fragments are passed on as they are, without copying them together.
  *
  * @param rdg		Datagram reassembly structure.
  */
 static errno_t reass_dgram_deliver(reass_dgram_t *rdg)
 {
-	size_t dgram_size;
-	size_t fragoff_limit;
+	inet_dgram_seg_t *segs;
 	inet_dgram_t dgram;
-	uint8_t proto;
-	reass_frag_t *frag;
+	size_t i;
 	errno_t rc;
 
-	/*
-	 * Potentially there could be something beyond the first packet
-	 * that has !MF. Make sure we ignore that.
-	 */
-	frag = NULL;
-	list_foreach(rdg->frags, dgram_link, reass_frag_t, cfrag) {
-		if (!cfrag->packet.mf) {
-			frag = cfrag;
-			break;
-		}
-	}
-
-	assert(frag != NULL);
-	assert(!frag->packet.mf);
-
-	dgram_size = frag->packet.offs + frag->packet.size;
-
-	/* Upper bound for fragment offset field */
-	fragoff_limit = 1 << (FF_FRAGOFF_h - FF_FRAGOFF_l + 1);
-
-	/* Verify that total size of datagram is within reasonable bounds */
-	if (dgram_size > FRAG_OFFS_UNIT * fragoff_limit)
-		return ELIMIT;
-
-	dgram.data = calloc(dgram_size, 1);
-	if (dgram.data == NULL)
+	segs = calloc(rdg->nfrags, sizeof(inet_dgram_seg_t));
+	if (segs == NULL)
 		return ENOMEM;
 
-	/* XXX What if different fragments came from different link? */
-	dgram.iplink = frag->packet.link_id;
-	dgram.size = dgram_size;
-	dgram.src = frag->packet.src;
-	dgram.dest = frag->packet.dest;
-	dgram.tos = frag->packet.tos;
-	proto = frag->packet.proto;
-
-	/* Pull together data from individual fragments */
-
-	size_t doffs = 0;
-
-	list_foreach(rdg->frags, dgram_link, reass_frag_t, cfrag) {
-		size_t cb, ce;
-
-		cb = max(doffs, cfrag->packet.offs);
-		ce = min(dgram_size, cfrag->packet.offs + cfrag->packet.size);
-
-		if (ce > cb) {
-			memcpy(dgram.data + cb,
-			    cfrag->packet.data + cb - cfrag->packet.offs,
-			    ce - cb);
-		}
-
-		if (!cfrag->packet.mf)
-			break;
+	i = 0;
+	list_foreach(rdg->frags, dgram_link, reass_frag_t, frag) {
+		segs[i].data = frag + 1;
+		segs[i].size = frag->size;
+		++i;
 	}
 
-	rc = inet_recv_dgram_local(&dgram, proto);
-	free(dgram.data);
+	/* XXX What if different fragments came from different link? */
+	dgram.iplink = rdg->link_id;
+	dgram.size = rdg->total;
+	dgram.data = NULL;
+	dgram.src = rdg->src;
+	dgram.dest = rdg->dest;
+	dgram.tos = rdg->tos;
+
+	rc = inet_recv_dgram_local_sg(&dgram, segs, rdg->nfrags, rdg->proto);
+	free(segs);
 	return rc;
 }
 
@@ -371,7 +582,6 @@ static void reass_dgram_destroy(reass_dgram_t *rdg)
 		    dgram_link);
 
 		list_remove(&frag->dgram_link);
-		free(frag->packet.data);
 		free(frag);
 	}
 
@@ -39,7 +39,9 @@
 
 #include "inetsrv.h"
 
+extern errno_t inet_reass_init(void);
 extern errno_t inet_reass_queue_packet(inet_packet_t *);
+extern void inet_reass_get_usage(size_t *, size_t *);
 
 #endif
 
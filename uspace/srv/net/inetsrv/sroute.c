@@ -34,11 +34,15 @@
  * @brief
  */
 
+#include <assert.h>
 #include <bitops.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <io/log.h>
 #include <ipc/loc.h>
+#include <mem.h>
+#include <nettl/rtrie.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <str.h>
 #include "sroute.h"
@@ -49,6 +53,89 @@ static FIBRIL_MUTEX_INITIALIZE(sroute_list_lock);
 static LIST_INITIALIZE(sroute_list);
 static sysarg_t sroute_id = 0;
 
+/** Routes by destination network (of inet_sroute_t), for lookups */
+static rtrie_t sroute_trie4;
+static rtrie_t sroute_trie6;
+
+/** Get trie and key for network or address.
+ *
+ * @param ver  IP version
+ * @param v4   IPv4 address
+ * @param v6   IPv6 address
+ * @param key  Place to store key
+ *
+ * @return Trie or NULL if @a ver is not supported
+ */
+static rtrie_t *inet_sroute_key(ip_ver_t ver, addr32_t v4, addr128_t v6,
+    uint8_t *key)
+{
+	switch (ver) {
+	case ip_v4:
+		key[0] = v4 >> 24;
+		key[1] = (v4 >> 16) & 0xff;
+		key[2] = (v4 >> 8) & 0xff;
+		key[3] = v4 & 0xff;
+		return &sroute_trie4;
+	case ip_v6:
+		addr128(v6, key);
+		return &sroute_trie6;
+	default:
+		return NULL;
+	}
+}
+
+/** Get trie and key for route destination network. */
+static rtrie_t *inet_sroute_dest_key(inet_sroute_t *sroute, uint8_t *key,
+    uint8_t *bits)
+{
+	addr32_t v4;
+	addr128_t v6;
+	ip_ver_t ver;
+
+	ver = inet_naddr_get(&sroute->dest, &v4, &v6, bits);
+	return inet_sroute_key(ver, v4, v6, key);
+}
+
+/** Determine if two routes lead to the same network. */
+static bool inet_sroute_same_dest(inet_sroute_t *a, inet_sroute_t *b)
+{
+	uint8_t akey[16];
+	uint8_t bkey[16];
+	uint8_t abits;
+	uint8_t bbits;
+	uint8_t mask;
+
+	if (inet_sroute_dest_key(a, akey, &abits) !=
+	    inet_sroute_dest_key(b, bkey, &bbits) || abits != bbits)
+		return false;
+
+	if (memcmp(akey, bkey, abits / 8) != 0)
+		return false;
+
+	if (abits % 8 == 0)
+		return true;
+
+	mask = 0xff << (8 - abits % 8);
+	return ((akey[abits / 8] ^ bkey[abits / 8]) & mask) == 0;
+}
+
+errno_t inet_sroute_init(void)
+{
+	errno_t rc;
+
+	rc = rtrie_init(&sroute_trie4, 32);
+	if (rc != EOK)
+		return rc;
+
+	rc = rtrie_init(&sroute_trie6, 128);
+	if (rc != EOK) {
+		rtrie_fini(&sroute_trie4);
+		return rc;
+	}
+
+	return EOK;
+}
+
 inet_sroute_t *inet_sroute_new(void)
 {
 	inet_sroute_t *sroute = calloc(1, sizeof(inet_sroute_t));
@@ -74,61 +161,124 @@ void inet_sroute_delete(inet_sroute_t *sroute)
 	free(sroute);
 }
 
-void inet_sroute_add(inet_sroute_t *sroute)
+errno_t inet_sroute_add(inet_sroute_t *sroute)
 {
+	uint8_t key[16];
+	uint8_t bits;
+	rtrie_t *trie;
+	errno_t rc;
+
 	fibril_mutex_lock(&sroute_list_lock);
+
+	trie = inet_sroute_dest_key(sroute, key, &bits);
+	if (trie == NULL) {
+		fibril_mutex_unlock(&sroute_list_lock);
+		return EINVAL;
+	}
+
+	/* An earlier route to the same network takes precedence */
+	rc = rtrie_insert(trie, key, bits, sroute);
+	if (rc != EOK && rc != EEXIST) {
+		fibril_mutex_unlock(&sroute_list_lock);
+		return rc;
+	}
+
 	list_append(&sroute->sroute_list, &sroute_list);
-	fibril_mutex_unlock(&sroute_list_lock);
-}
 
-void inet_sroute_remove(inet_sroute_t *sroute)
-{
-	fibril_mutex_lock(&sroute_list_lock);
-	list_remove(&sroute->sroute_list);
+	/* Free trie nodes replaced by the insertion */
+	rtrie_synchronize(trie);
 	fibril_mutex_unlock(&sroute_list_lock);
+
+	return EOK;
 }
 
-/** Find static route object matching address @a addr.
+/** Remove static route.
+ *
+ * When this returns, lookups no longer use the route and it can be
+ * deleted.
  *
- * @param addr	Address
+ * @param sroute Static route
+ * @return EOK on success, ENOMEM if out of memory
  */
-inet_sroute_t *inet_sroute_find(inet_addr_t *addr)
+errno_t inet_sroute_remove(inet_sroute_t *sroute)
 {
-	ip_ver_t addr_ver = inet_addr_get(addr, NULL, NULL);
-
-	inet_sroute_t *best = NULL;
-	uint8_t best_bits = 0;
+	inet_sroute_t *next = NULL;
+	uint8_t key[16];
+	uint8_t bits;
+	rtrie_t *trie;
+	errno_t rc;
 
 	fibril_mutex_lock(&sroute_list_lock);
 
-	list_foreach(sroute_list, sroute_list, inet_sroute_t, sroute) {
-		uint8_t dest_bits;
-		ip_ver_t dest_ver = inet_naddr_get(&sroute->dest, NULL, NULL,
-		    &dest_bits);
-
-		/* Skip comparison with different address family */
-		if (addr_ver != dest_ver)
-			continue;
+	trie = inet_sroute_dest_key(sroute, key, &bits);
+	assert(trie != NULL);
 
-		/* Look for the most specific route */
-		if ((best != NULL) && (best_bits >= dest_bits))
-			continue;
+	if (rtrie_find(trie, key, bits) == sroute) {
+		/* Let the next route to the same network take over */
+		list_foreach(sroute_list, sroute_list, inet_sroute_t, sr) {
+			if (sr != sroute && inet_sroute_same_dest(sr, sroute)) {
+				next = sr;
+				break;
+			}
+		}
 
-		if (inet_naddr_compare_mask(&sroute->dest, addr)) {
-			log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: found candidate %p",
-			    sroute);
+		if (next != NULL)
+			rc = rtrie_set(trie, key, bits, next);
+		else
+			rc = rtrie_remove(trie, key, bits);
 
-			best = sroute;
-			best_bits = dest_bits;
+		if (rc != EOK) {
+			fibril_mutex_unlock(&sroute_list_lock);
+			return rc;
 		}
 	}
 
-	if (best == NULL)
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: Not found");
+	list_remove(&sroute->sroute_list);
 
+	/* Wait for lookups which might have found the route */
+	rtrie_synchronize(trie);
 	fibril_mutex_unlock(&sroute_list_lock);
 
-	return best;
+	return EOK;
+}
+
+/** Find static route matching address @a addr.
+ *
+ * Does not lock, the cost does not depend on the number of routes.
+ *
+ * @param addr   Address
+ * @param router Place to store address of router of the most specific
+ *               matching route
+ *
+ * @return EOK on success, ENOENT if no route matches
+ */
+errno_t inet_sroute_find(inet_addr_t *addr, inet_addr_t *router)
+{
+	inet_sroute_t *sroute;
+	addr32_t v4;
+	addr128_t v6;
+	uint8_t key[16];
+	rtrie_t *trie;
+	size_t epoch;
+
+	trie = inet_sroute_key(inet_addr_get(addr, &v4, &v6), v4, v6, key);
+	if (trie == NULL)
+		return ENOENT;
+
+	epoch = rtrie_read_begin(trie);
+
+	sroute = rtrie_lookup(trie, key);
+	if (sroute != NULL)
+		*router = sroute->router;
+
+	rtrie_read_end(trie, epoch);
+
+	if (sroute == NULL) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: Not found");
+		return ENOENT;
+	}
+
+	return EOK;
 }
 
 /** Find static route with a specific name.
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <macros.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../inet_std.h"
+#include "../inetsrv.h"
+#include "../reass.h"
+
+enum {
+	/** Size of test datagrams */
+	test_dgram_size = 4000,
+	/** Fragment size, multiple of FRAG_OFFS_UNIT */
+	test_frag_size = 496,
+	/** Number of bogus fragments in the storm */
+	test_storm_frags = 20000
+};
+
+/** Last datagram delivered by reassembly */
+static uint8_t test_delivered[test_dgram_size];
+static size_t test_delivered_size;
+static size_t test_delivered_cnt;
+static uint32_t test_seed;
+
+/** Stand-in for inetsrv delivery, gathers the datagram pieces */
+errno_t inet_recv_dgram_local_sg(inet_dgram_t *dgram, inet_dgram_seg_t *segs,
+    size_t nsegs, uint8_t proto)
+{
+	size_t offs = 0;
+	size_t i;
+
+	for (i = 0; i < nsegs; i++) {
+		if (offs + segs[i].size > sizeof(test_delivered))
+			return EINVAL;
+		memcpy(test_delivered + offs, segs[i].data, segs[i].size);
+		offs += segs[i].size;
+	}
+
+	test_delivered_size = offs;
+	++test_delivered_cnt;
+	return (offs == dgram->size) ? EOK : EINVAL;
+}
+
+static uint32_t test_rand(void)
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return test_seed >> 8;
+}
+
+/** Fill in datagram data */
+static void test_dgram_fill(uint8_t *data, uint32_t ident)
+{
+	size_t i;
+
+	for (i = 0; i < test_dgram_size; i++)
+		data[i] = (uint8_t) (ident * 7 + i);
+}
+
+/** Queue fragment of test datagram */
+static errno_t test_frag_queue(uint8_t *data, uint32_t ident, size_t offs,
+    size_t size)
+{
+	inet_packet_t packet;
+
+	memset(&packet, 0, sizeof(packet));
+	inet_addr(&packet.src, 10, 0, 0, 1);
+	inet_addr(&packet.dest, 10, 0, 0, 2);
+	packet.proto = 17;
+	packet.ident = ident;
+	packet.offs = offs;
+	packet.size = size;
+	packet.mf = offs + size < test_dgram_size;
+	packet.data = data + offs;
+
+	return inet_reass_queue_packet(&packet);
+}
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(reass);
+
+PCUT_TEST_BEFORE
+{
+	static bool initialized = false;
+
+	if (!initialized) {
+		PCUT_ASSERT_ERRNO_VAL(EOK, inet_reass_init());
+		initialized = true;
+	}
+
+	test_delivered_cnt = 0;
+	test_delivered_size = 0;
+}
+
+/** Fragments arriving in reverse order, some of them twice */
+PCUT_TEST(reverse_dup)
+{
+	uint8_t data[test_dgram_size];
+	size_t offs;
+	size_t ndgrams, mem;
+
+	test_dgram_fill(data, 1);
+
+	offs = test_dgram_size - test_dgram_size % test_frag_size;
+	while (true) {
+		PCUT_ASSERT_INT_EQUALS(0, test_delivered_cnt);
+		PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 1, offs,
+		    min(test_frag_size, test_dgram_size - offs)));
+		if (offs == 0)
+			break;
+
+		PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 1, offs,
+		    min(test_frag_size, test_dgram_size - offs)));
+		offs -= test_frag_size;
+	}
+
+	PCUT_ASSERT_INT_EQUALS(1, test_delivered_cnt);
+	PCUT_ASSERT_INT_EQUALS(test_dgram_size, test_delivered_size);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, test_delivered,
+	    test_dgram_size));
+
+	inet_reass_get_usage(&ndgrams, &mem);
+	PCUT_ASSERT_INT_EQUALS(0, ndgrams);
+	PCUT_ASSERT_INT_EQUALS(0, mem);
+}
+
+/** Overlapping fragments of different sizes */
+PCUT_TEST(overlap)
+{
+	uint8_t data[test_dgram_size];
+
+	test_dgram_fill(data, 2);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 2, 800, 800));
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 2, 2400, 1600));
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 2, 1000, 400));
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 2, 0, 1200));
+	PCUT_ASSERT_INT_EQUALS(0, test_delivered_cnt);
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 2, 1200, 2000));
+
+	PCUT_ASSERT_INT_EQUALS(1, test_delivered_cnt);
+	PCUT_ASSERT_INT_EQUALS(test_dgram_size, test_delivered_size);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(data, test_delivered,
+	    test_dgram_size));
+}
+
+/** Two datagrams reassembled back to back
+ *
+ * The first datagram leaves the map empty while the expiry timer is still
+ * running, the second one must not set it again.
+ */
+PCUT_TEST(back_to_back)
+{
+	uint8_t data[test_dgram_size];
+	size_t ndgrams, mem;
+	uint32_t ident;
+
+	for (ident = 4; ident <= 5; ident++) {
+		test_dgram_fill(data, ident);
+
+		PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, ident, 0,
+		    2000));
+		PCUT_ASSERT_INT_EQUALS(ident - 4, test_delivered_cnt);
+		PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, ident, 2000,
+		    2000));
+
+		PCUT_ASSERT_INT_EQUALS(ident - 3, test_delivered_cnt);
+		PCUT_ASSERT_INT_EQUALS(test_dgram_size, test_delivered_size);
+		PCUT_ASSERT_INT_EQUALS(0, memcmp(data, test_delivered,
+		    test_dgram_size));
+
+		inet_reass_get_usage(&ndgrams, &mem);
+		PCUT_ASSERT_INT_EQUALS(0, ndgrams);
+		PCUT_ASSERT_INT_EQUALS(0, mem);
+	}
+}
+
+/** Last fragment which contradicts the others drops the datagram */
+PCUT_TEST(inconsistent)
+{
+	uint8_t data[test_dgram_size];
+	size_t ndgrams, mem;
+	inet_packet_t packet;
+
+	test_dgram_fill(data, 3);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(data, 3, 1600, 800));
+
+	memset(&packet, 0, sizeof(packet));
+	inet_addr(&packet.src, 10, 0, 0, 1);
+	inet_addr(&packet.dest, 10, 0, 0, 2);
+	packet.proto = 17;
+	packet.ident = 3;
+	packet.offs = 800;
+	packet.size = 800;
+	packet.mf = false;
+	packet.data = data + 800;
+	PCUT_ASSERT_ERRNO_VAL(EINVAL, inet_reass_queue_packet(&packet));
+
+	inet_reass_get_usage(&ndgrams, &mem);
+	PCUT_ASSERT_INT_EQUALS(0, ndgrams);
+	PCUT_ASSERT_INT_EQUALS(0, test_delivered_cnt);
+}
+
+/** Storm of fragments of datagrams which never complete
+ *
+ * Memory held must stay bounded and a datagram whose fragments arrive in
+ * quick succession must still be reassembled.
+ */
+PCUT_TEST(storm)
+{
+	uint8_t data[test_dgram_size];
+	uint8_t good[test_dgram_size];
+	size_t ndgrams, mem;
+	size_t max_mem = 0;
+	size_t offs;
+	size_t good_offs = 0;
+	int i;
+
+	memset(data, 0x55, sizeof(data));
+	test_dgram_fill(good, 100000);
+
+	test_seed = 1;
+	for (i = 0; i < test_storm_frags; i++) {
+		/* Random fragments which never cover a whole datagram */
+		offs = FRAG_OFFS_UNIT * (1 + test_rand() %
+		    ((test_dgram_size - 2 * test_frag_size) / FRAG_OFFS_UNIT));
+		(void) test_frag_queue(data, test_rand() % 1000, offs,
+		    test_frag_size);
+
+		inet_reass_get_usage(&ndgrams, &mem);
+		if (mem > max_mem)
+			max_mem = mem;
+
+		/* Interleave fragments of a good datagram */
+		if (i % 4 == 0 && good_offs < test_dgram_size) {
+			PCUT_ASSERT_ERRNO_VAL(EOK, test_frag_queue(good,
+			    100000, good_offs, min(test_frag_size,
+			    test_dgram_size - good_offs)));
+			good_offs += test_frag_size;
+		}
+	}
+
+	PCUT_ASSERT_TRUE(max_mem <= 1024 * 1024 + test_frag_size + 128);
+	PCUT_ASSERT_INT_EQUALS(1, test_delivered_cnt);
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(good, test_delivered,
+	    test_dgram_size));
+}
+
+PCUT_EXPORT(reass);
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2026 agent
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <nettl/rtrie.h>
+#include <pcut/pcut.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** Test prefix */
+typedef struct {
+	uint8_t key[4];
+	size_t len;
+	bool present;
+} test_prefix_t;
+
+enum {
+	/** Number of prefixes for comparison with linear search */
+	test_cmp_prefixes = 2000,
+	/** Number of lookups for comparison with linear search */
+	test_cmp_lookups = 10000
+};
+
+static uint32_t test_seed;
+
+static uint32_t test_rand(void)
+{
+	test_seed = test_seed * 1103515245 + 12345;
+	return test_seed >> 8;
+}
+
+static void test_key(uint32_t addr, uint8_t *key)
+{
+	key[0] = addr >> 24;
+	key[1] = (addr >> 16) & 0xff;
+	key[2] = (addr >> 8) & 0xff;
+	key[3] = addr & 0xff;
+}
+
+/** Determine if @a addr matches prefix. */
+static bool test_match(const uint8_t *addr, test_prefix_t *prefix)
+{
+	size_t i;
+	unsigned a, p;
+
+	for (i = 0; i < prefix->len; i++) {
+		a = (addr[i / 8] >> (7 - i % 8)) & 1;
+		p = (prefix->key[i / 8] >> (7 - i % 8)) & 1;
+		if (a != p)
+			return false;
+	}
+
+	return true;
+}
+
+/** Find longest matching present prefix by linear search. */
+static test_prefix_t *test_linear_lookup(test_prefix_t *prefix,
+    size_t n, const uint8_t *addr)
+{
+	test_prefix_t *best = NULL;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!prefix[i].present || !test_match(addr, &prefix[i]))
+			continue;
+		if (best == NULL || prefix[i].len > best->len)
+			best = &prefix[i];
+	}
+
+	return best;
+}
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(rtrie);
+
+/** Lookup in empty trie */
+PCUT_TEST(empty)
+{
+	rtrie_t trie;
+	uint8_t key[4];
+	errno_t rc;
+
+	rc = rtrie_init(&trie, 32);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_key(0x0a000001, key);
+	PCUT_ASSERT_NULL(rtrie_lookup(&trie, key));
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, rtrie_remove(&trie, key, 8));
+
+	rtrie_fini(&trie);
+}
+
+/** Most specific prefix wins, removal uncovers less specific prefixes */
+PCUT_TEST(longest_match)
+{
+	rtrie_t trie;
+	uint8_t key[4];
+	int v[5];
+	errno_t rc;
+
+	rc = rtrie_init(&trie, 32);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_key(0, key);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 0, &v[0]));
+	test_key(0x0a000000, key);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 8, &v[1]));
+	test_key(0x0a010000, key);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 16, &v[2]));
+	test_key(0x0a010200, key);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 23, &v[3]));
+	test_key(0x0a010203, key);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 32, &v[4]));
+
+	test_key(0x0b000001, key);
+	PCUT_ASSERT_EQUALS(&v[0], rtrie_lookup(&trie, key));
+	test_key(0x0a020001, key);
+	PCUT_ASSERT_EQUALS(&v[1], rtrie_lookup(&trie, key));
+	test_key(0x0a01ff01, key);
+	PCUT_ASSERT_EQUALS(&v[2], rtrie_lookup(&trie, key));
+	test_key(0x0a010301, key);
+	PCUT_ASSERT_EQUALS(&v[3], rtrie_lookup(&trie, key));
+	test_key(0x0a010203, key);
+	PCUT_ASSERT_EQUALS(&v[4], rtrie_lookup(&trie, key));
+
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, rtrie_remove(&trie, key, 31));
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_remove(&trie, key, 32));
+	PCUT_ASSERT_EQUALS(&v[3], rtrie_lookup(&trie, key));
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_remove(&trie, key, 23));
+	PCUT_ASSERT_EQUALS(&v[2], rtrie_lookup(&trie, key));
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_remove(&trie, key, 0));
+	test_key(0x0b000001, key);
+	PCUT_ASSERT_NULL(rtrie_lookup(&trie, key));
+
+	rtrie_synchronize(&trie);
+	rtrie_fini(&trie);
+}
+
+/** Exact prefix operations */
+PCUT_TEST(exact)
+{
+	rtrie_t trie;
+	uint8_t key[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+	int a, b;
+	errno_t rc;
+
+	rc = rtrie_init(&trie, 128);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 32, &a));
+	PCUT_ASSERT_ERRNO_VAL(EEXIST, rtrie_insert(&trie, key, 32, &b));
+	PCUT_ASSERT_EQUALS(&a, rtrie_find(&trie, key, 32));
+	PCUT_ASSERT_NULL(rtrie_find(&trie, key, 33));
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_set(&trie, key, 32, &b));
+	PCUT_ASSERT_EQUALS(&b, rtrie_lookup(&trie, key));
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, rtrie_set(&trie, key, 31, &a));
+
+	PCUT_ASSERT_ERRNO_VAL(EOK, rtrie_insert(&trie, key, 128, &a));
+	PCUT_ASSERT_EQUALS(&a, rtrie_lookup(&trie, key));
+	key[15] = 1;
+	PCUT_ASSERT_EQUALS(&b, rtrie_lookup(&trie, key));
+
+	rtrie_synchronize(&trie);
+	rtrie_fini(&trie);
+}
+
+/** Compare with linear search while prefixes come and go */
+PCUT_TEST(linear)
+{
+	test_prefix_t *prefix;
+	test_prefix_t *expected;
+	test_prefix_t *found;
+	rtrie_t trie;
+	uint8_t addr[4];
+	size_t i;
+	int round;
+	errno_t rc;
+
+	prefix = calloc(test_cmp_prefixes, sizeof(test_prefix_t));
+	PCUT_ASSERT_NOT_NULL(prefix);
+
+	rc = rtrie_init(&trie, 32);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	/* Concentrate prefixes in a small part of the address space */
+	test_seed = 1;
+	for (i = 0; i < test_cmp_prefixes; i++) {
+		test_key(test_rand() & 0x0f0f0f0f, prefix[i].key);
+		prefix[i].len = test_rand() % 33;
+	}
+
+	for (round = 0; round < 4; round++) {
+		for (i = 0; i < test_cmp_prefixes; i++) {
+			if (prefix[i].present) {
+				if (test_rand() % 2 == 0)
+					continue;
+				rc = rtrie_remove(&trie, prefix[i].key,
+				    prefix[i].len);
+				PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+				prefix[i].present = false;
+			} else {
+				rc = rtrie_insert(&trie, prefix[i].key,
+				    prefix[i].len, &prefix[i]);
+				if (rc == EEXIST)
+					continue;
+				PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+				prefix[i].present = true;
+			}
+		}
+
+		rtrie_synchronize(&trie);
+
+		for (i = 0; i < test_cmp_lookups; i++) {
+			test_key(test_rand() & 0x0f0f0f0f, addr);
+			expected = test_linear_lookup(prefix, test_cmp_prefixes,
+			    addr);
+			found = rtrie_lookup(&trie, addr);
+			if (expected == NULL) {
+				PCUT_ASSERT_NULL(found);
+			} else {
+				PCUT_ASSERT_NOT_NULL(found);
+				PCUT_ASSERT_INT_EQUALS(expected->len,
+				    found->len);
+				PCUT_ASSERT_TRUE(test_match(addr, found));
+			}
+		}
+	}
+
+	rtrie_fini(&trie);
+	free(prefix);
+}
+
+PCUT_EXPORT(rtrie);
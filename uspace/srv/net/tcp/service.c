@@ -34,6 +34,8 @@
  * @file HelenOS service implementation
  */
 
+#include <align.h>
+#include <as.h>
 #include <async.h>
 #include <errno.h>
 #include <str_error.h>
@@ -45,7 +47,9 @@
 #include <loc.h>
 #include <macros.h>
 #include <mem.h>
+#include <ns.h>
 #include <stdlib.h>
+#include <vfs/vfs.h>
 
 #include "conn.h"
 #include "service.h"
@@ -57,6 +61,15 @@
 /** Maximum amount of data transferred in one send call */
 #define MAX_MSG_SIZE DATA_XFER_LIMIT
 
+/** Size of file window mapped at a time when sending a file */
+#define SENDFILE_WINDOW (64 * PAGE_SIZE)
+
+/** Session to VFS pager used to map files sent via sendfile */
+static async_sess_t *vfs_pager_sess;
+
+/** Serializes receiving of file handles passed to us via sendfile */
+static FIBRIL_MUTEX_INITIALIZE(sendfile_lock);
+
 static void tcp_ev_data(tcp_cconn_t *);
 static void tcp_ev_connected(tcp_cconn_t *);
 static void tcp_ev_conn_failed(tcp_cconn_t *);
@@ -676,6 +689,79 @@ static errno_t tcp_conn_send_impl(tcp_client_t *client, sysarg_t conn_id,
 	return EOK;
 }
 
+/** Send file contents over connection.
+ *
+ * Handle client request to send file contents (with parameters unmarshalled).
+ * The file is mapped into our address space in windows of
+ * @c SENDFILE_WINDOW bytes using the VFS pager and the mapped pages are
+ * passed directly to the connection, so the data does not need to travel
+ * through the client.
+ *
+ * @param client  TCP client
+ * @param conn_id Connection ID
+ * @param fd      File handle (in our VFS file table)
+ * @param pos     Position in file
+ * @param size    Number of bytes to send
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_conn_sendfile_impl(tcp_client_t *client, sysarg_t conn_id,
+    int fd, aoff64_t pos, size_t size)
+{
+	tcp_cconn_t *cconn;
+	vfs_stat_t stat;
+	errno_t rc;
+	tcp_error_t trc;
+
+	rc = tcp_cconn_get(client, conn_id, &cconn);
+	if (rc != EOK)
+		return rc;
+
+	rc = vfs_stat(fd, &stat);
+	if (rc != EOK)
+		return rc;
+
+	/* Do not send anything past the end of file */
+	if (pos >= stat.size)
+		return EOK;
+	if (size > stat.size - pos)
+		size = stat.size - pos;
+
+	if (vfs_pager_sess == NULL) {
+		vfs_pager_sess = service_connect_blocking(SERVICE_VFS,
+		    INTERFACE_PAGER, 0);
+		if (vfs_pager_sess == NULL)
+			return EIO;
+	}
+
+	while (size > 0) {
+		aoff64_t base = ALIGN_DOWN(pos, PAGE_SIZE);
+		size_t skip = pos - base;
+		size_t xfer_size = min(size, SENDFILE_WINDOW - skip);
+
+		/* The window offset is passed to the pager as a sysarg_t */
+		if ((sysarg_t) base != base)
+			return ERANGE;
+
+		void *area = async_as_area_create(AS_AREA_ANY,
+		    ALIGN_UP(skip + xfer_size, PAGE_SIZE),
+		    AS_AREA_READ | AS_AREA_CACHEABLE, vfs_pager_sess,
+		    (sysarg_t) fd, (sysarg_t) base, 0);
+		if (area == AS_MAP_FAILED)
+			return ENOMEM;
+
+		trc = tcp_uc_send(cconn->conn, area + skip, xfer_size, 0);
+		as_area_destroy(area);
+		if (trc != TCP_EOK)
+			return EIO;
+
+		pos += xfer_size;
+		size -= xfer_size;
+	}
+
+	return EOK;
+}
+
 /** Receive data from connection.
  *
  * Handle client request to receive data (with parameters unmarshalled).
@@ -1005,6 +1091,62 @@ static void tcp_conn_send_srv(tcp_client_t *client,
 	free(data);
 }
 
+/** Receive file handle passed along with a sendfile request.
+ *
+ * VFS queues passed handles per task in order of arrival, not per request.
+ * Forwarding the handle and waiting for it must therefore be done by one
+ * request at a time, otherwise concurrent requests could pick up each
+ * other's handles.
+ *
+ * @param fd Place to store the received file handle
+ * @return EOK on success or an error code
+ */
+static errno_t tcp_sendfile_receive_handle(int *fd)
+{
+	errno_t rc;
+
+	fibril_mutex_lock(&sendfile_lock);
+	rc = vfs_receive_handle(false, fd);
+	fibril_mutex_unlock(&sendfile_lock);
+
+	return rc;
+}
+
+/** Send file contents via connection.
+ *
+ * Handle client request to send file contents via connection.
+ *
+ * @param client        TCP client
+ * @param icall_handle  Async request call handle
+ * @param icall         Async request data
+ */
+static void tcp_conn_sendfile_srv(tcp_client_t *client,
+    cap_call_handle_t icall_handle, ipc_call_t *icall)
+{
+	sysarg_t conn_id;
+	aoff64_t pos;
+	size_t size;
+	int fd;
+	errno_t rc;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_sendfile_srv()");
+
+	conn_id = IPC_GET_ARG1(*icall);
+	pos = MERGE_LOUP32(IPC_GET_ARG2(*icall), IPC_GET_ARG3(*icall));
+	size = IPC_GET_ARG4(*icall);
+
+	rc = tcp_sendfile_receive_handle(&fd);
+	if (rc != EOK) {
+		async_answer_0(icall_handle, rc);
+		return;
+	}
+
+	rc = tcp_conn_sendfile_impl(client, conn_id, fd, pos, size);
+	vfs_put(fd);
+
+	async_answer_0(icall_handle, rc);
+}
+
 /** Read received data from connection without blocking.
  *
  * Handle client request to read received data via connection without blocking.
@@ -1229,6 +1371,9 @@ static void tcp_client_conn(cap_call_handle_t icall_handle, ipc_call_t *icall,
 		case TCP_CONN_SEND:
 			tcp_conn_send_srv(&client, chandle, &call);
 			break;
+		case TCP_CONN_SENDFILE:
+			tcp_conn_sendfile_srv(&client, chandle, &call);
+			break;
 		case TCP_CONN_RECV:
 			tcp_conn_recv_srv(&client, chandle, &call);
 			break;
@@ -69,6 +69,9 @@ static void vfs_pager(cap_call_handle_t icall_handle, ipc_call_t *icall, void *a
 		case IPC_M_PAGE_IN:
 			vfs_page_in(chandle, &call);
 			break;
+		case VFS_PAGER_READ:
+			vfs_pager_read(chandle, &call);
+			break;
 		default:
 			async_answer_0(chandle, ENOTSUP);
 			break;
@@ -100,6 +103,14 @@ int main(int argc, char **argv)
 		return ENOMEM;
 	}
 
+	/*
+	 * Initialize the pager page cache.
+	 */
+	if (!vfs_pager_init()) {
+		printf("%s: Failed to initialize pager page cache\n", NAME);
+		return ENOMEM;
+	}
+
 	/*
 	 * Allocate and initialize the Path Lookup Buffer.
 	 */
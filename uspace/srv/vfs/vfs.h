@@ -120,6 +120,12 @@ typedef struct _vfs_node {
 	fibril_rwlock_t contents_rwlock;
 
 	struct _vfs_node *mount;
+
+	/** Pages of this node cached by the pager. */
+	list_t pages;
+
+	/** Incremented whenever the cached pages are invalidated. */
+	unsigned pages_gen;
 } vfs_node_t;
 
 /**
@@ -223,7 +229,10 @@ extern errno_t vfs_op_write(int fd, aoff64_t, size_t *out_bytes);
 
 extern void vfs_register(cap_call_handle_t, ipc_call_t *);
 
+extern bool vfs_pager_init(void);
+extern void vfs_pager_invalidate(vfs_node_t *);
 extern void vfs_page_in(cap_call_handle_t, ipc_call_t *);
+extern void vfs_pager_read(cap_call_handle_t, ipc_call_t *);
 
 typedef struct {
 	void *buffer;
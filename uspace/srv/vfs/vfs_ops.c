@@ -493,6 +493,10 @@ static errno_t vfs_rdwr(int fd, aoff64_t pos, bool read, rdwr_ipc_cb_t ipc_cb,
 		fibril_rwlock_write_unlock(&file->node->contents_rwlock);
 	}
 
+	/* Pages cached by the pager are stale now. */
+	if (!read && (rc == EOK))
+		vfs_pager_invalidate(file->node);
+
 	vfs_file_put(file);
 
 	return rc;
@@ -623,6 +627,10 @@ errno_t vfs_op_resize(int fd, int64_t size)
 		file->node->size = size;
 
 	fibril_rwlock_write_unlock(&file->node->contents_rwlock);
+
+	if (rc == EOK)
+		vfs_pager_invalidate(file->node);
+
 	vfs_file_put(file);
 	return rc;
 }
@@ -40,23 +40,156 @@
 #include <fibril_synch.h>
 #include <errno.h>
 #include <as.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <align.h>
+#include <libarch/config.h>
+#include <macros.h>
+#include <mem.h>
 
-void vfs_page_in(cap_call_handle_t req_handle, ipc_call_t *request)
-{
-	aoff64_t offset = IPC_GET_ARG1(*request);
-	size_t page_size = IPC_GET_ARG2(*request);
-	int fd = IPC_GET_ARG3(*request);
+/** Maximum number of pages kept in the page cache. */
+#define PAGER_CACHE_PAGES	4096
+
+/** Page of a file cached by the pager.
+ *
+ * The pages are keyed by the VFS node and the offset within the file, so
+ * all tasks which map the same part of the same file (e.g. the text of a
+ * shared library) get the same physical frames.
+ */
+typedef struct {
+	/** Link in the page cache hash table. */
+	ht_link_t link;
+	/** Link in the list of cached pages of the node. */
+	link_t node_link;
+	/** Link in the LRU list. */
+	link_t lru_link;
+
+	vfs_node_t *node;
+	aoff64_t offset;
+
+	/** Address space area holding the page contents. */
 	void *page;
-	errno_t rc;
+} pager_page_t;
+
+typedef struct {
+	vfs_node_t *node;
+	aoff64_t offset;
+} pager_key_t;
+
+/** Mutex protecting the page cache. */
+static FIBRIL_MUTEX_INITIALIZE(pager_mutex);
+
+/** Page cache hash table. */
+static hash_table_t pager_pages;
+
+/** Cached pages, the least recently used first. */
+static LIST_INITIALIZE(pager_lru);
+
+static size_t pager_count = 0;
+
+static size_t pager_key_hash(void *key)
+{
+	pager_key_t *k = key;
+	return hash_combine((size_t) k->node, (size_t) k->offset);
+}
+
+static size_t pager_hash(const ht_link_t *item)
+{
+	pager_page_t *page = hash_table_get_inst(item, pager_page_t, link);
+	pager_key_t key = {
+		.node = page->node,
+		.offset = page->offset
+	};
+
+	return pager_key_hash(&key);
+}
+
+static bool pager_key_equal(void *key, const ht_link_t *item)
+{
+	pager_key_t *k = key;
+	pager_page_t *page = hash_table_get_inst(item, pager_page_t, link);
+	return page->node == k->node && page->offset == k->offset;
+}
+
+static hash_table_ops_t pager_ops = {
+	.hash = pager_hash,
+	.key_hash = pager_key_hash,
+	.key_equal = pager_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+/** Initialize the pager page cache.
+ *
+ * @return		Return true on success, false on failure.
+ */
+bool vfs_pager_init(void)
+{
+	return hash_table_create(&pager_pages, 0, 0, &pager_ops);
+}
+
+/** Remove a page from the page cache and free it.
+ *
+ * The tasks which have the page mapped keep their reference to the
+ * physical frame.
+ */
+static void pager_page_remove(pager_page_t *page)
+{
+	assert(fibril_mutex_is_locked(&pager_mutex));
+
+	hash_table_remove_item(&pager_pages, &page->link);
+	list_remove(&page->node_link);
+	list_remove(&page->lru_link);
+	pager_count--;
 
-	page = as_area_create(AS_AREA_ANY, page_size,
+	as_area_destroy(page->page);
+	free(page);
+}
+
+/** Drop all cached pages of a node.
+ *
+ * This needs to be called whenever the contents of the node change so that
+ * the stale pages are not handed out to new mappings. Existing mappings
+ * keep the old contents.
+ *
+ * @param node		VFS node.
+ */
+void vfs_pager_invalidate(vfs_node_t *node)
+{
+	fibril_mutex_lock(&pager_mutex);
+
+	node->pages_gen++;
+	while (!list_empty(&node->pages)) {
+		pager_page_t *page = list_get_instance(list_first(&node->pages),
+		    pager_page_t, node_link);
+		pager_page_remove(page);
+	}
+
+	fibril_mutex_unlock(&pager_mutex);
+}
+
+/** Read a page of a file into a new address space area.
+ *
+ * @param fd		File handle.
+ * @param offset	Page-aligned file offset.
+ * @param page_size	Page size.
+ * @param out_page	Place to store the address of the new area.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t pager_read(int fd, aoff64_t offset, size_t page_size,
+    void **out_page)
+{
+	errno_t rc = EOK;
+	void *page = as_area_create(AS_AREA_ANY, page_size,
 	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE,
 	    AS_AREA_UNPAGED);
 
-	if (page == AS_MAP_FAILED) {
-		async_answer_0(req_handle, ENOMEM);
-		return;
-	}
+	if (page == AS_MAP_FAILED)
+		return ENOMEM;
 
 	rdwr_io_chunk_t chunk = {
 		.buffer = page,
@@ -77,15 +210,277 @@ void vfs_page_in(cap_call_handle_t req_handle, ipc_call_t *request)
 		chunk.size = page_size - total;
 	} while (total < page_size);
 
-	async_answer_1(req_handle, rc, (sysarg_t) page);
+	if (rc != EOK) {
+		as_area_destroy(page);
+		return rc;
+	}
+
+	*out_page = page;
+	return EOK;
+}
+
+/** Get the node of a file opened for reading.
+ *
+ * @param fd		File handle.
+ * @param out_node	Place to store the node with an added reference.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t pager_node_get(int fd, vfs_node_t **out_node)
+{
+	vfs_file_t *file = vfs_file_get(fd);
+	if (!file)
+		return EBADF;
+
+	if (!file->open_read) {
+		vfs_file_put(file);
+		return EINVAL;
+	}
+
+	vfs_node_addref(file->node);
+	*out_node = file->node;
+	vfs_file_put(file);
+	return EOK;
+}
+
+/** Add a page which has just been read to the page cache.
+ *
+ * The page is destroyed instead if the node has been modified since
+ * @a gen or if another fibril has cached the page in the meantime.
+ *
+ * @param node		VFS node.
+ * @param offset	Page-aligned file offset.
+ * @param gen		Generation of the node's pages before the read.
+ * @param page		Address space area holding the page contents.
+ */
+static void pager_cache_insert(vfs_node_t *node, aoff64_t offset,
+    unsigned gen, void *page)
+{
+	pager_key_t key = {
+		.node = node,
+		.offset = offset
+	};
+
+	fibril_mutex_lock(&pager_mutex);
+
+	pager_page_t *cached = NULL;
+	if ((node->pages_gen == gen) &&
+	    (hash_table_find(&pager_pages, &key) == NULL))
+		cached = malloc(sizeof(pager_page_t));
+
+	if (cached != NULL) {
+		if (pager_count == PAGER_CACHE_PAGES) {
+			pager_page_remove(list_get_instance(
+			    list_first(&pager_lru), pager_page_t, lru_link));
+		}
+
+		cached->node = node;
+		cached->offset = offset;
+		cached->page = page;
+		list_append(&cached->node_link, &node->pages);
+		list_append(&cached->lru_link, &pager_lru);
+		hash_table_insert(&pager_pages, &cached->link);
+		pager_count++;
+	} else {
+		as_area_destroy(page);
+	}
+
+	fibril_mutex_unlock(&pager_mutex);
+}
+
+/** Find a cached page and mark it as recently used.
+ *
+ * @param node		VFS node.
+ * @param offset	Page-aligned file offset.
+ *
+ * @return		Cached page or NULL.
+ */
+static pager_page_t *pager_cache_find(vfs_node_t *node, aoff64_t offset)
+{
+	pager_key_t key = {
+		.node = node,
+		.offset = offset
+	};
+
+	assert(fibril_mutex_is_locked(&pager_mutex));
+
+	ht_link_t *link = hash_table_find(&pager_pages, &key);
+	if (link == NULL)
+		return NULL;
+
+	pager_page_t *cached = hash_table_get_inst(link, pager_page_t, link);
+	list_remove(&cached->lru_link);
+	list_append(&cached->lru_link, &pager_lru);
+	return cached;
+}
+
+/** Page in a page of a file-backed area.
+ *
+ * ARG1 is the offset of the page within the area, ARG3 the file handle and
+ * ARG4 the (page-aligned) file offset at which the area starts.
+ *
+ * The pages are kept in a cache shared by all clients, so that the areas
+ * mapping the same part of the same file share the physical frames. The
+ * kernel maps a private copy of the frame into writable areas, so that
+ * the cached page cannot be modified.
+ */
+void vfs_page_in(cap_call_handle_t req_handle, ipc_call_t *request)
+{
+	aoff64_t offset = IPC_GET_ARG1(*request) + IPC_GET_ARG4(*request);
+	size_t page_size = IPC_GET_ARG2(*request);
+	int fd = IPC_GET_ARG3(*request);
+	vfs_node_t *node;
+	void *page;
+	errno_t rc;
+
+	rc = pager_node_get(fd, &node);
+	if (rc != EOK) {
+		async_answer_0(req_handle, rc);
+		return;
+	}
+
+	fibril_mutex_lock(&pager_mutex);
+
+	pager_page_t *cached = pager_cache_find(node, offset);
+	if (cached != NULL) {
+		/*
+		 * The kernel takes its own reference to the frame while
+		 * processing the answer, so the page can be evicted
+		 * afterwards.
+		 */
+		async_answer_1(req_handle, EOK, (sysarg_t) cached->page);
+		fibril_mutex_unlock(&pager_mutex);
+		vfs_node_put(node);
+		return;
+	}
+
+	unsigned gen = node->pages_gen;
+	fibril_mutex_unlock(&pager_mutex);
+
+	/* Do not hold the pager mutex while communicating with the FS. */
+	rc = pager_read(fd, offset, page_size, &page);
+	if (rc != EOK) {
+		async_answer_0(req_handle, rc);
+		vfs_node_put(node);
+		return;
+	}
+
+	async_answer_1(req_handle, EOK, (sysarg_t) page);
+
+	pager_cache_insert(node, offset, gen, page);
+	vfs_node_put(node);
+}
+
+/** Copy data of a single page of a file through the page cache.
+ *
+ * @param node		VFS node of the file.
+ * @param fd		File handle.
+ * @param offset	Page-aligned file offset.
+ * @param skip		Offset of the data within the page.
+ * @param buf		Buffer to copy the data into.
+ * @param size		Number of bytes to copy, at most up to the end of
+ *			the page.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t pager_copy(vfs_node_t *node, int fd, aoff64_t offset,
+    size_t skip, void *buf, size_t size)
+{
+	void *page;
+	errno_t rc;
+
+	fibril_mutex_lock(&pager_mutex);
+
+	pager_page_t *cached = pager_cache_find(node, offset);
+	if (cached != NULL) {
+		memcpy(buf, (uint8_t *) cached->page + skip, size);
+		fibril_mutex_unlock(&pager_mutex);
+		return EOK;
+	}
+
+	unsigned gen = node->pages_gen;
+	fibril_mutex_unlock(&pager_mutex);
+
+	rc = pager_read(fd, offset, PAGE_SIZE, &page);
+	if (rc != EOK)
+		return rc;
+
+	memcpy(buf, (uint8_t *) page + skip, size);
+	pager_cache_insert(node, offset, gen, page);
+	return EOK;
+}
+
+/** Read data of a file through the page cache.
+ *
+ * ARG1 is the file handle, ARG2 and ARG3 the lower and upper half of the
+ * file position. The data is sent in a data read of at most
+ * DATA_XFER_LIMIT bytes which follows the request.
+ *
+ * Unlike accessing a file-backed area, reading reports I/O errors to the
+ * client and needs one request for many pages.
+ */
+void vfs_pager_read(cap_call_handle_t req_handle, ipc_call_t *request)
+{
+	int fd = IPC_GET_ARG1(*request);
+	aoff64_t pos = MERGE_LOUP32(IPC_GET_ARG2(*request),
+	    IPC_GET_ARG3(*request));
+	cap_call_handle_t chandle;
+	vfs_node_t *node;
+	size_t size;
+	errno_t rc;
+
+	if (!async_data_read_receive(&chandle, &size)) {
+		async_answer_0(req_handle, EINVAL);
+		return;
+	}
+
+	if (size > DATA_XFER_LIMIT) {
+		async_answer_0(chandle, EINVAL);
+		async_answer_0(req_handle, EINVAL);
+		return;
+	}
+
+	rc = pager_node_get(fd, &node);
+	if (rc != EOK) {
+		async_answer_0(chandle, rc);
+		async_answer_0(req_handle, rc);
+		return;
+	}
+
+	uint8_t *buf = malloc(max(size, 1));
+	if (buf == NULL) {
+		vfs_node_put(node);
+		async_answer_0(chandle, ENOMEM);
+		async_answer_0(req_handle, ENOMEM);
+		return;
+	}
+
+	size_t done = 0;
+	rc = EOK;
+	while (done < size) {
+		aoff64_t offset = ALIGN_DOWN(pos + done, PAGE_SIZE);
+		size_t skip = pos + done - offset;
+		size_t len = min(PAGE_SIZE - skip, size - done);
+
+		rc = pager_copy(node, fd, offset, skip, buf + done, len);
+		if (rc != EOK)
+			break;
+
+		done += len;
+	}
+
+	vfs_node_put(node);
+
+	if (rc != EOK) {
+		free(buf);
+		async_answer_0(chandle, rc);
+		async_answer_0(req_handle, rc);
+		return;
+	}
 
-	/*
-	 * FIXME:
-	 * This is just for now until we implement proper page cache
-	 * management.  Not keeping the pages around in a cache results in
-	 * inherently non-coherent private mappings.
-	 */
-	as_area_destroy(page);
+	rc = async_data_read_finalize(chandle, buf, size);
+	free(buf);
+	async_answer_0(req_handle, rc);
 }
 
 /**